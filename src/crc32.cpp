@@ -0,0 +1,359 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::CRC32.
+ *
+ * This file implements the CRC-32 used by the zip format with a
+ * slice-by-8 table and, on x86-64, with carry-less multiplications.
+ */
+
+#include "crc32.hpp"
+
+#include <array>
+
+#include <zlib.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ZIPIOS_CRC32_PCLMUL 1
+#include <immintrin.h>
+#endif
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The reflected CRC-32 polynomial used by the zip format.
+ */
+std::uint32_t const g_polynomial = 0xEDB88320;
+
+
+typedef std::array<std::array<std::uint32_t, 256>, 8>   tables_t;
+
+
+/** \brief Compute the slice-by-8 tables.
+ *
+ * Table 0 is the usual byte by byte table. Table N gives the CRC of a
+ * byte followed by N zero bytes, which lets us process 8 bytes at once.
+ *
+ * \return The eight tables.
+ */
+constexpr tables_t generate_tables()
+{
+    tables_t tables{};
+    for(std::uint32_t n(0); n < 256; ++n)
+    {
+        std::uint32_t crc(n);
+        for(int k(0); k < 8; ++k)
+        {
+            crc = (crc & 1) != 0 ? (crc >> 1) ^ g_polynomial : crc >> 1;
+        }
+        tables[0][n] = crc;
+    }
+    for(std::uint32_t n(0); n < 256; ++n)
+    {
+        for(std::size_t t(1); t < 8; ++t)
+        {
+            std::uint32_t const previous(tables[t - 1][n]);
+            tables[t][n] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+
+constexpr tables_t g_tables = generate_tables();
+
+
+/** \brief Compute the CRC-32 with the slice-by-8 tables.
+ *
+ * \param[in] crc  The inverted CRC so far.
+ * \param[in] data  The data to add to the CRC.
+ * \param[in] size  The number of bytes in \p data.
+ *
+ * \return The inverted CRC including \p data.
+ */
+std::uint32_t update_slice_by_8(std::uint32_t crc, unsigned char const * data, std::size_t size)
+{
+    // the bytes are assembled one by one so this works on any endianness
+    //
+    while(size >= 8)
+    {
+        std::uint32_t const lo(crc
+                ^ (static_cast<std::uint32_t>(data[0])
+                 | static_cast<std::uint32_t>(data[1]) << 8
+                 | static_cast<std::uint32_t>(data[2]) << 16
+                 | static_cast<std::uint32_t>(data[3]) << 24));
+        crc = g_tables[7][lo & 0xFF]
+            ^ g_tables[6][(lo >> 8) & 0xFF]
+            ^ g_tables[5][(lo >> 16) & 0xFF]
+            ^ g_tables[4][lo >> 24]
+            ^ g_tables[3][data[4]]
+            ^ g_tables[2][data[5]]
+            ^ g_tables[1][data[6]]
+            ^ g_tables[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+
+    for(; size > 0; --size, ++data)
+    {
+        crc = (crc >> 8) ^ g_tables[0][(crc ^ *data) & 0xFF];
+    }
+
+    return crc;
+}
+
+
+#ifdef ZIPIOS_CRC32_PCLMUL
+/** \brief Compute the CRC-32 by folding with carry-less multiplications.
+ *
+ * This function uses the PCLMULQDQ instruction to fold 64 bytes at a
+ * time in four 128 bit registers, then folds the registers into one
+ * and reduces the result to 32 bits with a Barrett reduction. This is
+ * the algorithm described by Intel in "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction".
+ *
+ * \param[in] crc  The inverted CRC so far.
+ * \param[in] data  The data to add to the CRC, at least 64 bytes.
+ * \param[in] size  The number of bytes in \p data, a multiple of 16.
+ *
+ * \return The inverted CRC including \p data.
+ */
+__attribute__((target("pclmul,sse4.1")))
+std::uint32_t update_pclmul(std::uint32_t crc, unsigned char const * data, std::size_t size)
+{
+    // x^(4*128+64) mod P, x^(4*128) mod P (bit reflected and shifted)
+    __m128i const k1k2(_mm_set_epi64x(0x01C6E41596, 0x0154442BD4));
+    // x^(128+64) mod P, x^128 mod P
+    __m128i const k3k4(_mm_set_epi64x(0x00CCAA009E, 0x01751997D0));
+    // x^64 mod P
+    __m128i const k5k0(_mm_set_epi64x(0x0000000000, 0x0163CD6124));
+    // P' and mu for the Barrett reduction
+    __m128i const poly(_mm_set_epi64x(0x01F7011641, 0x01DB710641));
+    __m128i const mask32(_mm_setr_epi32(~0, 0, ~0, 0));
+
+    __m128i x1(_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x00)));
+    __m128i x2(_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x10)));
+    __m128i x3(_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x20)));
+    __m128i x4(_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x30)));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    data += 64;
+    size -= 64;
+
+    // fold 64 bytes at a time
+    //
+    while(size >= 64)
+    {
+        __m128i const x5(_mm_clmulepi64_si128(x1, k1k2, 0x00));
+        __m128i const x6(_mm_clmulepi64_si128(x2, k1k2, 0x00));
+        __m128i const x7(_mm_clmulepi64_si128(x3, k1k2, 0x00));
+        __m128i const x8(_mm_clmulepi64_si128(x4, k1k2, 0x00));
+
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + 0x30)));
+
+        data += 64;
+        size -= 64;
+    }
+
+    // fold the four registers into one
+    //
+    __m128i x5(_mm_clmulepi64_si128(x1, k3k4, 0x00));
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // fold the remaining 16 bytes blocks
+    //
+    while(size >= 16)
+    {
+        x2 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        data += 16;
+        size -= 16;
+    }
+
+    // fold 128 bits to 64 bits
+    //
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    //
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<std::uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+
+/** \brief Check whether the CPU supports the carry-less multiplication.
+ *
+ * \return true if update_pclmul() can be used.
+ */
+bool has_pclmul()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul")
+        && __builtin_cpu_supports("sse4.1");
+}
+
+
+/** \brief Whether update_pclmul() gets used.
+ *
+ * The CPU is checked once, when the library gets loaded.
+ */
+bool const g_use_pclmul = has_pclmul();
+#endif
+
+
+} // no name namespace
+
+
+/** \class CRC32
+ * \brief Compute CRC-32 checksums.
+ *
+ * The zip format protects the data of each entry with a CRC-32. zlib
+ * offers a crc32() function, but it is table driven and it quickly
+ * becomes the bottleneck when reading or writing large STORED entries.
+ *
+ * This class computes the same checksum. On x86-64 processors which
+ * support the PCLMULQDQ instruction, large buffers get folded 64 bytes
+ * at a time with carry-less multiplications. Otherwise, or for small
+ * buffers and the tail of large buffers, the CRC is computed with the
+ * slice-by-8 algorithm. The CPU is checked once at runtime so the same
+ * binary works on any x86-64 processor.
+ */
+
+
+/** \brief Add data to a CRC-32.
+ *
+ * This function works like zlib's crc32(): start with a \p crc of 0
+ * and pass the result of the previous call to compute the CRC of data
+ * split in multiple buffers.
+ *
+ * \param[in] crc  The CRC of the data so far.
+ * \param[in] data  The data to add to the CRC.
+ * \param[in] size  The number of bytes in \p data.
+ *
+ * \return The CRC including \p data.
+ */
+std::uint32_t CRC32::update(std::uint32_t crc, void const * data, std::size_t size)
+{
+    unsigned char const * buf(reinterpret_cast<unsigned char const *>(data));
+    crc = ~crc;
+
+#ifdef ZIPIOS_CRC32_PCLMUL
+    // below 256 bytes, the setup and reduction cost more than the tables
+    //
+    if(g_use_pclmul
+    && size >= 256)
+    {
+        std::size_t const blocks(size & ~static_cast<std::size_t>(15));
+        crc = update_pclmul(crc, buf, blocks);
+        buf += blocks;
+        size -= blocks;
+    }
+#endif
+
+    return ~update_slice_by_8(crc, buf, size);
+}
+
+
+/** \brief Concatenate two CRC-32.
+ *
+ * This function returns the CRC of the data of \p crc1 followed by the
+ * \p size2 bytes of data of \p crc2, as if update() had been called
+ * on both buffers one after the other. This is used to compute the CRC
+ * of data processed in separate blocks by multiple threads.
+ *
+ * \param[in] crc1  The CRC of the first buffer.
+ * \param[in] crc2  The CRC of the second buffer.
+ * \param[in] size2  The number of bytes in the second buffer.
+ *
+ * \return The CRC of both buffers.
+ */
+std::uint32_t CRC32::combine(std::uint32_t crc1, std::uint32_t crc2, std::size_t size2)
+{
+    return static_cast<std::uint32_t>(crc32_combine(crc1, crc2, static_cast<z_off_t>(size2)));
+}
+
+
+/** \brief Get the name of the implementation in use.
+ *
+ * This function is mainly useful for tests and benchmarks.
+ *
+ * \return "pclmul" or "slice-by-8".
+ */
+char const * CRC32::getImplementation()
+{
+#ifdef ZIPIOS_CRC32_PCLMUL
+    if(g_use_pclmul)
+    {
+        return "pclmul";
+    }
+#endif
+
+    return "slice-by-8";
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef CRC32_HPP
+#define CRC32_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+/** \file
+ * \brief The header file for zipios::CRC32
+ *
+ * The zipios::CRC32 class computes the CRC-32 checksums of the
+ * entries data.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace zipios
+{
+
+
+class CRC32
+{
+public:
+    static std::uint32_t        update(std::uint32_t crc, void const * data, std::size_t size);
+    static std::uint32_t        combine(std::uint32_t crc1, std::uint32_t crc2, std::size_t size2);
+    static char const *         getImplementation();
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -29,12 +29,106 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
+#include "streampool.hpp"
 #include "zipios_common.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <thread>
+
 
 namespace zipios
 {
 
+
+namespace
+{
+
+
+/** \brief The size of the deflate window.
+ *
+ * When compressing blocks in parallel, each block gets primed with
+ * this many bytes of the data preceding it, which is all that deflate
+ * can reference.
+ */
+std::size_t const g_dictionary_size = 32 * 1024;
+
+
+/** \brief Compress one block of a parallel deflation.
+ *
+ * This function compresses \p size bytes of \p data with the raw
+ * deflate stream \p zs, fresh from the StreamPool, after priming it
+ * with \p dictionary, the data preceding the block.
+ *
+ * Unless it is the \p last block, the data ends with a Z_SYNC_FLUSH
+ * so it ends on a byte boundary without a final block. This way the
+ * output of the consecutive blocks can be concatenated as is to form
+ * one valid deflate stream.
+ *
+ * \exception IOException
+ * This exception is raised if a zlib function fails.
+ *
+ * \param[in,out] zs  The z_stream used to compress the block.
+ * \param[in] dictionary  The data preceding this block.
+ * \param[in] dictionary_size  The size of \p dictionary, possibly 0.
+ * \param[in] data  The data of the block.
+ * \param[in] size  The size of \p data.
+ * \param[in] last  Whether this is the last block of the stream.
+ * \param[out] output  The compressed data.
+ */
+void deflate_block(
+          z_stream * zs
+        , char const * dictionary
+        , std::size_t dictionary_size
+        , char * data
+        , std::size_t size
+        , bool last
+        , std::vector<char> & output)
+{
+    if(dictionary_size > 0)
+    {
+        int const err(deflateSetDictionary(zs, reinterpret_cast<Bytef const *>(dictionary), static_cast<uInt>(dictionary_size)));
+        if(err != Z_OK)
+        {
+            throw IOException(std::string("DeflateOutputStreambuf: deflateSetDictionary() failed: ") + zError(err)); // LCOV_EXCL_LINE
+        }
+    }
+
+    zs->next_in = reinterpret_cast<Bytef *>(data);
+    zs->avail_in = static_cast<uInt>(size);
+
+    int const flush(last ? Z_FINISH : Z_SYNC_FLUSH);
+    output.resize(deflateBound(zs, static_cast<uLong>(size)) + 16);
+    std::size_t used(0);
+    for(;;)
+    {
+        zs->next_out = reinterpret_cast<Bytef *>(output.data() + used);
+        zs->avail_out = static_cast<uInt>(output.size() - used);
+        int const err(deflate(zs, flush));
+        used = output.size() - zs->avail_out;
+
+        // a flush is complete once deflate() leaves room in the output
+        //
+        if(err == Z_STREAM_END
+        || (err == Z_OK && !last && zs->avail_out != 0))
+        {
+            break;
+        }
+        if(err != Z_OK
+        && err != Z_BUF_ERROR)
+        {
+            throw IOException(std::string("DeflateOutputStreambuf: deflate() failed: ") + zError(err)); // LCOV_EXCL_LINE
+        }
+        output.resize(output.size() * 2); // LCOV_EXCL_LINE
+    }
+    output.resize(used);
+}
+
+
+} // no name namespace
+
+
 /** \class DeflateOutputStreambuf
  * \brief A class to handle stream deflate on the fly.
  *
@@ -44,6 +138,10 @@ namespace zipios
  * compression/decompression method used in gzip and zip. The zlib
  * library is used to perform the actual deflation, this class only
  * wraps the functionality in an output stream filter.
+ *
+ * With setInflateIndex(), the stream saves access points in an
+ * InflateIndex as it compresses the data, so the data can later be read
+ * from the middle without building the index by inflating it all.
  */
 
 
@@ -56,8 +154,8 @@ namespace zipios
  */
 DeflateOutputStreambuf::DeflateOutputStreambuf(std::streambuf * outbuf)
     : FilterOutputStreambuf(outbuf)
-    , m_invec(getBufferSize())
-    , m_outvec(getBufferSize())
+    , m_invec(StreamPool::acquireBuffer())
+    , m_outvec(StreamPool::acquireBuffer())
 {
     // NOTICE: It is important that this constructor and the methods it
     //         calls do not do anything with the output streambuf m_outbuf.
@@ -73,11 +171,15 @@ DeflateOutputStreambuf::DeflateOutputStreambuf(std::streambuf * outbuf)
  * then makes sure that the remaining data from zlib is printed in
  * the output file.
  *
- * This is similar to calling closeStream() explicitly.
+ * This is similar to calling closeStream() explicitly. The buffers
+ * are then returned to the StreamPool.
  */
 DeflateOutputStreambuf::~DeflateOutputStreambuf()
 {
     closeStream();
+
+    StreamPool::releaseBuffer(m_invec);
+    StreamPool::releaseBuffer(m_outvec);
 }
 
 
@@ -108,8 +210,6 @@ bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level)
     }
     m_zs_initialized = true;
 
-    int const default_mem_level(8);
-
     int zlevel(Z_NO_COMPRESSION);
     switch(compression_level)
     {
@@ -152,36 +252,122 @@ bool DeflateOutputStreambuf::init(FileEntry::CompressionLevel compression_level)
 
     }
 
-    // m_zs.next_in and avail_in must be set according to
+    //
+    // the StreamPool initializes the z_stream with -MAX_WBITS to tell that
+    // no zlib header should be written; a z_stream used for a previous
+    // entry with the same level gets reused
+    //
+    m_zlevel = zlevel;
+    m_zs = StreamPool::acquireDeflate(zlevel);
+
+    // m_zs->next_in and avail_in must be set according to
     // zlib.h (inline doc).
-    m_zs.next_in  = reinterpret_cast<unsigned char *>(&m_invec[0]);
-    m_zs.avail_in = 0;
+    m_zs->next_in  = reinterpret_cast<unsigned char *>(&m_invec[0]);
+    m_zs->avail_in = 0;
 
-    m_zs.next_out  = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-    m_zs.avail_out = getBufferSize();
+    m_zs->next_out  = reinterpret_cast<unsigned char *>(&m_outvec[0]);
+    m_zs->avail_out = getBufferSize();
 
-    //
-    // windowBits is passed -MAX_WBITS to tell that no zlib
-    // header should be written.
-    //
-    int const err = deflateInit2(&m_zs, zlevel, Z_DEFLATED, -MAX_WBITS, default_mem_level, Z_DEFAULT_STRATEGY);
-    if(err != Z_OK)
+    // streambuf init:
+    setp(&m_invec[0], &m_invec[0] + getBufferSize());
+
+    m_crc32 = 0;
+    m_overflown_bytes = 0;
+    m_deflated_bytes = 0;
+
+    m_threads = 0;
+    m_block_size = 0;
+    m_pending.clear();
+    m_dictionary.clear();
+
+    m_index.reset();
+
+    return true;
+}
+
+
+/** \brief Compress the data with multiple threads.
+ *
+ * This function must be called after init() and before any data gets
+ * written. It makes the stream compress the data in blocks of
+ * \p block_size bytes, \p threads blocks at a time, each block in
+ * its own thread, the way pigz does.
+ *
+ * Each block gets primed with the last 32Kb of the data preceding it,
+ * so the compression ratio is barely affected. All the blocks but the
+ * last end with a Z_SYNC_FLUSH, which adds a few bytes per block but
+ * makes the output of all the blocks one valid deflate stream which
+ * any inflater can read. The CRC32 of the blocks is computed in the
+ * same threads and then combined.
+ *
+ * The output is not the same as the output of the single threaded
+ * compression. The memory used is about \p threads times \p block_size
+ * for the data and as much for the compressed data.
+ *
+ * The parallel mode lasts until the stream gets closed. Calling this
+ * function with \p threads set to 0 or 1 keeps the single threaded
+ * compression.
+ *
+ * \param[in] threads  The number of blocks to compress in parallel.
+ * \param[in] block_size  The size of one block, at least 32Kb.
+ */
+void DeflateOutputStreambuf::setParallel(std::size_t threads, std::size_t block_size)
+{
+    if(!m_zs_initialized
+    || m_overflown_bytes != 0
+    || pptr() != pbase())
     {
-        // Not too sure how we could generate an error here, the deflateInit2()
-        // would fail if (1) there is not enough memory and (2) if a parameter
-        // is out of wack which neither can be generated from the outside
-        // (well... not easily)
-        std::ostringstream msgs; // LCOV_EXCL_LINE
-        msgs << "DeflateOutputStreambuf::init(): error while initializing zlib, " << zError(err) << std::endl; // LCOV_EXCL_LINE
-        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+        throw std::logic_error("DeflateOutputStreambuf::setParallel() must be called after init() and before any data was written."); // LCOV_EXCL_LINE
     }
 
-    // streambuf init:
-    setp(&m_invec[0], &m_invec[0] + getBufferSize());
+    if(threads <= 1)
+    {
+        m_threads = 0;
+        return;
+    }
 
-    m_crc32 = crc32(0, Z_NULL, 0);
+    m_threads = threads;
+    m_block_size = std::max(block_size, g_dictionary_size);
+    m_pending.reserve(m_threads * m_block_size + getBufferSize());
+}
 
-    return err == Z_OK;
+
+/** \brief Save access points in an index while compressing.
+ *
+ * This function must be called after init() and before any data gets
+ * compressed. Each time the data written to the stream goes one span
+ * of the \p index past the last access point, the deflate stream gets
+ * a sync flush, which ends it on a byte boundary, and an access point
+ * with the last 32Kb of data gets added to \p index. When compressing
+ * in parallel, the access points are placed at the start of the blocks,
+ * which already end with a sync flush.
+ *
+ * Since this data is all available while compressing, the index comes
+ * for free, where building it afterward requires inflating all the data.
+ * The compressed data remains one valid deflate stream.
+ *
+ * The offsets of the access points are relative to the start of the
+ * file which includes this deflate stream. \p in_offset is the offset
+ * of the deflate stream in that file and \p out_offset the offset of
+ * its data in the uncompressed data of that file.
+ *
+ * The index is detached by the next call to init().
+ *
+ * \param[in] index  The index receiving the access points.
+ * \param[in] in_offset  The offset of the compressed data in the file.
+ * \param[in] out_offset  The offset of the uncompressed data.
+ */
+void DeflateOutputStreambuf::setInflateIndex(InflateIndex::pointer_t index, offset_t in_offset, offset_t out_offset)
+{
+    if(!m_zs_initialized
+    || m_overflown_bytes != 0)
+    {
+        throw std::logic_error("DeflateOutputStreambuf::setInflateIndex() must be called after init() and before any data was compressed."); // LCOV_EXCL_LINE
+    }
+
+    m_index = index;
+    m_index_in = in_offset;
+    m_index_out = out_offset;
 }
 
 
@@ -206,15 +392,14 @@ void DeflateOutputStreambuf::closeStream()
         // flush any remaining data
         endDeflation();
 
-        int const err(deflateEnd(&m_zs));
-        if(err != Z_OK) // when we close a directory, we get the Z_DATA_ERROR!
-        {
-            // There are not too many cases which break the deflateEnd()
-            // function call...
-            std::ostringstream msgs; // LCOV_EXCL_LINE
-            msgs << "DeflateOutputStreambuf::closeStream(): deflateEnd failed: " << zError(err) << std::endl; // LCOV_EXCL_LINE
-            throw IOException(msgs.str()); // LCOV_EXCL_LINE
-        }
+        // free the parallel compression buffers
+        m_threads = 0;
+        std::vector<char>().swap(m_pending);
+        std::vector<char>().swap(m_dictionary);
+
+        // give the z_stream back for the next entry
+        StreamPool::releaseDeflate(m_zs, m_zlevel);
+        m_zs = nullptr;
     }
 }
 
@@ -254,6 +439,20 @@ size_t DeflateOutputStreambuf::getSize() const
 }
 
 
+/** \brief Retrieve the size of the compressed data.
+ *
+ * This function returns the number of bytes of compressed data written
+ * to the output streambuf since the last call to init(). After
+ * closeStream() was called, this is the size of the deflate stream.
+ *
+ * \return The number of bytes of compressed data written.
+ */
+size_t DeflateOutputStreambuf::getDeflatedSize() const
+{
+    return m_deflated_bytes;
+}
+
+
 /** \brief Handle an overflow.
  *
  * This function is called by the streambuf implementation whenever
@@ -269,27 +468,82 @@ size_t DeflateOutputStreambuf::getSize() const
  */
 int DeflateOutputStreambuf::overflow(int c)
 {
+    if(m_threads > 1)
+    {
+        // buffer the data until we have one block per thread; the last
+        // block is kept until more data arrives since it may end the
+        // stream
+        //
+        std::size_t const size(pptr() - pbase());
+        m_overflown_bytes += size;
+        m_pending.insert(m_pending.end(), m_invec.data(), m_invec.data() + size);
+
+        std::size_t const batch_size(m_threads * m_block_size);
+        while(m_pending.size() > batch_size)
+        {
+            deflateBlocks(batch_size, false);
+        }
+
+        setp(&m_invec[0], &m_invec[0] + getBufferSize());
+
+        if(c != EOF)
+        {
+            *pptr() = c;
+            pbump(1);
+        }
+
+        return 0;
+    }
+
     int err(Z_OK);
 
-    m_zs.avail_in = pptr() - pbase();
-    m_zs.next_in = reinterpret_cast<unsigned char *>(&m_invec[0]);
+    m_zs->avail_in = pptr() - pbase();
+    m_zs->next_in = reinterpret_cast<unsigned char *>(&m_invec[0]);
+    m_overflown_bytes += m_zs->avail_in;
 
-    if(m_zs.avail_in > 0)
+    if(m_zs->avail_in > 0)
     {
-        m_crc32 = crc32(m_crc32, m_zs.next_in, m_zs.avail_in); // update crc32
+        m_crc32 = CRC32::update(m_crc32, m_zs->next_in, m_zs->avail_in); // update crc32
 
-        m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-        m_zs.avail_out = getBufferSize();
+        m_zs->next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
+        m_zs->avail_out = getBufferSize();
 
         // Deflate until m_invec is empty.
-        while((m_zs.avail_in > 0 || m_zs.avail_out == 0) && err == Z_OK)
+        while((m_zs->avail_in > 0 || m_zs->avail_out == 0) && err == Z_OK)
         {
-            if(m_zs.avail_out == 0)
+            if(m_zs->avail_out == 0)
             {
                 flushOutvec();
             }
 
-            err = deflate(&m_zs, Z_NO_FLUSH);
+            err = deflate(m_zs, Z_NO_FLUSH);
+        }
+
+        if(m_index != nullptr
+        && err == Z_OK
+        && m_index->needsCheckpoint(m_index_out + m_overflown_bytes))
+        {
+            // the sync flush ends the deflate data on a byte boundary
+            // and only returns once all the pending output was written
+            //
+            do
+            {
+                flushOutvec();
+                err = deflate(m_zs, Z_SYNC_FLUSH);
+            }
+            while(err == Z_OK && m_zs->avail_out == 0);
+            flushOutvec();
+
+            std::vector<char> window(g_dictionary_size);
+            uInt size(static_cast<uInt>(window.size()));
+            if(err == Z_OK)
+            {
+                err = deflateGetDictionary(m_zs, reinterpret_cast<Bytef *>(window.data()), &size);
+            }
+            if(err == Z_OK)
+            {
+                addCheckpoint(m_index_out + m_overflown_bytes, window.data(), size);
+            }
         }
     }
 
@@ -341,7 +595,7 @@ int DeflateOutputStreambuf::sync() // LCOV_EXCL_LINE
 /** \brief Flush the cached output data.
  *
  * This function flushes m_outvec and updates the output pointer
- * and size m_zs.next_out and m_zs.avail_out.
+ * and size m_zs->next_out and m_zs->avail_out.
  */
 void DeflateOutputStreambuf::flushOutvec()
 {
@@ -350,7 +604,7 @@ void DeflateOutputStreambuf::flushOutvec()
      * flow through without the need to have this crap of bytes to
      * skip...
      */
-    std::size_t const deflated_bytes(getBufferSize() - m_zs.avail_out);
+    std::size_t const deflated_bytes(getBufferSize() - m_zs->avail_out);
     if(deflated_bytes > 0)
     {
         std::size_t const bc(m_outbuf->sputn(&m_outvec[0], deflated_bytes));
@@ -361,10 +615,11 @@ void DeflateOutputStreambuf::flushOutvec()
             // inside the same loop in ZipFile::saveCollectionToArchive()
             throw IOException("DeflateOutputStreambuf::flushOutvec(): write to buffer failed."); // LCOV_EXCL_LINE
         }
+        m_deflated_bytes += bc;
     }
 
-    m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-    m_zs.avail_out = getBufferSize();
+    m_zs->next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
+    m_zs->avail_out = getBufferSize();
 }
 
 
@@ -378,8 +633,17 @@ void DeflateOutputStreambuf::endDeflation()
 {
     overflow();
 
-    m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
-    m_zs.avail_out = getBufferSize();
+    if(m_threads > 1)
+    {
+        if(m_overflown_bytes > 0)
+        {
+            deflateBlocks(m_pending.size(), true);
+        }
+        return;
+    }
+
+    m_zs->next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
+    m_zs->avail_out = getBufferSize();
 
     // Deflate until _invec is empty.
     int err(Z_OK);
@@ -393,12 +657,12 @@ void DeflateOutputStreambuf::endDeflation()
     {
         while(err == Z_OK)
         {
-            if(m_zs.avail_out == 0)
+            if(m_zs->avail_out == 0)
             {
                 flushOutvec();
             }
 
-            err = deflate(&m_zs, Z_FINISH);
+            err = deflate(m_zs, Z_FINISH);
         }
     }
     else
@@ -423,6 +687,160 @@ void DeflateOutputStreambuf::endDeflation()
 }
 
 
+/** \brief Compress the first \p size bytes of pending data in parallel.
+ *
+ * This function splits the first \p size bytes of m_pending in blocks
+ * of m_block_size bytes and compresses them with one thread per block.
+ * The compressed blocks are then written to the output in order, the
+ * CRC32 of the blocks is combined with the CRC32 of the data so far,
+ * and the compressed data is removed from m_pending. The last 32Kb of
+ * the data are kept in m_dictionary to prime the next block.
+ *
+ * \exception IOException
+ * This exception is raised if the compression or writing the compressed
+ * data fails.
+ *
+ * \param[in] size  The number of bytes to compress, may not be 0.
+ * \param[in] last  Whether this is the end of the data, in which case
+ *                  the last block finishes the deflate stream.
+ */
+void DeflateOutputStreambuf::deflateBlocks(std::size_t size, bool last)
+{
+    std::size_t const count((size + m_block_size - 1) / m_block_size);
+
+    std::vector<z_stream *> streams(count);
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        streams[idx] = StreamPool::acquireDeflate(m_zlevel);
+    }
+    std::vector<std::vector<char>> outputs(count);
+    std::vector<uint32_t> crcs(count);
+    std::vector<std::exception_ptr> errors(count);
+
+    auto compress([this, size, last, count, &streams, &outputs, &crcs, &errors](std::size_t idx) noexcept
+        {
+            try
+            {
+                char * block(m_pending.data() + idx * m_block_size);
+                std::size_t const length(std::min(m_block_size, size - idx * m_block_size));
+                crcs[idx] = CRC32::update(0, block, length);
+                if(idx == 0)
+                {
+                    deflate_block(streams[idx], m_dictionary.data(), m_dictionary.size(), block, length, last && count == 1, outputs[idx]);
+                }
+                else
+                {
+                    deflate_block(streams[idx], block - g_dictionary_size, g_dictionary_size, block, length, last && idx + 1 == count, outputs[idx]);
+                }
+            }
+            catch(...)
+            {
+                errors[idx] = std::current_exception();
+            }
+        });
+
+    // the calling thread compresses the first block
+    //
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    try
+    {
+        for(std::size_t idx(1); idx < count; ++idx)
+        {
+            threads.emplace_back(compress, idx);
+        }
+    }
+    catch(...)
+    {
+        // LCOV_EXCL_START
+        for(auto it(threads.begin()); it != threads.end(); ++it)
+        {
+            it->join();
+        }
+        for(std::size_t idx(0); idx < count; ++idx)
+        {
+            StreamPool::releaseDeflate(streams[idx], m_zlevel);
+        }
+        throw;
+        // LCOV_EXCL_STOP
+    }
+    compress(0);
+    for(auto it(threads.begin()); it != threads.end(); ++it)
+    {
+        it->join();
+    }
+
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        StreamPool::releaseDeflate(streams[idx], m_zlevel);
+    }
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        if(errors[idx] != nullptr)
+        {
+            std::rethrow_exception(errors[idx]); // LCOV_EXCL_LINE
+        }
+    }
+
+    // all the blocks start on a byte boundary, after the sync flush of
+    // the previous block, so they are all possible access points
+    //
+    offset_t const start(m_index_out + static_cast<offset_t>(m_overflown_bytes - m_pending.size()));
+    for(std::size_t idx(0); idx < count; ++idx)
+    {
+        std::size_t const length(std::min(m_block_size, size - idx * m_block_size));
+        m_crc32 = CRC32::combine(m_crc32, crcs[idx], length);
+
+        offset_t const out(start + static_cast<offset_t>(idx * m_block_size));
+        if(m_index != nullptr
+        && m_index->needsCheckpoint(out))
+        {
+            if(idx == 0)
+            {
+                addCheckpoint(out, m_dictionary.data(), m_dictionary.size());
+            }
+            else
+            {
+                addCheckpoint(out, m_pending.data() + idx * m_block_size - g_dictionary_size, g_dictionary_size);
+            }
+        }
+
+        std::size_t const bc(m_outbuf->sputn(outputs[idx].data(), outputs[idx].size()));
+        if(outputs[idx].size() != bc)
+        {
+            throw IOException("DeflateOutputStreambuf::deflateBlocks(): write to buffer failed."); // LCOV_EXCL_LINE
+        }
+        m_deflated_bytes += bc;
+    }
+
+    if(!last)
+    {
+        m_dictionary.assign(m_pending.data() + size - g_dictionary_size, m_pending.data() + size);
+        m_pending.erase(m_pending.begin(), m_pending.begin() + size);
+    }
+}
+
+
+/** \brief Add an access point to the index.
+ *
+ * This function saves an access point at the current end of the
+ * compressed data, which must be on a byte boundary.
+ *
+ * \param[in] out  The offset of the access point in the uncompressed data.
+ * \param[in] window  The data which precedes the access point.
+ * \param[in] size  The size of \p window, at most 32Kb.
+ */
+void DeflateOutputStreambuf::addCheckpoint(offset_t out, char const * window, std::size_t size)
+{
+    InflateIndex::checkpoint_t checkpoint;
+    checkpoint.m_out = out;
+    checkpoint.m_in = m_index_in + static_cast<offset_t>(m_deflated_bytes);
+    checkpoint.m_window.assign(window, window + size);
+
+    m_index->addCheckpoint(checkpoint);
+}
+
+
 } // namespace
 
 // Local Variables:
@@ -33,6 +33,7 @@
  */
 
 #include "filteroutputstreambuf.hpp"
+#include "inflateindex.hpp"
 
 #include "zipios/fileentry.hpp"
 
@@ -54,26 +55,42 @@ public:
     DeflateOutputStreambuf & operator = (DeflateOutputStreambuf const & rhs) = delete;
 
     bool                    init(FileEntry::CompressionLevel compression_level);
+    void                    setParallel(std::size_t threads, std::size_t block_size);
+    void                    setInflateIndex(InflateIndex::pointer_t index, offset_t in_offset, offset_t out_offset);
     void                    closeStream();
     uint32_t                getCrc32() const;
     size_t                  getSize() const;
+    size_t                  getDeflatedSize() const;
 
 protected:
     virtual int             overflow(int c = EOF);
     virtual int             sync();
 
-    uint32_t                m_overflown_bytes = 0;
+    size_t                  m_overflown_bytes = 0;
     std::vector<char>       m_invec = std::vector<char>();
     uint32_t                m_crc32 = 0;
 
 private:
     void                    endDeflation();
     void                    flushOutvec();
+    void                    deflateBlocks(std::size_t size, bool last);
+    void                    addCheckpoint(offset_t out, char const * window, std::size_t size);
 
-    z_stream                m_zs = z_stream();
+    z_stream *              m_zs = nullptr;
+    int                     m_zlevel = Z_DEFAULT_COMPRESSION;
     bool                    m_zs_initialized = false;
 
     std::vector<char>       m_outvec = std::vector<char>();
+    size_t                  m_deflated_bytes = 0;
+
+    std::size_t             m_threads = 0;
+    std::size_t             m_block_size = 0;
+    std::vector<char>       m_pending = std::vector<char>();
+    std::vector<char>       m_dictionary = std::vector<char>();
+
+    InflateIndex::pointer_t m_index = InflateIndex::pointer_t();
+    offset_t                m_index_in = 0;
+    offset_t                m_index_out = 0;
 };
 
 
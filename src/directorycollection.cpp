@@ -256,6 +256,8 @@ void DirectoryCollection::loadEntries() const
             {
                 const_cast<DirectoryCollection *>(this)->load(FilePath());
             }
+
+            const_cast<DirectoryCollection *>(this)->indexEntries();
         }
         catch(...)
         {
@@ -30,6 +30,7 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "zipios_common.hpp"
 
 #include <fstream>
@@ -135,7 +136,7 @@ bool DirectoryEntry::isEqual(FileEntry const & file_entry) const
  */
 uint32_t DirectoryEntry::computeCRC32() const
 {
-    uint32_t result(crc32(0L, Z_NULL, 0));
+    uint32_t result(0);
 
     if(!m_filename.isDirectory())
     {
@@ -160,7 +161,7 @@ uint32_t DirectoryEntry::computeCRC32() const
             {
                 break;
             }
-            result = crc32(result, buf, in.gcount());
+            result = CRC32::update(result, buf, in.gcount());
         }
     }
 
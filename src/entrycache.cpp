@@ -0,0 +1,311 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::EntryCache.
+ *
+ * This file implements a least recently used cache of the decompressed
+ * data of Zip archive entries, limited by a number of bytes.
+ */
+
+#include "entrycache.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class EntryCache
+ * \brief A byte budgeted LRU cache of decompressed entries.
+ *
+ * The EntryCache keeps the decompressed data of entries which were
+ * read from a ZipFile. The data of an entry is identified by the offset
+ * of its local header in the archive.
+ *
+ * The cache is limited by a budget in bytes. When adding an entry makes
+ * the cache go over that budget, the least recently used entries get
+ * evicted. An entry larger than the budget is never cached.
+ *
+ * The data is shared with the streams reading it, so an entry evicted
+ * from the cache remains valid until the last stream using it is
+ * destroyed.
+ *
+ * The cache also holds the InflateIndex of the entries read with
+ * ZipFile::OPEN_MODE_SEEKABLE so all the streams reading an entry share
+ * the same access points. These indexes are not part of the budget.
+ *
+ * Finally, it remembers which STORED entries of a memory mapped archive
+ * had their CRC32 verified, so their data gets checked only once.
+ *
+ * All the functions are protected by a mutex so the cache can be used
+ * by multiple threads at the same time.
+ */
+
+
+/** \typedef std::shared_ptr<buffer_t const> EntryCache::data_t;
+ * \brief The decompressed data of an entry.
+ *
+ * The data of an entry is held by a shared pointer so it can be
+ * returned to the caller without copying it.
+ */
+
+
+/** \brief Initialize the cache.
+ *
+ * The cache starts empty. With a budget of zero, it is disabled.
+ *
+ * \param[in] budget  The maximum number of bytes kept in the cache.
+ */
+EntryCache::EntryCache(std::size_t budget)
+    : m_budget(budget)
+{
+}
+
+
+/** \brief Clean up the cache.
+ *
+ * The destructor releases the cached data. Streams still reading some
+ * of that data keep their own reference to it.
+ */
+EntryCache::~EntryCache()
+{
+}
+
+
+/** \brief Change the budget of the cache.
+ *
+ * This function changes the maximum number of bytes kept in the cache.
+ * If the cache currently holds more than \p budget bytes, the least
+ * recently used entries are evicted immediately.
+ *
+ * Setting the budget to zero disables the cache and releases all of
+ * its data.
+ *
+ * \param[in] budget  The new maximum number of bytes.
+ */
+void EntryCache::setBudget(std::size_t budget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_budget = budget;
+    evict();
+}
+
+
+/** \brief Retrieve the budget of the cache.
+ *
+ * \return The maximum number of bytes kept in the cache; 0 if the cache
+ *         is disabled.
+ */
+std::size_t EntryCache::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_budget;
+}
+
+
+/** \brief Retrieve the statistics of the cache.
+ *
+ * This function returns the number of hits, misses and evictions since
+ * the cache was created, and the current number of entries and bytes
+ * in the cache.
+ *
+ * \return A copy of the cache statistics.
+ */
+ZipFile::CacheStatistics EntryCache::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ZipFile::CacheStatistics statistics;
+    statistics.m_hits = m_hits;
+    statistics.m_misses = m_misses;
+    statistics.m_evictions = m_evictions;
+    statistics.m_entries = m_items.size();
+    statistics.m_size = m_size;
+    return statistics;
+}
+
+
+/** \brief Search the cache for an entry.
+ *
+ * This function returns the data of the entry at \p key and marks it
+ * as the most recently used entry. Each call counts as a hit or a miss.
+ *
+ * \param[in] key  The offset of the entry local header.
+ *
+ * \return The data of the entry or a null pointer if it is not cached.
+ */
+EntryCache::data_t EntryCache::find(offset_t key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto const it(m_map.find(key));
+    if(it == m_map.end())
+    {
+        ++m_misses;
+        return data_t();
+    }
+
+    ++m_hits;
+    m_items.splice(m_items.begin(), m_items, it->second);
+    return it->second->m_data;
+}
+
+
+/** \brief Add the data of an entry to the cache.
+ *
+ * This function saves \p data as the most recently used entry. If the
+ * entry was already cached, its data gets replaced. Then the least
+ * recently used entries get evicted until the cache fits its budget.
+ *
+ * Data larger than the budget is ignored.
+ *
+ * \param[in] key  The offset of the entry local header.
+ * \param[in] data  The decompressed data of the entry.
+ */
+void EntryCache::insert(offset_t key, data_t data)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(data == nullptr
+    || data->size() > m_budget)
+    {
+        return;
+    }
+
+    auto const it(m_map.find(key));
+    if(it != m_map.end())
+    {
+        m_size -= it->second->m_data->size();
+        m_items.erase(it->second);
+        m_map.erase(it);
+    }
+
+    item_t item;
+    item.m_key = key;
+    item.m_data = data;
+    m_items.push_front(item);
+    m_map[key] = m_items.begin();
+    m_size += data->size();
+
+    evict();
+}
+
+
+/** \brief Remove all the entries from the cache.
+ *
+ * This function releases all the cached data and indexes and forgets
+ * which entries were verified. The statistics are not reset.
+ */
+void EntryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_items.clear();
+    m_map.clear();
+    m_indexes.clear();
+    m_verified.clear();
+    m_size = 0;
+}
+
+
+/** \brief Get the index of access points of an entry.
+ *
+ * This function returns the InflateIndex of the entry at \p key. The
+ * index gets created the first time it is requested.
+ *
+ * \param[in] key  The offset of the entry local header.
+ *
+ * \return The index of the entry.
+ */
+InflateIndex::pointer_t EntryCache::getInflateIndex(offset_t key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    InflateIndex::pointer_t & index(m_indexes[key]);
+    if(index == nullptr)
+    {
+        index = std::make_shared<InflateIndex>();
+    }
+    return index;
+}
+
+
+/** \brief Check whether the data of an entry was verified.
+ *
+ * \param[in] key  The offset of the entry local header.
+ *
+ * \return true if setVerified() was called with \p key.
+ */
+bool EntryCache::isVerified(offset_t key) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_verified.find(key) != m_verified.end();
+}
+
+
+/** \brief Remember that the data of an entry was verified.
+ *
+ * This is used for the STORED entries read directly from the mapping
+ * of the archive, which has to be verified before being returned.
+ *
+ * \param[in] key  The offset of the entry local header.
+ */
+void EntryCache::setVerified(offset_t key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_verified.insert(key);
+}
+
+
+/** \brief Evict entries until the cache fits its budget.
+ *
+ * This function removes the least recently used entries until the
+ * size of the cache is at most its budget.
+ *
+ * The caller must hold the mutex.
+ */
+void EntryCache::evict()
+{
+    while(m_size > m_budget)
+    {
+        item_t const & item(m_items.back());
+        m_size -= item.m_data->size();
+        m_map.erase(item.m_key);
+        m_items.pop_back();
+        ++m_evictions;
+    }
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef ENTRYCACHE_HPP
+#define ENTRYCACHE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+/** \file
+ * \brief The header file for zipios::EntryCache
+ *
+ * The zipios::EntryCache class keeps the decompressed data of the
+ * most recently used entries of a zipios::ZipFile in memory.
+ */
+
+#include "inflateindex.hpp"
+#include "zipios_common.hpp"
+
+#include "zipios/zipfile.hpp"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace zipios
+{
+
+
+class EntryCache
+{
+public:
+    typedef std::shared_ptr<EntryCache>         pointer_t;
+    typedef std::shared_ptr<buffer_t const>     data_t;
+
+                                EntryCache(std::size_t budget = 0);
+                                EntryCache(EntryCache const & rhs) = delete;
+                                ~EntryCache();
+
+    EntryCache &                operator = (EntryCache const & rhs) = delete;
+
+    void                        setBudget(std::size_t budget);
+    std::size_t                 getBudget() const;
+    ZipFile::CacheStatistics    getStatistics() const;
+
+    data_t                      find(offset_t key);
+    void                        insert(offset_t key, data_t data);
+    void                        clear();
+
+    InflateIndex::pointer_t     getInflateIndex(offset_t key);
+    bool                        isVerified(offset_t key) const;
+    void                        setVerified(offset_t key);
+
+private:
+    struct item_t
+    {
+        offset_t                m_key = 0;
+        data_t                  m_data = data_t();
+    };
+
+    typedef std::list<item_t>   list_t;
+
+    void                        evict();
+
+    mutable std::mutex          m_mutex = std::mutex();
+    list_t                      m_items = list_t();
+    std::unordered_map<offset_t, list_t::iterator>
+                                m_map = std::unordered_map<offset_t, list_t::iterator>();
+    std::unordered_map<offset_t, InflateIndex::pointer_t>
+                                m_indexes = std::unordered_map<offset_t, InflateIndex::pointer_t>();
+    std::unordered_set<offset_t>
+                                m_verified = std::unordered_set<offset_t>();
+    std::size_t                 m_budget = 0;
+    std::size_t                 m_size = 0;
+    std::size_t                 m_hits = 0;
+    std::size_t                 m_misses = 0;
+    std::size_t                 m_evictions = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -31,6 +31,8 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "fileentryindex.hpp"
+
 #include <algorithm>
 
 
@@ -50,106 +52,6 @@ namespace
 char const * g_default_filename = "-";
 
 
-/** \brief Class object used with the std::find_if() function.
- *
- * This function object is used with the STL find_if algorithm to
- * find a FileEntry in a container, which name (as obtained with
- * FileEntry::getName()) is identical to the name specified in the
- * MatchName constructor.
- */
-class MatchName
-{
-public:
-    /** \brief Initialize a MatchName object.
-     *
-     * This function saves the name to search in the FileCollection.
-     *
-     * This class expect the name to be a full path and file name
-     * with extension. The full name has to match.
-     *
-     * \param[in] name  The name of the file being searched.
-     */
-    explicit MatchName(std::string const & name)
-        : m_name(name)
-    {
-    }
-
-    /** \brief Compare an entry to this MatchName.
-     *
-     * This function compares the full name of the entry with the
-     * saved full name. If equal, then it returns true. It is used
-     * with the std::find_if() function.
-     *
-     * \todo
-     * We could transform that with lambda at some point.
-     *
-     * \param[in] entry  The entry to compare with the MatchName.
-     *
-     * \return true if the name of the entry matches the MatchName.
-     */
-    bool operator() (FileEntry::pointer_t entry) const
-    {
-        return entry->getName() == m_name;
-    }
-
-private:
-    std::string const       m_name;
-};
-
-
-/** \brief Class object used with the std::find_if() function.
- *
- * This function object is used with the STL find_if algorithm to
- * find a FileEntry in a container, which name (as obtained with
- * FileEntry::getFileName()) is identical to the name specified in the
- * MatchFileName constructor.
- *
- * \warning
- * The file name cannot include a '/' in this case or the search will
- * always fail.
- */
-class MatchFileName
-{
-public:
-    /** \brief Initialize a MatchFileName object.
-     *
-     * This function saves the base name to search in the
-     * FileCollection.
-     *
-     * This class expect the name to be a base file name, eventually with
-     * an extension. If the name includes a slash then the search will
-     * always fail.
-     *
-     * \param[in] name  The name of the file being searched.
-     */
-    explicit MatchFileName(std::string const & name)
-        : m_name(name)
-    {
-    }
-
-    /** \brief Compare an entry to this MatchFileName.
-     *
-     * This function compares the base name of the entry with the
-     * saved base name. If equal, then it returns true. It is used
-     * with the std::find_if() function.
-     *
-     * \todo
-     * We could transform that with lambda at some point.
-     *
-     * \param[in] entry  The entry to compare with the MatchFileName.
-     *
-     * \return true if the name of the entry matches the MatchFileName.
-     */
-    bool operator() (FileEntry::pointer_t entry) const
-    {
-        return entry->getFileName() == m_name;
-    }
-
-private:
-    std::string const       m_name;
-};
-
-
 } // no name namespace
 
 
@@ -268,6 +170,8 @@ private:
  */
 FileCollection::FileCollection(std::string const & filename)
     : m_filename(filename.empty() ? g_default_filename : filename)
+    , m_name_index(std::make_unique<FileEntryIndex>(&FileEntry::getName))
+    , m_filename_index(std::make_unique<FileEntryIndex>(&FileEntry::getFileName))
 {
 }
 
@@ -285,6 +189,8 @@ FileCollection::FileCollection(std::string const & filename)
  */
 FileCollection::FileCollection(FileCollection const & rhs)
     : m_filename(rhs.m_filename)
+    , m_name_index(std::make_unique<FileEntryIndex>(*rhs.m_name_index))
+    , m_filename_index(std::make_unique<FileEntryIndex>(*rhs.m_filename_index))
     , m_valid(rhs.m_valid)
 {
     m_entries.reserve(rhs.m_entries.size());
@@ -321,6 +227,8 @@ FileCollection & FileCollection::operator = (FileCollection const & rhs)
         {
             m_entries.push_back((*it)->clone());
         }
+        *m_name_index = *rhs.m_name_index;
+        *m_filename_index = *rhs.m_filename_index;
 
         m_valid = rhs.m_valid;
     }
@@ -365,6 +273,8 @@ FileCollection::~FileCollection()
 void FileCollection::addEntry(FileEntry const & entry)
 {
     m_entries.push_back(entry.clone());
+    m_name_index->add(*m_entries.back());
+    m_filename_index->add(*m_entries.back());
 }
 
 
@@ -375,6 +285,8 @@ void FileCollection::addEntry(FileEntry const & entry)
 void FileCollection::close()
 {
     m_entries.clear();
+    m_name_index->clear();
+    m_filename_index->clear();
     m_filename = g_default_filename;
     m_valid = false;
 }
@@ -405,9 +317,23 @@ FileEntry::vector_t FileCollection::entries() const
  * filename while searching for a match, specify FileCollection::IGNORE
  * as the second argument.
  *
+ * The entry is found using the name index of the collection, or the
+ * base name index when the path is ignored, which does not require a
+ * scan of all the entries. If the index is not in sync with the vector
+ * of entries (i.e. a derived class added entries without calling
+ * indexEntries()) then the function falls back to a linear search.
+ *
+ * When several entries match, the first one, in the order of the
+ * collection, is returned. This is especially important when the path
+ * is ignored since many entries may share the same base name.
+ *
  * \note
  * The collection must be valid or the function raises an exception.
  *
+ * \note
+ * A collection which loads its entries lazily (such as the
+ * DirectoryCollection) must load them before calling this function.
+ *
  * \param[in] name  A string containing the name of the entry to get.
  * \param[in] matchpath  Specify MatchPath::MATCH, if the path should match
  *                       as well, specify MatchPath::IGNORE, if the path
@@ -416,23 +342,40 @@ FileEntry::vector_t FileCollection::entries() const
  * \return A shared pointer to the found entry. The returned pointer
  *         is null if no entry is found.
  *
+ * \sa indexEntries()
  * \sa mustBeValid()
  */
 FileEntry::pointer_t FileCollection::getEntry(std::string const & name, MatchPath matchpath) const
 {
-    // make sure the entries were loaded if necessary
-    entries();
-
     mustBeValid();
 
+    FileEntryIndex const & index(matchpath == MatchPath::MATCH ? *m_name_index : *m_filename_index);
+    if(index.size() == m_entries.size())
+    {
+        std::size_t const pos(index.find(name));
+        return pos == FileEntryIndex::npos ? FileEntry::pointer_t() : m_entries[pos];
+    }
+
     FileEntry::vector_t::const_iterator iter;
     if(matchpath == MatchPath::MATCH)
     {
-        iter = std::find_if(m_entries.begin(), m_entries.end(), MatchName(name));
+        iter = std::find_if(
+                      m_entries.begin()
+                    , m_entries.end()
+                    , [&name](FileEntry::pointer_t const & entry)
+                    {
+                        return entry->getName() == name;
+                    });
     }
     else
     {
-        iter = std::find_if(m_entries.begin(), m_entries.end(), MatchFileName(name));
+        iter = std::find_if(
+                      m_entries.begin()
+                    , m_entries.end()
+                    , [&name](FileEntry::pointer_t const & entry)
+                    {
+                        return entry->getFileName() == name;
+                    });
     }
 
     return iter == m_entries.end() ? FileEntry::pointer_t() : *iter;
@@ -457,6 +400,175 @@ std::string FileCollection::getName() const
 }
 
 
+/** \brief Read the whole data of an entry in a vector.
+ *
+ * This function reads all the data of the named entry in \p data.
+ * The vector gets resized to the size of the entry.
+ *
+ * The default implementation reads the data from the stream returned
+ * by getInputStream(). A ZipFile reads the data directly from the
+ * archive instead, without going through an std::istream.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data cannot be read or is shorter
+ * than the size of the entry (i.e. it is corrupted or truncated).
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[out] data  The vector where the data is saved.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return true if the entry was found and read; false if the entry
+ *         does not exist, in which case \p data is not modified.
+ */
+bool FileCollection::readEntry(std::string const & entry_name, std::vector<char> & data, MatchPath matchpath)
+{
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return false;
+    }
+
+    return readEntry(*entry, data);
+}
+
+
+/** \brief Read the whole data of an entry in a buffer.
+ *
+ * This function reads all the data of the named entry in \p buf.
+ * On entry, \p size is the size of \p buf. On return, it is set to
+ * the number of bytes saved in \p buf, the size of the entry.
+ *
+ * The size of an entry is available with FileEntry::getSize().
+ *
+ * \exception InvalidException
+ * This exception is raised if \p buf is too small for the entry.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data cannot be read or is shorter
+ * than the size of the entry.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[out] buf  The buffer where the data is saved.
+ * \param[in,out] size  The size of \p buf, then the size of the data.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return true if the entry was found and read; false if the entry
+ *         does not exist.
+ */
+bool FileCollection::readEntry(std::string const & entry_name, char * buf, std::size_t & size, MatchPath matchpath)
+{
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return false;
+    }
+
+    return readEntry(*entry, buf, size);
+}
+
+
+/** \brief Read the whole data of an entry in a vector.
+ *
+ * This function reads all the data of \p entry, an entry of this
+ * collection as returned by entries() or getEntry(), in \p data. It
+ * saves a search by name when the entry is already known.
+ *
+ * The default implementation reads the data from the stream returned
+ * by getInputStream() for the name of \p entry, which is correct as
+ * long as the names in the collection are unique. A ZipFile reads the
+ * data of \p entry itself, even if other entries have the same name.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data cannot be read or is shorter
+ * than the size of the entry.
+ *
+ * \param[in] entry  The entry to read.
+ * \param[out] data  The vector where the data is saved.
+ *
+ * \return true if the entry was read; false if it is not part of this
+ *         collection, in which case \p data is not modified.
+ */
+bool FileCollection::readEntry(FileEntry const & entry, std::vector<char> & data)
+{
+    stream_pointer_t is(getInputStream(entry.getName()));
+    if(is == nullptr)
+    {
+        return false;
+    }
+
+    data.resize(entry.getSize());
+    readEntryStream(entry, *is, data.data());
+
+    return true;
+}
+
+
+/** \brief Read the whole data of an entry in a buffer.
+ *
+ * This function is the same as the other readEntry() function of
+ * \p entry, only it saves the data in \p buf. On entry, \p size is
+ * the size of \p buf. On return, it is set to the size of the entry.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p buf is too small for the entry.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data cannot be read or is shorter
+ * than the size of the entry.
+ *
+ * \param[in] entry  The entry to read.
+ * \param[out] buf  The buffer where the data is saved.
+ * \param[in,out] size  The size of \p buf, then the size of the data.
+ *
+ * \return true if the entry was read; false if it is not part of this
+ *         collection.
+ */
+bool FileCollection::readEntry(FileEntry const & entry, char * buf, std::size_t & size)
+{
+    if(entry.getSize() > size)
+    {
+        throw InvalidException("FileCollection::readEntry(): the buffer is too small for entry \"" + entry.getName() + "\".");
+    }
+
+    stream_pointer_t is(getInputStream(entry.getName()));
+    if(is == nullptr)
+    {
+        return false;
+    }
+
+    readEntryStream(entry, *is, buf);
+    size = entry.getSize();
+
+    return true;
+}
+
+
+/** \brief Read the whole data of an entry from its stream.
+ *
+ * This function reads FileEntry::getSize() bytes from \p is in \p buf.
+ * A stream which fails (for example, because the CRC32 of the data
+ * does not match) or ends early is an error.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data cannot be read or is shorter
+ * than the size of the entry.
+ *
+ * \param[in] entry  The entry being read.
+ * \param[in,out] is  The stream returning the data of \p entry.
+ * \param[out] buf  The buffer where the data is saved, at least the
+ *                  size of the entry.
+ */
+void FileCollection::readEntryStream(FileEntry const & entry, std::istream & is, char * buf)
+{
+    is.read(buf, static_cast<std::streamsize>(entry.getSize()));
+    if(is.bad()
+    || static_cast<std::size_t>(is.gcount()) != entry.getSize())
+    {
+        throw FileCollectionException("FileCollection::readEntry(): the data of entry \"" + entry.getName() + "\" is corrupted or truncated.");
+    }
+}
+
+
 /** \brief Returns the number of entries in the FileCollection.
  *
  * This function returns the number of entries in the collection.
@@ -592,6 +704,22 @@ void FileCollection::setLevel(
 }
 
 
+/** \brief Rebuild the name indexes of the collection.
+ *
+ * This function rebuilds the indexes used by getEntry() to find entries
+ * by name and by base name. Derived classes which fill the m_entries
+ * vector directly (instead of calling addEntry()) call this function
+ * once they are done loading their entries.
+ *
+ * \sa getEntry()
+ */
+void FileCollection::indexEntries()
+{
+    m_name_index->rebuild(m_entries);
+    m_filename_index->rebuild(m_entries);
+}
+
+
 /** \brief Write a FileCollection to the output stream.
  *
  * This function writes a simple textual representation of this
@@ -0,0 +1,260 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::FileEntryIndex.
+ *
+ * This file implements the hash table used by the zipios::FileCollection
+ * to search its entries by name.
+ */
+
+#include "fileentryindex.hpp"
+
+#include <algorithm>
+#include <functional>
+
+
+namespace zipios
+{
+
+
+/** \class FileEntryIndex
+ * \brief An index of the entries of a FileCollection.
+ *
+ * The FileEntryIndex is a hash table with open addressing (linear
+ * probing) which maps a key to the position of an entry in the vector
+ * of entries of a FileCollection. The key is obtained by calling the
+ * FileEntry function specified on construction, generally getName(),
+ * on each entry.
+ *
+ * The table only holds the hash and the position of each entry. The
+ * keys are kept in a separate vector, in the same order as the entries,
+ * so the table remains small and probing it stays cache friendly.
+ *
+ * When several entries have the same key, the index only returns the
+ * first one, in the order they were added. This is the same result as
+ * a linear search from the start of the vector of entries.
+ *
+ * \note
+ * Entries can only be added. To remove entries, clear() the index and
+ * rebuild() it from the new vector of entries.
+ */
+
+
+/** \typedef std::string (FileEntry::*FileEntryIndex::key_function_t)() const;
+ * \brief The FileEntry function used to retrieve the key of an entry.
+ *
+ * This type is used to define which FileEntry function is called to
+ * compute the key of an entry, for example &FileEntry::getName.
+ */
+
+
+/** \var FileEntryIndex::npos
+ * \brief The value returned by find() when a key is not found.
+ *
+ * This value represents an invalid position in the vector of entries.
+ */
+std::size_t const FileEntryIndex::npos;
+
+
+/** \brief Initialize a FileEntryIndex.
+ *
+ * The constructor creates an empty index. The \p key_function
+ * parameter defines the FileEntry function used to compute the
+ * key of each entry.
+ *
+ * \param[in] key_function  The function used to get the key of an entry.
+ */
+FileEntryIndex::FileEntryIndex(key_function_t key_function)
+    : m_key_function(key_function)
+{
+}
+
+
+/** \brief Remove all the keys from the index.
+ *
+ * This function empties the index. It is used when the collection
+ * gets closed.
+ */
+void FileEntryIndex::clear()
+{
+    m_slots.clear();
+    m_keys.clear();
+    m_used = 0;
+}
+
+
+/** \brief Add one entry to the index.
+ *
+ * This function adds \p entry to the index. The entry is expected to
+ * have been appended to the vector of entries of the collection, its
+ * position is therefore the number of entries added so far.
+ *
+ * If another entry with the same key was already added, the index
+ * keeps pointing to the first one.
+ *
+ * \param[in] entry  The entry to add to the index.
+ */
+void FileEntryIndex::add(FileEntry const & entry)
+{
+    std::size_t const index(m_keys.size());
+    m_keys.push_back((entry.*m_key_function)());
+
+    if((m_used + 1) * 2 > m_slots.size())
+    {
+        grow();
+    }
+
+    std::size_t const hash(std::hash<std::string>()(m_keys.back()));
+    std::size_t const mask(m_slots.size() - 1);
+    for(std::size_t pos(hash & mask);; pos = (pos + 1) & mask)
+    {
+        slot_t & slot(m_slots[pos]);
+        if(slot.m_index == npos)
+        {
+            slot.m_hash = hash;
+            slot.m_index = index;
+            ++m_used;
+            return;
+        }
+        if(slot.m_hash == hash
+        && m_keys[slot.m_index] == m_keys.back())
+        {
+            // keep the first entry, like a search from the start would
+            return;
+        }
+    }
+}
+
+
+/** \brief Rebuild the index from a vector of entries.
+ *
+ * This function clears the index and then adds all the \p entries
+ * to it. The table is allocated once, with enough room for all the
+ * entries.
+ *
+ * \param[in] entries  The entries of the collection.
+ */
+void FileEntryIndex::rebuild(FileEntry::vector_t const & entries)
+{
+    clear();
+
+    std::size_t capacity(16);
+    while(capacity < entries.size() * 2)
+    {
+        capacity *= 2;
+    }
+    m_slots.resize(capacity);
+    m_keys.reserve(entries.size());
+
+    for(auto it(entries.begin()); it != entries.end(); ++it)
+    {
+        add(**it);
+    }
+}
+
+
+/** \brief Search for a key.
+ *
+ * This function computes the hash of \p key and probes the table
+ * until it finds the key or an empty slot.
+ *
+ * \param[in] key  The key to search for.
+ *
+ * \return The position of the first entry with that key or npos if
+ *         no entry has that key.
+ */
+std::size_t FileEntryIndex::find(std::string const & key) const
+{
+    if(m_slots.empty())
+    {
+        return npos;
+    }
+
+    std::size_t const hash(std::hash<std::string>()(key));
+    std::size_t const mask(m_slots.size() - 1);
+    for(std::size_t pos(hash & mask);; pos = (pos + 1) & mask)
+    {
+        slot_t const & slot(m_slots[pos]);
+        if(slot.m_index == npos)
+        {
+            return npos;
+        }
+        if(slot.m_hash == hash
+        && m_keys[slot.m_index] == key)
+        {
+            return slot.m_index;
+        }
+    }
+}
+
+
+/** \brief Retrieve the number of entries added to this index.
+ *
+ * This function returns the number of entries that were added to the
+ * index, including entries with a duplicate key. It is expected to be
+ * equal to the number of entries in the collection.
+ *
+ * \return The number of entries in the index.
+ */
+std::size_t FileEntryIndex::size() const
+{
+    return m_keys.size();
+}
+
+
+/** \brief Double the size of the table.
+ *
+ * This function allocates a table twice as large and re-inserts all
+ * the slots in it. The hashes are saved in the slots so the keys do
+ * not need to be hashed again.
+ */
+void FileEntryIndex::grow()
+{
+    std::vector<slot_t> old_slots(std::max<std::size_t>(16, m_slots.size() * 2));
+    old_slots.swap(m_slots);
+
+    std::size_t const mask(m_slots.size() - 1);
+    for(auto it(old_slots.begin()); it != old_slots.end(); ++it)
+    {
+        if(it->m_index != npos)
+        {
+            std::size_t pos(it->m_hash & mask);
+            while(m_slots[pos].m_index != npos)
+            {
+                pos = (pos + 1) & mask;
+            }
+            m_slots[pos] = *it;
+        }
+    }
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef FILEENTRYINDEX_HPP
+#define FILEENTRYINDEX_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Declaration of the zipios::FileEntryIndex class.
+ *
+ * The zipios::FileEntryIndex class is used by the zipios::FileCollection
+ * to find entries by name without scanning the whole vector of entries.
+ */
+
+#include "zipios/fileentry.hpp"
+
+
+namespace zipios
+{
+
+
+class FileEntryIndex
+{
+public:
+    typedef std::string         (FileEntry::*key_function_t)() const;
+
+    static std::size_t const    npos = static_cast<std::size_t>(-1);
+
+                                FileEntryIndex(key_function_t key_function);
+
+    void                        clear();
+    void                        add(FileEntry const & entry);
+    void                        rebuild(FileEntry::vector_t const & entries);
+    std::size_t                 find(std::string const & key) const;
+    std::size_t                 size() const;
+
+private:
+    struct slot_t
+    {
+        std::size_t             m_hash = 0;
+        std::size_t             m_index = npos;
+    };
+
+    void                        grow();
+
+    key_function_t              m_key_function = nullptr;
+    std::vector<slot_t>         m_slots = std::vector<slot_t>();
+    std::vector<std::string>    m_keys = std::vector<std::string>();
+    std::size_t                 m_used = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,215 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::GZIPInputStream.
+ *
+ * The zipios::GZIPInputStream class reads gzip files as created by
+ * the zipios::GZIPOutputStream class or the gzip tool.
+ */
+
+#include "gzipinputstream.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+
+namespace zipios
+{
+
+/** \class GZIPInputStream
+ * \brief A stream implementation that reads a gzip file.
+ *
+ * GZIPInputStream is an istream that returns the decompressed data
+ * of a gzip file. It is the counterpart of GZIPOutputStream.
+ *
+ * It can be used with either an existing std::istream object, or
+ * a filename. To read a whole file in memory, readFile() is faster.
+ *
+ * The stream supports seekg() when the input can seek. To read
+ * a few records from the middle of a large file, give the stream an
+ * InflateIndex, created with buildIndex() or by the GZIPOutputStream
+ * which wrote the file, and usually saved in a sidecar file with
+ * InflateIndex::save().
+ */
+
+
+/** \brief Create a gzip input stream object.
+ *
+ * This constructor creates a gzip stream reading from an existing
+ * standard input stream.
+ *
+ * \warning
+ * You must keep the input stream valid for as long as this object
+ * exists.
+ *
+ * \exception IOException
+ * This exception is raised if \p is does not start with a gzip header.
+ *
+ * \param[in,out] is  istream from which the gzip file is read.
+ * \param[in] index  The index of access points of the file, or a null
+ *                   pointer. The offsets in the index are relative to
+ *                   the current position of \p is.
+ */
+GZIPInputStream::GZIPInputStream(std::istream & is, InflateIndex::pointer_t index)
+    : m_izf(std::make_unique<GZIPInputStreambuf>(is.rdbuf(), -1, index))
+{
+    init(m_izf.get());
+}
+
+
+/** \brief Create a gzip input stream reading a file.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be read or does not start
+ * with a gzip header.
+ *
+ * \param[in] filename  The name of the gzip file to read.
+ * \param[in] index  The index of access points of the file, or a null
+ *                   pointer.
+ */
+GZIPInputStream::GZIPInputStream(std::string const & filename, InflateIndex::pointer_t index)
+    : std::istream(0)
+    , m_ifs(std::make_unique<std::ifstream>(filename.c_str(), std::ios::in | std::ios::binary))
+    , m_izf(std::make_unique<GZIPInputStreambuf>(m_ifs->rdbuf(), -1, index))
+{
+    init(m_izf.get());
+}
+
+
+/** \brief Destroy the input stream.
+ *
+ * The destructor ensures that all allocated resources get destroyed.
+ */
+GZIPInputStream::~GZIPInputStream()
+{
+}
+
+
+/** \brief Get the original filename.
+ *
+ * \return The filename saved in the gzip header or an empty string.
+ */
+std::string const & GZIPInputStream::getFilename() const
+{
+    return m_izf->getFilename();
+}
+
+
+/** \brief Get the comment.
+ *
+ * \return The comment saved in the gzip header or an empty string.
+ */
+std::string const & GZIPInputStream::getComment() const
+{
+    return m_izf->getComment();
+}
+
+
+/** \brief Get the extra field.
+ *
+ * \return The extra field saved in the gzip header or an empty buffer.
+ */
+buffer_t const & GZIPInputStream::getExtra() const
+{
+    return m_izf->getExtra();
+}
+
+
+/** \brief Read and decompress a whole gzip file.
+ *
+ * This function loads the gzip file \p filename in memory and
+ * decompresses it in \p data with GZIPInputStreambuf::decompress(),
+ * which is much faster than reading the data through a stream.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be read or is not
+ * a valid gzip file.
+ *
+ * \param[in] filename  The name of the gzip file to read.
+ * \param[out] data  The decompressed data.
+ */
+void GZIPInputStream::readFile(std::string const & filename, std::vector<char> & data)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+    if(!in)
+    {
+        throw IOException("GZIPInputStream::readFile(): could not open \"" + filename + "\".");
+    }
+    std::vector<char> gz(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    if(!in.read(gz.data(), gz.size()))
+    {
+        throw IOException("GZIPInputStream::readFile(): could not read \"" + filename + "\"."); // LCOV_EXCL_LINE
+    }
+
+    GZIPInputStreambuf::decompress(gz.data(), gz.size(), data);
+}
+
+
+/** \brief Build the index of access points of a gzip file.
+ *
+ * This function reads the whole gzip file \p filename once and returns
+ * an index with one access point every \p span bytes of uncompressed
+ * data, or a little more since access points can only be placed at the
+ * end of a deflate block. The data gets verified as usual.
+ *
+ * The index can then be given to a GZIPInputStream reading the same
+ * file, and saved with InflateIndex::save() to be reused later.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be read or is not
+ * a valid gzip file.
+ *
+ * \param[in] filename  The name of the gzip file to index.
+ * \param[in] span  The distance between two access points.
+ *
+ * \return The index of the file.
+ */
+InflateIndex::pointer_t GZIPInputStream::buildIndex(std::string const & filename, offset_t span)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if(!in)
+    {
+        throw IOException("GZIPInputStream::buildIndex(): could not open \"" + filename + "\".");
+    }
+
+    InflateIndex::pointer_t index(std::make_shared<InflateIndex>(span));
+    GZIPInputStreambuf buf(in.rdbuf(), -1, index);
+    std::vector<char> data(getBufferSize());
+    while(buf.sgetn(data.data(), data.size()) > 0)
+    {
+        // the stream buffer adds the access points as it reads
+    }
+
+    return index;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef GZIPINPUTSTREAM_HPP
+#define GZIPINPUTSTREAM_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define zipios::GZIPInputStream.
+ *
+ * This file declares the zipios::GZIPInputStream class which reads
+ * and decompresses a gzip file.
+ */
+
+#include "gzipinputstreambuf.hpp"
+
+#include <fstream>
+#include <memory>
+
+
+namespace zipios
+{
+
+
+class GZIPInputStream : public std::istream
+{
+public:
+                                            GZIPInputStream(std::istream & is, InflateIndex::pointer_t index = InflateIndex::pointer_t());
+                                            GZIPInputStream(std::string const & filename, InflateIndex::pointer_t index = InflateIndex::pointer_t());
+                                            GZIPInputStream(GZIPInputStream const & rhs) = delete;
+    virtual                                 ~GZIPInputStream() override;
+
+    GZIPInputStream &                       operator = (GZIPInputStream const & rhs) = delete;
+
+    std::string const &                     getFilename() const;
+    std::string const &                     getComment() const;
+    buffer_t const &                        getExtra() const;
+
+    static void                             readFile(std::string const & filename, std::vector<char> & data);
+    static InflateIndex::pointer_t          buildIndex(std::string const & filename, offset_t span = InflateIndex::DEFAULT_SPAN);
+
+private:
+    std::unique_ptr<std::ifstream>          m_ifs = std::unique_ptr<std::ifstream>();
+    std::unique_ptr<GZIPInputStreambuf>     m_izf = std::unique_ptr<GZIPInputStreambuf>();
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,621 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of the zipios::GZIPInputStreambuf class.
+ *
+ * This class is an input stream filter which reads a .gz file and
+ * returns the data it contains, the counterpart of the
+ * zipios::GZIPOutputStreambuf class.
+ */
+
+#include "gzipinputstreambuf.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "crc32.hpp"
+#include "streampool.hpp"
+
+#include <cstring>
+#include <limits>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The size of the gzip trailer.
+ *
+ * The trailer of a gzip member includes the CRC32 and the size modulo
+ * 2^32 of the data of that member.
+ */
+std::size_t const g_trailer_size = 8;
+
+
+/** \brief The maximum compression ratio of deflate.
+ *
+ * The deflate format cannot compress data more than 1032 to 1. This
+ * limits how much data a given number of compressed bytes can expand
+ * to.
+ */
+std::size_t const g_maximum_deflate_ratio = 1032;
+
+
+/** \brief The fields of a gzip member header we keep.
+ *
+ * The other fields (modification time, extra flags, operating system)
+ * are ignored.
+ */
+struct gzip_header_t
+{
+    std::string         m_filename = std::string();
+    std::string         m_comment = std::string();
+    buffer_t            m_extra = buffer_t();
+};
+
+
+/** \brief Read the header of a gzip member.
+ *
+ * This function reads the header of a gzip member (RFC 1952) with the
+ * \p read function. That function is expected to read exactly the
+ * requested number of bytes and return true, or return false if the
+ * input ends before that.
+ *
+ * The optional FEXTRA, FNAME and FCOMMENT fields are saved in \p header.
+ * The optional header CRC16 gets verified.
+ *
+ * \exception IOException
+ * This exception is raised if the input is not a valid gzip header.
+ *
+ * \param[in] read  The function used to read the header bytes.
+ * \param[out] header  The fields found in the header.
+ */
+template<typename F>
+void read_gzip_header(F read, gzip_header_t & header)
+{
+    buffer_t raw;
+    auto get([&read, &raw](std::size_t size)
+        {
+            std::size_t const start(raw.size());
+            raw.resize(start + size);
+            if(!read(raw.data() + start, size))
+            {
+                throw IOException("GZIPInputStreambuf: the gzip header is truncated.");
+            }
+            return start;
+        });
+    auto get_string([&get, &raw]()
+        {
+            std::string result;
+            for(;;)
+            {
+                std::size_t const pos(get(1));
+                if(raw[pos] == 0)
+                {
+                    return result;
+                }
+                result += static_cast<char>(raw[pos]);
+            }
+        });
+
+    get(10);
+    if(raw[0] != 0x1F
+    || raw[1] != 0x8B)
+    {
+        throw IOException("GZIPInputStreambuf: the input is not in the gzip format.");
+    }
+    if(raw[2] != 0x08)
+    {
+        throw IOException("GZIPInputStreambuf: the gzip compression method is not supported.");
+    }
+    unsigned char const flg(raw[3]);
+    if((flg & 0xE0) != 0)
+    {
+        throw IOException("GZIPInputStreambuf: the gzip header uses reserved flags.");
+    }
+
+    if((flg & 0x04) != 0)
+    {
+        std::size_t pos(get(2));
+        uint16_t xlen(0);
+        zipRead(raw, pos, xlen);
+        pos = get(xlen);
+        header.m_extra.assign(raw.begin() + pos, raw.end());
+    }
+    if((flg & 0x08) != 0)
+    {
+        header.m_filename = get_string();
+    }
+    if((flg & 0x10) != 0)
+    {
+        header.m_comment = get_string();
+    }
+    if((flg & 0x02) != 0)
+    {
+        uint16_t const expected(CRC32::update(0, raw.data(), raw.size()) & 0xFFFF);
+        std::size_t pos(get(2));
+        uint16_t crc16(0);
+        zipRead(raw, pos, crc16);
+        if(crc16 != expected)
+        {
+            throw IOException("GZIPInputStreambuf: the CRC16 of the gzip header does not match.");
+        }
+    }
+}
+
+
+/** \brief Verify the trailer of a gzip member.
+ *
+ * \exception IOException
+ * This exception is raised if the CRC32 or size do not match.
+ *
+ * \param[in] trailer  The 8 bytes of the trailer.
+ * \param[in] crc32  The CRC32 of the data of the member.
+ * \param[in] size  The size of the data of the member modulo 2^32.
+ */
+void verify_gzip_trailer(buffer_t const & trailer, uint32_t crc32, uint32_t size)
+{
+    std::size_t pos(0);
+    uint32_t expected_crc32(0);
+    uint32_t expected_size(0);
+    zipRead(trailer, pos, expected_crc32);
+    zipRead(trailer, pos, expected_size);
+    if(expected_crc32 != crc32)
+    {
+        throw IOException("GZIPInputStreambuf: the CRC32 of the gzip data does not match.");
+    }
+    if(expected_size != size)
+    {
+        throw IOException("GZIPInputStreambuf: the size of the gzip data does not match.");
+    }
+}
+
+
+} // no name namespace
+
+
+
+/** \class GZIPInputStreambuf
+ * \brief Read the data of a gzip file.
+ *
+ * This class is an input stream filter which parses the header of
+ * a gzip file, inflates its data with the InflateInputStreambuf, and
+ * verifies the CRC32 and size found in the trailer.
+ *
+ * A gzip file may include multiple members, one after the other, as
+ * created by GZIPOutputStreambuf::setMemberSize() or by concatenating
+ * gzip files. The data of all the members is returned as one stream.
+ * The filename, comment and extra field are those of the first member.
+ *
+ * When the input streambuf supports seeking, so does this stream buffer.
+ * Without an InflateIndex, seeking backward means inflating the data
+ * again from the start of the file. With an index, such as one built
+ * by GZIPInputStream::buildIndex() or saved by the GZIPOutputStreambuf
+ * which created the file, inflating resumes from the closest access
+ * point. The CRC32 of a member in which reading resumed from an access
+ * point cannot be verified, so it is not.
+ */
+
+
+/** \brief Initialize a GZIPInputStreambuf object.
+ *
+ * The constructor reads the header of the first gzip member.
+ *
+ * \exception IOException
+ * This exception is raised if the input does not start with a valid
+ * gzip header.
+ *
+ * \param[in,out] inbuf  The streambuf to use for input.
+ * \param[in] start_pos  A position to reset the inbuf to before reading.
+ *                       Specify -1 to read from the current position.
+ * \param[in] index  The index of access points of this file, or a
+ *                   null pointer.
+ */
+GZIPInputStreambuf::GZIPInputStreambuf(std::streambuf * inbuf, offset_t start_pos, InflateIndex::pointer_t index)
+    : InflateInputStreambuf(inbuf, start_pos)
+{
+    readHeader(true);
+    markDataStart();
+    setInflateIndex(index);
+}
+
+
+/** \brief Clean up the GZIPInputStreambuf object.
+ *
+ * The destructor ensures that all resources get released.
+ */
+GZIPInputStreambuf::~GZIPInputStreambuf()
+{
+}
+
+
+/** \brief Get the original filename.
+ *
+ * \return The FNAME field of the first member, or an empty string.
+ */
+std::string const & GZIPInputStreambuf::getFilename() const
+{
+    return m_filename;
+}
+
+
+/** \brief Get the comment.
+ *
+ * \return The FCOMMENT field of the first member, or an empty string.
+ */
+std::string const & GZIPInputStreambuf::getComment() const
+{
+    return m_comment;
+}
+
+
+/** \brief Get the extra field.
+ *
+ * \return The FEXTRA field of the first member, or an empty buffer.
+ */
+buffer_t const & GZIPInputStreambuf::getExtra() const
+{
+    return m_extra;
+}
+
+
+/** \brief Decompress a whole gzip file at once.
+ *
+ * This function decompresses the \p size bytes of the gzip file found
+ * in \p gz in \p data.
+ *
+ * The size of the data of the last member is found at the very end of
+ * the file. When the file has a single member, as usual, this is the
+ * size of the data so the buffer gets allocated once and the data
+ * inflated in one inflate() call with Z_FINISH, which also saves zlib
+ * from maintaining its window. Otherwise, the buffer grows as required.
+ *
+ * Since that size comes from the file, it is not trusted: the initial
+ * buffer is never larger than what \p size bytes can inflate to with
+ * the maximum deflate ratio.
+ *
+ * \exception IOException
+ * This exception is raised if \p gz is not a valid gzip file, including
+ * when the CRC32 or size of a member does not match its data.
+ *
+ * \param[in] gz  The gzip file.
+ * \param[in] size  The size of \p gz.
+ * \param[out] data  The decompressed data.
+ */
+void GZIPInputStreambuf::decompress(char const * gz, std::size_t size, std::vector<char> & data)
+{
+    std::size_t expected_size(0);
+    if(size >= g_trailer_size)
+    {
+        buffer_t const isize(gz + size - 4, gz + size);
+        std::size_t pos(0);
+        uint32_t value(0);
+        zipRead(isize, pos, value);
+
+        // deflate cannot compress more than 1032 to 1, so a larger
+        // size is a lie which must not make us allocate gigabytes
+        //
+        expected_size = std::min(static_cast<std::size_t>(value), size * g_maximum_deflate_ratio);
+    }
+
+    // zlib refuses null pointers, even when the size is zero
+    //
+    data.resize(std::max(expected_size, static_cast<std::size_t>(1)));
+
+    // avail_in and avail_out are limited to 32 bits
+    //
+    std::size_t const max_chunk(std::numeric_limits<uInt>::max());
+
+    z_stream * zs(StreamPool::acquireInflate());
+    try
+    {
+        std::size_t in_pos(0);
+        std::size_t out_pos(0);
+        do
+        {
+            gzip_header_t header;
+            read_gzip_header([gz, size, &in_pos](unsigned char * buf, std::size_t length)
+                {
+                    if(size - in_pos < length)
+                    {
+                        return false;
+                    }
+                    memcpy(buf, gz + in_pos, length);
+                    in_pos += length;
+                    return true;
+                }, header);
+
+            std::size_t const member_start(out_pos);
+            inflateReset(zs);
+            zs->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(gz + in_pos));
+            zs->avail_in = 0;
+            zs->next_out = reinterpret_cast<Bytef *>(data.data() + out_pos);
+            zs->avail_out = 0;
+            for(;;)
+            {
+                if(zs->avail_in == 0)
+                {
+                    zs->avail_in = static_cast<uInt>(std::min(size - in_pos, max_chunk));
+                }
+                if(zs->avail_out == 0)
+                {
+                    if(out_pos == data.size())
+                    {
+                        data.resize(data.size() * 2);
+                    }
+                    zs->next_out = reinterpret_cast<Bytef *>(data.data() + out_pos);
+                    zs->avail_out = static_cast<uInt>(std::min(data.size() - out_pos, max_chunk));
+                }
+
+                Bytef const * const next_in(zs->next_in);
+                Bytef const * const next_out(zs->next_out);
+                int const err(inflate(zs, Z_FINISH));
+                in_pos += zs->next_in - next_in;
+                out_pos += zs->next_out - next_out;
+                if(err == Z_STREAM_END)
+                {
+                    break;
+                }
+
+                // Z_BUF_ERROR means more input or output is necessary
+                //
+                if((err != Z_OK && err != Z_BUF_ERROR)
+                || (zs->avail_in == 0 && in_pos == size))
+                {
+                    throw IOException(std::string("GZIPInputStreambuf::decompress(): inflate() failed: ")
+                                        + (err == Z_BUF_ERROR ? "the gzip data is truncated" : zError(err)));
+                }
+            }
+
+            if(size - in_pos < g_trailer_size)
+            {
+                throw IOException("GZIPInputStreambuf::decompress(): the gzip trailer is truncated.");
+            }
+            buffer_t const trailer(gz + in_pos, gz + in_pos + g_trailer_size);
+            in_pos += g_trailer_size;
+            verify_gzip_trailer(
+                      trailer
+                    , CRC32::update(0, data.data() + member_start, out_pos - member_start)
+                    , static_cast<uint32_t>(out_pos - member_start));
+        }
+        while(in_pos < size);
+
+        data.resize(out_pos);
+    }
+    catch(...)
+    {
+        StreamPool::releaseInflate(zs);
+        throw;
+    }
+    StreamPool::releaseInflate(zs);
+}
+
+
+/** \brief Called when more data is required.
+ *
+ * This function inflates more data with the InflateInputStreambuf and
+ * adds it to the CRC32 of the current member. At the end of a member,
+ * the trailer gets verified and, if another member follows, the
+ * inflation restarts after its header.
+ *
+ * \exception IOException
+ * This exception is raised if the data is not valid, including when
+ * the CRC32 or the size of a member does not match. Like other errors
+ * in underflow(), it makes the istream set its badbit.
+ *
+ * \return The value of the next character or
+ *         std::streambuf::traits_type::eof() at the end of the file.
+ */
+std::streambuf::int_type GZIPInputStreambuf::underflow()
+{
+    for(;;)
+    {
+        if(m_end_of_file)
+        {
+            return traits_type::eof();
+        }
+        if(isStreamEnd()
+        && !nextMember())
+        {
+            m_end_of_file = true;
+            return traits_type::eof();
+        }
+
+        int_type const c(InflateInputStreambuf::underflow());
+        if(m_verify)
+        {
+            std::size_t const size(egptr() - eback());
+            m_crc32 = CRC32::update(m_crc32, eback(), size);
+            m_size += static_cast<uint32_t>(size);
+        }
+        if(!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            return c;
+        }
+        if(!isStreamEnd())
+        {
+            m_end_of_file = true; // LCOV_EXCL_LINE
+            return traits_type::eof(); // LCOV_EXCL_LINE
+        }
+    }
+}
+
+
+/** \brief Change the read position.
+ *
+ * This function moves the read position within the uncompressed data
+ * of the gzip file. Only the input position is supported and, since
+ * the size of the data is not known without inflating it all, only
+ * positions relative to the start or the current position.
+ *
+ * \param[in] off  The offset to move to.
+ * \param[in] dir  Whether \p off is relative to the start or the current
+ *                 position.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type GZIPInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    offset_t target(off);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        target += getInflatedPosition();
+        break;
+
+    default:
+        return pos_type(off_type(-1));
+
+    }
+
+    if(!seekInflated(target))
+    {
+        return pos_type(off_type(-1));
+    }
+
+    return pos_type(target);
+}
+
+
+/** \brief Change the read position to an absolute position.
+ *
+ * This function is the same as seekoff() with std::ios_base::beg.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type GZIPInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+/** \brief Restart inflating from an access point.
+ *
+ * When restarting from the beginning of the file or from an access
+ * point at the start of a member, which has no window, the CRC32 of
+ * that member gets computed again. When restarting from another access
+ * point, the data which precedes it in its member is not read, so the
+ * trailer of that member cannot be verified.
+ *
+ * \param[in] checkpoint  The access point to restart from or nullptr.
+ */
+void GZIPInputStreambuf::restart(InflateIndex::checkpoint_t const * checkpoint)
+{
+    InflateInputStreambuf::restart(checkpoint);
+
+    m_crc32 = 0;
+    m_size = 0;
+    m_verify = checkpoint == nullptr || checkpoint->m_window.empty();
+    m_end_of_file = false;
+}
+
+
+/** \brief Read the header of a gzip member.
+ *
+ * The fields of the \p first header are saved. The fields of the
+ * following members are ignored.
+ *
+ * \param[in] first  Whether this is the header of the first member.
+ */
+void GZIPInputStreambuf::readHeader(bool first)
+{
+    gzip_header_t header;
+    read_gzip_header([this](unsigned char * buf, std::size_t size)
+        {
+            return readInput(reinterpret_cast<char *>(buf), size) == size;
+        }, header);
+
+    if(first)
+    {
+        m_filename = header.m_filename;
+        m_comment = header.m_comment;
+        m_extra = header.m_extra;
+    }
+}
+
+
+/** \brief Terminate the current member.
+ *
+ * This function verifies the trailer of the member which just ended,
+ * unless reading resumed from an access point in the middle of that
+ * member, see restart(). If more data follows, it must be another gzip
+ * member, in which case its header gets read and the inflation
+ * restarts.
+ *
+ * \exception IOException
+ * This exception is raised if the trailer does not match the data or
+ * what follows is not a valid gzip header.
+ *
+ * \return true if another member follows, false at the end of the file.
+ */
+bool GZIPInputStreambuf::nextMember()
+{
+    buffer_t trailer(g_trailer_size);
+    if(readInput(reinterpret_cast<char *>(trailer.data()), trailer.size()) != trailer.size())
+    {
+        throw IOException("GZIPInputStreambuf::nextMember(): the gzip trailer is truncated.");
+    }
+    if(m_verify)
+    {
+        verify_gzip_trailer(trailer, m_crc32, m_size);
+    }
+
+    if(!hasInput())
+    {
+        return false;
+    }
+
+    readHeader(false);
+    restartStream();
+    m_crc32 = 0;
+    m_size = 0;
+    m_verify = true;
+
+    return true;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
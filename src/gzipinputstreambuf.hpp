@@ -0,0 +1,86 @@
+#pragma once
+#ifndef GZIPINPUTSTREAMBUF_HPP
+#define GZIPINPUTSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief File defining zipios::GZIPInputStreambuf.
+ *
+ * This file includes the declaration of the zipios::GZIPInputStreambuf
+ * class which is used to read the data of a gzip file, the counterpart
+ * of the zipios::GZIPOutputStreambuf class.
+ */
+
+#include "inflateinputstreambuf.hpp"
+
+
+namespace zipios
+{
+
+
+class GZIPInputStreambuf : public InflateInputStreambuf
+{
+public:
+                            GZIPInputStreambuf(std::streambuf * inbuf, offset_t start_pos = -1, InflateIndex::pointer_t index = InflateIndex::pointer_t());
+                            GZIPInputStreambuf(GZIPInputStreambuf const & rhs) = delete;
+    virtual                 ~GZIPInputStreambuf() override;
+
+    GZIPInputStreambuf &    operator = (GZIPInputStreambuf const & rhs) = delete;
+
+    std::string const &     getFilename() const;
+    std::string const &     getComment() const;
+    buffer_t const &        getExtra() const;
+
+    static void             decompress(char const * gz, std::size_t size, std::vector<char> & data);
+
+protected:
+    virtual std::streambuf::int_type    underflow() override;
+    virtual pos_type                    seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    virtual pos_type                    seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    virtual void                        restart(InflateIndex::checkpoint_t const * checkpoint) override;
+
+private:
+    void                    readHeader(bool first);
+    bool                    nextMember();
+
+    std::string             m_filename = std::string();
+    std::string             m_comment = std::string();
+    buffer_t                m_extra = buffer_t();
+    std::uint32_t           m_crc32 = 0;
+    std::uint32_t           m_size = 0;
+    bool                    m_verify = true;        // false once restarted in the middle of a member
+    bool                    m_end_of_file = false;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -124,6 +124,53 @@ void GZIPOutputStream::setComment(std::string const & comment)
 }
 
 
+/** \brief Compress the data with multiple threads.
+ *
+ * This function must be called before writing any data. The data then
+ * gets compressed in blocks of \p block_size bytes, with \p threads
+ * blocks compressed in parallel.
+ *
+ * \param[in] threads  The number of threads, 0 or 1 to use one thread.
+ * \param[in] block_size  The size of one block.
+ *
+ * \sa GZIPOutputStreambuf::setParallelDeflate()
+ */
+void GZIPOutputStream::setParallelDeflate(std::size_t threads, std::size_t block_size)
+{
+    m_ozf->setParallelDeflate(threads, block_size);
+}
+
+
+/** \brief Save the data in multiple gzip members.
+ *
+ * A new gzip member starts each time \p member_size bytes of data
+ * were written. Zero, the default, saves one member.
+ *
+ * \param[in] member_size  The number of bytes of data per member or 0.
+ *
+ * \sa GZIPOutputStreambuf::setMemberSize()
+ */
+void GZIPOutputStream::setMemberSize(std::size_t member_size)
+{
+    m_ozf->setMemberSize(member_size);
+}
+
+
+/** \brief Save the index of access points of the file.
+ *
+ * This function must be called before writing any data. The access
+ * points get added to \p index while the data gets compressed.
+ *
+ * \param[in] index  The index receiving the access points.
+ *
+ * \sa GZIPOutputStreambuf::setInflateIndex()
+ */
+void GZIPOutputStream::setInflateIndex(InflateIndex::pointer_t index)
+{
+    m_ozf->setInflateIndex(index);
+}
+
+
 /** \brief Close the streams.
  *
  * This function closes the streams making sure that all data gets
@@ -32,6 +32,7 @@
 
 #include "gzipoutputstreambuf.hpp"
 
+#include <fstream>
 #include <memory>
 
 
@@ -48,6 +49,9 @@ public:
 
     void                                    setFilename(std::string const & filename);
     void                                    setComment(std::string const & comment);
+    void                                    setParallelDeflate(std::size_t threads, std::size_t block_size);
+    void                                    setMemberSize(std::size_t member_size);
+    void                                    setInflateIndex(InflateIndex::pointer_t index);
     void                                    close();
     void                                    finish();
 
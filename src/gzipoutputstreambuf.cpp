@@ -32,6 +32,9 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace zipios
 {
@@ -41,6 +44,13 @@ namespace zipios
  *
  * This class is used to output the data of a file in a gzip stream
  * including the necessary header and footer.
+ *
+ * The data can be compressed by multiple threads in one member with
+ * setParallelDeflate(), and split in multiple members, which gzip
+ * decompresses as if they were one file, with setMemberSize().
+ *
+ * The stream can also save the index of access points used to read the
+ * file from the middle with setInflateIndex().
  */
 
 
@@ -53,6 +63,7 @@ namespace zipios
  */
 GZIPOutputStreambuf::GZIPOutputStreambuf(std::streambuf * outbuf, FileEntry::CompressionLevel compression_level)
     : DeflateOutputStreambuf(outbuf)
+    , m_compression_level(compression_level)
 {
     if(!init(compression_level))
     {
@@ -85,6 +96,83 @@ void GZIPOutputStreambuf::setComment(std::string const & comment)
 }
 
 
+/** \brief Compress the data with multiple threads.
+ *
+ * This function makes the stream compress the data in blocks of
+ * \p block_size bytes, \p threads blocks at a time, each in its own
+ * thread. The result remains one gzip member (or one per member when
+ * setMemberSize() is used), with the blocks separated by sync flushes.
+ * See DeflateOutputStreambuf::setParallel() for details.
+ *
+ * \exception InvalidStateException
+ * This exception is raised if data was already written to the stream.
+ *
+ * \param[in] threads  The number of threads, 0 or 1 to use one thread.
+ * \param[in] block_size  The size of one block, at least 32Kb.
+ */
+void GZIPOutputStreambuf::setParallelDeflate(std::size_t threads, std::size_t block_size)
+{
+    if(m_open
+    || pptr() != pbase())
+    {
+        throw InvalidStateException("GZIPOutputStreambuf::setParallelDeflate() must be called before writing any data.");
+    }
+
+    m_deflate_threads = threads;
+    m_deflate_block_size = block_size;
+    setParallel(m_deflate_threads, m_deflate_block_size);
+}
+
+
+/** \brief Split the output in multiple gzip members.
+ *
+ * Each time \p member_size bytes of uncompressed data were written to
+ * the stream, the current gzip member gets terminated, with its own
+ * CRC32 and size, and a new member starts. The members are compressed
+ * independently of each other so they can also be decompressed
+ * independently, for example to start reading in the middle of a
+ * large file. gzip decompresses the concatenated members as one file.
+ *
+ * By default, the member size is 0, meaning that the whole stream is
+ * saved in a single member.
+ *
+ * \param[in] member_size  The number of bytes of data per member or 0.
+ */
+void GZIPOutputStreambuf::setMemberSize(std::size_t member_size)
+{
+    m_member_size = member_size;
+}
+
+
+/** \brief Save the index of access points of the file.
+ *
+ * While compressing the data, the stream adds access points to
+ * \p index about every span of the index. Each member start is also
+ * an access point. The index can then be saved with
+ * InflateIndex::save(), for example in a sidecar file, and used by
+ * a GZIPInputStream to read the file from the middle.
+ *
+ * The offsets saved in the index are relative to the start of the gzip
+ * file, which is the position of the output streambuf when the stream
+ * gets created.
+ *
+ * \exception InvalidStateException
+ * This exception is raised if data was already written to the stream.
+ *
+ * \param[in] index  The index receiving the access points.
+ */
+void GZIPOutputStreambuf::setInflateIndex(InflateIndex::pointer_t index)
+{
+    if(m_open
+    || pptr() != pbase())
+    {
+        throw InvalidStateException("GZIPOutputStreambuf::setInflateIndex() must be called before writing any data.");
+    }
+
+    m_index = index;
+}
+
+
 /** \brief Close the stream.
  *
  * This function ensures that the streams get closed.
@@ -101,13 +189,36 @@ void GZIPOutputStreambuf::close()
  */
 void GZIPOutputStreambuf::finish()
 {
-    if(!m_open)
+    if(m_finished)
     {
         return;
     }
-    m_open = false;
+    m_finished = true;
 
+    // an empty stream still gets a valid gzip member
+    //
+    if(!m_open)
+    {
+        writeHeader();
+        m_open = true;
+    }
+
+    // the buffered data may still start a new member, which has to
+    // happen before closeStream(); also closeStream() calls overflow()
+    // so m_open must still be true
+    //
+    overflow();
     closeStream();
+
+    if(getSize() == 0)
+    {
+        // the deflate data of an empty file is one empty final block
+        //
+        std::ostream os(m_outbuf);
+        os << static_cast<unsigned char>(0x03);
+        os << static_cast<unsigned char>(0x00);
+    }
+
     writeTrailer();
 }
 
@@ -120,6 +231,31 @@ int GZIPOutputStreambuf::overflow(int c)
         m_open = true;
     }
 
+    // the data past the end of the current member goes to the next one
+    //
+    if(m_member_size > 0)
+    {
+        for(;;)
+        {
+            std::size_t const size(pptr() - pbase());
+            std::size_t const left(m_member_size - std::min(getSize(), m_member_size));
+            if(size <= left)
+            {
+                break;
+            }
+
+            std::vector<char> const rest(pbase() + left, pptr());
+            setp(pbase(), epptr());
+            pbump(static_cast<int>(left));
+            DeflateOutputStreambuf::overflow();
+
+            nextMember();
+
+            std::copy(rest.begin(), rest.end(), pbase());
+            pbump(static_cast<int>(rest.size()));
+        }
+    }
+
     return DeflateOutputStreambuf::overflow(c);
 }
 
@@ -130,11 +266,78 @@ int GZIPOutputStreambuf::sync()
 }
 
 
+/** \brief Write the header of a new member.
+ *
+ * The deflate data of the member starts right after this header so
+ * this is where the index, if any, gets attached to the new deflate
+ * stream.
+ */
 void GZIPOutputStreambuf::writeHeader()
+{
+    writeHeader(m_outbuf, m_filename, m_comment);
+    m_compressed_size += 10
+            + (m_filename.empty() ? 0 : strlen(m_filename.c_str()) + 1)
+            + (m_comment.empty() ? 0 : strlen(m_comment.c_str()) + 1);
+
+    if(m_index != nullptr)
+    {
+        DeflateOutputStreambuf::setInflateIndex(m_index, m_compressed_size, m_uncompressed_size);
+
+        if(m_index->needsCheckpoint(m_uncompressed_size))
+        {
+            // a member starts without any history
+            //
+            InflateIndex::checkpoint_t checkpoint;
+            checkpoint.m_out = m_uncompressed_size;
+            checkpoint.m_in = m_compressed_size;
+            m_index->addCheckpoint(checkpoint);
+        }
+    }
+}
+
+
+void GZIPOutputStreambuf::writeTrailer()
+{
+    writeTrailer(m_outbuf, getCrc32(), static_cast<uint32_t>(getSize()));
+    m_compressed_size += getDeflatedSize() + 8;
+    m_uncompressed_size += getSize();
+}
+
+
+/** \brief Terminate the current member and start a new one.
+ *
+ * This function ends the deflate stream of the current member, writes
+ * its trailer, and then starts a new deflate stream, with the same
+ * options, after a new header.
+ */
+void GZIPOutputStreambuf::nextMember()
+{
+    closeStream();
+    writeTrailer();
+
+    init(m_compression_level);
+    setParallel(m_deflate_threads, m_deflate_block_size);
+    writeHeader();
+}
+
+
+/** \brief Write a gzip member header.
+ *
+ * This function writes the header of a gzip member to \p outbuf. It
+ * can be used to wrap raw deflate data which was compressed by other
+ * means, such as the data of a DEFLATED entry of a Zip archive, in
+ * a gzip member. The raw deflate data and a trailer written with
+ * writeTrailer() must follow.
+ *
+ * \param[in,out] outbuf  The streambuf where the header gets written.
+ * \param[in] filename  The original filename or an empty string.
+ * \param[in] comment  The comment or an empty string.
+ */
+void GZIPOutputStreambuf::writeHeader(std::streambuf * outbuf, std::string const & filename, std::string const & comment)
 {
     unsigned char const flg(
-                  (m_filename.empty() ? 0x00 : 0x08)
-                | (m_comment.empty()  ? 0x00 : 0x10)
+                  (filename.empty() ? 0x00 : 0x08)
+                | (comment.empty()  ? 0x00 : 0x10)
             );
 
     /** \TODO
@@ -146,7 +349,7 @@ void GZIPOutputStreambuf::writeHeader()
      * I am thinking that the OS should be 3 under Unices.
      */
 
-    std::ostream os(m_outbuf);
+    std::ostream os(outbuf);
     os << static_cast<unsigned char>(0x1f);  // Magic #
     os << static_cast<unsigned char>(0x8b);  // Magic #
     os << static_cast<unsigned char>(0x08);  // Deflater.DEFLATED
@@ -158,32 +361,41 @@ void GZIPOutputStreambuf::writeHeader()
     os << static_cast<unsigned char>(0x00);  // XFLG
     os << static_cast<unsigned char>(0x00);  // OS
 
-    if(!m_filename.empty())
+    if(!filename.empty())
     {
-        os << m_filename.c_str();             // Filename
+        os << filename.c_str();               // Filename
         os << static_cast<unsigned char>(0x00);
     }
 
-    if(!m_comment.empty())
+    if(!comment.empty())
     {
-        os << m_comment.c_str();              // Comment
+        os << comment.c_str();                // Comment
         os << static_cast<unsigned char>(0x00);
     }
 }
 
 
-void GZIPOutputStreambuf::writeTrailer()
+/** \brief Write a gzip member trailer.
+ *
+ * This function writes the CRC32 and the size of the uncompressed
+ * data at the end of a gzip member.
+ *
+ * \param[in,out] outbuf  The streambuf where the trailer gets written.
+ * \param[in] crc32  The CRC32 of the uncompressed data.
+ * \param[in] size  The size of the uncompressed data modulo 2^32.
+ */
+void GZIPOutputStreambuf::writeTrailer(std::streambuf * outbuf, uint32_t crc32, uint32_t size)
 {
     // write the CRC32 and Size at the end of the file
-    writeInt(getCrc32());
-    writeInt(getSize());
+    writeInt(outbuf, crc32);
+    writeInt(outbuf, size);
 }
 
 
-void GZIPOutputStreambuf::writeInt(uint32_t i)
+void GZIPOutputStreambuf::writeInt(std::streambuf * outbuf, uint32_t i)
 {
     /** \todo: add support for 64 bit files if it exists? */
-    std::ostream os(m_outbuf);
+    std::ostream os(outbuf);
     os << static_cast<unsigned char>( i        & 0xFF);
     os << static_cast<unsigned char>((i >>  8) & 0xFF);
     os << static_cast<unsigned char>((i >> 16) & 0xFF);
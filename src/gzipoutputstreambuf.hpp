@@ -46,9 +46,15 @@ public:
 
     void          setFilename(std::string const & filename);
     void          setComment(std::string const & comment);
+    void          setParallelDeflate(std::size_t threads, std::size_t block_size);
+    void          setMemberSize(std::size_t member_size);
+    void          setInflateIndex(InflateIndex::pointer_t index);
     void          close();
     void          finish();
 
+    static void   writeHeader(std::streambuf * outbuf, std::string const & filename, std::string const & comment);
+    static void   writeTrailer(std::streambuf * outbuf, uint32_t crc32, uint32_t size);
+
 protected:
     virtual int   overflow(int c = EOF) override;
     virtual int   sync() override;
@@ -56,11 +62,22 @@ protected:
 private:
     void          writeHeader();
     void          writeTrailer();
-    void          writeInt(uint32_t i);
+    static void   writeInt(std::streambuf * outbuf, uint32_t i);
+    void          nextMember();
 
+    FileEntry::CompressionLevel
+                  m_compression_level = FileEntry::COMPRESSION_LEVEL_DEFAULT;
     std::string   m_filename = std::string();
     std::string   m_comment = std::string();
+    std::size_t   m_deflate_threads = 0;
+    std::size_t   m_deflate_block_size = 0;
+    std::size_t   m_member_size = 0;
+    InflateIndex::pointer_t
+                  m_index = InflateIndex::pointer_t();
+    offset_t      m_compressed_size = 0;
+    offset_t      m_uncompressed_size = 0;
     bool          m_open = false;
+    bool          m_finished = false;
 };
 
 
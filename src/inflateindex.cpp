@@ -0,0 +1,337 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::InflateIndex.
+ *
+ * This file implements the list of access points used to seek inside
+ * a deflated stream without inflating everything before the target.
+ */
+
+#include "inflateindex.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The magic found at the start of a saved index.
+ *
+ * The magic is followed by the version of the format, see
+ * g_index_version.
+ */
+char const g_index_magic[] = "ZIDX";
+
+
+/** \brief The version of the format of a saved index.
+ *
+ * This number must be incremented whenever the format of the saved
+ * index changes.
+ */
+uint32_t const g_index_version = 1;
+
+
+} // no name namespace
+
+
+/** \class InflateIndex
+ * \brief A list of access points inside a deflated stream.
+ *
+ * Deflated data can only be decompressed from the start: each block
+ * may refer to the previous 32 KiB of output. To seek forward, one has
+ * to inflate all the data before the target, and to seek backward, one
+ * has to restart from the beginning.
+ *
+ * The InflateIndex saves an access point, the state required to resume
+ * inflating, every span bytes of output (1 MiB by default). An access
+ * point records the position in the compressed and uncompressed data,
+ * the number of bits of the last compressed byte which were not yet
+ * used, and the last 32 KiB of output. This is the technique used by
+ * the zran.c example of zlib.
+ *
+ * The access points are added by the InflateInputStreambuf as it reads
+ * the data forward, so the first pass over an entry builds its index
+ * and the following seeks resume from the nearest access point.
+ *
+ * The index is protected by a mutex so multiple streams reading the
+ * same entry from different threads can share it.
+ *
+ * An index can be saved with save() and loaded back with load(), for
+ * example in a sidecar file next to a large gzip file, so it does not
+ * need to be rebuilt each time the file gets opened.
+ */
+
+
+/** \var InflateIndex::DEFAULT_SPAN
+ * \brief The default distance between two access points.
+ *
+ * Each access point holds a 32 KiB window, so with the default of
+ * 1 MiB, the index uses about 3% of the size of the uncompressed data.
+ */
+offset_t const InflateIndex::DEFAULT_SPAN;
+
+
+/** \var InflateIndex::WINDOW_SIZE
+ * \brief The size of the deflate window saved in each access point.
+ */
+std::size_t const InflateIndex::WINDOW_SIZE;
+
+
+/** \struct InflateIndex::checkpoint_t
+ * \brief One access point inside a deflated stream.
+ *
+ * The m_out field is the offset in the uncompressed data and m_in the
+ * offset in the compressed data. When m_bits is not zero, the
+ * decompression resumes with the last m_bits bits of the byte found
+ * just before m_in. The m_window holds the uncompressed data which
+ * precedes m_out, up to 32 KiB.
+ */
+
+
+/** \brief Initialize an empty index.
+ *
+ * \param[in] span  The minimum distance, in uncompressed bytes, between
+ *                  two access points.
+ */
+InflateIndex::InflateIndex(offset_t span)
+    : m_span(span)
+{
+}
+
+
+/** \brief Clean up the index.
+ *
+ * The destructor releases all the access points.
+ */
+InflateIndex::~InflateIndex()
+{
+}
+
+
+/** \brief Get the distance between two access points.
+ *
+ * \return The span defined on construction.
+ */
+offset_t InflateIndex::getSpan() const
+{
+    return m_span;
+}
+
+
+/** \brief Get the number of access points.
+ *
+ * \return The number of access points currently in the index.
+ */
+std::size_t InflateIndex::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_checkpoints.size();
+}
+
+
+/** \brief Check whether an access point is wanted at \p out.
+ *
+ * The InflateInputStreambuf calls this function at each deflate block
+ * boundary. It returns true once the output is at least one span past
+ * the last access point.
+ *
+ * \param[in] out  The current offset in the uncompressed data.
+ *
+ * \return true if a new access point should be added at \p out.
+ */
+bool InflateIndex::needsCheckpoint(offset_t out) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    offset_t const last(m_checkpoints.empty() ? 0 : m_checkpoints.back().m_out);
+    return out >= last + m_span;
+}
+
+
+/** \brief Add an access point.
+ *
+ * The access points are kept sorted. Since several streams may read
+ * the same entry, an access point which is not past the last one is
+ * ignored; it is already covered.
+ *
+ * \param[in] checkpoint  The access point to add.
+ */
+void InflateIndex::addCheckpoint(checkpoint_t const & checkpoint)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_checkpoints.empty()
+    && checkpoint.m_out <= m_checkpoints.back().m_out)
+    {
+        return;
+    }
+
+    m_checkpoints.push_back(checkpoint);
+}
+
+
+/** \brief Search the access point closest to \p out.
+ *
+ * This function searches the last access point which is at or before
+ * \p out and returns a copy of it.
+ *
+ * \param[in] out  The offset in the uncompressed data to seek to.
+ * \param[out] checkpoint  The access point found.
+ *
+ * \return true if an access point was found.
+ */
+bool InflateIndex::findCheckpoint(offset_t out, checkpoint_t & checkpoint) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto const it(std::upper_bound(
+              m_checkpoints.begin()
+            , m_checkpoints.end()
+            , out
+            , [](offset_t value, checkpoint_t const & c)
+            {
+                return value < c.m_out;
+            }));
+    if(it == m_checkpoints.begin())
+    {
+        return false;
+    }
+
+    checkpoint = *(it - 1);
+    return true;
+}
+
+
+/** \brief Save the index to a stream.
+ *
+ * This function writes the span and all the access points to \p os
+ * in a binary format, with all the numbers in little endian. The
+ * index can then be reloaded with load().
+ *
+ * \exception IOException
+ * This exception is raised if writing to \p os fails.
+ *
+ * \param[in,out] os  The stream where the index gets saved.
+ */
+void InflateIndex::save(std::ostream & os) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    zipWrite(os, std::string(g_index_magic));
+    zipWrite(os, g_index_version);
+    zipWrite(os, static_cast<uint64_t>(m_span));
+    zipWrite(os, static_cast<uint64_t>(m_checkpoints.size()));
+    for(auto it(m_checkpoints.begin()); it != m_checkpoints.end(); ++it)
+    {
+        zipWrite(os, static_cast<uint64_t>(it->m_out));
+        zipWrite(os, static_cast<uint64_t>(it->m_in));
+        zipWrite(os, static_cast<uint8_t>(it->m_bits));
+        zipWrite(os, static_cast<uint32_t>(it->m_window.size()));
+        zipWrite(os, it->m_window);
+    }
+}
+
+
+/** \brief Load an index saved with save().
+ *
+ * This function reads an index from \p is. The index is expected to
+ * have been saved with save() from the same deflated data.
+ *
+ * \exception IOException
+ * This exception is raised if \p is does not include a valid index.
+ *
+ * \param[in,out] is  The stream from which the index gets loaded.
+ *
+ * \return The loaded index.
+ */
+InflateIndex::pointer_t InflateIndex::load(std::istream & is)
+{
+    std::string magic;
+    zipRead(is, magic, sizeof(g_index_magic) - 1);
+    uint32_t version(0);
+    zipRead(is, version);
+    if(magic != g_index_magic
+    || version != g_index_version)
+    {
+        throw IOException("InflateIndex::load(): the input is not a saved inflate index.");
+    }
+
+    uint64_t span(0);
+    uint64_t count(0);
+    zipRead(is, span);
+    zipRead(is, count);
+    if(span == 0)
+    {
+        throw IOException("InflateIndex::load(): the span of the index is invalid.");
+    }
+
+    pointer_t index(std::make_shared<InflateIndex>(static_cast<offset_t>(span)));
+    for(uint64_t idx(0); idx < count; ++idx)
+    {
+        checkpoint_t checkpoint;
+        uint64_t out(0);
+        uint64_t in(0);
+        uint8_t bits(0);
+        uint32_t window_size(0);
+        zipRead(is, out);
+        zipRead(is, in);
+        zipRead(is, bits);
+        zipRead(is, window_size);
+        if(window_size > WINDOW_SIZE)
+        {
+            throw IOException("InflateIndex::load(): the index includes an invalid access point.");
+        }
+        zipRead(is, checkpoint.m_window, static_cast<ssize_t>(window_size));
+        checkpoint.m_out = static_cast<offset_t>(out);
+        checkpoint.m_in = static_cast<offset_t>(in);
+        checkpoint.m_bits = bits;
+        if(bits > 7
+        || (bits > 0 && checkpoint.m_in == 0)
+        || (!index->m_checkpoints.empty() && checkpoint.m_out <= index->m_checkpoints.back().m_out))
+        {
+            throw IOException("InflateIndex::load(): the index includes an invalid access point.");
+        }
+        index->m_checkpoints.push_back(checkpoint);
+    }
+
+    return index;
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef INFLATEINDEX_HPP
+#define INFLATEINDEX_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+/** \file
+ * \brief The header file for zipios::InflateIndex
+ *
+ * The zipios::InflateIndex class holds access points inside a deflated
+ * stream so reading can resume from the middle of that stream.
+ */
+
+#include "zipios_common.hpp"
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+
+namespace zipios
+{
+
+
+class InflateIndex
+{
+public:
+    typedef std::shared_ptr<InflateIndex>       pointer_t;
+
+    static offset_t const       DEFAULT_SPAN = 1024 * 1024;
+    static std::size_t const    WINDOW_SIZE = 32 * 1024;
+
+    struct checkpoint_t
+    {
+        offset_t                m_out = 0;
+        offset_t                m_in = 0;
+        int                     m_bits = 0;
+        buffer_t                m_window = buffer_t();
+    };
+
+                                InflateIndex(offset_t span = DEFAULT_SPAN);
+                                InflateIndex(InflateIndex const & rhs) = delete;
+                                ~InflateIndex();
+
+    InflateIndex &              operator = (InflateIndex const & rhs) = delete;
+
+    offset_t                    getSpan() const;
+    std::size_t                 size() const;
+    bool                        needsCheckpoint(offset_t out) const;
+    void                        addCheckpoint(checkpoint_t const & checkpoint);
+    bool                        findCheckpoint(offset_t out, checkpoint_t & checkpoint) const;
+    void                        save(std::ostream & os) const;
+
+    static pointer_t            load(std::istream & is);
+
+private:
+    typedef std::vector<checkpoint_t>   checkpoint_vector_t;
+
+    mutable std::mutex          m_mutex = std::mutex();
+    offset_t const              m_span;
+    checkpoint_vector_t         m_checkpoints = checkpoint_vector_t();
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -31,8 +31,12 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "streampool.hpp"
 #include "zipios_common.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 
 namespace zipios
 {
@@ -48,6 +52,12 @@ namespace zipios
  * inflation, this class only wraps the functionality in an input
  * stream filter.
  *
+ * The stream buffer can seek within the inflated data. Seeking
+ * forward inflates and drops the data up to the target. Seeking
+ * backward restarts from the beginning of the deflated data, unless
+ * an InflateIndex is attached, in which case inflating resumes from
+ * the closest access point.
+ *
  * \todo
  * Add support for bzip2, lzma compressions.
  */
@@ -69,8 +79,9 @@ namespace zipios
  */
 InflateInputStreambuf::InflateInputStreambuf(std::streambuf * inbuf, offset_t start_pos)
     : FilterInputStreambuf(inbuf)
-    , m_outvec(getBufferSize())
-    , m_invec(getBufferSize())
+    , m_outvec(StreamPool::acquireBuffer())
+    , m_invec(StreamPool::acquireBuffer())
+    , m_zs(StreamPool::acquireInflate())
 {
     // NOTICE: It is important that this constructor and the methods it
     // calls doesn't do anything with the input streambuf inbuf, other
@@ -88,23 +99,14 @@ InflateInputStreambuf::InflateInputStreambuf(std::streambuf * inbuf, offset_t st
 /** \brief Clean up the InflateInputStreambuf object.
  *
  * The destructor makes sure all allocated resources get cleaned up.
+ * The z_stream and the buffers are returned to the StreamPool so the
+ * next stream buffer can reuse them.
  */
 InflateInputStreambuf::~InflateInputStreambuf()
 {
-    // Dealloc z_stream
-    int const err(inflateEnd(&m_zs));
-    if(err != Z_OK)
-    {
-        // in a destructor we cannot throw...
-        OutputStringStream msgs; // LCOV_EXCL_LINE
-        msgs << "InflateInputStreambuf::~InflateInputStreambuf(): inflateEnd() failed" // LCOV_EXCL_LINE
-             << ": " << zError(err); // LCOV_EXCL_LINE
-        /** \TODO
-         * Write an error callback interface and call that instead of
-         * using std::cerr...
-         */
-        std::cerr << msgs.str() << std::endl; // LCOV_EXCL_LINE
-    }
+    StreamPool::releaseInflate(m_zs);
+    StreamPool::releaseBuffer(m_invec);
+    StreamPool::releaseBuffer(m_outvec);
 }
 
 
@@ -130,38 +132,56 @@ std::streambuf::int_type InflateInputStreambuf::underflow()
     }
 
     // Prepare _outvec and get array pointers
-    m_zs.avail_out = getBufferSize();
-    m_zs.next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
+    m_zs->avail_out = getBufferSize();
+    m_zs->next_out = reinterpret_cast<unsigned char *>(&m_outvec[0]);
+
+    // with an index, stop at each deflate block boundary so we can
+    // record access points
+    int const flush(m_index == nullptr ? Z_NO_FLUSH : Z_BLOCK);
 
     // Inflate until _outvec is full
     // eof (or I/O prob) on _inbuf will break out of loop too.
     int err(Z_OK);
-    while(m_zs.avail_out > 0 && err == Z_OK)
+    while(m_zs->avail_out > 0 && err == Z_OK)
     {
-        if(m_zs.avail_in == 0)
+        if(m_zs->avail_in == 0)
         {
             // fill m_invec
             std::streamsize const bc(m_inbuf->sgetn(&m_invec[0], getBufferSize()));
             /** \FIXME
              * Add I/O error handling while inflating data from a file.
              */
-            m_zs.next_in = reinterpret_cast<unsigned char *>(&m_invec[0]);
-            m_zs.avail_in = bc;
+            m_zs->next_in = reinterpret_cast<unsigned char *>(&m_invec[0]);
+            m_zs->avail_in = bc;
             // If we could not read any new data (bc == 0) and inflate is not
             // done it will return Z_BUF_ERROR and thus breaks out of the
             // loop. This means we do not have to respond to the situation
             // where we cannot read more bytes here.
         }
 
-        err = inflate(&m_zs, Z_NO_FLUSH);
+        err = inflate(m_zs, flush);
+
+        // bit 7 of data_type is set at the end of a block and bit 6
+        // when that block is the last one
+        //
+        if(m_index != nullptr
+        && err == Z_OK
+        && (m_zs->data_type & 0xC0) == 0x80
+        && m_index->needsCheckpoint(m_out_base + static_cast<offset_t>(m_zs->total_out)))
+        {
+            addCheckpoint();
+        }
     }
 
+    m_stream_end = err == Z_STREAM_END;
+
     // Normally the number of inflated bytes will be the
     // full length of the output buffer, but if we can't read
     // more input from the _inbuf streambuf, we end up with
     // less.
-    offset_t const inflated_bytes = getBufferSize() - m_zs.avail_out;
+    offset_t const inflated_bytes = getBufferSize() - m_zs->avail_out;
     setg(&m_outvec[0], &m_outvec[0], &m_outvec[0] + inflated_bytes);
+    m_position += inflated_bytes;
 
     /** \FIXME
      * Look at the error returned from inflate here, if there is
@@ -210,31 +230,34 @@ bool InflateInputStreambuf::reset(offset_t stream_position)
     {
         // reposition m_inbuf
         m_inbuf->pubseekpos(stream_position);
-    }
-
-    // m_zs.next_in and avail_in must be set according to
-    // zlib.h (inline doc).
-    m_zs.next_in = reinterpret_cast<Bytef *>(&m_invec[0]);
-    m_zs.avail_in = 0;
-
-    int err(Z_OK);
-    if(m_zs_initialized)
-    {
-        // just reset it
-        err = inflateReset(&m_zs);
+        m_start_pos = stream_position;
     }
     else
     {
-        // initialize it
-        err = inflateInit2(&m_zs, -MAX_WBITS);
-        /* windowBits is passed < 0 to tell that there is no zlib header.
-           Note that in this case inflate *requires* an extra "dummy" byte
-           after the compressed stream in order to complete decompression
-           and return Z_STREAM_END.  We always have an extra "dummy" byte,
-           because there is always some trailing data after the compressed
-           data (either the next entry or the central directory).  */
-        m_zs_initialized = true;
+        // -1 if the input does not support seeking
+        m_start_pos = m_inbuf->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
     }
+    m_data_start = 0;
+    m_in_base = 0;
+    m_out_base = 0;
+    m_position = 0;
+    m_stream_end = false;
+
+    // m_zs->next_in and avail_in must be set according to
+    // zlib.h (inline doc).
+    m_zs->next_in = reinterpret_cast<Bytef *>(&m_invec[0]);
+    m_zs->avail_in = 0;
+
+    // the z_stream comes from the StreamPool, already initialized
+    // with inflateInit2(), so we just reset it
+    //
+    /* windowBits is passed < 0 to tell that there is no zlib header.
+       Note that in this case inflate *requires* an extra "dummy" byte
+       after the compressed stream in order to complete decompression
+       and return Z_STREAM_END.  We always have an extra "dummy" byte,
+       because there is always some trailing data after the compressed
+       data (either the next entry or the central directory).  */
+    int const err(inflateReset(m_zs));
 
     // streambuf init:
     // The important thing here, is that
@@ -247,6 +270,289 @@ bool InflateInputStreambuf::reset(offset_t stream_position)
 }
 
 
+/** \brief Attach an index of access points to this stream buffer.
+ *
+ * When an index is attached, the stream buffer adds access points to
+ * it as it inflates the data and seekInflated() resumes from the closest
+ * access point instead of restarting from the beginning.
+ *
+ * The index may be shared by several stream buffers reading the same
+ * deflated data.
+ *
+ * \param[in] index  The index to use, or a null pointer.
+ */
+void InflateInputStreambuf::setInflateIndex(InflateIndex::pointer_t index)
+{
+    m_index = index;
+}
+
+
+/** \brief Get the current position in the inflated data.
+ *
+ * \return The offset of the next byte to be read from this stream buffer.
+ */
+offset_t InflateInputStreambuf::getInflatedPosition() const
+{
+    return m_position - (egptr() - gptr());
+}
+
+
+/** \brief Move the read position within the inflated data.
+ *
+ * This function moves the read position to \p target, an offset in
+ * the inflated data.
+ *
+ * If the target is in the current output buffer, only the pointers are
+ * updated. Otherwise, when an access point before the target is
+ * available and better than the current position, inflating resumes
+ * from it. When seeking backward without such an access point, inflating
+ * restarts from the beginning of the data. In all cases, the data up to
+ * the target then gets inflated and dropped.
+ *
+ * The input streambuf must support seeking.
+ *
+ * \exception IOException
+ * This exception is raised if the data cannot be inflated.
+ *
+ * \param[in] target  The new position in the inflated data.
+ *
+ * \return true if the position was changed; false if the input cannot
+ *         be repositioned or the target is past the end of the data.
+ */
+bool InflateInputStreambuf::seekInflated(offset_t target)
+{
+    if(target < 0)
+    {
+        return false;
+    }
+
+    offset_t const buffer_start(m_position - (egptr() - eback()));
+    if(target >= buffer_start && target <= m_position)
+    {
+        setg(eback(), eback() + (target - buffer_start), egptr());
+        return true;
+    }
+
+    if(m_start_pos < 0)
+    {
+        return false;
+    }
+
+    offset_t const current(getInflatedPosition());
+    InflateIndex::checkpoint_t checkpoint;
+    bool const found(m_index != nullptr && m_index->findCheckpoint(target, checkpoint));
+    if(found && checkpoint.m_out > current)
+    {
+        restart(&checkpoint);
+    }
+    else if(target < current)
+    {
+        restart(found ? &checkpoint : nullptr);
+    }
+
+    // inflate and drop the data up to the target
+    //
+    while(m_position < target)
+    {
+        setg(egptr(), egptr(), egptr());
+        if(traits_type::eq_int_type(underflow(), traits_type::eof()))
+        {
+            return false;
+        }
+    }
+    setg(eback(), egptr() - (m_position - target), egptr());
+
+    return true;
+}
+
+
+/** \brief Check whether the end of the deflate stream was reached.
+ *
+ * \return true once inflate() returned Z_STREAM_END.
+ */
+bool InflateInputStreambuf::isStreamEnd() const
+{
+    return m_stream_end;
+}
+
+
+/** \brief Read input which follows the deflate data.
+ *
+ * This function reads up to \p size bytes of input as is. The input
+ * already read from the input streambuf but not used by inflate()
+ * comes first. This is used to read data found before or after the
+ * deflated data, such as the header and trailer of a gzip member.
+ *
+ * The bytes read are counted as part of the input so the positions
+ * saved in the access points remain correct.
+ *
+ * \param[out] buf  The buffer receiving the data.
+ * \param[in] size  The number of bytes to read.
+ *
+ * \return The number of bytes read, less than \p size at the end of
+ *         the input.
+ */
+std::size_t InflateInputStreambuf::readInput(char * buf, std::size_t size)
+{
+    std::size_t const buffered(std::min(size, static_cast<std::size_t>(m_zs->avail_in)));
+    if(buffered > 0)
+    {
+        memcpy(buf, m_zs->next_in, buffered);
+        m_zs->next_in += buffered;
+        m_zs->avail_in -= static_cast<uInt>(buffered);
+    }
+
+    std::size_t result(buffered);
+    if(result < size)
+    {
+        std::streamsize const bc(m_inbuf->sgetn(buf + result, size - result));
+        if(bc > 0)
+        {
+            result += bc;
+        }
+    }
+    m_in_base += result;
+
+    return result;
+}
+
+
+/** \brief Check whether more input is available.
+ *
+ * \return true if readInput() would return at least one byte.
+ */
+bool InflateInputStreambuf::hasInput()
+{
+    return m_zs->avail_in > 0
+        || !traits_type::eq_int_type(m_inbuf->sgetc(), traits_type::eof());
+}
+
+
+/** \brief Start inflating another deflate stream.
+ *
+ * Once the end of a deflate stream was reached and the data following
+ * it was read with readInput(), this function resets the zlib stream
+ * to inflate the next deflate stream, starting with the input not yet
+ * read. The position in the inflated data continues from the end of
+ * the previous stream.
+ */
+void InflateInputStreambuf::restartStream()
+{
+    m_in_base += static_cast<offset_t>(m_zs->total_in);
+    m_out_base += static_cast<offset_t>(m_zs->total_out);
+
+    // inflateReset() keeps next_in and avail_in
+    //
+    int const err(inflateReset(m_zs));
+    if(err != Z_OK)
+    {
+        throw IOException(std::string("InflateInputStreambuf::restartStream(): inflateReset() failed: ") + zError(err)); // LCOV_EXCL_LINE
+    }
+    m_stream_end = false;
+}
+
+
+/** \brief Mark the start of the deflated data.
+ *
+ * A sub-class which reads a header with readInput() before the deflated
+ * data calls this function once done, so restarting from the beginning
+ * skips that header.
+ */
+void InflateInputStreambuf::markDataStart()
+{
+    m_data_start = m_in_base;
+}
+
+
+/** \brief Restart inflating from an access point.
+ *
+ * This function resets the zlib stream and repositions the input
+ * streambuf at the access point \p checkpoint, or at the beginning of
+ * the deflated data if \p checkpoint is a null pointer.
+ *
+ * A sub-class which keeps track of the data it read overrides this
+ * function to reset its own state, calling this implementation first.
+ *
+ * \exception IOException
+ * This exception is raised if the zlib stream cannot be restored.
+ *
+ * \param[in] checkpoint  The access point to restart from or nullptr.
+ */
+void InflateInputStreambuf::restart(InflateIndex::checkpoint_t const * checkpoint)
+{
+    int err(inflateReset(m_zs));
+    m_zs->next_in = reinterpret_cast<Bytef *>(&m_invec[0]);
+    m_zs->avail_in = 0;
+
+    if(checkpoint == nullptr)
+    {
+        m_in_base = m_data_start;
+        m_out_base = 0;
+        m_inbuf->pubseekpos(m_start_pos + m_data_start);
+    }
+    else
+    {
+        m_in_base = checkpoint->m_in;
+        m_out_base = checkpoint->m_out;
+        if(checkpoint->m_bits == 0)
+        {
+            m_inbuf->pubseekpos(m_start_pos + checkpoint->m_in);
+        }
+        else
+        {
+            // the access point starts in the middle of a byte
+            //
+            m_inbuf->pubseekpos(m_start_pos + checkpoint->m_in - 1);
+            std::streambuf::int_type const c(m_inbuf->sbumpc());
+            if(traits_type::eq_int_type(c, traits_type::eof()))
+            {
+                throw IOException("InflateInputStreambuf::restart(): could not read the byte of an access point.");
+            }
+            err = inflatePrime(m_zs, checkpoint->m_bits, c >> (8 - checkpoint->m_bits));
+        }
+        if(err == Z_OK)
+        {
+            err = inflateSetDictionary(m_zs, checkpoint->m_window.data(), static_cast<uInt>(checkpoint->m_window.size()));
+        }
+    }
+
+    if(err != Z_OK)
+    {
+        OutputStringStream msgs;
+        msgs << "InflateInputStreambuf::restart(): could not restore the inflate state"
+             << ": " << zError(err);
+        throw IOException(msgs.str());
+    }
+
+    m_position = m_out_base;
+    m_stream_end = false;
+    setg(&m_outvec[0], &m_outvec[0] + getBufferSize(), &m_outvec[0] + getBufferSize());
+}
+
+
+/** \brief Add an access point at the current position to the index.
+ *
+ * This function is called at the end of a deflate block. It saves the
+ * current positions and the last 32 KiB of inflated data in the index.
+ */
+void InflateInputStreambuf::addCheckpoint()
+{
+    InflateIndex::checkpoint_t checkpoint;
+    checkpoint.m_out = m_out_base + static_cast<offset_t>(m_zs->total_out);
+    checkpoint.m_in = m_in_base + static_cast<offset_t>(m_zs->total_in);
+    checkpoint.m_bits = m_zs->data_type & 7;
+    checkpoint.m_window.resize(InflateIndex::WINDOW_SIZE);
+    uInt size(static_cast<uInt>(checkpoint.m_window.size()));
+    if(inflateGetDictionary(m_zs, checkpoint.m_window.data(), &size) != Z_OK)
+    {
+        return; // LCOV_EXCL_LINE
+    }
+    checkpoint.m_window.resize(size);
+
+    m_index->addCheckpoint(checkpoint);
+}
+
+
 } // zipios namespace
 
 // Local Variables:
@@ -32,6 +32,7 @@
  */
 
 #include "filterinputstreambuf.hpp"
+#include "inflateindex.hpp"
 
 #include "zipios/zipios-config.hpp"
 
@@ -54,10 +55,20 @@ public:
     InflateInputStreambuf &  operator = (InflateInputStreambuf const & rhs) = delete;
 
     bool                    reset(offset_t stream_position = -1);
+    void                    setInflateIndex(InflateIndex::pointer_t index);
 
 protected:
     virtual std::streambuf::int_type             underflow() override;
 
+    offset_t                getInflatedPosition() const;
+    bool                    seekInflated(offset_t target);
+    bool                    isStreamEnd() const;
+    std::size_t             readInput(char * buf, std::size_t size);
+    bool                    hasInput();
+    void                    restartStream();
+    void                    markDataStart();
+    virtual void            restart(InflateIndex::checkpoint_t const * checkpoint);
+
     /** \FIXME Consider design?
      */
     std::vector<char>       m_outvec = std::vector<char>();
@@ -65,8 +76,16 @@ protected:
 private:
     std::vector<char>       m_invec = std::vector<char>();
 
-    z_stream                m_zs = z_stream();
-    bool                    m_zs_initialized = false;
+    void                    addCheckpoint();
+
+    z_stream *              m_zs = nullptr;
+    offset_t                m_start_pos = -1;
+    offset_t                m_data_start = 0;
+    offset_t                m_in_base = 0;
+    offset_t                m_out_base = 0;
+    offset_t                m_position = 0;
+    bool                    m_stream_end = false;
+    InflateIndex::pointer_t m_index = InflateIndex::pointer_t();
 };
 
 
@@ -0,0 +1,194 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::MemoryMapStreambuf.
+ *
+ * This file implements an input std::streambuf which reads its data
+ * directly from a memory mapped file.
+ */
+
+#include "memorymapstreambuf.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class MemoryMapStreambuf
+ * \brief An input stream buffer over a block of a memory mapped file.
+ *
+ * The MemoryMapStreambuf class is an std::streambuf which get area is
+ * the block of data it was given on construction. It never copies
+ * the data: the characters returned by the stream come directly from
+ * the mapping.
+ *
+ * The ZipFile uses this stream buffer for STORED entries when the
+ * archive was opened with ZipFile::OPEN_MODE_MEMORY_MAP.
+ *
+ * The stream buffer holds a shared pointer to the RandomAccessFile so
+ * the mapping remains valid for as long as the stream buffer exists.
+ *
+ * The same stream buffer is used to read the decompressed data of an
+ * entry found in the cache of a ZipFile. In that case it holds a shared
+ * pointer to that data instead.
+ */
+
+
+
+/** \brief Initialize the stream buffer.
+ *
+ * This constructor makes the \p size bytes at \p data available
+ * through this stream buffer.
+ *
+ * \exception InvalidStateException
+ * This exception is raised if \p file is a null pointer.
+ *
+ * \param[in] file  The memory mapped file.
+ * \param[in] data  A pointer to the data inside the mapping of \p file.
+ * \param[in] size  The number of bytes available at \p data.
+ */
+MemoryMapStreambuf::MemoryMapStreambuf(RandomAccessFile::pointer_t file, char const * data, std::size_t size)
+    : m_file(file)
+{
+    if(m_file == nullptr)
+    {
+        throw InvalidStateException("MemoryMapStreambuf::MemoryMapStreambuf() was called with a null file pointer");
+    }
+
+    // the get area is never written to, std::streambuf just does not
+    // offer a read-only version of the pointers
+    //
+    char * ptr(const_cast<char *>(data));
+    setg(ptr, ptr, ptr + size);
+}
+
+
+/** \brief Initialize the stream buffer over a shared block of memory.
+ *
+ * This constructor makes the bytes of \p buffer available through this
+ * stream buffer. The buffer is not copied, the stream buffer keeps a
+ * reference to it instead.
+ *
+ * \exception InvalidStateException
+ * This exception is raised if \p buffer is a null pointer.
+ *
+ * \param[in] buffer  The data to read.
+ */
+MemoryMapStreambuf::MemoryMapStreambuf(std::shared_ptr<buffer_t const> buffer)
+    : m_buffer(buffer)
+{
+    if(m_buffer == nullptr)
+    {
+        throw InvalidStateException("MemoryMapStreambuf::MemoryMapStreambuf() was called with a null buffer pointer");
+    }
+
+    char * ptr(const_cast<char *>(reinterpret_cast<char const *>(m_buffer->data())));
+    setg(ptr, ptr, ptr + m_buffer->size());
+}
+
+
+/** \brief Clean up the stream buffer.
+ *
+ * The destructor releases the file or buffer. A file gets unmapped and
+ * closed if this was the last reference to it.
+ */
+MemoryMapStreambuf::~MemoryMapStreambuf()
+{
+}
+
+
+/** \brief Change the read position.
+ *
+ * This function moves the read position within the block of data.
+ * Only the input position is supported.
+ *
+ * \param[in] off  The offset to move to.
+ * \param[in] dir  Whether \p off is relative to the start, the current
+ *                 position, or the end of the block.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type MemoryMapStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    off_type target(off);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        target += gptr() - eback();
+        break;
+
+    case std::ios_base::end:
+        target += egptr() - eback();
+        break;
+
+    default: // LCOV_EXCL_LINE
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    if(target < 0 || target > egptr() - eback())
+    {
+        return pos_type(off_type(-1));
+    }
+
+    setg(eback(), eback() + target, egptr());
+
+    return pos_type(target);
+}
+
+
+/** \brief Change the read position to an absolute position.
+ *
+ * This function is the same as seekoff() with std::ios_base::beg.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type MemoryMapStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef MEMORYMAPSTREAMBUF_HPP
+#define MEMORYMAPSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The header file for zipios::MemoryMapStreambuf
+ *
+ * The zipios::MemoryMapStreambuf class is an std::streambuf giving
+ * direct access to a block of a memory mapped zipios::RandomAccessFile.
+ */
+
+#include "randomaccessfile.hpp"
+#include "zipios_common.hpp"
+
+#include <iostream>
+
+
+namespace zipios
+{
+
+
+class MemoryMapStreambuf : public std::streambuf
+{
+public:
+                                MemoryMapStreambuf(RandomAccessFile::pointer_t file, char const * data, std::size_t size);
+                                MemoryMapStreambuf(std::shared_ptr<buffer_t const> buffer);
+                                MemoryMapStreambuf(MemoryMapStreambuf const & rhs) = delete;
+    virtual                     ~MemoryMapStreambuf() override;
+
+    MemoryMapStreambuf &        operator = (MemoryMapStreambuf const & rhs) = delete;
+
+protected:
+    virtual pos_type            seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    virtual pos_type            seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+
+private:
+    RandomAccessFile::pointer_t m_file = RandomAccessFile::pointer_t();
+    std::shared_ptr<buffer_t const>
+                                m_buffer = std::shared_ptr<buffer_t const>();
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
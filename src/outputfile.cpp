@@ -0,0 +1,239 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::OutputFile.
+ *
+ * This file implements the functions used to create the files and
+ * directories of extracted entries.
+ */
+
+#include "outputfile.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef ZIPIOS_WINDOWS
+#include <algorithm>
+
+#include <direct.h>
+#include <io.h>
+#include <sys/utime.h>
+#else
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+
+namespace zipios
+{
+
+
+/** \class OutputFile
+ * \brief A file being created with the data of an entry.
+ *
+ * The OutputFile creates (or truncates) a file and writes the data of
+ * an entry to it. Since the final size of the file is known, the space
+ * gets reserved on creation, which lets the file system allocate the
+ * file in one contiguous extent instead of growing it write after write.
+ *
+ * The class also offers the few other file system functions needed to
+ * extract an archive: creating directories and restoring modification
+ * times.
+ */
+
+
+/** \brief Create a file.
+ *
+ * This constructor creates the named file, truncating it if it already
+ * exists. Under Linux, \p size bytes get reserved with fallocate().
+ * Failing to reserve the space is not an error, the space then gets
+ * allocated by the writes.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be created.
+ *
+ * \param[in] filename  The name of the file to create.
+ * \param[in] size  The expected size of the file.
+ */
+OutputFile::OutputFile(std::string const & filename, std::size_t size)
+    : m_filename(filename)
+{
+#ifdef ZIPIOS_WINDOWS
+    m_fd = _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    m_fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+#endif
+    if(m_fd < 0)
+    {
+        throw IOException("OutputFile::OutputFile(): could not create file \"" + filename + "\".");
+    }
+
+#ifdef __linux__
+    if(size > 0)
+    {
+        static_cast<void>(fallocate(m_fd, 0, 0, static_cast<off_t>(size)));
+    }
+#else
+    static_cast<void>(size);
+#endif
+}
+
+
+/** \brief Close the file.
+ *
+ * The destructor closes the file if close() was not called. Errors are
+ * ignored here, call close() to detect them.
+ */
+OutputFile::~OutputFile()
+{
+    if(m_fd >= 0)
+    {
+#ifdef ZIPIOS_WINDOWS
+        _close(m_fd);
+#else
+        ::close(m_fd);
+#endif
+    }
+}
+
+
+/** \brief Write data at the end of the file.
+ *
+ * \exception IOException
+ * This exception is raised if the data cannot be written in full.
+ *
+ * \param[in] buf  The data to write.
+ * \param[in] size  The number of bytes to write.
+ */
+void OutputFile::write(void const * buf, std::size_t size)
+{
+    char const * ptr(static_cast<char const *>(buf));
+    while(size > 0)
+    {
+#ifdef ZIPIOS_WINDOWS
+        int const r(_write(m_fd, ptr, static_cast<unsigned int>(std::min(size, static_cast<std::size_t>(0x40000000)))));
+#else
+        ssize_t const r(::write(m_fd, ptr, size));
+#endif
+        if(r < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+            throw IOException("OutputFile::write(): could not write to file \"" + m_filename + "\"."); // LCOV_EXCL_LINE
+        }
+        ptr += r;
+        size -= static_cast<std::size_t>(r);
+    }
+}
+
+
+/** \brief Close the file.
+ *
+ * \exception IOException
+ * This exception is raised if closing the file fails, which may mean
+ * that some of the data did not make it to the disk.
+ */
+void OutputFile::close()
+{
+    int const fd(m_fd);
+    m_fd = -1;
+#ifdef ZIPIOS_WINDOWS
+    int const r(_close(fd));
+#else
+    int const r(::close(fd));
+#endif
+    if(r != 0)
+    {
+        throw IOException("OutputFile::close(): could not close file \"" + m_filename + "\"."); // LCOV_EXCL_LINE
+    }
+}
+
+
+/** \brief Create a directory.
+ *
+ * This function creates the named directory. The parent directory must
+ * already exist. If the directory already exists, nothing happens.
+ *
+ * \exception IOException
+ * This exception is raised if the directory cannot be created.
+ *
+ * \param[in] path  The directory to create.
+ */
+void OutputFile::createDirectory(std::string const & path)
+{
+#ifdef ZIPIOS_WINDOWS
+    int const r(_mkdir(path.c_str()));
+#else
+    int const r(mkdir(path.c_str(), 0777));
+#endif
+    if(r != 0)
+    {
+        int const e(errno);
+        os_stat_t st;
+        if(e != EEXIST
+        || stat(path.c_str(), &st) != 0
+        || !S_ISDIR(st.st_mode))
+        {
+            throw IOException("OutputFile::createDirectory(): could not create directory \"" + path + "\".");
+        }
+    }
+}
+
+
+/** \brief Change the modification time of a file or directory.
+ *
+ * The access time is set to the same time. Errors are ignored.
+ *
+ * \param[in] filename  The file to change.
+ * \param[in] time  The new modification time.
+ */
+void OutputFile::setModificationTime(std::string const & filename, std::time_t time)
+{
+#ifdef ZIPIOS_WINDOWS
+    struct _utimbuf times;
+    times.actime = time;
+    times.modtime = time;
+    static_cast<void>(_utime(filename.c_str(), &times));
+#else
+    struct utimbuf times;
+    times.actime = time;
+    times.modtime = time;
+    static_cast<void>(utime(filename.c_str(), &times));
+#endif
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
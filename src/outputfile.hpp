@@ -0,0 +1,78 @@
+#pragma once
+#ifndef OUTPUTFILE_HPP
+#define OUTPUTFILE_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The header file for zipios::OutputFile
+ *
+ * The zipios::OutputFile class creates the files written when
+ * extracting entries.
+ */
+
+#if !defined(ZIPIOS_WINDOWS) && (defined(_WINDOWS) || defined(WIN32) || defined(_WIN32) || defined(__WIN32))
+#define ZIPIOS_WINDOWS
+#endif
+
+#include "zipios/zipios-config.hpp"
+
+#include <ctime>
+#include <string>
+
+
+namespace zipios
+{
+
+
+class OutputFile
+{
+public:
+                                OutputFile(std::string const & filename, std::size_t size);
+                                OutputFile(OutputFile const & rhs) = delete;
+                                ~OutputFile();
+
+    OutputFile &                operator = (OutputFile const & rhs) = delete;
+
+    void                        write(void const * buf, std::size_t size);
+    void                        close();
+
+    static void                 createDirectory(std::string const & path);
+    static void                 setModificationTime(std::string const & filename, std::time_t time);
+
+private:
+    std::string                 m_filename = std::string();
+    int                         m_fd = -1;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
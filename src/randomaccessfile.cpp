@@ -0,0 +1,305 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::RandomAccessFile.
+ *
+ * This file implements the functions used to read a file at any
+ * position without changing a shared file position.
+ */
+
+#include "randomaccessfile.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <fcntl.h>
+#include <errno.h>
+
+#include <algorithm>
+
+#ifdef ZIPIOS_WINDOWS
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+/** \class RandomAccessFile
+ * \brief A file opened once and read at any position.
+ *
+ * The RandomAccessFile opens a file in read-only mode and keeps it
+ * open until the object gets destroyed. The read() function takes
+ * the position at which the data is to be read, so the object has
+ * no current position and any number of readers can share it.
+ *
+ * The ZipFile creates one RandomAccessFile for its archive. Each
+ * input stream returned by ZipFile::getInputStream() holds a shared
+ * pointer to that file, so opening an entry does not open the archive
+ * again. Since the file descriptor remains open, the streams continue
+ * to read the same file even if it gets renamed or replaced.
+ *
+ * The file can also be memory mapped. In that case, data() returns a
+ * pointer to the entire file and read() copies the data from the
+ * mapping. The ZipFile uses the mapping to parse the Central Directory
+ * and to give direct access to the data of STORED entries.
+ *
+ * \note
+ * Under MS-Windows, the positional read is emulated with a seek
+ * followed by a read, both protected by a mutex. Memory mapping is
+ * not yet supported there; data() always returns nullptr.
+ */
+
+
+
+/** \brief Open a file for random access.
+ *
+ * This constructor opens the named file in read-only binary mode.
+ * The size of the file is determined once, at the time it gets
+ * opened.
+ *
+ * When \p memory_map is true, the whole file also gets mapped in
+ * memory. If the mapping fails (for example, the file is empty or
+ * the file system does not support mappings) the file is still
+ * usable with read() and data() returns nullptr.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be opened or its size
+ * cannot be determined.
+ *
+ * \param[in] filename  The name of the file to open.
+ * \param[in] memory_map  Whether the file gets memory mapped.
+ */
+RandomAccessFile::RandomAccessFile(std::string const & filename, bool memory_map)
+{
+#ifdef ZIPIOS_WINDOWS
+    m_fd = _open(filename.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    m_fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    if(m_fd < 0)
+    {
+        throw IOException("Error opening Zip archive file for reading in binary mode.");
+    }
+
+    os_stat_t st;
+    if(fstat(m_fd, &st) != 0)
+    {
+#ifdef ZIPIOS_WINDOWS
+        _close(m_fd); // LCOV_EXCL_LINE
+#else
+        close(m_fd); // LCOV_EXCL_LINE
+#endif
+        throw IOException("Error retrieving the size of the Zip archive file."); // LCOV_EXCL_LINE
+    }
+    m_size = st.st_size;
+
+#ifndef ZIPIOS_WINDOWS
+    if(memory_map && m_size > 0)
+    {
+        void * ptr(mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0));
+        if(ptr != MAP_FAILED)
+        {
+            m_data = static_cast<unsigned char const *>(ptr);
+        }
+    }
+#else
+    static_cast<void>(memory_map);
+#endif
+}
+
+
+/** \brief Close the file.
+ *
+ * The destructor unmaps and closes the file. This happens once the
+ * last shared pointer to this file is released, which may be long
+ * after the ZipFile which created it is gone.
+ */
+RandomAccessFile::~RandomAccessFile()
+{
+#ifdef ZIPIOS_WINDOWS
+    _close(m_fd);
+#else
+    if(m_data != nullptr)
+    {
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+    }
+    close(m_fd);
+#endif
+}
+
+
+/** \brief Retrieve the size of the file.
+ *
+ * This function returns the size of the file at the time it was opened.
+ *
+ * \return The size of the file in bytes.
+ */
+offset_t RandomAccessFile::size() const
+{
+    return m_size;
+}
+
+
+/** \brief Retrieve a pointer to the memory mapped file.
+ *
+ * This function returns a pointer to the first byte of the file when
+ * it was memory mapped. The pointer remains valid as long as this
+ * RandomAccessFile exists.
+ *
+ * \return A pointer to the file data or nullptr if the file is not
+ *         memory mapped.
+ */
+unsigned char const * RandomAccessFile::data() const
+{
+    return m_data;
+}
+
+
+/** \brief Read data from the file at the specified position.
+ *
+ * This function reads up to \p size bytes at position \p pos and saves
+ * them in \p buf. It does not change any file position, so multiple
+ * readers can call it simultaneously.
+ *
+ * The function reads less than \p size bytes only when the end of the
+ * file is reached.
+ *
+ * When the file is memory mapped, the data is copied from the mapping.
+ *
+ * \exception IOException
+ * This exception is raised if the read fails.
+ *
+ * \param[in] pos  The position of the first byte to read.
+ * \param[out] buf  The buffer where the data gets saved.
+ * \param[in] size  The number of bytes to read.
+ *
+ * \return The number of bytes read, 0 if \p pos is at or after the
+ *         end of the file.
+ */
+std::size_t RandomAccessFile::read(offset_t pos, void * buf, std::size_t size) const
+{
+    if(m_data != nullptr)
+    {
+        if(pos < 0 || pos >= m_size)
+        {
+            return 0;
+        }
+        std::size_t const available(static_cast<std::size_t>(m_size - pos));
+        std::size_t const total(size < available ? size : available);
+        memcpy(buf, m_data + pos, total);
+        return total;
+    }
+
+    char * ptr(static_cast<char *>(buf));
+    std::size_t total(0);
+    while(total < size)
+    {
+#ifdef ZIPIOS_WINDOWS
+        int r;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(_lseeki64(m_fd, pos + static_cast<offset_t>(total), SEEK_SET) < 0)
+            {
+                throw IOException("RandomAccessFile::read(): seek failed.");
+            }
+            r = _read(m_fd, ptr + total, static_cast<unsigned int>(std::min(size - total, static_cast<std::size_t>(0x40000000))));
+        }
+#else
+        ssize_t const r(pread(m_fd, ptr + total, size - total, pos + static_cast<offset_t>(total)));
+#endif
+        if(r < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue; // LCOV_EXCL_LINE
+            }
+            throw IOException("RandomAccessFile::read(): read failed."); // LCOV_EXCL_LINE
+        }
+        if(r == 0)
+        {
+            // end of file
+            break;
+        }
+        total += static_cast<std::size_t>(r);
+    }
+
+    return total;
+}
+
+
+/** \brief Tell the system that a range of the file is going to be read.
+ *
+ * This function gives the operating system a chance to start reading
+ * the specified range of the file ahead of time. When the file is memory
+ * mapped, the hint is given with madvise(), otherwise posix_fadvise()
+ * is used.
+ *
+ * The function is only a hint. Errors are ignored and under MS-Windows
+ * it does nothing.
+ *
+ * \param[in] pos  The position of the first byte to be read.
+ * \param[in] size  The number of bytes to be read.
+ */
+void RandomAccessFile::willNeed(offset_t pos, std::size_t size) const
+{
+#ifdef ZIPIOS_WINDOWS
+    static_cast<void>(pos);
+    static_cast<void>(size);
+#else
+    if(pos < 0 || pos >= m_size || size == 0)
+    {
+        return;
+    }
+    size = std::min(size, static_cast<std::size_t>(m_size - pos));
+
+    if(m_data != nullptr)
+    {
+        // madvise() requires an address aligned on a page
+        //
+        offset_t const page_size(sysconf(_SC_PAGESIZE));
+        offset_t const start(pos - pos % page_size);
+        madvise(const_cast<unsigned char *>(m_data) + start, size + static_cast<std::size_t>(pos - start), MADV_WILLNEED);
+    }
+    else
+    {
+        posix_fadvise(m_fd, pos, static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+    }
+#endif
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,296 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::RandomAccessStreambuf.
+ *
+ * This file implements an input std::streambuf which reads its data
+ * with positional reads from a zipios::RandomAccessFile.
+ */
+
+#include "randomaccessstreambuf.hpp"
+
+#include "streampool.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace zipios
+{
+
+
+/** \class RandomAccessStreambuf
+ * \brief An input stream buffer reading a RandomAccessFile.
+ *
+ * The RandomAccessStreambuf class is an std::streambuf which keeps its
+ * own read position and reads its data from a RandomAccessFile shared
+ * with other stream buffers. Since the reads are positional, multiple
+ * RandomAccessStreambuf objects can read the same file without
+ * interfering with each other.
+ *
+ * Reads larger than the internal buffer are done directly in the
+ * caller's buffer, which is what happens when the InflateInputStreambuf
+ * and ZipInputStreambuf refill their own buffers.
+ */
+
+
+
+/** \brief Initialize the stream buffer.
+ *
+ * This constructor attaches the stream buffer to \p file. The read
+ * position starts at the beginning of the file.
+ *
+ * The stream buffer holds a shared pointer to the file so the file
+ * remains open as long as the stream buffer exists.
+ *
+ * \exception InvalidStateException
+ * This exception is raised if \p file is a null pointer.
+ *
+ * \param[in] file  The file to read from.
+ */
+RandomAccessStreambuf::RandomAccessStreambuf(RandomAccessFile::pointer_t file)
+    : m_file(file)
+    , m_buffer(StreamPool::acquireBuffer())
+{
+    if(m_file == nullptr)
+    {
+        throw InvalidStateException("RandomAccessStreambuf::RandomAccessStreambuf() was called with a null file pointer");
+    }
+
+    m_end = m_file->size();
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+}
+
+
+/** \brief Initialize the stream buffer with a window of the file.
+ *
+ * This constructor attaches the stream buffer to \p size bytes of
+ * \p file starting at \p start. The stream buffer behaves as if the
+ * file only included those bytes: position 0 is \p start and the end
+ * of the file is reached after \p size bytes.
+ *
+ * \exception InvalidStateException
+ * This exception is raised if \p file is a null pointer or if the
+ * window is not within the file.
+ *
+ * \param[in] file  The file to read from.
+ * \param[in] start  The position of the first byte of the window.
+ * \param[in] size  The number of bytes in the window.
+ */
+RandomAccessStreambuf::RandomAccessStreambuf(RandomAccessFile::pointer_t file, offset_t start, offset_t size)
+    : m_file(file)
+    , m_start(start)
+    , m_end(start + size)
+    , m_pos(start)
+    , m_buffer(StreamPool::acquireBuffer())
+{
+    if(m_file == nullptr)
+    {
+        throw InvalidStateException("RandomAccessStreambuf::RandomAccessStreambuf() was called with a null file pointer");
+    }
+    if(start < 0
+    || size < 0
+    || m_end > m_file->size())
+    {
+        throw InvalidStateException("RandomAccessStreambuf::RandomAccessStreambuf() was called with a window outside of the file");
+    }
+
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+}
+
+
+/** \brief Clean up the stream buffer.
+ *
+ * The destructor releases the file. It gets closed if this was the
+ * last reference to it. The buffer is returned to the StreamPool.
+ */
+RandomAccessStreambuf::~RandomAccessStreambuf()
+{
+    StreamPool::releaseBuffer(m_buffer);
+}
+
+
+/** \brief Called when more data is required.
+ *
+ * The function fills the buffer with the data found at the current
+ * position in the file.
+ *
+ * \return The value of the next character on success or
+ *         std::streambuf::traits_type::eof() at the end of the file.
+ */
+std::streambuf::int_type RandomAccessStreambuf::underflow()
+{
+    if(gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr()); // LCOV_EXCL_LINE
+    }
+
+    std::size_t const available(m_pos < m_end ? static_cast<std::size_t>(m_end - m_pos) : 0);
+    std::size_t const size(m_file->read(m_pos, &m_buffer[0], std::min(m_buffer.size(), available)));
+    m_pos += size;
+    setg(&m_buffer[0], &m_buffer[0], &m_buffer[0] + size);
+
+    if(size > 0)
+    {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    return traits_type::eof();
+}
+
+
+/** \brief Read a block of data.
+ *
+ * This function first returns the data already available in the buffer.
+ * If the remaining data to read is at least as large as the buffer,
+ * it gets read directly in \p s, otherwise the buffer gets refilled.
+ *
+ * \param[out] s  The destination buffer.
+ * \param[in] n  The number of characters to read.
+ *
+ * \return The number of characters read, less than \p n only at the
+ *         end of the file.
+ */
+std::streamsize RandomAccessStreambuf::xsgetn(char_type * s, std::streamsize n)
+{
+    std::streamsize total(0);
+    while(total < n)
+    {
+        std::streamsize const available(egptr() - gptr());
+        if(available > 0)
+        {
+            std::streamsize const size(std::min(available, n - total));
+            memcpy(s + total, gptr(), size);
+            gbump(static_cast<int>(size));
+            total += size;
+            continue;
+        }
+
+        std::size_t const remaining(n - total);
+        if(remaining >= m_buffer.size())
+        {
+            std::size_t const left(m_pos < m_end ? static_cast<std::size_t>(m_end - m_pos) : 0);
+            std::size_t const size(m_file->read(m_pos, s + total, std::min(remaining, left)));
+            m_pos += size;
+            total += size;
+            break;
+        }
+
+        if(traits_type::eq_int_type(underflow(), traits_type::eof()))
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+
+/** \brief Change the read position.
+ *
+ * This function changes the read position. When the new position is
+ * still within the buffer, the buffer is kept. Otherwise it gets
+ * emptied and the next read happens at the new position.
+ *
+ * Only the input position is supported.
+ *
+ * \param[in] off  The offset to move to.
+ * \param[in] dir  Whether \p off is relative to the start, the current
+ *                 position, or the end of the file.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type RandomAccessStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    offset_t target(off);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        target += m_start;
+        break;
+
+    case std::ios_base::cur:
+        target += m_pos - (egptr() - gptr());
+        break;
+
+    case std::ios_base::end:
+        target += m_end;
+        break;
+
+    default: // LCOV_EXCL_LINE
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    if(target < m_start)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    offset_t const buffer_start(m_pos - (egptr() - eback()));
+    if(target >= buffer_start && target <= m_pos)
+    {
+        setg(eback(), eback() + (target - buffer_start), egptr());
+    }
+    else
+    {
+        m_pos = target;
+        setg(&m_buffer[0], &m_buffer[0], &m_buffer[0]);
+    }
+
+    return pos_type(target - m_start);
+}
+
+
+/** \brief Change the read position to an absolute position.
+ *
+ * This function is the same as seekoff() with std::ios_base::beg.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type RandomAccessStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
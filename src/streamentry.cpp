@@ -30,6 +30,7 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "zipios_common.hpp"
 
 #include <fstream>
@@ -148,7 +149,7 @@ bool StreamEntry::isEqual(FileEntry const & file_entry) const
  */
 uint32_t StreamEntry::computeCRC32() const
 {
-    uint32_t result(crc32(0L, Z_NULL, 0));
+    uint32_t result(0);
 
     if(f_istream)
     {
@@ -161,7 +162,7 @@ uint32_t StreamEntry::computeCRC32() const
             {
                 break;
             }
-            result = crc32(result, buf, f_istream.gcount());
+            result = CRC32::update(result, buf, f_istream.gcount());
         }
     }
 
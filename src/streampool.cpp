@@ -0,0 +1,335 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief The implementation file of zipios::StreamPool.
+ *
+ * This file implements thread local pools of zlib streams and buffers.
+ */
+
+#include "streampool.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include <sstream>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+
+/** \brief The pools of one thread.
+ *
+ * Each thread has its own pools so acquiring and releasing objects
+ * does not require any locking. An object acquired in one thread and
+ * released in another simply moves to the pool of the second thread.
+ *
+ * When the thread exits, the pooled zlib streams get ended and freed.
+ */
+struct pools_t
+{
+    struct deflate_t
+    {
+        z_stream *          m_zs = nullptr;
+        int                 m_level = Z_DEFAULT_COMPRESSION;
+    };
+
+                            pools_t() = default;
+                            pools_t(pools_t const & rhs) = delete;
+                            ~pools_t();
+
+    pools_t &               operator = (pools_t const & rhs) = delete;
+
+    std::vector<z_stream *> m_inflates = std::vector<z_stream *>();
+    std::vector<deflate_t>  m_deflates = std::vector<deflate_t>();
+    std::vector<std::vector<char>>
+                            m_buffers = std::vector<std::vector<char>>();
+};
+
+
+/** \brief Whether the pools of this thread were already destroyed.
+ *
+ * Streams destroyed after the thread local pools (i.e. by the destructor
+ * of a static object) must free their resources directly.
+ */
+thread_local bool g_pools_destroyed = false;
+
+
+pools_t::~pools_t()
+{
+    g_pools_destroyed = true;
+
+    for(auto it(m_inflates.begin()); it != m_inflates.end(); ++it)
+    {
+        inflateEnd(*it);
+        delete *it;
+    }
+    for(auto it(m_deflates.begin()); it != m_deflates.end(); ++it)
+    {
+        deflateEnd(it->m_zs);
+        delete it->m_zs;
+    }
+}
+
+
+thread_local pools_t g_pools;
+
+
+/** \brief Get the pools of the current thread.
+ *
+ * \return The pools or nullptr if they were already destroyed.
+ */
+pools_t * get_pools()
+{
+    return g_pools_destroyed ? nullptr : &g_pools;
+}
+
+
+} // no name namespace
+
+
+/** \class StreamPool
+ * \brief Recycle the zlib streams and I/O buffers.
+ *
+ * Opening an entry used to allocate two buffers and initialize a new
+ * zlib stream with inflateInit2(), which allocates the inflate state.
+ * Similarly, each entry written with a ZipOutputStream called
+ * deflateInit2() and deflateEnd(), allocating and freeing the deflate
+ * state and its window each time.
+ *
+ * The StreamPool keeps the zlib streams and buffers which are not in
+ * use anymore so they can be reused. A released zlib stream gets reset
+ * with inflateReset() or deflateReset(), which keeps its allocated
+ * memory. So, once the pools are warm, opening a small entry does not
+ * require any zlib setup nor allocation of buffers.
+ *
+ * The pools are thread local, so no locking is required. Each pool
+ * keeps at most MAXIMUM_POOLED objects; extra objects get freed.
+ */
+
+
+/** \var StreamPool::MAXIMUM_POOLED
+ * \brief The maximum number of objects kept in each pool of a thread.
+ */
+std::size_t const StreamPool::MAXIMUM_POOLED;
+
+
+/** \brief Get a raw inflate stream.
+ *
+ * This function returns a z_stream ready to inflate raw deflate data
+ * (no zlib header), as initialized by inflateInit2() with -MAX_WBITS.
+ *
+ * The z_stream must be returned with releaseInflate().
+ *
+ * \exception IOException
+ * This exception is raised if a new z_stream cannot be initialized.
+ *
+ * \return A pointer to the inflate stream.
+ */
+z_stream * StreamPool::acquireInflate()
+{
+    pools_t * pools(get_pools());
+    if(pools != nullptr
+    && !pools->m_inflates.empty())
+    {
+        z_stream * zs(pools->m_inflates.back());
+        pools->m_inflates.pop_back();
+        return zs;
+    }
+
+    z_stream * zs(new z_stream());
+    int const err(inflateInit2(zs, -MAX_WBITS));
+    if(err != Z_OK)
+    {
+        delete zs; // LCOV_EXCL_LINE
+        std::ostringstream msgs; // LCOV_EXCL_LINE
+        msgs << "StreamPool::acquireInflate(): inflateInit2() failed: " << zError(err); // LCOV_EXCL_LINE
+        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+    }
+    return zs;
+}
+
+
+/** \brief Return an inflate stream to the pool.
+ *
+ * The stream gets reset with inflateReset() and saved in the pool of
+ * the current thread. If the pool is full, the stream is freed instead.
+ *
+ * \param[in] zs  The stream to release, may be nullptr.
+ */
+void StreamPool::releaseInflate(z_stream * zs)
+{
+    if(zs == nullptr)
+    {
+        return;
+    }
+
+    pools_t * pools(get_pools());
+    if(pools == nullptr
+    || pools->m_inflates.size() >= MAXIMUM_POOLED
+    || inflateReset(zs) != Z_OK)
+    {
+        inflateEnd(zs);
+        delete zs;
+        return;
+    }
+
+    pools->m_inflates.push_back(zs);
+}
+
+
+/** \brief Get a raw deflate stream.
+ *
+ * This function returns a z_stream ready to deflate data without any
+ * zlib header, as initialized by deflateInit2() with -MAX_WBITS, the
+ * default memory level and strategy, and the specified \p level.
+ *
+ * The z_stream must be returned with releaseDeflate() and the same
+ * \p level.
+ *
+ * \exception IOException
+ * This exception is raised if a new z_stream cannot be initialized.
+ *
+ * \param[in] level  The zlib compression level.
+ *
+ * \return A pointer to the deflate stream.
+ */
+z_stream * StreamPool::acquireDeflate(int level)
+{
+    pools_t * pools(get_pools());
+    if(pools != nullptr)
+    {
+        for(auto it(pools->m_deflates.begin()); it != pools->m_deflates.end(); ++it)
+        {
+            if(it->m_level == level)
+            {
+                z_stream * zs(it->m_zs);
+                pools->m_deflates.erase(it);
+                return zs;
+            }
+        }
+    }
+
+    int const default_mem_level(8);
+
+    z_stream * zs(new z_stream());
+    int const err(deflateInit2(zs, level, Z_DEFLATED, -MAX_WBITS, default_mem_level, Z_DEFAULT_STRATEGY));
+    if(err != Z_OK)
+    {
+        delete zs; // LCOV_EXCL_LINE
+        std::ostringstream msgs; // LCOV_EXCL_LINE
+        msgs << "StreamPool::acquireDeflate(): error while initializing zlib, " << zError(err); // LCOV_EXCL_LINE
+        throw IOException(msgs.str()); // LCOV_EXCL_LINE
+    }
+    return zs;
+}
+
+
+/** \brief Return a deflate stream to the pool.
+ *
+ * The stream gets reset with deflateReset() and saved in the pool of
+ * the current thread. If the pool is full, the stream is freed instead.
+ *
+ * \param[in] zs  The stream to release, may be nullptr.
+ * \param[in] level  The level used to acquire the stream.
+ */
+void StreamPool::releaseDeflate(z_stream * zs, int level)
+{
+    if(zs == nullptr)
+    {
+        return;
+    }
+
+    pools_t * pools(get_pools());
+    if(pools == nullptr
+    || pools->m_deflates.size() >= MAXIMUM_POOLED
+    || deflateReset(zs) != Z_OK)
+    {
+        deflateEnd(zs);
+        delete zs;
+        return;
+    }
+
+    pools_t::deflate_t deflate;
+    deflate.m_zs = zs;
+    deflate.m_level = level;
+    pools->m_deflates.push_back(deflate);
+}
+
+
+/** \brief Get an I/O buffer.
+ *
+ * This function returns a buffer of getBufferSize() bytes. Its content
+ * is undefined.
+ *
+ * \return A buffer, to be returned with releaseBuffer().
+ */
+std::vector<char> StreamPool::acquireBuffer()
+{
+    pools_t * pools(get_pools());
+    if(pools != nullptr
+    && !pools->m_buffers.empty())
+    {
+        std::vector<char> buffer(std::move(pools->m_buffers.back()));
+        pools->m_buffers.pop_back();
+        return buffer;
+    }
+
+    return std::vector<char>(getBufferSize());
+}
+
+
+/** \brief Return an I/O buffer to the pool.
+ *
+ * The memory of \p buffer is moved to the pool of the current thread,
+ * leaving \p buffer empty. Buffers which do not have the standard size
+ * and buffers released when the pool is full are freed.
+ *
+ * \param[in,out] buffer  The buffer to release.
+ */
+void StreamPool::releaseBuffer(std::vector<char> & buffer)
+{
+    pools_t * pools(get_pools());
+    if(pools != nullptr
+    && buffer.size() == getBufferSize()
+    && pools->m_buffers.size() < MAXIMUM_POOLED)
+    {
+        pools->m_buffers.push_back(std::move(buffer));
+    }
+    buffer.clear();
+    buffer.shrink_to_fit();
+}
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef STREAMPOOL_HPP
+#define STREAMPOOL_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+/** \file
+ * \brief The header file for zipios::StreamPool
+ *
+ * The zipios::StreamPool class recycles the zlib streams and the
+ * buffers used by the stream buffers of the library.
+ */
+
+#include "zipios/zipios-config.hpp"
+
+#include <vector>
+
+#include <zlib.h>
+
+
+namespace zipios
+{
+
+
+class StreamPool
+{
+public:
+    static std::size_t const    MAXIMUM_POOLED = 16;
+
+    static z_stream *           acquireInflate();
+    static void                 releaseInflate(z_stream * zs);
+    static z_stream *           acquireDeflate(int level);
+    static void                 releaseDeflate(z_stream * zs, int level);
+    static std::vector<char>    acquireBuffer();
+    static void                 releaseBuffer(std::vector<char> & buffer);
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -57,6 +57,14 @@ namespace
 uint32_t const  g_signature = 0x02014b50;
 
 
+/** \brief The size of the fixed part of a Central Directory entry.
+ *
+ * This is the size of the ZipCentralDirectoryEntryHeader as found in
+ * a Zip archive, without the alignment padding of the structure.
+ */
+size_t const    g_fixed_header_size = 46;
+
+
 // The zip codes (values are pre-shifted)
 uint16_t const   g_msdos         = 0x0000;
 uint16_t const   g_amiga         = 0x0100;
@@ -161,6 +169,22 @@ ZipCentralDirectoryEntry::ZipCentralDirectoryEntry(FileEntry const & entry)
 }
 
 
+/** \brief Copy a ZipCentralDirectoryEntry.
+ *
+ * This function copies \p rhs, including whether its local header
+ * was already verified. The copy is required because the verified
+ * flag is atomic.
+ *
+ * \param[in] rhs  The entry to copy.
+ */
+ZipCentralDirectoryEntry::ZipCentralDirectoryEntry(ZipCentralDirectoryEntry const & rhs)
+    : ZipLocalEntry(rhs)
+    , m_local_header_verified(rhs.m_local_header_verified.load(std::memory_order_acquire))
+    , m_compression_changed(rhs.m_compression_changed)
+{
+}
+
+
 /** \brief Clean up the entry.
  *
  * The destructor makes sure the entry is fully cleaned up.
@@ -170,6 +194,24 @@ ZipCentralDirectoryEntry::~ZipCentralDirectoryEntry()
 }
 
 
+/** \brief Copy a ZipCentralDirectoryEntry.
+ *
+ * This function copies \p rhs in this entry, including whether its
+ * local header was already verified.
+ *
+ * \param[in] rhs  The entry to copy.
+ *
+ * \return A reference to this entry.
+ */
+ZipCentralDirectoryEntry & ZipCentralDirectoryEntry::operator = (ZipCentralDirectoryEntry const & rhs)
+{
+    ZipLocalEntry::operator = (rhs);
+    m_local_header_verified.store(rhs.m_local_header_verified.load(std::memory_order_acquire), std::memory_order_release);
+    m_compression_changed = rhs.m_compression_changed;
+    return *this;
+}
+
+
 /** \brief Compute and return the current header size.
  *
  * This function computes the size that this entry will take in the
@@ -179,17 +221,13 @@ ZipCentralDirectoryEntry::~ZipCentralDirectoryEntry()
  */
 size_t ZipCentralDirectoryEntry::getHeaderSize() const
 {
-    /** \todo
-     * Add support for 64 bit Zip. At this time this function returns
-     * an invalid size if the filename, extra field, or file comment
-     * sizes are more than allowed in an older version of the Zip format.
-     */
     // Note that the structure is 48 bytes because of an alignment
     // and attempting to use options to avoid the alignment would
     // not be portable so we use a hard coded value (yuck!)
     return 46 /* sizeof(ZipCentralDirectoryEntryHeader) */
          + m_filename.length() + (m_is_directory ? 1 : 0)
          + m_extra_field.size()
+         + getZip64ExtraField(false).size()
          + m_comment.length();
 }
 
@@ -222,6 +260,9 @@ FileEntry::pointer_t ZipCentralDirectoryEntry::clone() const
  * If the signature or some other parameter is found to be invalid, then
  * the input stream is marked as failed and an exception is thrown.
  *
+ * The entry is loaded in memory and parsed with
+ * read(unsigned char const * buf, size_t size, size_t & pos).
+ *
  * \exception IOException
  * This exception is thrown if the signature read does not match the
  * signature of a Central Directory entry. This can only mean a bug
@@ -235,12 +276,77 @@ void ZipCentralDirectoryEntry::read(std::istream & is)
 {
     m_valid = false; // set back to true upon successful completion below.
 
+    // read the fixed size part of the entry and, if it has the Central
+    // Directory entry signature, the filename, extra field and comment
+    // which follow
+    //
+    buffer_t header;
+    zipRead(is, header, g_fixed_header_size);
+    size_t pos(0);
+    uint32_t signature(0);
+    zipRead(header, pos, signature);
+    if(g_signature == signature)
+    {
+        uint16_t filename_len(0);
+        uint16_t extra_field_len(0);
+        uint16_t file_comment_len(0);
+        pos = 28;
+        zipRead(header, pos, filename_len);
+        zipRead(header, pos, extra_field_len);
+        zipRead(header, pos, file_comment_len);
+        buffer_t variable;
+        zipRead(is, variable, filename_len + extra_field_len + file_comment_len);
+        header.insert(header.end(), variable.begin(), variable.end());
+    }
+
+    // then parse the whole entry from memory
+    //
+    pos = 0;
+    try
+    {
+        read(header.data(), header.size(), pos);
+    }
+    catch(IOException const &)
+    {
+        is.setstate(std::ios::failbit);
+        throw;
+    }
+}
+
+
+/** \brief Read a Central Directory entry from memory.
+ *
+ * This function reads one Central Directory entry from the \p size
+ * bytes found at \p buf, starting at position \p pos. On return,
+ * \p pos is the position right after this entry, which is where the
+ * next entry starts.
+ *
+ * This is used to parse the Central Directory directly from a memory
+ * mapped Zip archive, without going through an input stream. It is
+ * also the parser of the read() function using an input stream.
+ *
+ * \exception IOException
+ * This exception is thrown if the signature read does not match the
+ * signature of a Central Directory entry or if the entry goes beyond
+ * the end of the buffer.
+ *
+ * \param[in] buf  A pointer to the Zip archive data.
+ * \param[in] size  The number of bytes available at \p buf.
+ * \param[in,out] pos  The position of the entry in \p buf.
+ *
+ * \sa read(std::istream & is)
+ */
+void ZipCentralDirectoryEntry::read(unsigned char const * buf, size_t size, size_t & pos)
+{
+    m_valid = false; // set back to true upon successful completion below.
+    m_local_header_verified.store(false, std::memory_order_release);
+    m_compression_changed = false;
+
     // verify the signature
     uint32_t signature;
-    zipRead(is, signature);
+    zipRead(buf, size, pos, signature);
     if(g_signature != signature)
     {
-        is.setstate(std::ios::failbit);
         throw IOException("ZipCentralDirectoryEntry::read(): Expected Central Directory entry signature not found");
     }
 
@@ -259,27 +365,24 @@ void ZipCentralDirectoryEntry::read(std::istream & is)
     std::string filename;
 
     // read the header
-    zipRead(is, writer_version);                    // 16
-    zipRead(is, m_extract_version);                 // 16
-    zipRead(is, m_general_purpose_bitfield);        // 16
-    zipRead(is, compress_method);                   // 16
-    zipRead(is, dosdatetime);                       // 32
-    zipRead(is, m_crc_32);                          // 32
-    zipRead(is, compressed_size);                   // 32
-    zipRead(is, uncompressed_size);                 // 32
-    zipRead(is, filename_len);                      // 16
-    zipRead(is, extra_field_len);                   // 16
-    zipRead(is, file_comment_len);                  // 16
-    zipRead(is, disk_num_start);                    // 16
-    zipRead(is, intern_file_attr);                  // 16
-    zipRead(is, extern_file_attr);                  // 32
-    zipRead(is, rel_offset_loc_head);               // 32
-    zipRead(is, filename, filename_len);            // string
-    zipRead(is, m_extra_field, extra_field_len);    // buffer
-    zipRead(is, m_comment, file_comment_len);       // string
-    /** \todo check whether this was a 64 bit header and make sure
-     *        to read the 64 bit header too if so
-     */
+    zipRead(buf, size, pos, writer_version);                    // 16
+    zipRead(buf, size, pos, m_extract_version);                 // 16
+    zipRead(buf, size, pos, m_general_purpose_bitfield);        // 16
+    zipRead(buf, size, pos, compress_method);                   // 16
+    zipRead(buf, size, pos, dosdatetime);                       // 32
+    zipRead(buf, size, pos, m_crc_32);                          // 32
+    zipRead(buf, size, pos, compressed_size);                   // 32
+    zipRead(buf, size, pos, uncompressed_size);                 // 32
+    zipRead(buf, size, pos, filename_len);                      // 16
+    zipRead(buf, size, pos, extra_field_len);                   // 16
+    zipRead(buf, size, pos, file_comment_len);                  // 16
+    zipRead(buf, size, pos, disk_num_start);                    // 16
+    zipRead(buf, size, pos, intern_file_attr);                  // 16
+    zipRead(buf, size, pos, extern_file_attr);                  // 32
+    zipRead(buf, size, pos, rel_offset_loc_head);               // 32
+    zipRead(buf, size, pos, filename, filename_len);            // string
+    zipRead(buf, size, pos, m_extra_field, extra_field_len);    // buffer
+    zipRead(buf, size, pos, m_comment, file_comment_len);       // string
 
     // the FilePath() will remove the trailing slash so make sure
     // to defined the m_is_directory ahead of time!
@@ -294,11 +397,92 @@ void ZipCentralDirectoryEntry::read(std::istream & is)
     m_entry_offset = rel_offset_loc_head;
     m_filename = FilePath(filename);
 
+    readZip64ExtraField(false);
+
     // the zipRead() should throw if it is false...
     m_valid = true;
 }
 
 
+/** \brief Change the compression level of this entry.
+ *
+ * This function calls FileEntry::setLevel() and also records that the
+ * compression of this entry was explicitly changed, so its data gets
+ * compressed again when the archive is saved instead of being copied
+ * as is. See isCompressionChanged().
+ *
+ * \param[in] level  The compression level to use to compress the file data.
+ */
+void ZipCentralDirectoryEntry::setLevel(CompressionLevel level)
+{
+    ZipLocalEntry::setLevel(level);
+    m_compression_changed = true;
+}
+
+
+/** \brief Change the storage method of this entry.
+ *
+ * This function calls FileEntry::setMethod() and also records that the
+ * compression of this entry was explicitly changed. See
+ * isCompressionChanged().
+ *
+ * \param[in] method  The method field is set to the specified value.
+ */
+void ZipCentralDirectoryEntry::setMethod(StorageMethod method)
+{
+    ZipLocalEntry::setMethod(method);
+    m_compression_changed = true;
+}
+
+
+/** \brief Check whether the compression of this entry was changed.
+ *
+ * An entry read from a Zip archive has the storage method of its data.
+ * Once setLevel() or setMethod() was called, even with the same value,
+ * the user expects the data to be compressed as requested, so the
+ * ZipFile does not copy the compressed data as is anymore.
+ *
+ * \return true if setLevel() or setMethod() was called since the entry
+ *         was read.
+ */
+bool ZipCentralDirectoryEntry::isCompressionChanged() const
+{
+    return m_compression_changed;
+}
+
+
+/** \brief Check whether the local header of this entry was verified.
+ *
+ * When a ZipFile is opened, the local header of each entry is compared
+ * against its Central Directory entry. With
+ * ZipFile::OPEN_MODE_LAZY_VALIDATION, that verification happens the
+ * first time the data of the entry is accessed instead. This flag is
+ * used to do that verification only once.
+ *
+ * \return true if the local header was verified.
+ *
+ * \sa setLocalHeaderVerified()
+ */
+bool ZipCentralDirectoryEntry::isLocalHeaderVerified() const
+{
+    return m_local_header_verified.load(std::memory_order_acquire);
+}
+
+
+/** \brief Mark the local header of this entry as verified.
+ *
+ * This function is called once the local header of this entry was
+ * found to be consistent with this Central Directory entry. The flag
+ * only records work already done, so it can be set on a constant entry.
+ *
+ * \sa isLocalHeaderVerified()
+ */
+void ZipCentralDirectoryEntry::setLocalHeaderVerified() const
+{
+    m_local_header_verified.store(true, std::memory_order_release);
+}
+
+
 /** \brief Write a Central Directory Entry to the output stream.
  *
  * This function verifies that the data of the Central Directory entry
@@ -326,9 +510,6 @@ void ZipCentralDirectoryEntry::read(std::istream & is)
  */
 void ZipCentralDirectoryEntry::write(std::ostream & os)
 {
-    /** \todo add support for 64 bit entries
-     *        (zip64 is available, just need to add a 64 bit header...)
-     */
     if(m_filename.length()  > 0x10000
     || m_extra_field.size() > 0x10000
     || m_comment.length()   > 0x10000)
@@ -336,19 +517,18 @@ void ZipCentralDirectoryEntry::write(std::ostream & os)
         throw InvalidStateException("ZipCentralDirectoryEntry::write(): file name, comment, or extra field too large to save in a Zip file.");
     }
 
-// Solaris defines _ILP32 for 32 bit platforms
-#if INTPTR_MAX != INT32_MAX
-    if(m_compressed_size   >= 0x100000000ULL
-    || m_uncompressed_size >= 0x100000000ULL
-    || m_entry_offset      >= 0x100000000LL)
+    // sizes and offset which do not fit in 32 bits get saved in
+    // a ZIP64 extra field
+    //
+    buffer_t const zip64_extra_field(getZip64ExtraField(false));
+    if(m_extra_field.size() + zip64_extra_field.size() > 0xFFFF)
     {
-        // This represents really large files which we do not test at this point
-        throw InvalidStateException("ZipCentralDirectoryEntry::write(): The size of this file is too large to fit in a zip archive."); // LCOV_EXCL_LINE
+        throw InvalidStateException("ZipCentralDirectoryEntry::write(): file name, comment, or extra field too large to save in a Zip file.");
     }
-#endif
+    bool const zip64(m_zip64 || !zip64_extra_field.empty());
 
     // define version
-    uint16_t writer_version = g_zip_format_version;
+    uint16_t writer_version = zip64 ? g_zip64_format_version : g_zip_format_version;
     // including the "compatibility" code
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
     // MS-Windows
@@ -380,10 +560,11 @@ void ZipCentralDirectoryEntry::write(std::ostream & os)
     DOSDateTime t;
     t.setUnixTimestamp(m_unix_time);
     uint32_t dosdatetime(t.getDOSDateTime());   // type could be set to DOSDateTime::dosdatetime_t
-    uint32_t compressed_size(m_compressed_size);
-    uint32_t uncompressed_size(m_uncompressed_size);
+    uint16_t extract_version(zip64 && m_extract_version < g_zip64_format_version ? g_zip64_format_version : m_extract_version);
+    uint32_t compressed_size(m_compressed_size >= g_zip64_escape ? g_zip64_escape : m_compressed_size);
+    uint32_t uncompressed_size(m_uncompressed_size >= g_zip64_escape ? g_zip64_escape : m_uncompressed_size);
     uint16_t filename_len(filename.length());
-    uint16_t extra_field_len(m_extra_field.size());
+    uint16_t extra_field_len(m_extra_field.size() + zip64_extra_field.size());
     uint16_t file_comment_len(m_comment.length());
     uint16_t disk_num_start(0);
     uint16_t intern_file_attr(0);
@@ -407,11 +588,11 @@ void ZipCentralDirectoryEntry::write(std::ostream & os)
      * from the file entry.
      */
     uint32_t extern_file_attr(m_is_directory ? 0x41FD0010 : 0x81B40000);
-    uint32_t rel_offset_loc_head(m_entry_offset);
+    uint32_t rel_offset_loc_head(m_entry_offset >= static_cast<std::streamoff>(g_zip64_escape) ? g_zip64_escape : static_cast<uint32_t>(m_entry_offset));
 
     zipWrite(os, g_signature);                  // 32
     zipWrite(os, writer_version);               // 16
-    zipWrite(os, m_extract_version);            // 16
+    zipWrite(os, extract_version);              // 16
     zipWrite(os, m_general_purpose_bitfield);   // 16
     zipWrite(os, compress_method);              // 16
     zipWrite(os, dosdatetime);                  // 32
@@ -427,6 +608,7 @@ void ZipCentralDirectoryEntry::write(std::ostream & os)
     zipWrite(os, rel_offset_loc_head);          // 32
     zipWrite(os, filename);                     // string
     zipWrite(os, m_extra_field);                // buffer
+    zipWrite(os, zip64_extra_field);            // buffer
     zipWrite(os, m_comment);                    // string
 }
 
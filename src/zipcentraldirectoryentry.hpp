@@ -35,6 +35,8 @@
 
 #include "ziplocalentry.hpp"
 
+#include <atomic>
+
 
 namespace zipios
 {
@@ -45,13 +47,27 @@ class ZipCentralDirectoryEntry : public ZipLocalEntry
 public:
                                 ZipCentralDirectoryEntry();
                                 ZipCentralDirectoryEntry(FileEntry const & entry);
+                                ZipCentralDirectoryEntry(ZipCentralDirectoryEntry const & rhs);
     virtual pointer_t           clone() const override;
     virtual                     ~ZipCentralDirectoryEntry() override;
 
+    ZipCentralDirectoryEntry &  operator = (ZipCentralDirectoryEntry const & rhs);
+
     virtual size_t              getHeaderSize() const override;
+    virtual void                setLevel(CompressionLevel level) override;
+    virtual void                setMethod(StorageMethod method) override;
 
     virtual void                read(std::istream & is) override;
+    void                        read(unsigned char const * buf, size_t size, size_t & pos);
     virtual void                write(std::ostream & os) override;
+
+    bool                        isLocalHeaderVerified() const;
+    void                        setLocalHeaderVerified() const;
+    bool                        isCompressionChanged() const;
+
+private:
+    mutable std::atomic<bool>   m_local_header_verified{false};
+    bool                        m_compression_changed = false;
 };
 
 
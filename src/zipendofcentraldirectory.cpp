@@ -68,9 +68,58 @@ namespace
 uint32_t const g_signature = 0x06054b50;
 
 
+/** \brief Signature of the ZIP64 End of Central Directory Locator.
+ *
+ * The locator is found just before the End of Central Directory of a
+ * ZIP64 archive. It gives the offset of the ZIP64 End of Central
+ * Directory record.
+ *
+ * "PK 6.7" -- ZIP64 End of Central Directory Locator
+ */
+uint32_t const g_zip64_locator_signature = 0x07064b50;
+
+
+/** \brief Signature of the ZIP64 End of Central Directory record.
+ *
+ * This record holds the 64 bit version of the End of Central Directory
+ * fields.
+ *
+ * "PK 6.6" -- ZIP64 End of Central Directory record
+ */
+uint32_t const g_zip64_signature = 0x06064b50;
+
+
 } // no name namespace
 
 
+/** \var ZipEndOfCentralDirectory::MAXIMUM_SIZE
+ * \brief The largest possible End of Central Directory structure.
+ *
+ * The End of Central Directory is 22 bytes followed by a comment of
+ * at most 65535 bytes. Since it is the last structure of a Zip archive,
+ * it has to be found within the last MAXIMUM_SIZE bytes of the archive.
+ */
+size_t const ZipEndOfCentralDirectory::MAXIMUM_SIZE;
+
+
+/** \var ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE
+ * \brief The size of the ZIP64 End of Central Directory Locator.
+ *
+ * The locator, when present, is found exactly this many bytes before
+ * the End of Central Directory.
+ */
+size_t const ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE;
+
+
+/** \var ZipEndOfCentralDirectory::ZIP64_SIZE
+ * \brief The size of the ZIP64 End of Central Directory record.
+ *
+ * This is the size of the fixed part of the record. The extensible
+ * data sector which may follow is ignored.
+ */
+size_t const ZipEndOfCentralDirectory::ZIP64_SIZE;
+
+
 /** \brief Initialize an ZipEndOfCentralDirectory object.
  *
  * This function initializes an ZipEndOfCentralDirectory object. By default,
@@ -142,6 +191,22 @@ offset_t ZipEndOfCentralDirectory::getOffset() const
 }
 
 
+/** \brief Retrieve the offset of the ZIP64 End of Central Directory.
+ *
+ * This function returns the offset of the ZIP64 End of Central
+ * Directory record as found by readZip64Locator(). If the archive
+ * has no ZIP64 locator, the function returns -1.
+ *
+ * \return The offset of the ZIP64 record or -1.
+ *
+ * \sa readZip64Locator()
+ */
+offset_t ZipEndOfCentralDirectory::getZip64Offset() const
+{
+    return m_zip64_offset;
+}
+
+
 /** \brief Define the size of the central directory.
  *
  * When creating a Zip archive, it is necessary to call this function
@@ -223,6 +288,29 @@ void ZipEndOfCentralDirectory::setOffset(offset_t start_offset)
  * \return true if the ZipEndOfCentralDirectory was found, false otherwise.
  */
 bool ZipEndOfCentralDirectory::read(::zipios::buffer_t const & buf, size_t pos)
+{
+    return read(buf.data(), buf.size(), pos);
+}
+
+
+/** \brief Attempt to read an ZipEndOfCentralDirectory structure from memory.
+ *
+ * This function is the same as the read() function using a buffer_t,
+ * only it reads the data from \p size bytes at \p buf. This is used
+ * to parse the ZipEndOfCentralDirectory directly from a memory mapped
+ * Zip archive.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the number of entries is not equal to
+ * the total number of entries, as expected.
+ *
+ * \param[in] buf  A pointer to the file data.
+ * \param[in] size  The number of bytes available at \p buf.
+ * \param[in] pos  The position at which we are expected to check.
+ *
+ * \return true if the ZipEndOfCentralDirectory was found, false otherwise.
+ */
+bool ZipEndOfCentralDirectory::read(unsigned char const * buf, size_t size, size_t pos)
 {
     // the number of bytes we are going to read in the buffer
     // (including the signature)
@@ -234,14 +322,14 @@ bool ZipEndOfCentralDirectory::read(::zipios::buffer_t const & buf, size_t pos)
     //       if there is a comment and we find the signature too early, then
     //       it will throw
     //
-    if(static_cast<ssize_t>(buf.size() - pos) < HEADER_SIZE)
+    if(static_cast<ssize_t>(size - pos) < HEADER_SIZE)
     {
         return false;
     }
 
     // first read and check the signature
     uint32_t signature;
-    zipRead(buf, pos, signature);               // 32
+    zipRead(buf, size, pos, signature);         // 32
     if(signature != g_signature)
     {
         return false;
@@ -255,14 +343,14 @@ bool ZipEndOfCentralDirectory::read(::zipios::buffer_t const & buf, size_t pos)
     uint32_t central_directory_offset;
     uint16_t comment_len;
 
-    zipRead(buf, pos, disk_number);                         // 16
-    zipRead(buf, pos, disk_number);                         // 16
-    zipRead(buf, pos, central_directory_entries);           // 16
-    zipRead(buf, pos, central_directory_total_entries);     // 16
-    zipRead(buf, pos, central_directory_size);              // 32
-    zipRead(buf, pos, central_directory_offset);            // 32
-    zipRead(buf, pos, comment_len);                         // 16
-    zipRead(buf, pos, m_zip_comment, comment_len);          // string
+    zipRead(buf, size, pos, disk_number);                     // 16
+    zipRead(buf, size, pos, disk_number);                     // 16
+    zipRead(buf, size, pos, central_directory_entries);       // 16
+    zipRead(buf, size, pos, central_directory_total_entries); // 16
+    zipRead(buf, size, pos, central_directory_size);          // 32
+    zipRead(buf, size, pos, central_directory_offset);        // 32
+    zipRead(buf, size, pos, comment_len);                     // 16
+    zipRead(buf, size, pos, m_zip_comment, comment_len);      // string
 
     // note that if disk_number is defined, then these following two
     // numbers should differ too
@@ -279,6 +367,163 @@ bool ZipEndOfCentralDirectory::read(::zipios::buffer_t const & buf, size_t pos)
 }
 
 
+/** \brief Search for the ZipEndOfCentralDirectory structure.
+ *
+ * This function searches the End of Central Directory signature in
+ * \p buf, starting from the end of the buffer and going backward. The
+ * buffer is expected to hold the end of the Zip archive, generally
+ * its last MAXIMUM_SIZE bytes.
+ *
+ * The scan only compares bytes. The read() function is called only
+ * where the signature is found, so a long archive comment or data
+ * appended after the archive does not slow down the search much.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the number of entries is not equal to
+ * the total number of entries, as expected.
+ *
+ * \param[in] buf  A pointer to the end of the Zip archive.
+ * \param[in] size  The number of bytes available at \p buf.
+ * \param[out] pos  The position of the structure in \p buf.
+ *
+ * \return true if the ZipEndOfCentralDirectory was found, false otherwise.
+ */
+bool ZipEndOfCentralDirectory::find(unsigned char const * buf, size_t size, size_t & pos)
+{
+    // "PK\5\6" in little endian
+    //
+    unsigned char const b0(static_cast<unsigned char>(g_signature >>  0));
+    unsigned char const b1(static_cast<unsigned char>(g_signature >>  8));
+    unsigned char const b2(static_cast<unsigned char>(g_signature >> 16));
+    unsigned char const b3(static_cast<unsigned char>(g_signature >> 24));
+
+    for(size_t p(size); p >= sizeof(g_signature); --p)
+    {
+        // search the last byte first, it is the least common one
+        //
+        if(buf[p - 1] == b3
+        && buf[p - 2] == b2
+        && buf[p - 3] == b1
+        && buf[p - 4] == b0
+        && read(buf, size, p - 4))
+        {
+            pos = p - 4;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/** \brief Attempt to read a ZIP64 End of Central Directory Locator.
+ *
+ * A ZIP64 archive has a locator just before its End of Central
+ * Directory. This function checks whether such a locator is found
+ * at \p pos and if so saves the offset of the ZIP64 End of Central
+ * Directory record. That offset is then returned by getZip64Offset().
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the locator says the archive spans
+ * multiple disks.
+ *
+ * \param[in] buf  A pointer to the file data.
+ * \param[in] size  The number of bytes available at \p buf.
+ * \param[in] pos  The position at which the locator would be.
+ *
+ * \return true if a locator was found.
+ */
+bool ZipEndOfCentralDirectory::readZip64Locator(unsigned char const * buf, size_t size, size_t pos)
+{
+    if(pos + ZIP64_LOCATOR_SIZE > size)
+    {
+        return false;
+    }
+
+    uint32_t signature;
+    zipRead(buf, size, pos, signature);                     // 32
+    if(signature != g_zip64_locator_signature)
+    {
+        return false;
+    }
+
+    uint32_t disk_number;
+    uint64_t zip64_offset;
+    uint32_t total_disks;
+    zipRead(buf, size, pos, disk_number);                   // 32
+    zipRead(buf, size, pos, zip64_offset);                  // 64
+    zipRead(buf, size, pos, total_disks);                   // 32
+
+    if(disk_number != 0 || total_disks > 1)
+    {
+        throw FileCollectionException("ZIP64 End of Central Directory Locator of a spanned zip file, spanned zip files are not supported");
+    }
+
+    m_zip64_offset = static_cast<offset_t>(zip64_offset);
+
+    return true;
+}
+
+
+/** \brief Read the ZIP64 End of Central Directory record.
+ *
+ * This function reads the ZIP64 End of Central Directory record found
+ * at \p pos in \p buf. The 64 bit number of entries, size, and offset
+ * of the Central Directory found in that record replace the values
+ * read from the End of Central Directory, which are limited to 16 and
+ * 32 bits.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the record signature is not found at
+ * \p pos or if the number of entries is not equal to the total number
+ * of entries.
+ *
+ * \exception IOException
+ * This exception is raised if the record goes past the end of the
+ * buffer.
+ *
+ * \param[in] buf  A pointer to the file data.
+ * \param[in] size  The number of bytes available at \p buf.
+ * \param[in] pos  The position of the record in \p buf.
+ */
+void ZipEndOfCentralDirectory::readZip64(unsigned char const * buf, size_t size, size_t pos)
+{
+    uint32_t signature;
+    zipRead(buf, size, pos, signature);                         // 32
+    if(signature != g_zip64_signature)
+    {
+        throw FileCollectionException("Unable to find zip structure: ZIP64 End-of-central-directory");
+    }
+
+    uint64_t record_size;
+    uint16_t version;
+    uint32_t disk_number;
+    uint64_t central_directory_entries;
+    uint64_t central_directory_total_entries;
+    uint64_t central_directory_size;
+    uint64_t central_directory_offset;
+
+    zipRead(buf, size, pos, record_size);                       // 64
+    zipRead(buf, size, pos, version);                           // 16
+    zipRead(buf, size, pos, version);                           // 16
+    zipRead(buf, size, pos, disk_number);                       // 32
+    zipRead(buf, size, pos, disk_number);                       // 32
+    zipRead(buf, size, pos, central_directory_entries);         // 64
+    zipRead(buf, size, pos, central_directory_total_entries);   // 64
+    zipRead(buf, size, pos, central_directory_size);            // 64
+    zipRead(buf, size, pos, central_directory_offset);          // 64
+
+    if(central_directory_entries != central_directory_total_entries)
+    {
+        throw FileCollectionException("ZIP64 End of Central Directory with a number of entries and total entries that differ is not supported, spanned zip files are not supported");
+    }
+
+    m_central_directory_entries = central_directory_entries;
+    m_central_directory_size    = central_directory_size;
+    m_central_directory_offset  = static_cast<offset_t>(central_directory_offset);
+}
+
+
 /** \brief Write the ZipEndOfCentralDirectory structure to a stream.
  *
  * This function writes the currently defined end of central
@@ -293,41 +538,62 @@ bool ZipEndOfCentralDirectory::read(::zipios::buffer_t const & buf, size_t pos)
  * The function does not change the output pointer of the stream
  * before writing to it.
  *
- * \exception FileCollectionException
- * This function throws this exception if the data cannot be saved. In
- * general this means there are too many entries, the size is too large
- * or the comment is more than 64Kb (some of which will be resolved with
- * Zip64 support.)
+ * When the number of entries, the size, or the offset of the Central
+ * Directory do not fit in the End of Central Directory, the function
+ * first writes a ZIP64 End of Central Directory record and its locator.
+ * The End of Central Directory then has all those fields set to
+ * 0xFFFF or 0xFFFFFFFF.
+ *
+ * \exception InvalidStateException
+ * This function throws this exception if the comment is more than 64Kb.
  *
  * \param[in] os  The output stream where the data is to be saved.
  */
 void ZipEndOfCentralDirectory::write(std::ostream & os)
 {
-    /** \todo
-     * Add support for 64 bit Zip archive. This would allow for pretty
-     * much all the following conditions to be dropped out.
-     */
     if(m_zip_comment.length() > 65535)
     {
         throw InvalidStateException("the Zip archive comment is too large");
     }
-    if(m_central_directory_entries > 65535)
-    {
-        throw InvalidStateException("the number of entries in the Zip archive is too large");
-    }
-// Solaris defines _ILP32 for 32 bit platforms
-#if INTPTR_MAX != INT32_MAX
-    if(m_central_directory_size   >= 0x100000000UL
-    || m_central_directory_offset >= 0x100000000L)
+
+    // values which do not fit in the End of Central Directory get
+    // saved in a ZIP64 End of Central Directory record instead
+    //
+    bool const zip64(m_central_directory_entries >= 0xFFFF
+                  || m_central_directory_size    >= 0xFFFFFFFF
+                  || m_central_directory_offset  >= 0xFFFFFFFF);
+    if(zip64)
     {
-        throw FileCollectionException("the Zip archive size or offset are too large"); // LCOV_EXCL_LINE
+        uint64_t const zip64_offset(os.tellp());
+        uint64_t const record_size(ZIP64_SIZE - sizeof(uint32_t) - sizeof(uint64_t));
+        uint16_t const version(45);
+        uint32_t const disk_number(0);
+        uint32_t const total_disks(1);
+        uint64_t const central_directory_entries(m_central_directory_entries);
+        uint64_t const central_directory_size(m_central_directory_size);
+        uint64_t const central_directory_offset(m_central_directory_offset);
+
+        zipWrite(os, g_zip64_signature);            // 32
+        zipWrite(os, record_size);                  // 64
+        zipWrite(os, version);                      // 16
+        zipWrite(os, version);                      // 16
+        zipWrite(os, disk_number);                  // 32
+        zipWrite(os, disk_number);                  // 32
+        zipWrite(os, central_directory_entries);    // 64
+        zipWrite(os, central_directory_entries);    // 64
+        zipWrite(os, central_directory_size);       // 64
+        zipWrite(os, central_directory_offset);     // 64
+
+        zipWrite(os, g_zip64_locator_signature);    // 32
+        zipWrite(os, disk_number);                  // 32
+        zipWrite(os, zip64_offset);                 // 64
+        zipWrite(os, total_disks);                  // 32
     }
-#endif
 
     uint16_t const disk_number(0);
-    uint16_t const central_directory_entries(m_central_directory_entries);
-    uint32_t const central_directory_size(m_central_directory_size);
-    uint32_t const central_directory_offset(m_central_directory_offset);
+    uint16_t const central_directory_entries(zip64 ? 0xFFFF : m_central_directory_entries);
+    uint32_t const central_directory_size(zip64 ? 0xFFFFFFFF : m_central_directory_size);
+    uint32_t const central_directory_offset(zip64 ? 0xFFFFFFFF : m_central_directory_offset);
     uint16_t const comment_len(m_zip_comment.length());
 
     // the total number of entries, across all disks is the same in our
@@ -45,16 +45,25 @@ namespace zipios
 class ZipEndOfCentralDirectory
 {
 public:
+    static size_t const MAXIMUM_SIZE = 22 + 0xFFFF;
+    static size_t const ZIP64_LOCATOR_SIZE = 20;
+    static size_t const ZIP64_SIZE = 56;
+
                         ZipEndOfCentralDirectory(std::string const & zip_comment = std::string());
 
     size_t              getCentralDirectorySize() const;
     size_t              getCount() const;
     offset_t            getOffset() const;
+    offset_t            getZip64Offset() const;
     void                setCentralDirectorySize(size_t size);
     void                setCount(size_t c);
     void                setOffset(offset_t new_offset);
 
     bool                read(::zipios::buffer_t const & buf, size_t pos);
+    bool                read(unsigned char const * buf, size_t size, size_t pos);
+    bool                find(unsigned char const * buf, size_t size, size_t & pos);
+    bool                readZip64Locator(unsigned char const * buf, size_t size, size_t pos);
+    void                readZip64(unsigned char const * buf, size_t size, size_t pos);
     void                write(std::ostream & os);
 
 private:
@@ -62,6 +71,7 @@ private:
     size_t              m_central_directory_entries = 0;
     size_t              m_central_directory_size = 0;
     offset_t            m_central_directory_offset = 0;
+    offset_t            m_zip64_offset = -1;
     std::string         m_zip_comment = std::string();
 };
 
@@ -31,13 +31,30 @@
 #include "zipios/streamentry.hpp"
 #include "zipios/zipiosexceptions.hpp"
 
-#include "backbuffer.hpp"
+#include "crc32.hpp"
+#include "deflateoutputstreambuf.hpp"
+#include "entrycache.hpp"
+#include "gzipoutputstreambuf.hpp"
+#include "outputfile.hpp"
+#include "randomaccessfile.hpp"
+#include "randomaccessstreambuf.hpp"
+#include "streampool.hpp"
 #include "zipendofcentraldirectory.hpp"
 #include "zipcentraldirectoryentry.hpp"
 #include "zipinputstream.hpp"
 #include "zipoutputstream.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <zlib.h>
 
 
 /** \brief The zipios namespace includes the Zipios library definitions.
@@ -266,11 +283,376 @@ namespace zipios
  */
 
 
+namespace
+{
+
+
+/** \brief The signature of a local header.
+ *
+ * \code
+ * "PK 3.4"
+ * \endcode
+ */
+uint32_t const      g_local_header_signature = 0x04034b50;
+
+
+/** \brief The size of the fixed part of a local header.
+ *
+ * The fixed part is followed by the filename and the extra field, of
+ * which the sizes are found at offset 26 and 28.
+ */
+std::size_t const   g_local_header_size = 30;
+
+
+/** \brief Estimate the end of the data of an entry.
+ *
+ * The local header of an entry is expected to have the same filename
+ * and extra field as the Central Directory entry. If it is larger, the
+ * data of the entry gets read separately.
+ *
+ * \param[in] entry  The entry of which the end is estimated.
+ *
+ * \return The estimated offset of the end of the data of the entry.
+ */
+offset_t estimated_entry_end(FileEntry const & entry)
+{
+    return static_cast<offset_t>(entry.getEntryOffset())
+         + static_cast<offset_t>(g_local_header_size
+                               + entry.getName().length()
+                               + entry.getExtra().size()
+                               + entry.getCompressedSize());
+}
+
+
+/** \brief Check whether an entry can be extracted safely.
+ *
+ * A name which is absolute or includes a ".." segment would let
+ * extractTo() write outside of the destination directory.
+ *
+ * Under MS-Windows, a backslash is also a separator and a colon
+ * introduces a drive letter, so names with either are refused too.
+ * Elsewhere, these are valid characters in a filename.
+ *
+ * \param[in] name  The name of the entry.
+ *
+ * \return true if the name stays inside the destination directory.
+ */
+bool is_safe_name(std::string const & name)
+{
+    if(name.empty()
+    || name[0] == '/')
+    {
+        return false;
+    }
+#ifdef ZIPIOS_WINDOWS
+    if(name.find('\\') != std::string::npos
+    || name.find(':') != std::string::npos)
+    {
+        return false;
+    }
+#endif
+
+    std::string::size_type start(0);
+    for(;;)
+    {
+        std::string::size_type const end(name.find('/', start));
+        if(name.compare(start, end == std::string::npos ? std::string::npos : end - start, "..") == 0)
+        {
+            return false;
+        }
+        if(end == std::string::npos)
+        {
+            return true;
+        }
+        start = end + 1;
+    }
+}
+
+
+/** \brief The result of the compression of an entry by a worker.
+ *
+ * The parallel saveCollectionToArchive() keeps one of these per entry.
+ * The entries compressed by the workers have m_parallel set to true.
+ * Once a worker is done with an entry, it sets m_done to true.
+ */
+struct compressed_entry_t
+{
+    bool                m_parallel = false;
+    bool                m_done = false;
+    uint32_t            m_crc32 = 0;
+    std::size_t         m_size = 0;
+    std::vector<char>   m_data = std::vector<char>();
+};
+
+
+/** \brief A streambuf appending the data written to a vector.
+ *
+ * The workers of the parallel saveCollectionToArchive() compress the
+ * entries in memory with this streambuf as the output.
+ */
+class vector_streambuf
+    : public std::streambuf
+{
+public:
+    vector_streambuf(std::vector<char> & data)
+        : m_data(data)
+    {
+    }
+
+protected:
+    virtual int_type overflow(int_type c) override
+    {
+        if(!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            m_data.push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual std::streamsize xsputn(char_type const * s, std::streamsize n) override
+    {
+        m_data.insert(m_data.end(), s, s + n);
+        return n;
+    }
+
+private:
+    std::vector<char> & m_data;
+};
+
+
+/** \brief Compress the data of an entry in memory.
+ *
+ * This function reads the data of \p entry from \p collection and
+ * compresses it in \p result exactly as the ZipOutputStreambuf would:
+ * STORED data is copied and DEFLATED data goes through a
+ * DeflateOutputStreambuf with the same level and the same buffers.
+ *
+ * \param[in] collection  The collection from which the data is read.
+ * \param[in] entry  The entry to compress.
+ * \param[out] result  The compressed data, CRC32 and size of the entry.
+ */
+void compress_entry(FileCollection & collection, FileEntry const & entry, compressed_entry_t & result)
+{
+    FileCollection::stream_pointer_t is(collection.getInputStream(entry.getName()));
+    bool const has_data(is != nullptr && is->good());
+
+    result.m_data.reserve(entry.getSize());
+    vector_streambuf out(result.m_data);
+    if(entry.getMethod() == StorageMethod::STORED
+    || entry.getLevel() == FileEntry::COMPRESSION_LEVEL_NONE)
+    {
+        if(has_data)
+        {
+            std::ostream os(&out);
+            os << is->rdbuf();
+        }
+        result.m_crc32 = CRC32::update(0, result.m_data.data(), result.m_data.size());
+        result.m_size = result.m_data.size();
+    }
+    else
+    {
+        DeflateOutputStreambuf deflater(&out);
+        deflater.init(entry.getLevel());
+        if(has_data)
+        {
+            std::ostream os(&deflater);
+            os << is->rdbuf();
+        }
+        deflater.closeStream();
+        result.m_crc32 = deflater.getCrc32();
+        result.m_size = deflater.getSize();
+    }
+}
+
+
+} // no name namespace
+
+
+
 /** \class ZipFile
  * \brief The ZipFile class represents a collection of files.
  *
  * ZipFile is a FileCollection, where the files are stored
  * in a .zip file.
+ *
+ * Once opened, a ZipFile can be shared between threads: getEntry(),
+ * entries(), getInputStream() and getStoredData() can be called
+ * concurrently on the same ZipFile object. The archive file is read
+ * with positional reads (or directly from the mapping), so the
+ * streams do not share a file position. Each returned stream must
+ * only be used by one thread at a time.
+ *
+ * Functions that modify the collection, such as addEntry(), close()
+ * and the assignment operator, must not be called while other threads
+ * use the same ZipFile.
+ */
+
+
+/** \typedef uint32_t ZipFile::OpenMode;
+ * \brief A set of flags defining how a Zip archive gets opened.
+ *
+ * This type is used to pass a set of OPEN_MODE_... flags to the
+ * ZipFile constructor and openEmbeddedZipFile() function.
+ */
+
+
+/** \var ZipFile::OPEN_MODE_DEFAULT
+ * \brief Open the Zip archive in the default mode.
+ *
+ * The archive file is opened and read with positional reads.
+ */
+ZipFile::OpenMode const ZipFile::OPEN_MODE_DEFAULT;
+
+
+/** \var ZipFile::OPEN_MODE_MEMORY_MAP
+ * \brief Memory map the Zip archive.
+ *
+ * With this flag, the archive file gets memory mapped. The Central
+ * Directory is parsed directly from the mapping, the input streams of
+ * STORED entries read their data directly from the mapping (no copy)
+ * and getStoredData() gives direct access to that data.
+ *
+ * The CRC32 of a STORED entry gets verified over the mapping the first
+ * time getInputStream() returns it. If it does not match, the stream
+ * reads the entry as in the default mode and reports the error once
+ * the end of the data is reached. getStoredData() does not verify the
+ * data.
+ *
+ * If the file cannot be memory mapped, the ZipFile silently falls back
+ * to the default mode.
+ */
+ZipFile::OpenMode const ZipFile::OPEN_MODE_MEMORY_MAP;
+
+
+/** \var ZipFile::OPEN_MODE_LAZY_VALIDATION
+ * \brief Verify the local headers on first access.
+ *
+ * By default, the ZipFile constructor reads the local header of each
+ * entry and verifies that it is consistent with the Central Directory.
+ * That requires one random read per entry, which can make opening a
+ * large archive slow.
+ *
+ * With this flag, the local header of an entry gets verified the first
+ * time its data is accessed with getInputStream() or getStoredData()
+ * instead. An inconsistent entry then raises a FileCollectionException
+ * at that time. When several threads access the same entry for the
+ * first time, each may verify it; the result is the same.
+ */
+ZipFile::OpenMode const ZipFile::OPEN_MODE_LAZY_VALIDATION;
+
+
+/** \var ZipFile::OPEN_MODE_PARALLEL_VALIDATION
+ * \brief Verify the local headers using multiple threads.
+ *
+ * With this flag, the constructor still verifies all the local headers,
+ * only it does so using multiple threads, each reading its share of the
+ * local headers with positional reads. This mode is as strict as the
+ * default mode.
+ *
+ * If OPEN_MODE_LAZY_VALIDATION is also specified, it has priority.
+ */
+ZipFile::OpenMode const ZipFile::OPEN_MODE_PARALLEL_VALIDATION;
+
+
+/** \var ZipFile::OPEN_MODE_SEEKABLE
+ * \brief Index the DEFLATED entries for fast seeking.
+ *
+ * The input streams returned by getInputStream() support seekg(). For
+ * a DEFLATED entry, seeking requires inflating all the data before the
+ * target, from the start of the entry when seeking backward.
+ *
+ * With this flag, the streams of large DEFLATED entries record access
+ * points (the inflate state and a 32 KiB window) every 1 MiB of data
+ * as they read. A seek then resumes inflating from the closest access
+ * point. The access points are kept by the ZipFile and shared by all
+ * the streams reading the same entry, so once an entry was read, any
+ * seek or readAt() only inflates at most 1 MiB of data.
+ *
+ * The access points use about 3% of the size of the inflated data.
+ */
+ZipFile::OpenMode const ZipFile::OPEN_MODE_SEEKABLE;
+
+
+/** \var ZipFile::DEFAULT_MERGE_GAP
+ * \brief The default gap between entries merged in one read.
+ *
+ * When readEntries() finds two entries separated by at most this many
+ * bytes, they get read with a single read. The gap is read and ignored.
+ */
+std::size_t const ZipFile::DEFAULT_MERGE_GAP;
+
+
+/** \var ZipFile::MAXIMUM_BATCH_READ
+ * \brief The maximum size of one read of readEntries().
+ *
+ * The entries get merged in one read as long as the read remains under
+ * this size. An entry larger than this size is read alone.
+ */
+std::size_t const ZipFile::MAXIMUM_BATCH_READ;
+
+
+/** \var ZipFile::DEFAULT_SAVE_BUDGET
+ * \brief The default memory budget of a parallel save.
+ *
+ * When saveCollectionToArchive() compresses entries in parallel, the
+ * compressed data waiting to be written uses at most about this many
+ * bytes. See SaveOptions.
+ */
+std::size_t const ZipFile::DEFAULT_SAVE_BUDGET;
+
+
+/** \struct ZipFile::SaveOptions
+ * \brief The options of a parallel saveCollectionToArchive().
+ *
+ * The m_threads field is the number of threads compressing entries.
+ * Zero means one per CPU and one means the entries get compressed
+ * by the calling thread, as with the saveCollectionToArchive()
+ * function without options.
+ *
+ * The m_budget field is the maximum number of bytes of entries being
+ * compressed or waiting to be written. Entries larger than the budget
+ * get compressed by the calling thread while being written.
+ *
+ * The m_block_size field, when not zero, makes the calling thread
+ * compress those larger entries in blocks of that many bytes with
+ * m_threads threads (see ZipOutputStream::setParallelDeflate()).
+ * Something between 128Kb and 1Mb works well. The data of those
+ * entries is then not the same as with the serial save. By default,
+ * it is 0 and the output is the same.
+ */
+
+
+/** \struct ZipFile::CacheStatistics
+ * \brief The statistics of the decompressed data cache.
+ *
+ * This structure is returned by getCacheStatistics(). The hits, misses
+ * and evictions are counted since the ZipFile was opened. The entries
+ * and size represent the current content of the cache.
+ */
+
+
+/** \var ZipFile::CacheStatistics::m_hits
+ * \brief Number of getInputStream() calls served from the cache.
+ */
+
+
+/** \var ZipFile::CacheStatistics::m_misses
+ * \brief Number of getInputStream() calls which had to read the archive.
+ */
+
+
+/** \var ZipFile::CacheStatistics::m_evictions
+ * \brief Number of entries removed to keep the cache within its budget.
+ */
+
+
+/** \var ZipFile::CacheStatistics::m_entries
+ * \brief Number of entries currently in the cache.
+ */
+
+
+/** \var ZipFile::CacheStatistics::m_size
+ * \brief Number of bytes currently used by the cached data.
  */
 
 
@@ -298,10 +680,11 @@ namespace zipios
  * that the input stream represents what is considered a valid zip file.
  *
  * \param[in] filename  The filename of your executable (generally, argv[0]).
+ * \param[in] mode  A set of OPEN_MODE_... flags.
  *
  * \return A ZipFile that one can use to read compressed data.
  */
-ZipFile::pointer_t ZipFile::openEmbeddedZipFile(std::string const & filename)
+ZipFile::pointer_t ZipFile::openEmbeddedZipFile(std::string const & filename, OpenMode mode)
 {
     // open zipfile, read 4 last bytes close file
     uint32_t start_offset;
@@ -313,7 +696,7 @@ ZipFile::pointer_t ZipFile::openEmbeddedZipFile(std::string const & filename)
     }
 
     // create ZipFile object from embedded data
-    return std::make_shared<ZipFile>(filename, start_offset, 4);
+    return std::make_shared<ZipFile>(filename, start_offset, 4, mode);
 }
 
 
@@ -326,6 +709,7 @@ ZipFile::pointer_t ZipFile::openEmbeddedZipFile(std::string const & filename)
  * if you want to work with maps or vectors of ZipFile objects.
  */
 ZipFile::ZipFile()
+    : m_cache(std::make_shared<EntryCache>())
 {
 }
 
@@ -340,6 +724,18 @@ ZipFile::ZipFile()
  * If the file cannot be opened or the Zip directory cannot
  * be read, then the constructor throws an exception.
  *
+ * The file remains open until the ZipFile is closed. The input streams
+ * returned by getInputStream() read the entries from that same file
+ * with positional reads instead of opening the file again.
+ *
+ * When \p mode includes OPEN_MODE_MEMORY_MAP, the file gets memory
+ * mapped and the Central Directory is parsed directly from the mapping.
+ * The OPEN_MODE_LAZY_VALIDATION and OPEN_MODE_PARALLEL_VALIDATION flags
+ * define how the local headers get verified.
+ *
+ * \exception IOException
+ * This exception is raised if the file cannot be opened.
+ *
  * \exception FileCollectionException
  * This exception is raised if the initialization fails. The function verifies
  * that the input stream represents what is considered a valid zip file.
@@ -351,18 +747,26 @@ ZipFile::ZipFile()
  *                   indicates the end of the zip data in the file.
  *                   The offset is a positive number, even though the
  *                   offset goes toward the beginning of the file.
+ * \param[in] mode  A set of OPEN_MODE_... flags.
  */
-ZipFile::ZipFile(std::string const & filename, offset_t s_off, offset_t e_off)
+ZipFile::ZipFile(std::string const & filename, offset_t s_off, offset_t e_off, OpenMode mode)
     : FileCollection(filename)
     , m_vs(s_off, e_off)
+    , m_open_mode(mode)
+    , m_cache(std::make_shared<EntryCache>())
 {
-    std::ifstream zipfile(m_filename, std::ios::in | std::ios::binary);
-    if(!zipfile)
+    m_file = std::make_shared<RandomAccessFile>(m_filename, (mode & OPEN_MODE_MEMORY_MAP) != 0);
+
+    if(m_file->data() != nullptr)
     {
-        throw IOException("Error opening Zip archive file for reading in binary mode.");
+        init(m_file->data(), m_file->size());
+    }
+    else
+    {
+        RandomAccessStreambuf filebuf(m_file);
+        std::istream zipfile(&filebuf);
+        init(zipfile);
     }
-
-    init(zipfile);
 }
 
 
@@ -390,6 +794,7 @@ ZipFile::ZipFile(std::string const & filename, offset_t s_off, offset_t e_off)
  */
 ZipFile::ZipFile(std::istream & is, offset_t s_off, offset_t e_off)
     : m_vs(s_off, e_off)
+    , m_cache(std::make_shared<EntryCache>())
 {
     init(is);
 }
@@ -409,160 +814,1873 @@ ZipFile::ZipFile(std::istream & is, offset_t s_off, offset_t e_off)
 void ZipFile::init(std::istream & is)
 {
     // Find and read the End of Central Directory.
-    ZipEndOfCentralDirectory eocd;
+    //
+    // It has to be within the last MAXIMUM_SIZE bytes of the archive
+    // so read that tail once and search it backward; the tail also
+    // includes room for the ZIP64 locator which precedes it
+    //
+    m_vs.vseekg(is, 0, std::ios::end);
+    offset_t const zip_size(m_vs.vtellg(is));
+    if(!is || zip_size < 0)
     {
-        BackBuffer bb(is, m_vs);
-        ssize_t read_p(-1);
-        for(;;)
-        {
-            if(read_p < 0)
-            {
-                if(!bb.readChunk(read_p))
-                {
-                    throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
-                }
-            }
-            // Note: this is pretty fast since it reads from 'bb' which
-            //       caches the buffer the readChunk() function just read.
-            //
-            if(eocd.read(bb, read_p))
-            {
-                // found it!
-                break;
-            }
-            --read_p;
-        }
+        throw IOException("Invalid virtual file endings.");
     }
+    offset_t const tail_size(std::min(zip_size, static_cast<offset_t>(ZipEndOfCentralDirectory::MAXIMUM_SIZE + ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE)));
+    buffer_t tail;
+    m_vs.vseekg(is, zip_size - tail_size, std::ios::beg);
+    zipRead(is, tail, static_cast<ssize_t>(tail_size));
 
-    // Position read pointer to start of first entry in central dir.
-    m_vs.vseekg(is, eocd.getOffset(), std::ios::beg);
-
-    // TBD -- is that ", 0" still necessary? (With VC2012 and better)
-    // Give the second argument in the next line to keep Visual C++ quiet
-    //m_entries.resize(eocd.getCount(), 0);
-    m_entries.resize(eocd.getCount());
+    ZipEndOfCentralDirectory eocd;
+    std::size_t read_p(0);
+    if(!eocd.find(tail.data(), tail.size(), read_p))
+    {
+        throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
+    }
+    offset_t const eocd_pos(zip_size - tail_size + static_cast<offset_t>(read_p));
 
-    size_t const max_entry(eocd.getCount());
-    for(size_t entry_num(0); entry_num < max_entry; ++entry_num)
+    // A ZIP64 archive has a locator just before the End of Central
+    // Directory which gives us the position of the ZIP64 record
+    //
+    if(read_p >= ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE
+    && eocd.readZip64Locator(tail.data(), tail.size(), read_p - ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE))
     {
-        m_entries[entry_num] = std::make_shared<ZipCentralDirectoryEntry>();
-        m_entries[entry_num].get()->read(is);
+        if(eocd.getZip64Offset() < 0
+        || eocd.getZip64Offset() + static_cast<offset_t>(ZipEndOfCentralDirectory::ZIP64_SIZE) > eocd_pos)
+        {
+            throw FileCollectionException("Unable to find zip structure: ZIP64 End-of-central-directory");
+        }
+        buffer_t zip64;
+        m_vs.vseekg(is, eocd.getZip64Offset(), std::ios::beg);
+        zipRead(is, zip64, static_cast<ssize_t>(ZipEndOfCentralDirectory::ZIP64_SIZE));
+        eocd.readZip64(zip64.data(), zip64.size(), 0);
     }
 
-    // Consistency check #1:
-    // The virtual seeker position is exactly the start offset of the
-    // Central Directory plus the Central Directory size
+    // Read the entire Central Directory in one go; it ends at the
+    // latest where the End of Central Directory starts
     //
-    offset_t const pos(m_vs.vtellg(is));
-    if(static_cast<offset_t>(eocd.getOffset() + eocd.getCentralDirectorySize()) != pos)
+    if(eocd.getOffset() > eocd_pos)
     {
-        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+        throw IOException("EOF reached while reading zip archive data from file.");
     }
+    buffer_t central_directory;
+    m_vs.vseekg(is, eocd.getOffset(), std::ios::beg);
+    zipRead(is, central_directory, static_cast<ssize_t>(eocd_pos - eocd.getOffset()));
+
+    readCentralDirectory(central_directory.data(), central_directory.size(), eocd.getCount(), eocd.getCentralDirectorySize());
 
     // Consistency check #2:
     // Are local headers consistent with CD headers?
     //
-    for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    if(m_file != nullptr)
+    {
+        verifyLocalHeaders();
+    }
+    else
     {
-        /** \TODO
-         * Make sure the entry offset is properly defined by
-         * ZipCentralDirectoryEntry.
-         *
-         * Also the isEqual() is a quite advanced (slow) test here!
-         */
-        m_vs.vseekg(is, (*it)->getEntryOffset(), std::ios::beg);
-        ZipLocalEntry zlh;
-        zlh.read(is);
-        if(!is || !zlh.isEqual(**it))
+        for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
         {
-            throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+            /** \TODO
+             * Make sure the entry offset is properly defined by
+             * ZipCentralDirectoryEntry.
+             *
+             * Also the isEqual() is a quite advanced (slow) test here!
+             */
+            m_vs.vseekg(is, (*it)->getEntryOffset(), std::ios::beg);
+            ZipLocalEntry zlh;
+            zlh.read(is);
+            if(!is || !zlh.isEqual(**it))
+            {
+                throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+            }
         }
     }
 
+    indexEntries();
+
     // we are all good!
     m_valid = true;
 }
 
 
-/** \brief Create a clone of this ZipFile.
+/** \brief Initialize the ZipFile from a memory mapped file.
  *
- * This function creates a heap allocated clone of the ZipFile object.
+ * This function does the same work as the init() function using an
+ * input stream, only it parses the Zip archive structures directly
+ * from the memory mapped file.
  *
- * \return A shared pointer to a copy of this ZipFile object.
+ * \exception FileCollectionException
+ * This exception is raised if the initialization fails. The function verifies
+ * that the data represents what is considered a valid zip file.
+ *
+ * \param[in] data  A pointer to the memory mapped file.
+ * \param[in] size  The size of the file.
  */
-FileCollection::pointer_t ZipFile::clone() const
+void ZipFile::init(unsigned char const * data, offset_t size)
 {
-    return FileCollection::pointer_t(std::make_shared<ZipFile>(*this));
-}
+    // restrict the buffer to the zip archive itself
+    offset_t const zip_size(size - m_vs.startOffset() - m_vs.endOffset());
+    if(m_vs.startOffset() < 0
+    || m_vs.endOffset() < 0
+    || zip_size < 0)
+    {
+        throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
+    }
+    unsigned char const * const buf(data + m_vs.startOffset());
+    size_t const buf_size(static_cast<size_t>(zip_size));
+
+    // Find and read the End of Central Directory.
+    size_t const tail_size(std::min(buf_size, ZipEndOfCentralDirectory::MAXIMUM_SIZE + ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE));
+    ZipEndOfCentralDirectory eocd;
+    std::size_t read_p(0);
+    if(!eocd.find(buf + buf_size - tail_size, tail_size, read_p))
+    {
+        throw FileCollectionException("Unable to find zip structure: End-of-central-directory");
+    }
+    read_p += buf_size - tail_size;
 
+    // A ZIP64 archive has a locator just before the End of Central
+    // Directory which gives us the position of the ZIP64 record
+    //
+    if(read_p >= ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE
+    && eocd.readZip64Locator(buf, buf_size, read_p - ZipEndOfCentralDirectory::ZIP64_LOCATOR_SIZE))
+    {
+        if(eocd.getZip64Offset() < 0
+        || eocd.getZip64Offset() + static_cast<offset_t>(ZipEndOfCentralDirectory::ZIP64_SIZE) > static_cast<offset_t>(read_p))
+        {
+            throw FileCollectionException("Unable to find zip structure: ZIP64 End-of-central-directory");
+        }
+        eocd.readZip64(buf, buf_size, static_cast<std::size_t>(eocd.getZip64Offset()));
+    }
 
-/** \brief Clean up the ZipFile object.
- *
- * The destructor ensures that any ZipFile data gets flushed
- * out before returning.
- */
-ZipFile::~ZipFile()
-{
-    close();
+    // Read the central directory entries from the mapping.
+    if(eocd.getOffset() > static_cast<offset_t>(read_p))
+    {
+        throw IOException("EOF reached while reading zip archive data from file.");
+    }
+    std::size_t const cd_offset(static_cast<std::size_t>(eocd.getOffset()));
+    readCentralDirectory(buf + cd_offset, read_p - cd_offset, eocd.getCount(), eocd.getCentralDirectorySize());
+
+    // Consistency check #2:
+    // Are local headers consistent with CD headers?
+    //
+    verifyLocalHeaders();
+
+    indexEntries();
+
+    // we are all good!
+    m_valid = true;
 }
 
 
-/** \brief Retrieve a pointer to a file in the Zip archive.
- *
- * This function returns a shared pointer to an istream defined from the
- * named entry, which gives you access to the corresponding file defined
- * in the Zip archive.
+/** \brief Parse the entries of the Central Directory.
  *
- * The function returns nullptr if there is no entry with the
- * specified name in this ZipFile.
- *
- * Note that the function returns a smart pointer to an istream. The
- * ZipFile class does not hold that pointer meaning that
- * if you call getInputStream() multiple times with the same
- * \p entry_name parameter, you get different istream instance each
- * time.
+ * This function decodes the \p count entries of the Central Directory
+ * found at \p buf. The init() functions load the whole Central
+ * Directory in memory (or point to the memory mapped file) so each
+ * field gets decoded directly from memory instead of costing one
+ * istream read per field.
  *
- * By default the \p entry_name parameter is expected to match the full
- * path and filename (MatchPath::MATCH). If you are looking for a file
- * and want to ignore the path, set the matchpath parameter
- * to MatchPath::IGNORE.
- *
- * \note
- * If the file is compressed inside the Zip archive, this input stream
- * returns the uncompressed data transparently to you (outside of the
- * time it takes to decompress the data, of course.)
+ * The buffer may extend past the end of the Central Directory, up to
+ * the End of Central Directory. The entries must end exactly
+ * \p central_directory_size bytes after \p buf.
  *
- * \param[in] entry_name  The name of the file to search in the collection.
- * \param[in] matchpath  Whether the full path or just the filename is matched.
+ * \exception IOException
+ * This exception is raised if an entry is invalid or goes past the
+ * end of the buffer.
  *
- * \return A shared pointer to an open istream for the specified entry.
+ * \exception FileCollectionException
+ * This exception is raised if the entries do not end where the End of
+ * Central Directory says the Central Directory ends.
  *
- * \sa CollectionCollection
- * \sa DirectoryCollection
- * \sa FileCollection
+ * \param[in] buf  A pointer to the first Central Directory entry.
+ * \param[in] size  The number of bytes available at \p buf.
+ * \param[in] count  The number of entries to read.
+ * \param[in] central_directory_size  The size of the Central Directory.
  */
-ZipFile::stream_pointer_t ZipFile::getInputStream(std::string const & entry_name, MatchPath matchpath)
+void ZipFile::readCentralDirectory(unsigned char const * buf, std::size_t size, std::size_t count, std::size_t central_directory_size)
 {
-    mustBeValid();
-
-    // TODO: see whether we could make the handling of the StreamEntry
-    //       non-special
+    // each entry is at least 46 bytes; this prevents a corrupted count
+    // (possibly 64 bits with ZIP64) from allocating a huge vector
     //
-    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
-    StreamEntry::pointer_t stream(std::dynamic_pointer_cast<StreamEntry>(entry));
-    if(stream != nullptr)
+    if(count > size / 46)
     {
-        stream_pointer_t zis(std::make_shared<ZipInputStream>(stream->getStream()));
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+    }
+
+    m_entries.resize(count);
+
+    std::size_t pos(0);
+    for(std::size_t entry_num(0); entry_num < count; ++entry_num)
+    {
+        std::shared_ptr<ZipCentralDirectoryEntry> entry(std::make_shared<ZipCentralDirectoryEntry>());
+        entry->read(buf, size, pos);
+        m_entries[entry_num] = entry;
+    }
+
+    // Consistency check #1:
+    // The end of the last entry is exactly the start offset of the
+    // Central Directory plus the Central Directory size
+    //
+    if(pos != central_directory_size)
+    {
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+    }
+}
+
+
+/** \brief Verify the local headers of all the entries.
+ *
+ * This function compares the local header of each entry with its
+ * Central Directory entry, as defined by the open mode:
+ *
+ * \li OPEN_MODE_LAZY_VALIDATION -- nothing is done here, each entry
+ *     gets verified on first access;
+ * \li OPEN_MODE_PARALLEL_VALIDATION -- the entries are split between
+ *     multiple threads which verify them simultaneously;
+ * \li otherwise the entries are verified one after the other.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if a local header is not consistent with
+ * its Central Directory entry.
+ */
+void ZipFile::verifyLocalHeaders()
+{
+    if((m_open_mode & OPEN_MODE_LAZY_VALIDATION) != 0)
+    {
+        return;
+    }
+
+    // avoid creating threads for a few entries only
+    //
+    size_t const entries_per_thread(256);
+    size_t thread_count(1);
+    if((m_open_mode & OPEN_MODE_PARALLEL_VALIDATION) != 0)
+    {
+        thread_count = std::min<size_t>(
+                  std::max(1U, std::thread::hardware_concurrency())
+                , (m_entries.size() + entries_per_thread - 1) / entries_per_thread);
+    }
+
+    if(thread_count <= 1)
+    {
+        for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            verifyLocalHeader(**it);
+        }
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(thread_count);
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    try
+    {
+        size_t const count(m_entries.size());
+        for(size_t t(0); t < thread_count; ++t)
+        {
+            size_t const start(count * t / thread_count);
+            size_t const end(count * (t + 1) / thread_count);
+            threads.emplace_back([this, start, end, t, &errors]()
+                {
+                    try
+                    {
+                        for(size_t idx(start); idx < end; ++idx)
+                        {
+                            verifyLocalHeader(*m_entries[idx]);
+                        }
+                    }
+                    catch(...)
+                    {
+                        errors[t] = std::current_exception();
+                    }
+                });
+        }
+    }
+    catch(...)
+    {
+        // could not create all the threads
+        for(auto it(threads.begin()); it != threads.end(); ++it) // LCOV_EXCL_LINE
+        {
+            it->join(); // LCOV_EXCL_LINE
+        }
+        throw; // LCOV_EXCL_LINE
+    }
+
+    for(auto it(threads.begin()); it != threads.end(); ++it)
+    {
+        it->join();
+    }
+
+    for(auto it(errors.begin()); it != errors.end(); ++it)
+    {
+        if(*it != nullptr)
+        {
+            std::rethrow_exception(*it);
+        }
+    }
+}
+
+
+/** \brief Verify the local header of one entry.
+ *
+ * This function reads the local header of \p entry, with a positional
+ * read or directly from the mapping, and compares it with the Central
+ * Directory entry. Once verified, the entry is marked as such so the
+ * verification happens only once.
+ *
+ * Entries which were not read from the Central Directory (i.e. entries
+ * added with addEntry()) are ignored.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the local header is not consistent with
+ * the Central Directory entry.
+ *
+ * \exception IOException
+ * This exception is raised if the local header cannot be read.
+ *
+ * \param[in] entry  The entry to verify.
+ */
+void ZipFile::verifyLocalHeader(FileEntry const & entry) const
+{
+    ZipCentralDirectoryEntry const * const cd_entry(dynamic_cast<ZipCentralDirectoryEntry const *>(&entry));
+    if(m_file == nullptr
+    || cd_entry == nullptr
+    || cd_entry->isLocalHeaderVerified())
+    {
+        return;
+    }
+
+    ZipLocalEntry zlh;
+    if(m_file->data() != nullptr)
+    {
+        unsigned char const * const buf(m_file->data() + m_vs.startOffset());
+        size_t const buf_size(static_cast<size_t>(m_file->size() - m_vs.startOffset() - m_vs.endOffset()));
+        size_t pos(cd_entry->getEntryOffset());
+        zlh.read(buf, buf_size, pos);
+    }
+    else
+    {
+        // read the fixed size part, then the filename and extra field
+        //
+        size_t const fixed_size(30);
+        offset_t const offset(m_vs.startOffset() + cd_entry->getEntryOffset());
+        buffer_t header(fixed_size);
+        header.resize(m_file->read(offset, header.data(), header.size()));
+        if(header.size() == fixed_size)
+        {
+            size_t pos(26);
+            uint16_t filename_len(0);
+            uint16_t extra_field_len(0);
+            zipRead(header, pos, filename_len);
+            zipRead(header, pos, extra_field_len);
+            size_t const variable_size(filename_len + extra_field_len);
+            header.resize(fixed_size + variable_size);
+            header.resize(fixed_size + m_file->read(offset + fixed_size, header.data() + fixed_size, variable_size));
+        }
+        size_t pos(0);
+        zlh.read(header.data(), header.size(), pos);
+    }
+
+    if(!zlh.isEqual(*cd_entry))
+    {
+        throw FileCollectionException("Zip file consistency problem. Zip file data fields are inconsistent with zip file layout.");
+    }
+
+    cd_entry->setLocalHeaderVerified();
+}
+
+
+/** \brief Create a clone of this ZipFile.
+ *
+ * This function creates a heap allocated clone of the ZipFile object.
+ *
+ * \return A shared pointer to a copy of this ZipFile object.
+ */
+FileCollection::pointer_t ZipFile::clone() const
+{
+    return FileCollection::pointer_t(std::make_shared<ZipFile>(*this));
+}
+
+
+/** \brief Clean up the ZipFile object.
+ *
+ * The destructor ensures that any ZipFile data gets flushed
+ * out before returning.
+ */
+ZipFile::~ZipFile()
+{
+    close();
+}
+
+
+/** \brief Close the ZipFile.
+ *
+ * This function releases the file used to read the Zip archive and
+ * then closes the collection.
+ *
+ * The input streams previously returned by getInputStream() hold their
+ * own reference to the file, so they remain valid. The file descriptor
+ * gets closed once the last of these streams is destroyed.
+ *
+ * The decompressed data cache is shared with the clones of this ZipFile
+ * so it only gets cleared when no clone uses it anymore.
+ */
+void ZipFile::close()
+{
+    m_file.reset();
+    if(m_cache != nullptr
+    && m_cache.use_count() == 1)
+    {
+        m_cache->clear();
+    }
+
+    FileCollection::close();
+}
+
+
+/** \brief Retrieve a pointer to a file in the Zip archive.
+ *
+ * This function returns a shared pointer to an istream defined from the
+ * named entry, which gives you access to the corresponding file defined
+ * in the Zip archive.
+ *
+ * The function returns nullptr if there is no entry with the
+ * specified name in this ZipFile.
+ *
+ * Note that the function returns a smart pointer to an istream. The
+ * ZipFile class does not hold that pointer meaning that
+ * if you call getInputStream() multiple times with the same
+ * \p entry_name parameter, you get different istream instance each
+ * time.
+ *
+ * By default the \p entry_name parameter is expected to match the full
+ * path and filename (MatchPath::MATCH). If you are looking for a file
+ * and want to ignore the path, set the matchpath parameter
+ * to MatchPath::IGNORE.
+ *
+ * \note
+ * If the file is compressed inside the Zip archive, this input stream
+ * returns the uncompressed data transparently to you (outside of the
+ * time it takes to decompress the data, of course.)
+ *
+ * \note
+ * When the ZipFile was opened from a filename, the stream reads the
+ * archive file that the ZipFile already has open. It does not open
+ * the file again. If the file is memory mapped and the entry is STORED,
+ * the stream returns the data directly from the mapping, once its
+ * CRC32 was verified.
+ *
+ * \note
+ * When a cache budget was defined with setCacheBudget(), the decompressed
+ * data of the entry is saved in the cache and the following calls for
+ * the same entry return a stream reading the cached data. An entry which
+ * fails its CRC32 or size verification is not cached; the function then
+ * returns the stream used to read it, with its badbit set.
+ *
+ * \note
+ * This function can be called by multiple threads at the same time.
+ * However, entries added with a StreamEntry share the stream of that
+ * entry and their input streams cannot be read concurrently.
+ *
+ * \exception FileCollectionException
+ * With OPEN_MODE_LAZY_VALIDATION, this exception is raised if the local
+ * header of the entry is not consistent with its Central Directory entry.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return A shared pointer to an open istream for the specified entry.
+ *
+ * \sa CollectionCollection
+ * \sa DirectoryCollection
+ * \sa FileCollection
+ */
+ZipFile::stream_pointer_t ZipFile::getInputStream(std::string const & entry_name, MatchPath matchpath)
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        // no entry with that name (and match) available
+        return nullptr;
+    }
+
+    return getEntryInputStream(*entry);
+}
+
+
+/** \brief Get an input stream reading the data of an entry.
+ *
+ * This function is the implementation of getInputStream() once the
+ * entry was found. See that function for details. The entry must be
+ * one of the entries of this ZipFile.
+ *
+ * \exception FileCollectionException
+ * With OPEN_MODE_LAZY_VALIDATION, this exception is raised if the local
+ * header of the entry is not consistent with its Central Directory entry.
+ *
+ * \param[in] entry  The entry to read.
+ *
+ * \return A shared pointer to an open istream for \p entry.
+ */
+ZipFile::stream_pointer_t ZipFile::getEntryInputStream(FileEntry const & entry)
+{
+    // TODO: see whether we could make the handling of the StreamEntry
+    //       non-special
+    //
+    StreamEntry const * stream(dynamic_cast<StreamEntry const *>(&entry));
+    if(stream != nullptr)
+    {
+        stream_pointer_t zis(std::make_shared<ZipInputStream>(stream->getStream()));
+        return zis;
+    }
+
+    if((m_open_mode & OPEN_MODE_LAZY_VALIDATION) != 0)
+    {
+        verifyLocalHeader(entry);
+    }
+
+    // the mapped data is verified once; when corrupted, the entry
+    // gets read the usual way, which reports the error
+    //
+    char const * data(nullptr);
+    std::size_t size(0);
+    if(getMappedData(entry, data, size))
+    {
+        offset_t const key(entry.getEntryOffset());
+        bool verified(m_cache->isVerified(key));
+        if(!verified
+        && size == entry.getSize()
+        && CRC32::update(0, data, size) == entry.getCrc())
+        {
+            m_cache->setVerified(key);
+            verified = true;
+        }
+        if(verified)
+        {
+            stream_pointer_t zis(std::make_shared<ZipInputStream>(m_file, data, size));
+            return zis;
+        }
+    }
+
+    std::size_t const budget(m_cache->getBudget());
+    if(budget > 0)
+    {
+        EntryCache::data_t cached(m_cache->find(entry.getEntryOffset()));
+        if(cached == nullptr
+        && entry.getSize() <= budget)
+        {
+            stream_pointer_t is(openEntry(entry));
+            std::shared_ptr<buffer_t> buffer(std::make_shared<buffer_t>(entry.getSize()));
+            is->read(reinterpret_cast<char *>(buffer->data()), static_cast<std::streamsize>(buffer->size()));
+            if(is->bad()
+            || static_cast<std::size_t>(is->gcount()) != buffer->size())
+            {
+                // corrupted or truncated entry: never cache it and
+                // return the failed stream so the error gets reported
+                // exactly as without a cache
+                //
+                return is;
+            }
+            m_cache->insert(entry.getEntryOffset(), buffer);
+            cached = buffer;
+        }
+        if(cached != nullptr)
+        {
+            stream_pointer_t zis(std::make_shared<ZipInputStream>(cached));
+            return zis;
+        }
+    }
+
+    return openEntry(entry);
+}
+
+
+/** \brief Open a stream reading the data of an entry from the archive.
+ *
+ * This function creates a ZipInputStream which reads the data of
+ * \p entry from the archive file, decompressing it if necessary.
+ *
+ * With OPEN_MODE_SEEKABLE, large DEFLATED entries get the InflateIndex
+ * kept for that entry attached to their stream.
+ *
+ * \param[in] entry  The entry to read.
+ *
+ * \return A shared pointer to the new input stream.
+ */
+ZipFile::stream_pointer_t ZipFile::openEntry(FileEntry const & entry) const
+{
+    if(m_file != nullptr)
+    {
+        InflateIndex::pointer_t index;
+        if((m_open_mode & OPEN_MODE_SEEKABLE) != 0
+        && entry.getMethod() == StorageMethod::DEFLATED
+        && entry.getSize() > static_cast<std::size_t>(InflateIndex::DEFAULT_SPAN))
+        {
+            index = m_cache->getInflateIndex(entry.getEntryOffset());
+        }
+        stream_pointer_t zis(std::make_shared<ZipInputStream>(m_file, entry.getEntryOffset() + m_vs.startOffset(), index));
         return zis;
     }
-    else if(entry != nullptr)
+    stream_pointer_t zis(std::make_shared<ZipInputStream>(m_filename, entry.getEntryOffset() + m_vs.startOffset()));
+    return zis;
+}
+
+
+/** \brief Read a range of bytes from an entry.
+ *
+ * This function reads up to \p size bytes of the uncompressed data of
+ * the named entry, starting at \p offset, into \p buf.
+ *
+ * For a STORED entry, the data is read directly at the corresponding
+ * offset in the archive. For a DEFLATED entry, the data before
+ * \p offset has to be inflated; with OPEN_MODE_SEEKABLE, inflating
+ * resumes from the closest access point instead of the start of the
+ * entry. When the entry is in the decompressed data cache, the bytes
+ * are copied from the cache.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if there is no entry named \p entry_name.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in] offset  The offset of the first byte to read.
+ * \param[out] buf  The buffer where the data is saved.
+ * \param[in] size  The number of bytes to read.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return The number of bytes read, which is smaller than \p size when
+ *         the end of the entry is reached, 0 when \p offset is past the end.
+ */
+std::size_t ZipFile::readAt(
+      std::string const & entry_name
+    , offset_t offset
+    , void * buf
+    , std::size_t size
+    , MatchPath matchpath)
+{
+    stream_pointer_t is(getInputStream(entry_name, matchpath));
+    if(is == nullptr)
+    {
+        throw FileCollectionException("ZipFile::readAt(): entry \"" + entry_name + "\" not found.");
+    }
+
+    if(!is->seekg(offset))
+    {
+        return 0;
+    }
+    is->read(static_cast<char *>(buf), static_cast<std::streamsize>(size));
+    return static_cast<std::size_t>(is->gcount());
+}
+
+
+/** \brief Define the budget of the decompressed data cache.
+ *
+ * By default, each call to getInputStream() reads the data of the entry
+ * from the archive and decompresses it again. When the same entries get
+ * read over and over again, a cache of the decompressed data avoids
+ * that work.
+ *
+ * This function sets the maximum number of bytes of decompressed data
+ * kept in memory. When the cache is full, the least recently used
+ * entries get evicted. Entries larger than the budget are never cached.
+ * A budget of zero, the default, disables the cache.
+ *
+ * The STORED entries of a memory mapped archive are not cached since
+ * their data is already read directly from the mapping.
+ *
+ * \note
+ * The cache is shared with the clones of this ZipFile.
+ *
+ * \param[in] budget  The maximum number of bytes kept in the cache.
+ *
+ * \sa getCacheStatistics()
+ */
+void ZipFile::setCacheBudget(std::size_t budget)
+{
+    m_cache->setBudget(budget);
+}
+
+
+/** \brief Retrieve the budget of the decompressed data cache.
+ *
+ * \return The maximum number of bytes kept in the cache, 0 when the
+ *         cache is disabled.
+ *
+ * \sa setCacheBudget()
+ */
+std::size_t ZipFile::getCacheBudget() const
+{
+    return m_cache->getBudget();
+}
+
+
+/** \brief Retrieve the statistics of the decompressed data cache.
+ *
+ * This function returns the number of cache hits and misses of
+ * getInputStream() and the current usage of the cache.
+ *
+ * \return A copy of the cache statistics.
+ *
+ * \sa setCacheBudget()
+ */
+ZipFile::CacheStatistics ZipFile::getCacheStatistics() const
+{
+    return m_cache->getStatistics();
+}
+
+
+/** \brief Retrieve a direct pointer to the data of a STORED entry.
+ *
+ * This function gives direct access to the data of a STORED entry
+ * when the ZipFile was opened with OPEN_MODE_MEMORY_MAP. The data
+ * is not copied: \p data points inside the mapping of the archive.
+ *
+ * The pointer remains valid until the ZipFile is closed. To keep
+ * the data available longer, use getInputStream() instead, which
+ * keeps the mapping alive for as long as the stream exists.
+ *
+ * \warning
+ * Unlike all the other functions reading entries, this function does
+ * not verify the CRC32 of the data, since that would read the whole
+ * entry before returning. Use getInputStream() or readEntry() to get
+ * verified data.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the local header of the entry is invalid
+ * or the data of the entry goes beyond the end of the archive. With
+ * OPEN_MODE_LAZY_VALIDATION, it is also raised if the local header is
+ * not consistent with the Central Directory entry.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[out] data  A pointer to the data of the entry.
+ * \param[out] size  The size of the data.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return true if \p data and \p size were set; false if the entry does
+ *         not exist, is not STORED, or the archive is not memory mapped.
+ */
+bool ZipFile::getStoredData(
+      std::string const & entry_name
+    , char const * & data
+    , std::size_t & size
+    , MatchPath matchpath) const
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return false;
+    }
+
+    if((m_open_mode & OPEN_MODE_LAZY_VALIDATION) != 0)
+    {
+        verifyLocalHeader(*entry);
+    }
+
+    return getMappedData(*entry, data, size);
+}
+
+
+/** \brief Retrieve a stream returning the compressed data of an entry.
+ *
+ * This function returns a stream which reads the data of the named
+ * entry exactly as saved in the archive: the raw deflate data of a
+ * DEFLATED entry or the data of a STORED entry. The stream ends after
+ * FileEntry::getCompressedSize() bytes.
+ *
+ * This is useful to serve the data of a DEFLATED entry with a
+ * "Content-Encoding: deflate" without decompressing and compressing
+ * it again. See also writeGZIPMember().
+ *
+ * The data is not verified. The CRC32 of the entry is only checked by
+ * the reader which eventually decompresses it.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the entry is not part of the archive
+ * file (i.e. it was added with addEntry()), if its local header is
+ * invalid, or if its data goes beyond the end of the archive.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return A shared pointer to the raw input stream or nullptr if the
+ *         entry does not exist.
+ */
+ZipFile::stream_pointer_t ZipFile::getRawInputStream(std::string const & entry_name, MatchPath matchpath)
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return nullptr;
+    }
+
+    return getRawInputStream(*entry);
+}
+
+
+/** \brief Retrieve a stream returning the compressed data of an entry.
+ *
+ * This function returns a stream which reads the compressed data of
+ * \p entry. The data is located using the offset of \p entry and not
+ * its name so it works with archives including several entries with
+ * the same name. The entry must be one of the entries of this archive.
+ *
+ * This function is used by ZipOutputStream::putRawEntry().
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the entry was not read from the archive
+ * file, if its local header is invalid, or if its data goes beyond the
+ * end of the archive.
+ *
+ * \param[in] entry  The entry of which the data is read.
+ *
+ * \return A shared pointer to the raw input stream.
+ *
+ * \sa getRawInputStream(std::string const & entry_name, MatchPath matchpath)
+ */
+ZipFile::stream_pointer_t ZipFile::getRawInputStream(FileEntry const & entry)
+{
+    mustBeValid();
+
+    if(m_file == nullptr
+    || dynamic_cast<ZipCentralDirectoryEntry const *>(&entry) == nullptr)
+    {
+        throw FileCollectionException("ZipFile::getRawInputStream(): entry \"" + entry.getName() + "\" has no data in the Zip archive file.");
+    }
+
+    if((m_open_mode & OPEN_MODE_LAZY_VALIDATION) != 0)
+    {
+        verifyLocalHeader(entry);
+    }
+
+    offset_t const header_offset(m_vs.startOffset() + entry.getEntryOffset());
+    unsigned char header[g_local_header_size];
+    if(m_file->read(header_offset, header, sizeof(header)) != sizeof(header))
+    {
+        throw FileCollectionException("Zip file consistency problem. Local header goes beyond the end of the Zip archive.");
+    }
+    offset_t const data_offset(getEntryDataOffset(entry, header_offset, header));
+
+    if(m_file->data() != nullptr)
+    {
+        stream_pointer_t is(std::make_shared<ZipInputStream>(
+                      m_file
+                    , reinterpret_cast<char const *>(m_file->data() + data_offset)
+                    , entry.getCompressedSize()));
+        return is;
+    }
+
+    stream_pointer_t is(std::make_shared<ZipInputStream>(m_file, data_offset, entry.getCompressedSize()));
+    return is;
+}
+
+
+/** \brief Write a DEFLATED entry as a gzip member.
+ *
+ * This function writes the named entry to \p os as a complete gzip
+ * member: a gzip header, the raw deflate data as found in the archive,
+ * and a trailer built from the CRC32 and size saved in the Central
+ * Directory. The data is not decompressed nor compressed again, making
+ * it possible to serve the entry with a "Content-Encoding: gzip" at
+ * the cost of a copy.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the entry is not DEFLATED or if its data
+ * cannot be read from the archive, see getRawInputStream().
+ *
+ * \exception IOException
+ * This exception is raised if writing to \p os fails.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[in,out] os  The stream where the gzip member gets written.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return true if the member was written, false if the entry does not
+ *         exist.
+ */
+bool ZipFile::writeGZIPMember(std::string const & entry_name, std::ostream & os, MatchPath matchpath)
+{
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return false;
+    }
+    if(entry->getMethod() != StorageMethod::DEFLATED)
+    {
+        throw FileCollectionException("ZipFile::writeGZIPMember(): entry \"" + entry_name + "\" is not DEFLATED.");
+    }
+
+    stream_pointer_t is(getRawInputStream(entry_name, matchpath));
+
+    GZIPOutputStreambuf::writeHeader(os.rdbuf(), std::string(), std::string());
+
+    if(entry->getCompressedSize() == 0)
+    {
+        // an empty entry may have no deflate data at all, gzip requires
+        // at least one block so write an empty final fixed block
+        //
+        os.write("\x03\x00", 2);
+    }
+    else
+    {
+        std::vector<char> buffer(StreamPool::acquireBuffer());
+        while(*is)
+        {
+            is->read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            os.write(buffer.data(), is->gcount());
+        }
+        StreamPool::releaseBuffer(buffer);
+    }
+
+    GZIPOutputStreambuf::writeTrailer(os.rdbuf(), entry->getCrc(), static_cast<uint32_t>(entry->getSize()));
+
+    if(!os)
+    {
+        throw IOException("ZipFile::writeGZIPMember(): an error occurred while writing the gzip member.");
+    }
+
+    return true;
+}
+
+
+/** \brief Read the whole data of an entry in a vector.
+ *
+ * This function reads all the data of the named entry in \p data,
+ * which gets resized to the exact size of the entry as found in the
+ * Central Directory.
+ *
+ * Contrary to getInputStream(), the data does not go through an
+ * std::istream. A STORED entry is read directly in \p data with one
+ * positional read (or one copy from the mapping). A DEFLATED entry
+ * gets its compressed data read at once and inflated in one pass
+ * directly in \p data. The CRC32 of the data is then verified.
+ *
+ * The decompressed data cache is not used by this function.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data is corrupted: it cannot be
+ * inflated, it does not match the size of the entry, or its CRC32
+ * does not match the CRC32 of the entry.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[out] data  The vector where the data is saved.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return true if the entry was found and read; false if the entry
+ *         does not exist, in which case \p data is not modified.
+ */
+bool ZipFile::readEntry(std::string const & entry_name, std::vector<char> & data, MatchPath matchpath)
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return false;
+    }
+
+    return readEntry(*entry, data);
+}
+
+
+/** \brief Read the whole data of an entry in a buffer.
+ *
+ * This function reads all the data of the named entry in \p buf. On
+ * entry, \p size is the size of \p buf. On return, it is set to the
+ * size of the entry.
+ *
+ * The data is read the same way as with the other readEntry() function,
+ * directly in \p buf.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p buf is too small for the entry.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data is corrupted.
+ *
+ * \param[in] entry_name  The name of the file to search in the collection.
+ * \param[out] buf  The buffer where the data is saved.
+ * \param[in,out] size  The size of \p buf, then the size of the data.
+ * \param[in] matchpath  Whether the full path or just the filename is matched.
+ *
+ * \return true if the entry was found and read; false if the entry
+ *         does not exist.
+ */
+bool ZipFile::readEntry(std::string const & entry_name, char * buf, std::size_t & size, MatchPath matchpath)
+{
+    mustBeValid();
+
+    FileEntry::pointer_t entry(getEntry(entry_name, matchpath));
+    if(entry == nullptr)
+    {
+        return false;
+    }
+
+    return readEntry(*entry, buf, size);
+}
+
+
+/** \brief Read the whole data of an entry in a vector.
+ *
+ * This function reads all the data of \p entry, one of the entries of
+ * this ZipFile, in \p data. The data of that very entry is read, even
+ * if other entries of the archive have the same name.
+ *
+ * The data is read as with the readEntry() function searching the
+ * entry by name. Entries which cannot be read directly from the archive
+ * (such as a StreamEntry) are read through their input stream.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data is corrupted or truncated.
+ *
+ * \param[in] entry  The entry to read.
+ * \param[out] data  The vector where the data is saved.
+ *
+ * \return Always true.
+ */
+bool ZipFile::readEntry(FileEntry const & entry, std::vector<char> & data)
+{
+    mustBeValid();
+
+    if(!isDirectlyReadable(entry))
+    {
+        stream_pointer_t is(getEntryInputStream(entry));
+        data.resize(entry.getSize());
+        readEntryStream(entry, *is, data.data());
+        return true;
+    }
+
+    data.resize(entry.getSize());
+    readEntryData(entry, data.data());
+
+    return true;
+}
+
+
+/** \brief Read the whole data of an entry in a buffer.
+ *
+ * This function reads all the data of \p entry, one of the entries of
+ * this ZipFile, in \p buf. On entry, \p size is the size of \p buf.
+ * On return, it is set to the size of the entry.
+ *
+ * \exception InvalidException
+ * This exception is raised if \p buf is too small for the entry.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data is corrupted or truncated.
+ *
+ * \param[in] entry  The entry to read.
+ * \param[out] buf  The buffer where the data is saved.
+ * \param[in,out] size  The size of \p buf, then the size of the data.
+ *
+ * \return Always true.
+ */
+bool ZipFile::readEntry(FileEntry const & entry, char * buf, std::size_t & size)
+{
+    mustBeValid();
+
+    if(entry.getSize() > size)
+    {
+        throw InvalidException("ZipFile::readEntry(): the buffer is too small for entry \"" + entry.getName() + "\".");
+    }
+
+    if(!isDirectlyReadable(entry))
+    {
+        stream_pointer_t is(getEntryInputStream(entry));
+        readEntryStream(entry, *is, buf);
+    }
+    else
+    {
+        readEntryData(entry, buf);
+    }
+    size = entry.getSize();
+
+    return true;
+}
+
+
+/** \brief Read the data of many entries.
+ *
+ * This function reads the whole data of all the \p entries and calls
+ * \p callback once per entry with that data. The entries must be
+ * entries of this ZipFile (as returned by entries() or getEntry()).
+ *
+ * Reading entries one by one with getInputStream() means one seek and
+ * a few small reads per entry, in whatever order the entries are
+ * requested. Instead, this function sorts the entries by their position
+ * in the archive and merges entries separated by at most \p merge_gap
+ * bytes in one large read of up to MAXIMUM_BATCH_READ bytes. While one
+ * such batch gets decompressed, the system is told to read ahead the
+ * next batch (see RandomAccessFile::willNeed()). This way the disk
+ * sees a few large sequential reads instead of many random reads.
+ *
+ * The callback gets called in the order of the entries in the archive,
+ * not the order of \p entries. The data pointer is only valid for the
+ * duration of the call. The data of STORED entries points directly to
+ * the read buffer or the memory mapped file.
+ *
+ * Entries which cannot be read directly (such as entries of a ZipFile
+ * created from an istream) are read through their input stream, with
+ * readEntry(FileEntry const & entry, std::vector<char> & data).
+ *
+ * \exception InvalidException
+ * This exception is raised if one of the \p entries is a null pointer.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data of an entry is corrupted, see
+ * readEntry(). Entries before that one were already passed to the
+ * callback.
+ *
+ * \param[in] entries  The entries to read.
+ * \param[in] callback  The function called with the data of each entry.
+ * \param[in] merge_gap  The largest gap between two entries read at once.
+ */
+void ZipFile::readEntries(FileEntry::vector_t const & entries, entry_callback_t const & callback, std::size_t merge_gap)
+{
+    mustBeValid();
+
+    FileEntry::vector_t sorted(entries);
+    for(auto it(sorted.begin()); it != sorted.end(); ++it)
+    {
+        if(*it == nullptr)
+        {
+            throw InvalidException("ZipFile::readEntries(): the list of entries includes a null pointer.");
+        }
+    }
+    std::stable_sort(
+              sorted.begin()
+            , sorted.end()
+            , [](FileEntry::pointer_t const & lhs, FileEntry::pointer_t const & rhs)
+            {
+                return static_cast<offset_t>(lhs->getEntryOffset()) < static_cast<offset_t>(rhs->getEntryOffset());
+            });
+
+    // group the entries close to each other in batches
+    //
+    std::vector<FileEntry::vector_t> batches;
+    offset_t batch_start(0);
+    offset_t batch_end(0);
+    for(auto it(sorted.begin()); it != sorted.end(); ++it)
+    {
+        if(!isDirectlyReadable(**it))
+        {
+            // read on its own with getInputStream()
+            //
+            batches.push_back(FileEntry::vector_t{ *it });
+            batch_end = -1;
+            continue;
+        }
+
+        offset_t const start((*it)->getEntryOffset());
+        offset_t const end(estimated_entry_end(**it));
+        if(batches.empty()
+        || batch_end < 0
+        || start > batch_end + static_cast<offset_t>(merge_gap)
+        || end - batch_start > static_cast<offset_t>(MAXIMUM_BATCH_READ))
+        {
+            batches.push_back(FileEntry::vector_t());
+            batch_start = start;
+            batch_end = end;
+        }
+        batches.back().push_back(*it);
+        batch_end = std::max(batch_end, end);
+    }
+
+    FileEntry::buffer_t buffer;
+    std::vector<char> data;
+    for(auto it(batches.begin()); it != batches.end(); ++it)
+    {
+        if(!isDirectlyReadable(*it->front()))
+        {
+            FileEntry::pointer_t entry(it->front());
+            readEntry(*entry, data);
+            callback(entry, data.data(), data.size());
+            continue;
+        }
+
+        // let the system read the next batch while we work on this one
+        //
+        auto next(it + 1);
+        if(next != batches.end()
+        && isDirectlyReadable(*next->front()))
+        {
+            offset_t const start(m_vs.startOffset() + next->front()->getEntryOffset());
+            offset_t end(start);
+            for(auto e(next->begin()); e != next->end(); ++e)
+            {
+                end = std::max(end, m_vs.startOffset() + estimated_entry_end(**e));
+            }
+            m_file->willNeed(start, static_cast<std::size_t>(end - start));
+        }
+
+        readEntryBatch(*it, callback, buffer);
+    }
+}
+
+
+/** \brief Extract all the entries to a directory.
+ *
+ * This function is the same as extractTo() with the default options.
+ *
+ * \param[in] path  The destination directory.
+ */
+void ZipFile::extractTo(std::string const & path)
+{
+    extractTo(path, ExtractOptions());
+}
+
+
+/** \brief Extract all the entries to a directory.
+ *
+ * This function creates one file per entry under \p path, which gets
+ * created if it does not exist yet (its parent must exist). Existing
+ * files get overwritten.
+ *
+ * The directories are all created first, once. Then the files get
+ * extracted by options.m_threads worker threads (by default, one per
+ * CPU). Each worker takes the next entry in the order of the archive,
+ * reads it with positional reads from the archive shared by all the
+ * workers, inflates it and writes it to a file created with its final
+ * size preallocated (see OutputFile). Entries of up to
+ * MAXIMUM_BATCH_READ bytes are read and inflated in memory at once, as
+ * with readEntry(); larger entries are streamed.
+ *
+ * When options.m_restore_times is true (the default), the modification
+ * time of the files and directories is set to the time of their entry.
+ *
+ * When several entries have the same name, only the last one gets
+ * extracted.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if an entry has a name which would be
+ * created outside of \p path (i.e. an absolute name or a name with a
+ * ".." segment, and under MS-Windows, a name with a backslash or a
+ * colon) or if the data of an entry is corrupted. In the former case,
+ * nothing gets extracted.
+ *
+ * \exception IOException
+ * This exception is raised if a directory or file cannot be created
+ * or written.
+ *
+ * \param[in] path  The destination directory.
+ * \param[in] options  The extraction options.
+ */
+void ZipFile::extractTo(std::string const & path, ExtractOptions const & options)
+{
+    mustBeValid();
+
+    std::string root(path);
+    while(root.length() > 1 && root.back() == '/')
+    {
+        root.pop_back();
+    }
+
+    // verify all the names and gather the directories; when several
+    // files have the same name the last one wins so two workers never
+    // write the same file
+    //
+    FileEntry::vector_t files;
+    FileEntry::vector_t directories;
+    std::set<std::string> paths;
+    std::map<std::string, std::size_t> file_positions;
+    for(auto it(m_entries.begin()); it != m_entries.end(); ++it)
+    {
+        std::string name((*it)->getName());
+        while(!name.empty() && name.back() == '/')
+        {
+            name.pop_back();
+        }
+        if(!is_safe_name(name))
+        {
+            throw FileCollectionException("ZipFile::extractTo(): entry \"" + (*it)->getName() + "\" would be extracted outside of the destination directory.");
+        }
+
+        if((*it)->isDirectory())
+        {
+            directories.push_back(*it);
+            paths.insert(name);
+        }
+        else
+        {
+            auto const position(file_positions.find(name));
+            if(position != file_positions.end())
+            {
+                files[position->second] = *it;
+            }
+            else
+            {
+                file_positions[name] = files.size();
+                files.push_back(*it);
+            }
+        }
+        for(std::string::size_type pos(name.find('/')); pos != std::string::npos; pos = name.find('/', pos + 1))
+        {
+            paths.insert(name.substr(0, pos));
+        }
+    }
+
+    // the set is sorted so parents get created before their children
+    //
+    OutputFile::createDirectory(root);
+    for(auto it(paths.begin()); it != paths.end(); ++it)
+    {
+        OutputFile::createDirectory(root + "/" + *it);
+    }
+
+    // read the archive in order
+    //
+    std::stable_sort(
+              files.begin()
+            , files.end()
+            , [](FileEntry::pointer_t const & lhs, FileEntry::pointer_t const & rhs)
+            {
+                return static_cast<offset_t>(lhs->getEntryOffset()) < static_cast<offset_t>(rhs->getEntryOffset());
+            });
+
+    std::size_t thread_count(options.m_threads);
+    if(thread_count == 0)
+    {
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    }
+    thread_count = std::max<std::size_t>(1, std::min(thread_count, files.size()));
+
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::exception_ptr> errors(thread_count);
+    auto worker([this, &root, &files, &options, &next, &failed, &errors](std::size_t t)
+        {
+            try
+            {
+                std::vector<char> buffer;
+                while(!failed)
+                {
+                    std::size_t const idx(next++);
+                    if(idx >= files.size())
+                    {
+                        break;
+                    }
+                    extractEntry(*files[idx], root + "/" + files[idx]->getName(), options.m_restore_times, buffer);
+                }
+            }
+            catch(...)
+            {
+                errors[t] = std::current_exception();
+                failed = true;
+            }
+        });
+
+    if(thread_count == 1)
+    {
+        worker(0);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+        try
+        {
+            for(std::size_t t(0); t < thread_count; ++t)
+            {
+                threads.emplace_back(worker, t);
+            }
+        }
+        catch(...)
+        {
+            // could not create all the threads
+            failed = true; // LCOV_EXCL_LINE
+            for(auto it(threads.begin()); it != threads.end(); ++it) // LCOV_EXCL_LINE
+            {
+                it->join(); // LCOV_EXCL_LINE
+            }
+            throw; // LCOV_EXCL_LINE
+        }
+
+        for(auto it(threads.begin()); it != threads.end(); ++it)
+        {
+            it->join();
+        }
+    }
+
+    for(auto it(errors.begin()); it != errors.end(); ++it)
+    {
+        if(*it != nullptr)
+        {
+            std::rethrow_exception(*it);
+        }
+    }
+
+    // creating the files changed the time of the directories, so this
+    // is done last
+    //
+    if(options.m_restore_times)
+    {
+        for(auto it(directories.begin()); it != directories.end(); ++it)
+        {
+            OutputFile::setModificationTime(root + "/" + (*it)->getName(), (*it)->getUnixTime());
+        }
+    }
+}
+
+
+/** \brief Check whether the data of an entry can be read directly.
+ *
+ * The readEntry() functions read the data of entries found in the
+ * Central Directory of an archive opened from a file directly. Other
+ * entries, such as a StreamEntry, are read through their input stream.
+ *
+ * \param[in] entry  The entry to check.
+ *
+ * \return true if readEntryData() can be used with \p entry.
+ */
+bool ZipFile::isDirectlyReadable(FileEntry const & entry) const
+{
+    ZipCentralDirectoryEntry const * const cd_entry(dynamic_cast<ZipCentralDirectoryEntry const *>(&entry));
+    return m_file != nullptr
+        && cd_entry != nullptr
+        && !cd_entry->hasTrailingDataDescriptor()
+        && (cd_entry->getMethod() == StorageMethod::STORED
+            || cd_entry->getMethod() == StorageMethod::DEFLATED);
+}
+
+
+/** \brief Check whether the compressed data of an entry can be copied.
+ *
+ * When saving a ZipFile to another archive, the compressed data of
+ * its entries can be copied as is instead of being decompressed and
+ * compressed again. This is only possible if the entry was read from
+ * the archive file and neither its storage method nor its compression
+ * level were explicitly changed since (for example with
+ * FileCollection::setMethod() or FileCollection::setLevel()).
+ *
+ * \param[in] entry  The entry to check.
+ *
+ * \return true if the compressed data of \p entry can be copied.
+ */
+bool ZipFile::isRawCopyable(FileEntry const & entry) const
+{
+    ZipCentralDirectoryEntry const * const cd_entry(dynamic_cast<ZipCentralDirectoryEntry const *>(&entry));
+    if(m_file == nullptr
+    || cd_entry == nullptr
+    || cd_entry->isCompressionChanged()
+    || (entry.getMethod() != StorageMethod::STORED
+        && entry.getMethod() != StorageMethod::DEFLATED))
+    {
+        return false;
+    }
+
+    // the method in the local header is the one of the saved data
+    //
+    unsigned char header[g_local_header_size];
+    if(m_file->read(m_vs.startOffset() + entry.getEntryOffset(), header, sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+    std::size_t pos(8);
+    uint16_t compress_method(0);
+    zipRead(header, sizeof(header), pos, compress_method);
+    return static_cast<StorageMethod>(compress_method) == entry.getMethod();
+}
+
+
+/** \brief Read the data of an entry directly in a buffer.
+ *
+ * This function reads the data of \p entry in \p buf, which must be
+ * at least FileEntry::getSize() bytes. The entry must be directly
+ * readable, see isDirectlyReadable().
+ *
+ * The compressed data is read at once, from the mapping or with one
+ * positional read. STORED data is read directly in \p buf and DEFLATED
+ * data is inflated in \p buf in one pass with Z_FINISH. Finally, the
+ * CRC32 of the data is verified.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the local header is invalid, the data
+ * goes beyond the end of the archive or the data is corrupted.
+ *
+ * \param[in] entry  The entry to read.
+ * \param[out] buf  The buffer receiving the data.
+ */
+void ZipFile::readEntryData(FileEntry const & entry, char * buf) const
+{
+    if((m_open_mode & OPEN_MODE_LAZY_VALIDATION) != 0)
+    {
+        verifyLocalHeader(entry);
+    }
+
+    // find the position of the data from the local header
+    //
+    offset_t const header_offset(m_vs.startOffset() + entry.getEntryOffset());
+    unsigned char header[g_local_header_size];
+    if(m_file->read(header_offset, header, sizeof(header)) != sizeof(header))
+    {
+        throw FileCollectionException("Zip file consistency problem. Local header goes beyond the end of the Zip archive.");
+    }
+    offset_t const data_offset(getEntryDataOffset(entry, header_offset, header));
+
+    std::size_t const compressed_size(entry.getCompressedSize());
+    std::size_t const size(entry.getSize());
+    if(entry.getMethod() == StorageMethod::STORED)
+    {
+        if(m_file->data() != nullptr)
+        {
+            std::copy(m_file->data() + data_offset, m_file->data() + data_offset + size, buf);
+        }
+        else if(m_file->read(data_offset, buf, size) != size)
+        {
+            throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the Zip archive."); // LCOV_EXCL_LINE
+        }
+    }
+    else
+    {
+        buffer_t compressed;
+        unsigned char const * in(nullptr);
+        if(m_file->data() != nullptr)
+        {
+            in = m_file->data() + data_offset;
+        }
+        else
+        {
+            compressed.resize(compressed_size);
+            if(m_file->read(data_offset, compressed.data(), compressed_size) != compressed_size)
+            {
+                throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the Zip archive."); // LCOV_EXCL_LINE
+            }
+            in = compressed.data();
+        }
+        inflateEntryData(entry, in, buf);
+    }
+
+    verifyEntryCrc(entry, buf);
+}
+
+
+/** \brief Read a batch of entries.
+ *
+ * This function reads the data of all the entries of \p batch with one
+ * read, or directly from the mapping, then it decompresses each entry,
+ * verifies its CRC32 and calls \p callback. The entries must be sorted
+ * by offset and be directly readable.
+ *
+ * An entry which goes beyond the estimated end of the batch (i.e. its
+ * local header is larger than expected) gets read with readEntryData().
+ *
+ * \param[in] batch  The entries to read.
+ * \param[in] callback  The function called with the data of each entry.
+ * \param[in,out] buffer  A buffer reused between batches.
+ */
+void ZipFile::readEntryBatch(FileEntry::vector_t const & batch, entry_callback_t const & callback, FileEntry::buffer_t & buffer) const
+{
+    offset_t const start(m_vs.startOffset() + batch.front()->getEntryOffset());
+    offset_t const limit(m_file->size() - m_vs.endOffset());
+    unsigned char const * block(nullptr);
+    std::size_t block_size(0);
+    if(m_file->data() != nullptr)
+    {
+        block = m_file->data() + start;
+        block_size = static_cast<std::size_t>(std::max(limit - start, static_cast<offset_t>(0)));
+    }
+    else
     {
-        stream_pointer_t zis(std::make_shared<ZipInputStream>(m_filename, entry->getEntryOffset() + m_vs.startOffset()));
-        return zis;
+        offset_t end(start);
+        for(auto it(batch.begin()); it != batch.end(); ++it)
+        {
+            end = std::max(end, m_vs.startOffset() + estimated_entry_end(**it));
+        }
+        end = std::min(end, limit);
+        buffer.resize(static_cast<std::size_t>(std::max(end - start, static_cast<offset_t>(0))));
+        block_size = m_file->read(start, buffer.data(), buffer.size());
+        block = buffer.data();
+    }
+
+    std::vector<char> data;
+    for(auto it(batch.begin()); it != batch.end(); ++it)
+    {
+        FileEntry & entry(**it);
+        if((m_open_mode & OPEN_MODE_LAZY_VALIDATION) != 0)
+        {
+            verifyLocalHeader(entry);
+        }
+
+        std::size_t const size(entry.getSize());
+        offset_t const header_offset(m_vs.startOffset() + entry.getEntryOffset());
+        std::size_t const header_pos(static_cast<std::size_t>(header_offset - start));
+        std::size_t data_pos(block_size);
+        if(header_pos + g_local_header_size <= block_size)
+        {
+            data_pos = static_cast<std::size_t>(getEntryDataOffset(entry, header_offset, block + header_pos) - start);
+        }
+        if(data_pos + entry.getCompressedSize() > block_size)
+        {
+            data.resize(size);
+            readEntryData(entry, data.data());
+            callback(*it, data.data(), size);
+            continue;
+        }
+
+        if(entry.getMethod() == StorageMethod::STORED)
+        {
+            char const * stored(reinterpret_cast<char const *>(block + data_pos));
+            verifyEntryCrc(entry, stored);
+            callback(*it, stored, size);
+        }
+        else
+        {
+            data.resize(size);
+            inflateEntryData(entry, block + data_pos, data.data());
+            verifyEntryCrc(entry, data.data());
+            callback(*it, data.data(), size);
+        }
+    }
+}
+
+
+/** \brief Extract one entry to a file.
+ *
+ * This function creates \p filename with the data of \p entry. It is
+ * used by the workers of extractTo() and can run in parallel.
+ *
+ * \param[in,out] entry  The entry to extract.
+ * \param[in] filename  The name of the file to create.
+ * \param[in] restore_time  Whether the modification time gets restored.
+ * \param[in,out] buffer  A buffer reused between entries.
+ */
+void ZipFile::extractEntry(FileEntry & entry, std::string const & filename, bool restore_time, std::vector<char> & buffer) const
+{
+    std::size_t const size(entry.getSize());
+    {
+        OutputFile out(filename, size);
+        if(isDirectlyReadable(entry)
+        && size <= MAXIMUM_BATCH_READ)
+        {
+            buffer.resize(size);
+            readEntryData(entry, buffer.data());
+            out.write(buffer.data(), size);
+        }
+        else
+        {
+            // stream large entries, the CRC32 gets verified by the
+            // ZipInputStreambuf, which throws on errors
+            //
+            stream_pointer_t is(openEntry(entry));
+            is->exceptions(std::ios::badbit);
+            buffer.resize(std::max<std::size_t>(getBufferSize(), 1024 * 1024));
+            while(*is)
+            {
+                is->read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                out.write(buffer.data(), static_cast<std::size_t>(is->gcount()));
+            }
+        }
+        out.close();
+    }
+
+    if(restore_time)
+    {
+        OutputFile::setModificationTime(filename, entry.getUnixTime());
+    }
+}
+
+
+/** \brief Get the position of the data of an entry.
+ *
+ * This function parses the local header of \p entry found in \p header
+ * to determine the position of its data. It also makes sure that the
+ * data is within the archive.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the local header is invalid or the data
+ * goes beyond the end of the archive.
+ *
+ * \param[in] entry  The entry being read.
+ * \param[in] header_offset  The position of the local header in the file.
+ * \param[in] header  The first g_local_header_size bytes of the local header.
+ *
+ * \return The position of the data in the file.
+ */
+offset_t ZipFile::getEntryDataOffset(FileEntry const & entry, offset_t header_offset, unsigned char const * header) const
+{
+    size_t pos(0);
+    uint32_t signature(0);
+    zipRead(header, g_local_header_size, pos, signature);
+    if(signature != g_local_header_signature)
+    {
+        throw FileCollectionException("Zip file consistency problem. Local header signature not found.");
+    }
+    pos = 26;
+    uint16_t filename_len(0);
+    uint16_t extra_field_len(0);
+    zipRead(header, g_local_header_size, pos, filename_len);
+    zipRead(header, g_local_header_size, pos, extra_field_len);
+    offset_t const data_offset(header_offset + static_cast<offset_t>(g_local_header_size) + filename_len + extra_field_len);
+
+    if(data_offset + static_cast<offset_t>(entry.getCompressedSize()) > m_file->size() - m_vs.endOffset())
+    {
+        throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the Zip archive.");
     }
+    if(entry.getMethod() == StorageMethod::STORED
+    && entry.getCompressedSize() != entry.getSize())
+    {
+        throw FileCollectionException("Zip file consistency problem. STORED entry with a compressed size different from its size.");
+    }
+
+    return data_offset;
+}
+
+
+/** \brief Inflate the data of a DEFLATED entry.
+ *
+ * This function inflates the FileEntry::getCompressedSize() bytes of
+ * \p in to \p buf in one pass with Z_FINISH. The \p buf buffer must be
+ * at least FileEntry::getSize() bytes.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data cannot be inflated or does not
+ * match the size of the entry.
+ *
+ * \param[in] entry  The entry being read.
+ * \param[in] in  The compressed data.
+ * \param[out] buf  The buffer receiving the data.
+ */
+void ZipFile::inflateEntryData(FileEntry const & entry, unsigned char const * in, char * buf)
+{
+    std::size_t const compressed_size(entry.getCompressedSize());
+    std::size_t const size(entry.getSize());
+    if(compressed_size == 0 && size == 0)
+    {
+        // an empty entry may have no DEFLATED data at all
+        //
+        return;
+    }
+
+    // zlib refuses null pointers, even when the size is zero
+    //
+    unsigned char dummy(0);
+    unsigned char * const out(size == 0 ? &dummy : reinterpret_cast<unsigned char *>(buf));
+    if(compressed_size == 0)
+    {
+        in = &dummy;
+    }
+
+    // a pooled z_stream keeps the pointers of its previous user
+    //
+    z_stream * zs(StreamPool::acquireInflate());
+    zs->next_in = nullptr;
+    zs->avail_in = 0;
+    zs->next_out = nullptr;
+    zs->avail_out = 0;
+    int err(Z_OK);
+
+    // avail_in and avail_out are limited to 32 bits
+    //
+    std::size_t const max_chunk(std::numeric_limits<uInt>::max());
+    std::size_t in_pos(0);
+    std::size_t out_pos(0);
+    do
+    {
+        if(zs->avail_in == 0 && in_pos < compressed_size)
+        {
+            std::size_t const chunk(std::min(compressed_size - in_pos, max_chunk));
+            zs->next_in = const_cast<unsigned char *>(in + in_pos);
+            zs->avail_in = static_cast<uInt>(chunk);
+            in_pos += chunk;
+        }
+        if(zs->avail_out == 0 && out_pos < size)
+        {
+            std::size_t const chunk(std::min(size - out_pos, max_chunk));
+            zs->next_out = out + out_pos;
+            zs->avail_out = static_cast<uInt>(chunk);
+            out_pos += chunk;
+        }
+        if(zs->next_out == nullptr)
+        {
+            zs->next_out = out;
+        }
+        if(zs->next_in == nullptr)
+        {
+            zs->next_in = const_cast<unsigned char *>(in);
+        }
+        err = inflate(zs, in_pos == compressed_size && out_pos == size ? Z_FINISH : Z_NO_FLUSH);
+    }
+    while(err == Z_OK);
+    std::size_t const remaining_out(zs->avail_out);
+    StreamPool::releaseInflate(zs);
 
-    // no entry with that name (and match) available
-    return nullptr;
+    if(err != Z_STREAM_END
+    || out_pos != size
+    || remaining_out != 0)
+    {
+        throw FileCollectionException("Zip file consistency problem. The DEFLATED data of the entry is invalid or does not match its size.");
+    }
+}
+
+
+/** \brief Verify the CRC32 of the data of an entry.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the CRC32 of the FileEntry::getSize()
+ * bytes of \p buf does not match the CRC32 of \p entry.
+ *
+ * \param[in] entry  The entry being read.
+ * \param[in] buf  The data of the entry.
+ */
+void ZipFile::verifyEntryCrc(FileEntry const & entry, char const * buf)
+{
+    // the CRC32 of an entry read from the Central Directory is always
+    // defined, even though hasCrc() returns false
+    //
+    if(CRC32::update(0, buf, entry.getSize()) != entry.getCrc())
+    {
+        throw FileCollectionException("Zip file consistency problem. The CRC32 of the entry data does not match.");
+    }
+}
+
+
+/** \brief Find the data of a STORED entry in the memory mapped archive.
+ *
+ * This function reads the local header of \p entry from the mapping to
+ * determine where its data starts. It only works with entries read from
+ * the Central Directory of a memory mapped archive which are STORED.
+ * Entries with a trailing data descriptor are not supported.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data goes beyond the end of the archive.
+ *
+ * \param[in] entry  The entry for which the data is requested.
+ * \param[out] data  A pointer to the data of the entry.
+ * \param[out] size  The size of the data.
+ *
+ * \return true if the data was found in the mapping.
+ */
+bool ZipFile::getMappedData(FileEntry const & entry, char const * & data, std::size_t & size) const
+{
+    ZipCentralDirectoryEntry const * const cd_entry(dynamic_cast<ZipCentralDirectoryEntry const *>(&entry));
+    if(m_file == nullptr
+    || m_file->data() == nullptr
+    || cd_entry == nullptr
+    || cd_entry->getMethod() != StorageMethod::STORED
+    || cd_entry->hasTrailingDataDescriptor())
+    {
+        return false;
+    }
+
+    unsigned char const * const buf(m_file->data() + m_vs.startOffset());
+    size_t const buf_size(static_cast<size_t>(m_file->size() - m_vs.startOffset() - m_vs.endOffset()));
+
+    size_t pos(entry.getEntryOffset());
+    ZipLocalEntry zlh;
+    zlh.read(buf, buf_size, pos);
+    if(pos + entry.getCompressedSize() > buf_size)
+    {
+        throw FileCollectionException("Zip file consistency problem. Entry data goes beyond the end of the Zip archive.");
+    }
+
+    data = reinterpret_cast<char const *>(buf + pos);
+    size = entry.getCompressedSize();
+
+    return true;
 }
 
 
@@ -571,7 +2689,15 @@ ZipFile::stream_pointer_t ZipFile::getInputStream(std::string const & entry_name
  * This function is expected to be used with a DirectoryCollection
  * that you created to save the collection in an archive.
  *
- * \param[in,out] os  The output stream where the Zip archive is saved.
+ * When \p collection is a ZipFile, the compressed data of its entries
+ * gets copied as is, unless their storage method or compression level
+ * was changed (with FileCollection::setMethod() or
+ * FileCollection::setLevel() for example). This
+ * makes filtering an archive I/O bound: remove the unwanted entries
+ * from a copy of the ZipFile and save it. To merge archives, see
+ * mergeArchives().
+ *
+ * \param[in] os  The output stream where the Zip archive is saved.
  * \param[in] collection  The collection to save in this output stream.
  * \param[in] zip_comment  The global comment of the Zip archive.
  */
@@ -589,27 +2715,232 @@ void ZipFile::saveCollectionToArchive(
         FileEntry::vector_t entries(collection.entries());
         for(auto it(entries.begin()); it != entries.end(); ++it)
         {
-            output_stream.putNextEntry(*it);
+            saveEntry(output_stream, collection, *it);
+        }
 
-            // next we need to include the data of that file in the
-            // output buffer if it is not a directory and the file is
-            // not an empty file
-            //
-            if(!(*it)->isDirectory()
-            && (*it)->getSize() > 0)
+        // clean up manually so we can get any exception
+        // (so we avoid having exceptions gobbled by the destructor)
+        output_stream.closeEntry();
+        output_stream.finish();
+        output_stream.close();
+    }
+    catch(...)
+    {
+        os.setstate(std::ios::failbit);
+        throw;
+    }
+}
+
+
+/** \brief Create a Zip archive compressing entries in parallel.
+ *
+ * This function creates the same archive, byte for byte, as the
+ * saveCollectionToArchive() without options, but compresses the
+ * entries with options.m_threads worker threads.
+ *
+ * Each worker takes the next entry, reads its data and compresses it
+ * in memory exactly as the ZipOutputStream would. The calling thread
+ * writes the local headers, with the CRC32 and sizes already known,
+ * and the compressed data in the order of the collection, so the output
+ * stream is never rewound for those entries.
+ *
+ * The memory used by the compressed data of the entries being worked on
+ * is limited by options.m_budget. Entries larger than the budget are
+ * compressed by the calling thread when their turn comes, as are the
+ * directories, the empty entries, and the entries of a ZipFile which
+ * get copied as is. When options.m_block_size is set, the calling
+ * thread compresses those large entries in blocks with
+ * options.m_threads threads, in which case the output is not byte for
+ * byte the same anymore.
+ *
+ * The getInputStream() function of \p collection gets called from the
+ * worker threads. It is safe to do so with a DirectoryCollection and
+ * a ZipFile.
+ *
+ * \param[in] os  The output stream where the Zip archive is saved.
+ * \param[in] collection  The collection to save in this output stream.
+ * \param[in] zip_comment  The global comment of the Zip archive.
+ * \param[in] options  The number of threads and memory budget to use.
+ */
+void ZipFile::saveCollectionToArchive(
+      std::ostream & os
+    , FileCollection & collection
+    , std::string const & zip_comment
+    , SaveOptions const & options)
+{
+    std::size_t thread_count(options.m_threads);
+    if(thread_count == 0)
+    {
+        thread_count = std::max(1U, std::thread::hardware_concurrency());
+    }
+    if(thread_count == 1)
+    {
+        saveCollectionToArchive(os, collection, zip_comment);
+        return;
+    }
+
+    try
+    {
+        ZipOutputStream output_stream(os);
+
+        output_stream.setComment(zip_comment);
+        if(options.m_block_size > 0)
+        {
+            output_stream.setParallelDeflate(thread_count, options.m_block_size);
+        }
+
+        FileEntry::vector_t entries(collection.entries());
+        ZipFile * zip_file(dynamic_cast<ZipFile *>(&collection));
+
+        // determine which entries get compressed by the workers
+        //
+        std::vector<compressed_entry_t> compressed(entries.size());
+        std::size_t parallel_count(0);
+        for(std::size_t idx(0); idx < entries.size(); ++idx)
+        {
+            FileEntry const & entry(*entries[idx]);
+            if(!entry.isDirectory()
+            && entry.getSize() > 0
+            && entry.getSize() <= options.m_budget
+            && (zip_file == nullptr || !zip_file->isRawCopyable(entry)))
+            {
+                compressed[idx].m_parallel = true;
+                ++parallel_count;
+            }
+        }
+        thread_count = std::min(thread_count, parallel_count);
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::size_t next(0);
+        std::size_t in_flight(0);
+        bool failed(false);
+        std::exception_ptr error;
+        auto worker([&collection, &entries, &compressed, &options, &mutex, &cond, &next, &in_flight, &failed, &error]()
+            {
+                for(;;)
+                {
+                    std::size_t idx(0);
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        for(;;)
+                        {
+                            while(next < entries.size()
+                               && !compressed[next].m_parallel)
+                            {
+                                ++next;
+                            }
+                            if(failed
+                            || next >= entries.size())
+                            {
+                                return;
+                            }
+
+                            // the entries get taken in order so when
+                            // nothing is in flight, the writer waits on
+                            // this very entry
+                            //
+                            if(in_flight == 0
+                            || in_flight + entries[next]->getSize() <= options.m_budget)
+                            {
+                                break;
+                            }
+                            cond.wait(lock);
+                        }
+                        idx = next;
+                        ++next;
+                        in_flight += entries[idx]->getSize();
+                    }
+
+                    try
+                    {
+                        compress_entry(collection, *entries[idx], compressed[idx]);
+                    }
+                    catch(...)
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        if(!failed)
+                        {
+                            failed = true;
+                            error = std::current_exception();
+                        }
+                        cond.notify_all();
+                        return;
+                    }
+
+                    std::unique_lock<std::mutex> lock(mutex);
+                    compressed[idx].m_done = true;
+                    cond.notify_all();
+                }
+            });
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+        try
+        {
+            for(std::size_t t(0); t < thread_count; ++t)
+            {
+                threads.emplace_back(worker);
+            }
+
+            for(std::size_t idx(0); idx < entries.size(); ++idx)
             {
-                // get an InputStream
+                if(!compressed[idx].m_parallel)
+                {
+                    saveEntry(output_stream, collection, entries[idx]);
+                    continue;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [&compressed, &failed, idx]() { return compressed[idx].m_done || failed; });
+                    if(failed)
+                    {
+                        std::rethrow_exception(error);
+                    }
+                }
+
+                // same entry as ZipOutputStream::putNextEntry() would save
                 //
-                FileCollection::stream_pointer_t is(collection.getInputStream((*it)->getName()));
-                if(is != nullptr
-                && is->good())
+                FileEntry::pointer_t entry(entries[idx]);
+                if(dynamic_cast<ZipCentralDirectoryEntry *>(entry.get()) == nullptr)
                 {
-                    // copy the file content to the output
-                    //
-                    output_stream << is->rdbuf();
+                    entry = std::make_shared<ZipCentralDirectoryEntry>(*entry);
                 }
+                else
+                {
+                    entry = entry->clone();
+                }
+                entry->setSize(compressed[idx].m_size);
+                entry->setCrc(compressed[idx].m_crc32);
+                entry->setCompressedSize(compressed[idx].m_data.size());
+                output_stream.putCompressedEntry(entry, compressed[idx].m_data.data(), compressed[idx].m_data.size());
+
+                std::vector<char>().swap(compressed[idx].m_data);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                in_flight -= entries[idx]->getSize();
+                cond.notify_all();
             }
         }
+        catch(...)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                failed = true;
+                cond.notify_all();
+            }
+            for(auto it(threads.begin()); it != threads.end(); ++it)
+            {
+                it->join();
+            }
+            throw;
+        }
+
+        for(auto it(threads.begin()); it != threads.end(); ++it)
+        {
+            it->join();
+        }
 
         // clean up manually so we can get any exception
         // (so we avoid having exceptions gobbled by the destructor)
@@ -625,6 +2956,114 @@ void ZipFile::saveCollectionToArchive(
 }
 
 
+/** \brief Merge multiple collections in one Zip archive.
+ *
+ * This function saves the entries of all the \p collections in one
+ * Zip archive. When multiple entries have the same name, only the
+ * first one is saved, just like CollectionCollection::getEntry()
+ * returns the first one.
+ *
+ * The compressed data of the entries of ZipFile collections is copied
+ * as is, so merging archives does not run zlib at all. Entries of which
+ * the storage method or compression level was changed are the
+ * exception; they get compressed again.
+ *
+ * \param[in] os  The output stream where the Zip archive is saved.
+ * \param[in] collections  The collections to merge.
+ * \param[in] zip_comment  The global comment of the Zip archive.
+ */
+void ZipFile::mergeArchives(
+      std::ostream & os
+    , FileCollection::vector_t const & collections
+    , std::string const & zip_comment)
+{
+    try
+    {
+        ZipOutputStream output_stream(os);
+
+        output_stream.setComment(zip_comment);
+
+        std::set<std::string> names;
+        for(auto collection(collections.begin()); collection != collections.end(); ++collection)
+        {
+            FileEntry::vector_t entries((*collection)->entries());
+            for(auto it(entries.begin()); it != entries.end(); ++it)
+            {
+                if(names.insert((*it)->getName()).second)
+                {
+                    saveEntry(output_stream, **collection, *it);
+                }
+            }
+        }
+
+        output_stream.closeEntry();
+        output_stream.finish();
+        output_stream.close();
+    }
+    catch(...)
+    {
+        os.setstate(std::ios::failbit);
+        throw;
+    }
+}
+
+
+/** \brief Save one entry of a collection to a Zip archive.
+ *
+ * If \p collection is a ZipFile and the compressed data of \p entry
+ * can be copied as is, it gets copied with
+ * ZipOutputStream::putRawEntry(). Otherwise, the data is read from
+ * \p collection and compressed again.
+ *
+ * \param[in,out] output_stream  The stream where the entry gets saved.
+ * \param[in] collection  The collection the entry comes from.
+ * \param[in] entry  The entry to save.
+ */
+void ZipFile::saveEntry(
+      ZipOutputStream & output_stream
+    , FileCollection & collection
+    , FileEntry::pointer_t entry)
+{
+    ZipFile * zip_file(dynamic_cast<ZipFile *>(&collection));
+    if(zip_file != nullptr)
+    {
+        if(zip_file->isRawCopyable(*entry))
+        {
+            output_stream.putRawEntry(*zip_file, entry);
+            return;
+        }
+
+        // the offset of the entries of a ZipFile must not change
+        // before their data is read
+        //
+        output_stream.putNextEntry(entry->clone());
+    }
+    else
+    {
+        output_stream.putNextEntry(entry);
+    }
+
+    // next we need to include the data of that file in the
+    // output buffer if it is not a directory and the file is
+    // not an empty file
+    //
+    if(!entry->isDirectory()
+    && entry->getSize() > 0)
+    {
+        // get an InputStream
+        //
+        FileCollection::stream_pointer_t is(collection.getInputStream(entry->getName()));
+        if(is != nullptr
+        && is->good())
+        {
+            // copy the file content to the output
+            //
+            output_stream << is->rdbuf();
+        }
+    }
+}
+
+
 } // zipios namespace
 
 // Local Variables:
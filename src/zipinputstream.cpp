@@ -29,6 +29,9 @@
 
 #include "zipinputstream.hpp"
 
+#include "memorymapstreambuf.hpp"
+#include "randomaccessstreambuf.hpp"
+
 #include <fstream>
 
 
@@ -62,8 +65,7 @@ namespace zipios
 ZipInputStream::ZipInputStream(std::string const & filename, std::streampos pos)
     : std::istream(nullptr)
     , m_ifs(std::make_unique<std::ifstream>(filename, std::ios::in | std::ios::binary))
-    , m_ifs_ref(*m_ifs)
-    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs_ref.rdbuf(), pos))
+    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs->rdbuf(), pos))
 {
     // properly initialize the stream with the newly allocated buffer
     init(m_izf.get());
@@ -72,14 +74,100 @@ ZipInputStream::ZipInputStream(std::string const & filename, std::streampos pos)
 
 ZipInputStream::ZipInputStream(std::istream & is)
     : std::istream(nullptr)
-    , m_ifs_ref(is)
-    , m_izf(std::make_unique<ZipInputStreambuf>(m_ifs_ref.rdbuf(), 0))
+    , m_izf(std::make_unique<ZipInputStreambuf>(is.rdbuf(), 0))
 {
     // properly initialize the stream with the newly allocated buffer
     init(m_izf.get());
 }
 
 
+/** \brief Initialize a ZipInputStream from an already open file.
+ *
+ * This constructor creates a ZIP file stream reading the entry found
+ * at position \p pos of \p file. The file is read with positional
+ * reads, so any number of ZipInputStream objects can share the same
+ * file, and creating one does not require opening the file again.
+ *
+ * The stream keeps a reference to the file, which therefore remains
+ * open until the stream is destroyed, even if the ZipFile which
+ * created it was closed in the meantime.
+ *
+ * When \p index is defined and the entry is DEFLATED, the stream uses
+ * and extends that index of access points to seek quickly.
+ *
+ * \param[in] file  The file representing the Zip archive.
+ * \param[in] pos  The position of the local header of the entry to read.
+ * \param[in] index  The index of access points of the entry or nullptr.
+ */
+ZipInputStream::ZipInputStream(RandomAccessFile::pointer_t file, std::streampos pos, InflateIndex::pointer_t index)
+    : std::istream(nullptr)
+    , m_filebuf(std::make_unique<RandomAccessStreambuf>(file))
+    , m_izf(std::make_unique<ZipInputStreambuf>(m_filebuf.get(), pos, index))
+{
+    // properly initialize the stream with the newly allocated buffer
+    init(m_izf.get());
+}
+
+
+/** \brief Initialize a ZipInputStream from a block of memory mapped data.
+ *
+ * This constructor creates a stream returning the \p size bytes found
+ * at \p data, which must point inside the mapping of \p file. It is
+ * used for STORED entries of a memory mapped archive: the data is not
+ * copied nor decompressed, the stream reads it directly from the mapping.
+ *
+ * The stream keeps a reference to the file, so the mapping remains valid
+ * until the stream is destroyed.
+ *
+ * \param[in] file  The memory mapped file representing the Zip archive.
+ * \param[in] data  A pointer to the data of the entry.
+ * \param[in] size  The size of the entry data.
+ */
+ZipInputStream::ZipInputStream(RandomAccessFile::pointer_t file, char const * data, std::size_t size)
+    : std::istream(nullptr)
+    , m_filebuf(std::make_unique<MemoryMapStreambuf>(file, data, size))
+{
+    // the data is read directly from the mapping
+    init(m_filebuf.get());
+}
+
+
+/** \brief Initialize a ZipInputStream reading a block of a file.
+ *
+ * This constructor creates a stream returning the \p size bytes found
+ * at position \p start of \p file as is. It is used to read the raw
+ * compressed data of an entry of an archive which is not memory mapped.
+ *
+ * \param[in] file  The file representing the Zip archive.
+ * \param[in] start  The position of the first byte to read.
+ * \param[in] size  The number of bytes to read.
+ */
+ZipInputStream::ZipInputStream(RandomAccessFile::pointer_t file, offset_t start, std::size_t size)
+    : std::istream(nullptr)
+    , m_filebuf(std::make_unique<RandomAccessStreambuf>(file, start, static_cast<offset_t>(size)))
+{
+    // the data is returned as is
+    init(m_filebuf.get());
+}
+
+
+/** \brief Initialize a ZipInputStream from already decompressed data.
+ *
+ * This constructor creates a stream returning the bytes of \p data.
+ * It is used for entries found in the cache of a ZipFile. The data is
+ * not copied, the stream keeps a reference to it.
+ *
+ * \param[in] data  The decompressed data of the entry.
+ */
+ZipInputStream::ZipInputStream(std::shared_ptr<buffer_t const> data)
+    : std::istream(nullptr)
+    , m_filebuf(std::make_unique<MemoryMapStreambuf>(data))
+{
+    // the data is read directly from the buffer
+    init(m_filebuf.get());
+}
+
+
 /** \brief Clean up the input stream.
  *
  * The destructor ensures that all resources used by the class get
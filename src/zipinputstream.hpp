@@ -32,7 +32,9 @@
  * have been compressed using the zlib library.
  */
 
+#include "randomaccessfile.hpp"
 #include "zipinputstreambuf.hpp"
+#include "zipios_common.hpp"
 
 
 namespace zipios
@@ -45,14 +47,18 @@ class ZipInputStream : public std::istream
 public:
                                         ZipInputStream(std::string const & filename, std::streampos pos = 0);
                                         ZipInputStream(std::istream & is);
+                                        ZipInputStream(RandomAccessFile::pointer_t file, std::streampos pos, InflateIndex::pointer_t index = InflateIndex::pointer_t());
+                                        ZipInputStream(RandomAccessFile::pointer_t file, char const * data, std::size_t size);
+                                        ZipInputStream(RandomAccessFile::pointer_t file, offset_t start, std::size_t size);
+                                        ZipInputStream(std::shared_ptr<buffer_t const> data);
                                         ZipInputStream(ZipInputStream const & rhs) = delete;
     virtual                             ~ZipInputStream() override;
 
     ZipInputStream &                    operator = (ZipInputStream const & rhs) = delete;
 
 private:
+    std::unique_ptr<std::streambuf>     m_filebuf = std::unique_ptr<std::streambuf>();
     std::unique_ptr<std::istream>       m_ifs = std::unique_ptr<std::istream>();
-    std::istream &                      m_ifs_ref;
     std::unique_ptr<ZipInputStreambuf>  m_izf = std::unique_ptr<ZipInputStreambuf>();
 };
 
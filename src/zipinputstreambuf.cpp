@@ -29,6 +29,8 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
+
 #include <algorithm>
 
 
@@ -42,6 +44,15 @@ namespace zipios
  * The ZipInputStreambuf class is a Zip input streambuf filter that
  * automatically decompresses input data that was compressed using
  * the zlib library.
+ *
+ * The stream buffer supports seeking within the data of the entry. For
+ * a STORED entry, the input streambuf gets repositioned directly. For
+ * a DEFLATED entry, see InflateInputStreambuf::seekInflated().
+ *
+ * The data read is verified against the CRC32 and size found in the
+ * local header of the entry. The CRC32 is computed as the data gets
+ * read in order. After a seek, the data past the part already verified
+ * does not get verified until the data in between was read.
  */
 
 
@@ -50,11 +61,15 @@ namespace zipios
  * This ZipInputStreambuf constructor initializes the buffer from the
  * user specified buffer.
  *
+ * When \p index is defined, the access points of a DEFLATED entry are
+ * saved in that index while reading and used when seeking.
+ *
  * \param[in,out] inbuf  The streambuf to use for input.
  * \param[in] start_pos  A position to reset the inbuf to before reading.
  *                       Specify -1 to read from the current position.
+ * \param[in] index  The index of access points of this entry or nullptr.
  */
-ZipInputStreambuf::ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos)
+ZipInputStreambuf::ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos, InflateIndex::pointer_t index)
     : InflateInputStreambuf(inbuf, start_pos)
 {
     // read the zip local header
@@ -72,10 +87,12 @@ ZipInputStreambuf::ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos)
     {
     case StorageMethod::DEFLATED:
         reset() ; // reset inflatestream data structures
+        setInflateIndex(index);
 //std::cerr << "deflated" << std::endl;
         break;
 
     case StorageMethod::STORED:
+        m_data_start = m_inbuf->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
         m_remain = m_current_entry.getSize();
         // Force underflow on first read:
         setg(&m_outvec[0], &m_outvec[0] + getBufferSize(), &m_outvec[0] + getBufferSize());
@@ -124,8 +141,12 @@ std::streambuf::int_type ZipInputStreambuf::underflow()
     switch(m_current_entry.getMethod())
     {
     case StorageMethod::DEFLATED:
+    {
         // inflate class takes care of it in this case
-        return InflateInputStreambuf::underflow();
+        int_type const c(InflateInputStreambuf::underflow());
+        verifyCrc();
+        return c;
+    }
 
     case StorageMethod::STORED:
     {
@@ -134,6 +155,7 @@ std::streambuf::int_type ZipInputStreambuf::underflow()
         std::streamsize const g(m_inbuf->sgetn(&m_outvec[0], num_b));
         setg(&m_outvec[0], &m_outvec[0], &m_outvec[0] + g);
         m_remain -= g;
+        verifyCrc();
         if(g > 0)
         {
             // we got some data, return it
@@ -153,6 +175,161 @@ std::streambuf::int_type ZipInputStreambuf::underflow()
 }
 
 
+/** \brief Verify the CRC32 of the entry.
+ *
+ * This function adds the data just read to the CRC32 of the entry.
+ * Data which was already included (i.e. read again after a seek) is
+ * ignored and data found after a gap (i.e. read after a seek forward)
+ * is not included until the gap gets read.
+ *
+ * Once all the data was included, or the end of the data was reached,
+ * the CRC32 and the size are compared with the values found in the
+ * header of the entry.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the CRC32 or the size of the data does
+ * not match the header of the entry. Like with other errors found in
+ * underflow(), it makes the istream set its badbit.
+ */
+void ZipInputStreambuf::verifyCrc()
+{
+    if(m_crc_verified)
+    {
+        return;
+    }
+
+    offset_t const size(m_current_entry.getSize());
+    offset_t const end(m_current_entry.getMethod() == StorageMethod::STORED
+                            ? size - m_remain
+                            : getInflatedPosition() + (egptr() - gptr()));
+    offset_t const start(end - (egptr() - eback()));
+    if(start > m_crc_position)
+    {
+        // not yet verified data in between
+        return;
+    }
+
+    if(end > m_crc_position)
+    {
+        m_crc32 = CRC32::update(m_crc32, eback() + (m_crc_position - start), static_cast<std::size_t>(end - m_crc_position));
+        m_crc_position = end;
+    }
+
+    // the end of the data is reached when the expected size was
+    // read or when no more data is available
+    //
+    if(m_crc_position >= size
+    || start == end)
+    {
+        m_crc_verified = true;
+        if(m_crc_position != size)
+        {
+            throw FileCollectionException("Zip file consistency problem. The size of the entry data does not match its header.");
+        }
+        if(m_crc32 != m_current_entry.getCrc())
+        {
+            throw FileCollectionException("Zip file consistency problem. The CRC32 of the entry data does not match.");
+        }
+    }
+}
+
+
+/** \brief Change the read position.
+ *
+ * This function moves the read position within the uncompressed data
+ * of the entry. Only the input position is supported.
+ *
+ * For a STORED entry, the input streambuf gets repositioned at the
+ * corresponding offset. For a DEFLATED entry, the data gets inflated
+ * up to the new position, starting from the closest access point when
+ * an InflateIndex is attached.
+ *
+ * \param[in] off  The offset to move to.
+ * \param[in] dir  Whether \p off is relative to the start, the current
+ *                 position, or the end of the entry.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type ZipInputStreambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if((which & std::ios_base::in) == 0)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    bool const stored(m_current_entry.getMethod() == StorageMethod::STORED);
+    offset_t const size(m_current_entry.getSize());
+    offset_t target(off);
+    switch(dir)
+    {
+    case std::ios_base::beg:
+        break;
+
+    case std::ios_base::cur:
+        target += stored
+                ? size - m_remain - (egptr() - gptr())
+                : getInflatedPosition();
+        break;
+
+    case std::ios_base::end:
+        target += size;
+        break;
+
+    default: // LCOV_EXCL_LINE
+        return pos_type(off_type(-1)); // LCOV_EXCL_LINE
+
+    }
+
+    if(target < 0 || target > size)
+    {
+        return pos_type(off_type(-1));
+    }
+
+    if(!stored)
+    {
+        if(!seekInflated(target))
+        {
+            return pos_type(off_type(-1));
+        }
+        return pos_type(target);
+    }
+
+    offset_t const buffer_end(size - m_remain);
+    offset_t const buffer_start(buffer_end - (egptr() - eback()));
+    if(target >= buffer_start && target <= buffer_end)
+    {
+        setg(eback(), eback() + (target - buffer_start), egptr());
+        return pos_type(target);
+    }
+
+    if(m_data_start < 0
+    || m_inbuf->pubseekpos(m_data_start + target) == pos_type(off_type(-1)))
+    {
+        return pos_type(off_type(-1));
+    }
+    m_remain = size - target;
+    setg(&m_outvec[0], &m_outvec[0] + getBufferSize(), &m_outvec[0] + getBufferSize());
+
+    return pos_type(target);
+}
+
+
+/** \brief Change the read position to an absolute position.
+ *
+ * This function is the same as seekoff() with std::ios_base::beg.
+ *
+ * \param[in] pos  The new position.
+ * \param[in] which  The position to change, must include std::ios_base::in.
+ *
+ * \return The new position or -1 on error.
+ */
+std::streambuf::pos_type ZipInputStreambuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
 } // namespace
 
 // Local Variables:
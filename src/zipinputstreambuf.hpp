@@ -42,18 +42,26 @@ namespace zipios
 class ZipInputStreambuf : public InflateInputStreambuf
 {
 public:
-                            ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos = -1);
+                            ZipInputStreambuf(std::streambuf * inbuf, offset_t start_pos = -1, InflateIndex::pointer_t index = InflateIndex::pointer_t());
                             ZipInputStreambuf(ZipInputStreambuf const & src) = delete;
     ZipInputStreambuf &     operator = (ZipInputStreambuf const & rhs) = delete;
     virtual                 ~ZipInputStreambuf() override;
 
 protected:
     virtual std::streambuf::int_type    underflow() override;
+    virtual pos_type                    seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    virtual pos_type                    seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
 
 private:
+    void                    verifyCrc();
+
     ZipLocalEntry           m_current_entry = ZipLocalEntry();
     offset_t                m_remain = 0;     // For STORED entry only. the number of bytes that
                                               // has not been put in the m_outvec yet.
+    offset_t                m_data_start = -1;    // For STORED entry only, -1 if the input cannot seek.
+    std::uint32_t           m_crc32 = 0;
+    offset_t                m_crc_position = 0;   // The number of bytes included in m_crc32.
+    bool                    m_crc_verified = false;
 };
 
 
@@ -71,6 +71,17 @@ char const g_separator = '/';
  */
 
 
+void zipRead(std::istream & is, uint64_t & value)
+{
+    // zip data is always in little endian
+    uint32_t low(0);
+    uint32_t high(0);
+    zipRead(is, low);
+    zipRead(is, high);
+    value = (static_cast<uint64_t>(high) << 32) | low;
+}
+
+
 void zipRead(std::istream & is, uint32_t & value)
 {
     unsigned char buf[sizeof(value)];
@@ -163,9 +174,25 @@ void zipRead(std::istream & is, std::string & str, ssize_t const count)
 }
 
 
-void zipRead(buffer_t const & is, size_t & pos, uint32_t & value)
+void zipRead(unsigned char const * is, size_t size, size_t & pos, uint64_t & value)
 {
-    if(pos + sizeof(value) > is.size())
+    if(pos + sizeof(value) > size)
+    {
+        throw IOException("EOF reached while reading zip archive data from file.");
+    }
+
+    // zip data is always in little endian
+    uint32_t low(0);
+    uint32_t high(0);
+    zipRead(is, size, pos, low);
+    zipRead(is, size, pos, high);
+    value = (static_cast<uint64_t>(high) << 32) | low;
+}
+
+
+void zipRead(unsigned char const * is, size_t size, size_t & pos, uint32_t & value)
+{
+    if(pos + sizeof(value) > size)
     {
         throw IOException("EOF reached while reading zip archive data from file.");
     }
@@ -179,9 +206,9 @@ void zipRead(buffer_t const & is, size_t & pos, uint32_t & value)
 }
 
 
-void zipRead(buffer_t const & is, size_t & pos, uint16_t & value)
+void zipRead(unsigned char const * is, size_t size, size_t & pos, uint16_t & value)
 {
-    if(pos + sizeof(value) > is.size())
+    if(pos + sizeof(value) > size)
     {
         throw IOException("EOF reached while reading zip archive data from file.");
     }
@@ -193,9 +220,9 @@ void zipRead(buffer_t const & is, size_t & pos, uint16_t & value)
 }
 
 
-void zipRead(buffer_t const & is, size_t & pos, uint8_t & value)
+void zipRead(unsigned char const * is, size_t size, size_t & pos, uint8_t & value)
 {
-    if(pos + sizeof(value) > is.size())
+    if(pos + sizeof(value) > size)
     {
         throw IOException("EOF reached while reading zip archive data from file.");
     }
@@ -206,34 +233,76 @@ void zipRead(buffer_t const & is, size_t & pos, uint8_t & value)
 }
 
 
-void zipRead(buffer_t const & is, size_t & pos, buffer_t & buffer, ssize_t const count)
+void zipRead(unsigned char const * is, size_t size, size_t & pos, buffer_t & buffer, ssize_t const count)
 {
-    if(pos + count > is.size())
+    if(pos + count > size)
     {
         throw IOException("EOF reached while reading zip archive data from file.");
     }
 
-    buffer.clear();
-    buffer.insert(buffer.begin(), is.begin() + pos, is.begin() + pos + count);
+    buffer.assign(is + pos, is + pos + count);
 
     pos += count;
 }
 
 
-void zipRead(buffer_t const & is, size_t & pos, std::string & str, ssize_t const count)
+void zipRead(unsigned char const * is, size_t size, size_t & pos, std::string & str, ssize_t const count)
 {
-    if(pos + count > is.size())
+    if(pos + count > size)
     {
         throw IOException("EOF reached while reading zip archive data from file.");
     }
 
-    str.clear();
-    str.insert(str.begin(), is.begin() + pos, is.begin() + pos + count);
+    str.assign(reinterpret_cast<char const *>(is) + pos, count);
 
     pos += count;
 }
 
 
+void zipRead(buffer_t const & is, size_t & pos, uint64_t & value)
+{
+    zipRead(is.data(), is.size(), pos, value);
+}
+
+
+void zipRead(buffer_t const & is, size_t & pos, uint32_t & value)
+{
+    zipRead(is.data(), is.size(), pos, value);
+}
+
+
+void zipRead(buffer_t const & is, size_t & pos, uint16_t & value)
+{
+    zipRead(is.data(), is.size(), pos, value);
+}
+
+
+void zipRead(buffer_t const & is, size_t & pos, uint8_t & value)
+{
+    zipRead(is.data(), is.size(), pos, value);
+}
+
+
+void zipRead(buffer_t const & is, size_t & pos, buffer_t & buffer, ssize_t const count)
+{
+    zipRead(is.data(), is.size(), pos, buffer, count);
+}
+
+
+void zipRead(buffer_t const & is, size_t & pos, std::string & str, ssize_t const count)
+{
+    zipRead(is.data(), is.size(), pos, str, count);
+}
+
+
+void zipWrite(std::ostream & os, uint64_t const & value)
+{
+    // zip data is always in little endian
+    zipWrite(os, static_cast<uint32_t>(value));
+    zipWrite(os, static_cast<uint32_t>(value >> 32));
+}
+
+
 void zipWrite(std::ostream & os, uint32_t const & value)
 {
     char buf[sizeof(value)];
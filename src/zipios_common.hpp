@@ -98,18 +98,28 @@ typedef std::ostringstream OutputStringStream;
 typedef std::vector<unsigned char>      buffer_t;
 
 
+void     zipRead(std::istream & is, uint64_t & value);
 void     zipRead(std::istream & is, uint32_t & value);
 void     zipRead(std::istream & is, uint16_t & value);
 void     zipRead(std::istream & is, uint8_t &  value);
 void     zipRead(std::istream & is, buffer_t & buffer, ssize_t const count);
 void     zipRead(std::istream & is, std::string & str, ssize_t const count);
 
+void     zipRead(unsigned char const * is, size_t size, size_t & pos, uint64_t & value);
+void     zipRead(unsigned char const * is, size_t size, size_t & pos, uint32_t & value);
+void     zipRead(unsigned char const * is, size_t size, size_t & pos, uint16_t & value);
+void     zipRead(unsigned char const * is, size_t size, size_t & pos, uint8_t &  value);
+void     zipRead(unsigned char const * is, size_t size, size_t & pos, buffer_t & buffer, ssize_t const count);
+void     zipRead(unsigned char const * is, size_t size, size_t & pos, std::string & str, ssize_t const count);
+
+void     zipRead(buffer_t const & is, size_t & pos, uint64_t & value);
 void     zipRead(buffer_t const & is, size_t & pos, uint32_t & value);
 void     zipRead(buffer_t const & is, size_t & pos, uint16_t & value);
 void     zipRead(buffer_t const & is, size_t & pos, uint8_t &  value);
 void     zipRead(buffer_t const & is, size_t & pos, buffer_t & buffer, ssize_t const count);
 void     zipRead(buffer_t const & is, size_t & pos, std::string & str, ssize_t const count);
 
+void     zipWrite(std::ostream & os, uint64_t const & value);
 void     zipWrite(std::ostream & os, uint32_t const & value);
 void     zipWrite(std::ostream & os, uint16_t const & value);
 void     zipWrite(std::ostream & os, uint8_t const &  value);
@@ -33,6 +33,8 @@
 
 #include "zipios_common.hpp"
 
+#include <algorithm>
+
 
 namespace zipios
 {
@@ -71,6 +73,25 @@ uint32_t const      g_signature = 0x04034b50;
 uint16_t const      g_trailing_data_descriptor = 1 << 3;
 
 
+/** \brief The header ID of the ZIP64 extended information extra field.
+ *
+ * When a size or offset does not fit in 32 bits, the headers save
+ * 0xFFFFFFFF in its place and the actual 64 bit value in an extra
+ * field with this ID.
+ *
+ * (see point 4.5.3 in doc/zip-format.txt)
+ */
+uint16_t const      g_zip64_extra_field_id = 0x0001;
+
+
+/** \brief The size of the fixed part of a local header.
+ *
+ * This is the size of the ZipLocalEntryHeader as found in a Zip
+ * archive, without the alignment padding of the structure.
+ */
+size_t const        g_fixed_header_size = 30;
+
+
 /** \brief ZipLocalEntry Header
  *
  * This structure shows how the header of the ZipLocalEntry is defined.
@@ -243,7 +264,8 @@ size_t ZipLocalEntry::getHeaderSize() const
     // not be portable so we use a hard coded value (yuck!)
     return 30 /* sizeof(ZipLocalEntryHeader) */
          + m_filename.length() + (m_is_directory ? 1 : 0)
-         + m_extra_field.size();
+         + m_extra_field.size()
+         + (m_zip64 ? 4 + sizeof(uint64_t) * 2 : 0);
 }
 
 
@@ -308,6 +330,66 @@ bool ZipLocalEntry::hasTrailingDataDescriptor() const
 }
 
 
+/** \brief Define whether a trailing data descriptor follows the data.
+ *
+ * When the data of an entry gets copied to another archive with its
+ * sizes and CRC32 already known, these are saved in the local header
+ * and the copy has no data descriptor. This function is used to clear
+ * the flag in that case.
+ *
+ * \param[in] trailing_data_descriptor  Whether the entry data is
+ *                                      followed by a data descriptor.
+ *
+ * \sa hasTrailingDataDescriptor()
+ */
+void ZipLocalEntry::setTrailingDataDescriptor(bool trailing_data_descriptor)
+{
+    if(trailing_data_descriptor)
+    {
+        m_general_purpose_bitfield |= g_trailing_data_descriptor;
+    }
+    else
+    {
+        m_general_purpose_bitfield &= ~g_trailing_data_descriptor;
+    }
+}
+
+
+/** \brief Check whether this entry gets written as a ZIP64 entry.
+ *
+ * This function returns true if setZip64() was called with true.
+ *
+ * \return true if the local header of this entry includes a ZIP64
+ *         extra field when written.
+ *
+ * \sa setZip64()
+ */
+bool ZipLocalEntry::isZip64() const
+{
+    return m_zip64;
+}
+
+
+/** \brief Mark this entry as a ZIP64 entry.
+ *
+ * The local header is written before the data of the entry, so before
+ * its sizes are known. When the sizes may not fit in 32 bits, the
+ * ZipOutputStreambuf calls this function so the local header gets
+ * written with a ZIP64 extra field in which the sizes can be saved
+ * once known.
+ *
+ * A ZIP64 entry requires version 4.5 to be extracted.
+ *
+ * \param[in] zip64  Whether the entry is a ZIP64 entry.
+ *
+ * \sa isZip64()
+ */
+void ZipLocalEntry::setZip64(bool zip64)
+{
+    m_zip64 = zip64;
+}
+
+
 /** \brief Read one local entry from \p is.
  *
  * This function verifies that the input stream starts with a local entry
@@ -319,6 +401,9 @@ bool ZipLocalEntry::hasTrailingDataDescriptor() const
  * If a read fails, the function throws an exception as defined in
  * the various zipRead() functions.
  *
+ * The header is loaded in memory and parsed with
+ * read(unsigned char const * buf, size_t size, size_t & pos).
+ *
  * \note
  * Some of the data found in the local entry on disk are not kept in
  * this class because there is nothing we can do with it.
@@ -329,17 +414,65 @@ void ZipLocalEntry::read(std::istream & is)
 {
     m_valid = false; // set to true upon successful completion.
 
-    //    // Before reading anything we record the position in the stream
-    //    // This is a field in the central directory entry, but not
-    //    // in the local entry. After all, we know where we are, anyway.
-    //    zlh.rel_offset_loc_head  = is.tellg() ;
+    // read the fixed size part of the header and, if it has the local
+    // header signature, the filename and extra field which follow
+    //
+    buffer_t header;
+    zipRead(is, header, g_fixed_header_size);
+    size_t pos(0);
+    uint32_t signature(0);
+    zipRead(header, pos, signature);
+    if(g_signature == signature)
+    {
+        uint16_t filename_len(0);
+        uint16_t extra_field_len(0);
+        pos = 26;
+        zipRead(header, pos, filename_len);
+        zipRead(header, pos, extra_field_len);
+        buffer_t variable;
+        zipRead(is, variable, filename_len + extra_field_len);
+        header.insert(header.end(), variable.begin(), variable.end());
+    }
+
+    // then parse the whole header from memory
+    //
+    pos = 0;
+    try
+    {
+        read(header.data(), header.size(), pos);
+    }
+    catch(IOException const &)
+    {
+        // put stream in error state
+        is.setstate(std::ios::failbit);
+        throw;
+    }
+}
+
+
+/** \brief Read one local entry from memory.
+ *
+ * This function reads the local entry from the \p size bytes found
+ * at \p buf, starting at position \p pos. On return, \p pos is the
+ * position of the first byte of data of this entry. It is also the
+ * parser of the read() function using an input stream.
+ *
+ * \exception IOException
+ * This exception is raised if the signature is not the local entry
+ * signature or the entry goes beyond the end of the buffer.
+ *
+ * \param[in] buf  A pointer to the Zip archive data.
+ * \param[in] size  The number of bytes available at \p buf.
+ * \param[in,out] pos  The position of the local entry in \p buf.
+ */
+void ZipLocalEntry::read(unsigned char const * buf, size_t size, size_t & pos)
+{
+    m_valid = false; // set to true upon successful completion.
 
     uint32_t signature(0);
-    zipRead(is, signature);                             // 32
+    zipRead(buf, size, pos, signature);                         // 32
     if(g_signature != signature)
     {
-        // put stream in error state and return
-        is.setstate(std::ios::failbit);
         throw IOException("ZipLocalEntry::read() expected a signature but got some other data");
     }
 
@@ -352,21 +485,17 @@ void ZipLocalEntry::read(std::istream & is)
     std::string filename;
 
     // See the ZipLocalEntryHeader for more details
-    zipRead(is, m_extract_version);                 // 16
-    zipRead(is, m_general_purpose_bitfield);        // 16
-    zipRead(is, compress_method);                   // 16
-    zipRead(is, dosdatetime);                       // 32
-    zipRead(is, m_crc_32);                          // 32
-    zipRead(is, compressed_size);                   // 32
-    zipRead(is, uncompressed_size);                 // 32
-    zipRead(is, filename_len);                      // 16
-    zipRead(is, extra_field_len);                   // 16
-    zipRead(is, filename, filename_len);            // string
-    zipRead(is, m_extra_field, extra_field_len);    // buffer
-    /** \todo add support for zip64, some of those parameters
-     *        may be 0xFFFFF...FFFF in which case the 64 bit
-     *        header should be read
-     */
+    zipRead(buf, size, pos, m_extract_version);                 // 16
+    zipRead(buf, size, pos, m_general_purpose_bitfield);        // 16
+    zipRead(buf, size, pos, compress_method);                   // 16
+    zipRead(buf, size, pos, dosdatetime);                       // 32
+    zipRead(buf, size, pos, m_crc_32);                          // 32
+    zipRead(buf, size, pos, compressed_size);                   // 32
+    zipRead(buf, size, pos, uncompressed_size);                 // 32
+    zipRead(buf, size, pos, filename_len);                      // 16
+    zipRead(buf, size, pos, extra_field_len);                   // 16
+    zipRead(buf, size, pos, filename, filename_len);            // string
+    zipRead(buf, size, pos, m_extra_field, extra_field_len);    // buffer
 
     // the FilePath() will remove the trailing slash so make sure
     // to defined the m_is_directory ahead of time!
@@ -380,10 +509,162 @@ void ZipLocalEntry::read(std::istream & is)
     m_uncompressed_size = uncompressed_size;
     m_filename = FilePath(filename);
 
+    readZip64ExtraField(true);
+
     m_valid = true;
 }
 
 
+/** \brief Read the 64 bit values from the ZIP64 extra field.
+ *
+ * When the compressed size, the uncompressed size, or the offset of
+ * an entry does not fit in 32 bits, the header has 0xFFFFFFFF in that
+ * field and the ZIP64 extended information extra field holds the 64 bit
+ * value. That extra field only includes the values that were replaced,
+ * always in this order: uncompressed size, compressed size, offset of
+ * the local header.
+ *
+ * In a local header, both sizes are present as soon as one of them
+ * does not fit in 32 bits and the offset is never present.
+ *
+ * This function is called by the read() functions once the 32 bit
+ * values were saved in the entry. The ZIP64 extra field is then
+ * removed from the extra field of the entry since write() generates
+ * a new one as required. A local header which had the field keeps it
+ * reserved (see setZip64()) so getHeaderSize() remains correct.
+ *
+ * \exception IOException
+ * This exception is raised if a field is 0xFFFFFFFF and the ZIP64
+ * extra field is missing or too small.
+ *
+ * \param[in] local_header  Whether the extra field comes from a local
+ *                          header (true) or a Central Directory entry.
+ */
+void ZipLocalEntry::readZip64ExtraField(bool local_header)
+{
+    bool uncompressed_size(m_uncompressed_size == g_zip64_escape);
+    bool compressed_size(m_compressed_size == g_zip64_escape);
+    bool const entry_offset(!local_header && m_entry_offset == static_cast<std::streamoff>(g_zip64_escape));
+    if(local_header && (uncompressed_size || compressed_size))
+    {
+        uncompressed_size = true;
+        compressed_size = true;
+    }
+
+    size_t pos(0);
+    while(pos + sizeof(uint16_t) * 2 <= m_extra_field.size())
+    {
+        size_t const start(pos);
+        uint16_t id(0);
+        uint16_t len(0);
+        zipRead(m_extra_field, pos, id);                        // 16
+        zipRead(m_extra_field, pos, len);                       // 16
+        if(id == g_zip64_extra_field_id)
+        {
+            // the values cannot go past the end of this extra field
+            //
+            size_t const end(std::min(pos + len, m_extra_field.size()));
+            uint64_t value(0);
+            if(uncompressed_size)
+            {
+                zipRead(m_extra_field.data(), end, pos, value); // 64
+                m_uncompressed_size = value;
+            }
+            if(compressed_size)
+            {
+                zipRead(m_extra_field.data(), end, pos, value); // 64
+                m_compressed_size = value;
+            }
+            if(entry_offset)
+            {
+                zipRead(m_extra_field.data(), end, pos, value); // 64
+                m_entry_offset = static_cast<std::streamoff>(value);
+            }
+
+            // write() generates a new ZIP64 extra field as required
+            // so we do not keep this one
+            //
+            m_extra_field.erase(m_extra_field.begin() + start, m_extra_field.begin() + end);
+            if(local_header)
+            {
+                m_zip64 = true;
+            }
+            return;
+        }
+        pos += len;
+    }
+
+    if(uncompressed_size || compressed_size || entry_offset)
+    {
+        throw IOException("ZipLocalEntry::readZip64ExtraField(): the ZIP64 extended information extra field is missing.");
+    }
+}
+
+
+/** \brief Generate the ZIP64 extra field to write with this entry.
+ *
+ * This function creates the ZIP64 extended information extra field
+ * to append to the extra field of this entry when it gets written.
+ *
+ * In a local header, the field is included with both sizes whenever
+ * the entry is marked as a ZIP64 entry (see setZip64()) since the
+ * space has to be reserved before the sizes are known. In the Central
+ * Directory, the field only includes the values that do not fit in
+ * 32 bits.
+ *
+ * \param[in] local_header  Whether the field is for the local header
+ *                          (true) or the Central Directory entry.
+ *
+ * \return The ZIP64 extra field or an empty buffer if not required.
+ */
+FileEntry::buffer_t ZipLocalEntry::getZip64ExtraField(bool local_header) const
+{
+    std::vector<uint64_t> values;
+    if(local_header)
+    {
+        if(m_zip64)
+        {
+            values.push_back(m_uncompressed_size);
+            values.push_back(m_compressed_size);
+        }
+    }
+    else
+    {
+        if(m_uncompressed_size >= g_zip64_escape)
+        {
+            values.push_back(m_uncompressed_size);
+        }
+        if(m_compressed_size >= g_zip64_escape)
+        {
+            values.push_back(m_compressed_size);
+        }
+        if(m_entry_offset >= static_cast<std::streamoff>(g_zip64_escape))
+        {
+            values.push_back(static_cast<std::streamoff>(m_entry_offset));
+        }
+    }
+
+    buffer_t result;
+    if(!values.empty())
+    {
+        uint16_t const len(static_cast<uint16_t>(values.size() * sizeof(uint64_t)));
+        result.push_back(static_cast<unsigned char>(g_zip64_extra_field_id >> 0));
+        result.push_back(static_cast<unsigned char>(g_zip64_extra_field_id >> 8));
+        result.push_back(static_cast<unsigned char>(len >> 0));
+        result.push_back(static_cast<unsigned char>(len >> 8));
+        for(auto it(values.begin()); it != values.end(); ++it)
+        {
+            for(int shift(0); shift < 64; shift += 8)
+            {
+                result.push_back(static_cast<unsigned char>(*it >> shift));
+            }
+        }
+    }
+
+    return result;
+}
+
+
 /** \brief Write a ZipLocalEntry to \p os.
  *
  * This function writes this ZipLocalEntry header to the specified
@@ -403,11 +684,12 @@ void ZipLocalEntry::write(std::ostream & os)
         throw InvalidStateException("ZipLocalEntry::write(): file name or extra field too large to save in a Zip file.");
     }
 
-    /** todo: add support for 64 bit zip archive
-     */
-#if INTPTR_MAX != INT32_MAX
-    if(m_compressed_size   >= 0x100000000UL
-    || m_uncompressed_size >= 0x100000000UL)
+    // sizes which do not fit in 32 bits can only be saved if the
+    // ZIP64 extra field was reserved when the header was first written
+    //
+    if(!m_zip64
+    && (m_compressed_size   >= g_zip64_escape
+     || m_uncompressed_size >= g_zip64_escape))
     {
         // these are really big files, we do not currently test such so ignore in coverage
         //
@@ -416,7 +698,12 @@ void ZipLocalEntry::write(std::ostream & os)
         //       is caught then if it was not out of bounds earlier.
         throw InvalidStateException("The size of this file is too large to fit in a 32 bit zip archive."); // LCOV_EXCL_LINE
     }
-#endif
+
+    buffer_t const zip64_extra_field(getZip64ExtraField(true));
+    if(m_extra_field.size() + zip64_extra_field.size() > 0xFFFF)
+    {
+        throw InvalidStateException("ZipLocalEntry::write(): file name or extra field too large to save in a Zip file.");
+    }
 
     std::string filename(m_filename);
     if(m_is_directory)
@@ -433,14 +720,15 @@ void ZipLocalEntry::write(std::ostream & os)
     DOSDateTime t;
     t.setUnixTimestamp(m_unix_time);
     std::uint32_t dosdatetime(t.getDOSDateTime());       // type could use DOSDateTime::dosdatetime_t
-    std::uint32_t compressed_size(m_compressed_size);
-    std::uint32_t uncompressed_size(m_uncompressed_size);
+    std::uint16_t extract_version(m_zip64 && m_extract_version < g_zip64_format_version ? g_zip64_format_version : m_extract_version);
+    std::uint32_t compressed_size(m_zip64 ? g_zip64_escape : m_compressed_size);
+    std::uint32_t uncompressed_size(m_zip64 ? g_zip64_escape : m_uncompressed_size);
     std::uint16_t filename_len(filename.length());
-    std::uint16_t extra_field_len(m_extra_field.size());
+    std::uint16_t extra_field_len(m_extra_field.size() + zip64_extra_field.size());
 
     // See the ZipLocalEntryHeader for more details
     zipWrite(os, g_signature);                  // 32
-    zipWrite(os, m_extract_version);            // 16
+    zipWrite(os, extract_version);              // 16
     zipWrite(os, m_general_purpose_bitfield);   // 16
     zipWrite(os, compress_method);              // 16
     zipWrite(os, dosdatetime);                  // 32
@@ -451,6 +739,7 @@ void ZipLocalEntry::write(std::ostream & os)
     zipWrite(os, extra_field_len);              // 16
     zipWrite(os, filename);                     // string
     zipWrite(os, m_extra_field);                // buffer
+    zipWrite(os, zip64_extra_field);            // buffer
 }
 
 
@@ -44,6 +44,8 @@ class ZipLocalEntry : public FileEntry
 public:
     // Zip file format version
     static uint16_t const       g_zip_format_version = 20; // 2.0
+    static uint16_t const       g_zip64_format_version = 45; // 4.5
+    static uint32_t const       g_zip64_escape = 0xFFFFFFFF;
 
                                 ZipLocalEntry();
                                 ZipLocalEntry(FileEntry const & src);
@@ -58,15 +60,23 @@ public:
     virtual void                setCrc(crc32_t crc) override;
 
     bool                        hasTrailingDataDescriptor() const;
+    bool                        isZip64() const;
+    void                        setTrailingDataDescriptor(bool trailing_data_descriptor);
+    void                        setZip64(bool zip64);
 
     virtual void                read(std::istream & is) override;
+    void                        read(unsigned char const * buf, size_t size, size_t & pos);
     virtual void                write(std::ostream & os) override;
 
 protected:
+    void                        readZip64ExtraField(bool local_header);
+    buffer_t                    getZip64ExtraField(bool local_header) const;
+
     uint16_t                    m_extract_version = g_zip_format_version;
     uint16_t                    m_general_purpose_bitfield = 0;
     bool                        m_is_directory = false;
     size_t                      m_compressed_size = 0;
+    bool                        m_zip64 = false;
 };
 
 
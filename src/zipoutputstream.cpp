@@ -29,6 +29,8 @@
 #include "zipoutputstream.hpp"
 #include "zipcentraldirectoryentry.hpp"
 
+#include "zipios/zipiosexceptions.hpp"
+
 #include <fstream>
 
 
@@ -140,6 +142,62 @@ void ZipOutputStream::putNextEntry(FileEntry::pointer_t entry)
 }
 
 
+/** \brief Copy an entry from another archive.
+ *
+ * This function copies \p entry of the \p source archive to the output
+ * stream without decompressing and compressing its data again. The
+ * compressed data is copied as is and the CRC32 and sizes of the entry
+ * are reused.
+ *
+ * The entry is copied so the offset of \p entry in \p source does not
+ * change.
+ *
+ * The data is found using the offset of \p entry in \p source, not its
+ * name, so archives with several entries of the same name get copied
+ * as expected. \p entry must be one of the entries of \p source.
+ *
+ * This makes merging and filtering archives limited by I/O instead
+ * of zlib.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if \p entry was not read from \p source or
+ * its data cannot be read from the archive file.
+ *
+ * \param[in,out] source  The archive in which \p entry is found.
+ * \param[in] entry  The entry to copy.
+ */
+void ZipOutputStream::putRawEntry(ZipFile & source, FileEntry::pointer_t entry)
+{
+    FileCollection::stream_pointer_t is(source.getRawInputStream(*entry));
+
+    FileEntry::pointer_t copy(entry->clone());
+    if(dynamic_cast<ZipCentralDirectoryEntry *>(copy.get()) == nullptr)
+    {
+        copy = std::make_shared<ZipCentralDirectoryEntry>(*entry);
+    }
+
+    m_ozf->putRawEntry(copy, *is);
+}
+
+
+/** \brief Add an entry which was already compressed.
+ *
+ * This function saves \p entry with \p data as its compressed data.
+ * The CRC32 and sizes of \p entry must already be set. The entry must
+ * be a ZipCentralDirectoryEntry since it is saved as is.
+ *
+ * \param[in] entry  The entry to add to the output stream.
+ * \param[in] data  The compressed data of the entry.
+ * \param[in] size  The size of \p data.
+ *
+ * \sa ZipOutputStreambuf::putCompressedEntry()
+ */
+void ZipOutputStream::putCompressedEntry(FileEntry::pointer_t entry, char const * data, std::size_t size)
+{
+    m_ozf->putCompressedEntry(entry, data, size);
+}
+
+
 /** \brief Set the global comment.
  *
  * This function is used to setup the Global Comment of the Zip archive
@@ -156,6 +214,21 @@ void ZipOutputStream::setComment(std::string const & comment)
 }
 
 
+/** \brief Compress large entries with multiple threads.
+ *
+ * The entries saved with putNextEntry() which are larger than
+ * \p block_size get compressed in blocks, \p threads blocks at a time.
+ * See ZipOutputStreambuf::setParallelDeflate().
+ *
+ * \param[in] threads  The number of threads, 0 or 1 to turn the feature off.
+ * \param[in] block_size  The size of one block.
+ */
+void ZipOutputStream::setParallelDeflate(std::size_t threads, std::size_t block_size)
+{
+    m_ozf->setParallelDeflate(threads, block_size);
+}
+
+
 } // zipios namespace
 
 // Local Variables:
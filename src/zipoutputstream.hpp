@@ -32,6 +32,8 @@
 
 #include "zipoutputstreambuf.hpp"
 
+#include "zipios/zipfile.hpp"
+
 
 namespace zipios
 {
@@ -48,7 +50,10 @@ public:
     void            close();
     void            finish();
     void            putNextEntry(FileEntry::pointer_t entry);
+    void            putRawEntry(ZipFile & source, FileEntry::pointer_t entry);
+    void            putCompressedEntry(FileEntry::pointer_t entry, char const * data, std::size_t size);
     void            setComment(std::string const & comment);
+    void            setParallelDeflate(std::size_t threads, std::size_t block_size);
 
 private:
     std::unique_ptr<ZipOutputStreambuf> m_ozf = std::unique_ptr<ZipOutputStreambuf>();
@@ -30,9 +30,12 @@
 
 #include "zipios/zipiosexceptions.hpp"
 
+#include "crc32.hpp"
 #include "ziplocalentry.hpp"
 #include "zipendofcentraldirectory.hpp"
 
+#include <algorithm>
+
 
 namespace zipios
 {
@@ -42,6 +45,39 @@ namespace
 {
 
 
+/** \brief Size from which an entry gets written as a ZIP64 entry.
+ *
+ * The local header of an entry is written before its data so when
+ * the size of the entry is expected to be close to 4Gb or more, the
+ * ZIP64 extra field gets reserved in that header. The threshold is a
+ * little under 4Gb since the compressed data can be slightly larger
+ * than the uncompressed data.
+ */
+std::size_t const g_zip64_size_threshold = 0xFF000000;
+
+
+/** \brief Check whether the local header needs a ZIP64 extra field.
+ *
+ * The ZIP64 extra field gets reserved in the local header when the
+ * entry starts past 4Gb or its size hint is close to 4Gb or more.
+ *
+ * An entry without a size hint (i.e. getSize() returns 0), such as a
+ * StreamEntry created from a stream which cannot seek, may grow to any
+ * size while its data gets written, so the field is reserved for it
+ * too. Directories never have data so they are not affected.
+ *
+ * \param[in] entry  The entry about to be saved.
+ *
+ * \return true if the ZIP64 extra field has to be reserved.
+ */
+bool need_zip64_extra_field(FileEntry const & entry)
+{
+    return entry.getEntryOffset() >= static_cast<std::streamoff>(ZipLocalEntry::g_zip64_escape)
+        || entry.getSize() >= g_zip64_size_threshold
+        || (entry.getSize() == 0 && !entry.isDirectory());
+}
+
+
 /** \brief Helper function used to write the central directory.
  *
  * When you create a Zip archive, it includes a central directory where
@@ -193,6 +229,13 @@ void ZipOutputStreambuf::finish()
  * If a previous entry was still open, the function calls closeEntry()
  * first.
  *
+ * The local header is written before the data, so the ZIP64 extra
+ * field is reserved if the size of \p entry (as returned by getSize())
+ * is close to 4Gb or more, if the entry has no size at all (a streamed
+ * entry), or if the entry starts past 4Gb. An entry with a size hint
+ * which ends up larger than 4Gb makes closeEntry() throw an
+ * InvalidStateException.
+ *
  * \param[in] entry  The entry to be saved and made current.
  */
 void ZipOutputStreambuf::putNextEntry(FileEntry::pointer_t entry)
@@ -219,6 +262,11 @@ void ZipOutputStreambuf::putNextEntry(FileEntry::pointer_t entry)
 
     default:
         init(m_compression_level);
+        if(m_deflate_threads > 1
+        && entry->getSize() > m_deflate_block_size)
+        {
+            setParallel(m_deflate_threads, m_deflate_block_size);
+        }
         break;
 
     }
@@ -229,16 +277,125 @@ void ZipOutputStreambuf::putNextEntry(FileEntry::pointer_t entry)
 
     // Update entry header info
     entry->setEntryOffset(os.tellp());
+
+    // reserve the ZIP64 extra field in the local header if the sizes
+    // or the offset may not fit in 32 bits
+    //
+    ZipLocalEntry * local_entry(static_cast<ZipLocalEntry *>(entry.get()));
+    if(need_zip64_extra_field(*entry))
+    {
+        local_entry->setZip64(true);
+    }
+
     /** \TODO
      * Rethink the design as we have to force a call to the correct
      * write() function?
      */
-    static_cast<ZipLocalEntry *>(entry.get())->ZipLocalEntry::write(os);
+    local_entry->ZipLocalEntry::write(os);
 
     m_open_entry = true;
 }
 
 
+/** \brief Save an entry with its already compressed data.
+ *
+ * This function writes the local header of \p entry followed by the
+ * data read from \p is, which must be the data of the entry exactly
+ * as saved in another archive (see ZipFile::getRawInputStream()).
+ * The data is not compressed again. The CRC32 and sizes of \p entry
+ * must already be correct, they are saved as is.
+ *
+ * Since the sizes are known, the local header does not need to be
+ * rewritten and the entry never uses a trailing data descriptor.
+ *
+ * If an entry was still open, the function calls closeEntry() first.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if \p is ends before the compressed size
+ * of the entry was copied.
+ *
+ * \exception IOException
+ * This exception is raised if writing the data fails.
+ *
+ * \param[in] entry  The entry to save, it gets added to the Central
+ *                   Directory as is.
+ * \param[in,out] is  The stream with the compressed data of the entry.
+ */
+void ZipOutputStreambuf::putRawEntry(FileEntry::pointer_t entry, std::istream & is)
+{
+    closeEntry();
+
+    std::ostream os(m_outbuf);
+    entry->setEntryOffset(os.tellp());
+
+    ZipLocalEntry * local_entry(static_cast<ZipLocalEntry *>(entry.get()));
+    local_entry->setZip64(entry->getEntryOffset() >= static_cast<std::streamoff>(ZipLocalEntry::g_zip64_escape)
+                       || entry->getSize() >= ZipLocalEntry::g_zip64_escape
+                       || entry->getCompressedSize() >= ZipLocalEntry::g_zip64_escape);
+    local_entry->setTrailingDataDescriptor(false);
+    local_entry->ZipLocalEntry::write(os);
+
+    std::size_t remaining(entry->getCompressedSize());
+    while(remaining > 0)
+    {
+        std::size_t const size(std::min(remaining, m_invec.size()));
+        is.read(&m_invec[0], static_cast<std::streamsize>(size));
+        if(static_cast<std::size_t>(is.gcount()) != size)
+        {
+            throw FileCollectionException("ZipOutputStreambuf::putRawEntry(): the compressed data of the entry is truncated.");
+        }
+        if(m_outbuf->sputn(&m_invec[0], size) != static_cast<std::streamsize>(size))
+        {
+            throw IOException("ZipOutputStreambuf::putRawEntry(): write to buffer failed."); // LCOV_EXCL_LINE
+        }
+        remaining -= size;
+    }
+
+    m_entries.push_back(entry);
+}
+
+
+/** \brief Save an entry compressed by the caller.
+ *
+ * This function writes the local header of \p entry followed by
+ * \p data. The caller is expected to have compressed the data exactly
+ * as putNextEntry() followed by closeEntry() would, and to have set
+ * the CRC32 and sizes of \p entry. The ZIP64 extra field is reserved
+ * with the same rules as in putNextEntry() so the output is the same
+ * as if the entry had been compressed by this streambuf.
+ *
+ * This is used to compress multiple entries in parallel.
+ *
+ * \exception IOException
+ * This exception is raised if writing the data fails.
+ *
+ * \param[in] entry  The entry to save.
+ * \param[in] data  The compressed data of the entry.
+ * \param[in] size  The size of \p data.
+ */
+void ZipOutputStreambuf::putCompressedEntry(FileEntry::pointer_t entry, char const * data, std::size_t size)
+{
+    closeEntry();
+
+    std::ostream os(m_outbuf);
+    entry->setEntryOffset(os.tellp());
+
+    ZipLocalEntry * local_entry(static_cast<ZipLocalEntry *>(entry.get()));
+    if(need_zip64_extra_field(*entry))
+    {
+        local_entry->setZip64(true);
+    }
+    local_entry->ZipLocalEntry::write(os);
+
+    if(m_outbuf->sputn(data, static_cast<std::streamsize>(size)) != static_cast<std::streamsize>(size))
+    {
+        throw IOException("ZipOutputStreambuf::putCompressedEntry(): write to buffer failed."); // LCOV_EXCL_LINE
+    }
+
+    m_entries.push_back(entry);
+}
+
+
 /** \brief Set the archive comment.
  *
  * This function saves a global comment for the Zip archive.
@@ -261,6 +418,26 @@ void ZipOutputStreambuf::setComment(std::string const & comment)
 // Protected and private methods
 //
 
+/** \brief Compress large entries with multiple threads.
+ *
+ * This function makes putNextEntry() compress the data of the DEFLATED
+ * entries larger than \p block_size in blocks of \p block_size bytes,
+ * with up to \p threads blocks compressed in parallel. See
+ * DeflateOutputStreambuf::setParallel() for details.
+ *
+ * The data of such entries differs from the data compressed by a single
+ * thread, but it remains one valid deflate stream.
+ *
+ * \param[in] threads  The number of threads, 0 or 1 to turn the feature off.
+ * \param[in] block_size  The size of one block.
+ */
+void ZipOutputStreambuf::setParallelDeflate(std::size_t threads, std::size_t block_size)
+{
+    m_deflate_threads = threads;
+    m_deflate_block_size = block_size;
+}
+
+
 /** \brief Implementation of the overflow() function.
  *
  * When writing to a buffer, the overflow() function gets called when
@@ -277,15 +454,16 @@ void ZipOutputStreambuf::setComment(std::string const & comment)
  */
 int ZipOutputStreambuf::overflow(int c)
 {
-    std::size_t const size(pptr() - pbase());
-    m_overflown_bytes += size;
     switch(m_compression_level)
     {
     case FileEntry::COMPRESSION_LEVEL_NONE:
     {
+        std::size_t const size(pptr() - pbase());
+        m_overflown_bytes += size;
+
         // Ok, we are STORED, so we handle it ourselves to avoid "side
         // effects" from zlib, which adds markers every now and then.
-        m_crc32 = crc32(m_crc32, reinterpret_cast<Bytef const *>(&m_invec[0]), size); // update crc32
+        m_crc32 = CRC32::update(m_crc32, &m_invec[0], size); // update crc32
         size_t const bc(m_outbuf->sputn(&m_invec[0], size));
         if(size != bc)
         {
@@ -337,7 +515,7 @@ int ZipOutputStreambuf::sync() // LCOV_EXCL_LINE
 void ZipOutputStreambuf::setEntryClosedState()
 {
     m_open_entry = false;
-    m_crc32 = crc32(0, nullptr, 0);
+    m_crc32 = 0;
 
     /** \FIXME
      * Update put pointers to trigger overflow on write. Overflow
@@ -365,7 +543,7 @@ void ZipOutputStreambuf::updateEntryHeaderInfo()
     }
 
     std::ostream os(m_outbuf);
-    int const curr_pos(os.tellp());
+    std::streamoff const curr_pos(os.tellp());
 
     // update fields in m_entries.back()
     FileEntry::pointer_t entry(m_entries.back());
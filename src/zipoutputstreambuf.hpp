@@ -51,7 +51,10 @@ public:
     void                        close();
     void                        finish();
     void                        putNextEntry(FileEntry::pointer_t entry);
+    void                        putRawEntry(FileEntry::pointer_t entry, std::istream & is);
+    void                        putCompressedEntry(FileEntry::pointer_t entry, char const * data, std::size_t size);
     void                        setComment(std::string const & comment);
+    void                        setParallelDeflate(std::size_t threads, std::size_t block_size);
 
 protected:
     virtual int                 overflow(int c = EOF) override;
@@ -66,6 +69,8 @@ private:
     FileEntry::CompressionLevel m_compression_level = FileEntry::COMPRESSION_LEVEL_DEFAULT;
     bool                        m_open_entry = false;
     bool                        m_open = true;
+    std::size_t                 m_deflate_threads = 0;
+    std::size_t                 m_deflate_block_size = 0;
 };
 
 
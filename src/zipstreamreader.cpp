@@ -0,0 +1,160 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::ZipStreamReader.
+ *
+ * This file includes the implementation of the zipios::ZipStreamReader
+ * class which reads a Zip archive from a stream which cannot seek.
+ */
+
+#include "zipios/zipstreamreader.hpp"
+
+#include "zipstreamreaderstreambuf.hpp"
+
+
+namespace zipios
+{
+
+
+/** \class ZipStreamReader
+ * \brief Read a Zip archive in a single forward pass.
+ *
+ * The ZipFile class requires a seekable file since it first reads the
+ * Central Directory found at the end of the archive. The
+ * ZipStreamReader reads the local headers and the data of the entries
+ * in order instead so it works with pipes and sockets. It uses no disk
+ * space and a constant amount of memory.
+ *
+ * \code
+ *      zipios::ZipStreamReader reader(std::cin);
+ *      for(;;)
+ *      {
+ *          zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+ *          if(entry == nullptr)
+ *          {
+ *              break;
+ *          }
+ *          std::istream & is(reader.getInputStream());
+ *          ...read the data of entry from is...
+ *      }
+ * \endcode
+ *
+ * Since the Central Directory is not read, the entries only include
+ * the information found in the local headers. Entries with a trailing
+ * data descriptor (general purpose bit 3) are supported when DEFLATED.
+ * Their CRC32 and sizes are only known once their data was read.
+ *
+ * The data of each entry gets verified against its CRC32 and sizes.
+ * Errors are reported with a FileCollectionException. The input stream
+ * returned by getInputStream() rethrows them only if badbit exceptions
+ * are enabled on it; otherwise its badbit gets set.
+ */
+
+
+/** \brief Initialize a ZipStreamReader.
+ *
+ * The reader uses the streambuf of \p is. The stream must remain valid
+ * for the lifetime of the reader.
+ *
+ * \param[in,out] is  The stream to read the Zip archive from.
+ */
+ZipStreamReader::ZipStreamReader(std::istream & is)
+    : m_streambuf(std::make_unique<ZipStreamReaderStreambuf>(is.rdbuf()))
+    , m_istream(std::make_unique<std::istream>(m_streambuf.get()))
+{
+}
+
+
+/** \fn ZipStreamReader::ZipStreamReader(ZipStreamReader const & rhs);
+ * \brief The copy constructor is deleted.
+ *
+ * A ZipStreamReader cannot be copied.
+ *
+ * \param[in] rhs  The source to copy.
+ */
+
+
+/** \fn ZipStreamReader & ZipStreamReader::operator = (ZipStreamReader const & rhs);
+ * \brief The assignment operator is deleted.
+ *
+ * A ZipStreamReader cannot be copied.
+ *
+ * \param[in] rhs  The source to copy.
+ *
+ * \return A reference to this object.
+ */
+
+
+/** \brief Clean up the ZipStreamReader.
+ *
+ * The destructor is defined here since the streambuf is an internal
+ * class.
+ */
+ZipStreamReader::~ZipStreamReader()
+{
+}
+
+
+/** \brief Move to the next entry.
+ *
+ * This function skips the data of the current entry that was not yet
+ * read and reads the local header of the next entry.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the archive is invalid, if the entry
+ * uses an unsupported compression method or if the data of the
+ * previous entry does not match its CRC32 or sizes.
+ *
+ * \return The next entry or nullptr once all the entries were read.
+ */
+FileEntry::pointer_t ZipStreamReader::getNextEntry()
+{
+    m_istream->clear();
+    return m_streambuf->nextEntry();
+}
+
+
+/** \brief Retrieve the input stream of the current entry.
+ *
+ * The returned stream reads the uncompressed data of the entry last
+ * returned by getNextEntry(). It reaches EOF at the end of the data
+ * of that entry.
+ *
+ * \return A reference to the input stream of the current entry.
+ */
+std::istream & ZipStreamReader::getInputStream()
+{
+    return *m_istream;
+}
+
+
+} // zipios namespace
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
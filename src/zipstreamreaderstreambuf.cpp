@@ -0,0 +1,496 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Implementation of zipios::ZipStreamReaderStreambuf.
+ *
+ * This file includes the implementation of the streambuf used to read
+ * the entries of a Zip archive from a stream which cannot seek.
+ */
+
+#include "zipstreamreaderstreambuf.hpp"
+
+#include "zipios/zipiosexceptions.hpp"
+
+#include "crc32.hpp"
+#include "streampool.hpp"
+
+#include <algorithm>
+
+
+namespace zipios
+{
+
+
+namespace
+{
+
+/** \brief The signatures which may follow the last local entry.
+ *
+ * Once all the local entries were read, the archive continues with
+ * the Central Directory. If the archive has no entries, the End of
+ * Central Directory appears instead, possibly preceeded by its
+ * Zip64 version.
+ */
+uint32_t const      g_local_header_signature = 0x04034b50;
+uint32_t const      g_central_directory_signature = 0x02014b50;
+uint32_t const      g_end_of_central_directory_signature = 0x06054b50;
+uint32_t const      g_zip64_end_of_central_directory_signature = 0x06064b50;
+uint32_t const      g_data_descriptor_signature = 0x08074b50;
+
+std::size_t const   g_local_header_size = 30;
+uint16_t const      g_trailing_data_descriptor = 1 << 3;
+uint16_t const      g_zip64_extra_field_id = 0x0001;
+
+
+/** \brief Decode a little endian number from a buffer.
+ *
+ * \param[in] buf  The buffer with the number.
+ * \param[in] size  The number of bytes to decode (2, 4 or 8).
+ *
+ * \return The decoded number.
+ */
+uint64_t decode(unsigned char const * buf, std::size_t size)
+{
+    uint64_t value(0);
+    for(std::size_t idx(size); idx > 0; --idx)
+    {
+        value = (value << 8) | buf[idx - 1];
+    }
+    return value;
+}
+
+
+/** \brief Check whether an extra field includes a Zip64 field.
+ *
+ * When the local header includes a Zip64 extended information extra
+ * field, the data descriptor uses 64 bit sizes.
+ *
+ * \param[in] buf  The extra field buffer.
+ * \param[in] size  The size of the extra field.
+ *
+ * \return true if the extra field includes a Zip64 field.
+ */
+bool has_zip64_extra_field(unsigned char const * buf, std::size_t size)
+{
+    std::size_t pos(0);
+    while(pos + 4 <= size)
+    {
+        if(decode(buf + pos, 2) == g_zip64_extra_field_id)
+        {
+            return true;
+        }
+        pos += 4 + decode(buf + pos + 2, 2);
+    }
+    return false;
+}
+
+
+} // no name namespace
+
+
+
+/** \class ZipStreamReaderStreambuf
+ * \brief A streambuf reading a Zip archive in a single forward pass.
+ *
+ * The ZipStreamReaderStreambuf reads the local headers and the data
+ * of the entries of a Zip archive one after the other. It never seeks
+ * so it can be used with pipes and sockets. The Central Directory is
+ * never read: the first signature which is not a local header marks
+ * the end of the archive.
+ *
+ * An entry with the general purpose bit 3 set has its CRC32 and
+ * sizes saved in a data descriptor after its data. This is only
+ * supported for DEFLATED entries since the end of a STORED entry
+ * cannot be found without knowing its size. Once the data of such
+ * an entry was read, the entry gets updated with the values of the
+ * data descriptor.
+ *
+ * The memory used is constant: one input and one output buffer and
+ * a zlib stream, all of which come from the StreamPool.
+ */
+
+
+/** \brief Initialize a ZipStreamReaderStreambuf.
+ *
+ * The constructor prepares the buffers. No data gets read until
+ * nextEntry() gets called.
+ *
+ * \param[in,out] inbuf  The streambuf to read the archive from.
+ */
+ZipStreamReaderStreambuf::ZipStreamReaderStreambuf(std::streambuf * inbuf)
+    : FilterInputStreambuf(inbuf)
+    , m_invec(StreamPool::acquireBuffer())
+    , m_outvec(StreamPool::acquireBuffer())
+    , m_zs(StreamPool::acquireInflate())
+{
+    m_in_ptr = m_invec.data();
+    setg(m_outvec.data(), m_outvec.data(), m_outvec.data());
+}
+
+
+/** \brief Clean up the ZipStreamReaderStreambuf.
+ *
+ * The buffers and the zlib stream are returned to the StreamPool.
+ */
+ZipStreamReaderStreambuf::~ZipStreamReaderStreambuf()
+{
+    StreamPool::releaseInflate(m_zs);
+    StreamPool::releaseBuffer(m_outvec);
+    StreamPool::releaseBuffer(m_invec);
+}
+
+
+/** \brief Move to the next entry.
+ *
+ * This function skips whatever remains of the data of the current
+ * entry and reads the local header of the next entry.
+ *
+ * The returned entry is also updated when its data is done being read
+ * if it has a trailing data descriptor.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the archive is not valid, if the entry
+ * uses an unsupported compression method, or if the data of the
+ * current entry does not match its header or data descriptor.
+ *
+ * \return The next entry or nullptr once the end of the entries is
+ *         reached.
+ */
+FileEntry::pointer_t ZipStreamReaderStreambuf::nextEntry()
+{
+    // skip the remainder of the current entry, this still verifies
+    // its CRC32
+    //
+    while(!m_end_of_data)
+    {
+        setg(egptr(), egptr(), egptr());
+        underflow();
+    }
+    setg(m_outvec.data(), m_outvec.data(), m_outvec.data());
+
+    if(m_end_of_archive)
+    {
+        return FileEntry::pointer_t();
+    }
+
+    std::size_t const offset(m_position - m_in_avail);
+    std::vector<unsigned char> header(g_local_header_size);
+    std::size_t const sz(readRaw(header.data(), 4));
+    if(sz == 0)
+    {
+        // a stream with no Central Directory, accept as is
+        //
+        m_end_of_archive = true;
+        return FileEntry::pointer_t();
+    }
+    if(sz != 4)
+    {
+        throw FileCollectionException("ZipStreamReaderStreambuf::nextEntry(): premature end of the Zip archive.");
+    }
+    uint32_t const signature(static_cast<uint32_t>(decode(header.data(), 4)));
+    if(signature == g_central_directory_signature
+    || signature == g_end_of_central_directory_signature
+    || signature == g_zip64_end_of_central_directory_signature)
+    {
+        m_end_of_archive = true;
+        return FileEntry::pointer_t();
+    }
+    if(signature != g_local_header_signature)
+    {
+        throw FileCollectionException("ZipStreamReaderStreambuf::nextEntry(): expected a local header signature.");
+    }
+
+    if(readRaw(header.data() + 4, g_local_header_size - 4) != g_local_header_size - 4)
+    {
+        throw FileCollectionException("ZipStreamReaderStreambuf::nextEntry(): premature end of the Zip archive.");
+    }
+    std::size_t const filename_len(decode(header.data() + 26, 2));
+    std::size_t const extra_field_len(decode(header.data() + 28, 2));
+    header.resize(g_local_header_size + filename_len + extra_field_len);
+    if(readRaw(header.data() + g_local_header_size, filename_len + extra_field_len) != filename_len + extra_field_len)
+    {
+        throw FileCollectionException("ZipStreamReaderStreambuf::nextEntry(): premature end of the Zip archive.");
+    }
+
+    m_entry = std::make_shared<ZipLocalEntry>();
+    std::size_t pos(0);
+    m_entry->read(header.data(), header.size(), pos);
+    m_entry->setEntryOffset(offset);
+    m_entry->setZip64(has_zip64_extra_field(header.data() + g_local_header_size + filename_len, extra_field_len));
+
+    m_end_of_data = false;
+    m_crc32 = 0;
+    m_size = 0;
+    m_compressed_size = 0;
+    switch(m_entry->getMethod())
+    {
+    case StorageMethod::STORED:
+        if(m_entry->hasTrailingDataDescriptor())
+        {
+            throw FileCollectionException("ZipStreamReaderStreambuf::nextEntry(): a STORED entry with a trailing data descriptor cannot be read from a stream.");
+        }
+        m_remain = m_entry->getSize();
+        break;
+
+    case StorageMethod::DEFLATED:
+        inflateReset(m_zs);
+        if(!m_entry->hasTrailingDataDescriptor()
+        && m_entry->getCompressedSize() == 0)
+        {
+            // an empty entry may have no deflate data at all
+            //
+            endOfData();
+        }
+        break;
+
+    default:
+        throw FileCollectionException("ZipStreamReaderStreambuf::nextEntry(): unsupported compression format.");
+
+    }
+
+    return m_entry;
+}
+
+
+/** \brief Read the next block of data of the current entry.
+ *
+ * For STORED entries, the get area points directly to the input
+ * buffer. For DEFLATED entries, the data gets inflated in the
+ * output buffer.
+ *
+ * When the end of the data is reached, the data descriptor, if any,
+ * is read and the data gets verified.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the archive ends prematurely, if the
+ * deflated data is invalid, or if the data does not match the header
+ * or data descriptor of the entry.
+ *
+ * \return The next character or EOF at the end of the entry data.
+ */
+std::streambuf::int_type ZipStreamReaderStreambuf::underflow()
+{
+    if(gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr());
+    }
+    if(m_end_of_data)
+    {
+        return traits_type::eof();
+    }
+
+    switch(m_entry->getMethod())
+    {
+    case StorageMethod::STORED:
+    {
+        if(m_remain == 0)
+        {
+            endOfData();
+            return traits_type::eof();
+        }
+        if(m_in_avail == 0
+        && !fill())
+        {
+            throw FileCollectionException("ZipStreamReaderStreambuf::underflow(): premature end of the Zip archive.");
+        }
+        std::size_t const size(std::min(m_remain, m_in_avail));
+        setg(m_in_ptr, m_in_ptr, m_in_ptr + size);
+        m_in_ptr += size;
+        m_in_avail -= size;
+        m_remain -= size;
+        m_crc32 = CRC32::update(m_crc32, eback(), size);
+        m_size += size;
+        return traits_type::to_int_type(*gptr());
+    }
+
+    case StorageMethod::DEFLATED:
+    {
+        m_zs->next_out = reinterpret_cast<Bytef *>(m_outvec.data());
+        m_zs->avail_out = static_cast<uInt>(m_outvec.size());
+        bool stream_end(false);
+        while(m_zs->avail_out == m_outvec.size())
+        {
+            if(m_in_avail == 0
+            && !fill())
+            {
+                throw FileCollectionException("ZipStreamReaderStreambuf::underflow(): premature end of the Zip archive.");
+            }
+            m_zs->next_in = reinterpret_cast<Bytef *>(m_in_ptr);
+            m_zs->avail_in = static_cast<uInt>(m_in_avail);
+            int const err(inflate(m_zs, Z_NO_FLUSH));
+            std::size_t const used(m_in_avail - m_zs->avail_in);
+            m_in_ptr += used;
+            m_in_avail -= used;
+            m_compressed_size += used;
+            if(err == Z_STREAM_END)
+            {
+                stream_end = true;
+                break;
+            }
+            if(err != Z_OK)
+            {
+                throw FileCollectionException(std::string("ZipStreamReaderStreambuf::underflow(): inflate() failed: ") + zError(err));
+            }
+        }
+        std::size_t const size(m_outvec.size() - m_zs->avail_out);
+        setg(m_outvec.data(), m_outvec.data(), m_outvec.data() + size);
+        m_crc32 = CRC32::update(m_crc32, m_outvec.data(), size);
+        m_size += size;
+        if(stream_end)
+        {
+            endOfData();
+        }
+        if(size == 0)
+        {
+            return traits_type::eof();
+        }
+        return traits_type::to_int_type(*gptr());
+    }
+
+    default: // LCOV_EXCL_LINE
+        throw std::logic_error("ZipStreamReaderStreambuf::underflow(): unknown storage method"); // LCOV_EXCL_LINE
+
+    }
+}
+
+
+/** \brief Read more data in the input buffer.
+ *
+ * This function reads the next block of data from the input streambuf.
+ * It must only be called once the input buffer is empty.
+ *
+ * \return true if some data was read, false at the end of the input.
+ */
+bool ZipStreamReaderStreambuf::fill()
+{
+    std::streamsize const size(m_inbuf->sgetn(m_invec.data(), static_cast<std::streamsize>(m_invec.size())));
+    m_in_ptr = m_invec.data();
+    m_in_avail = size > 0 ? static_cast<std::size_t>(size) : 0;
+    m_position += m_in_avail;
+    return m_in_avail > 0;
+}
+
+
+/** \brief Read raw bytes from the input.
+ *
+ * This function copies \p size bytes from the input to \p buf. It
+ * is used to read the headers and data descriptors.
+ *
+ * \param[out] buf  The buffer where the data gets saved.
+ * \param[in] size  The number of bytes to read.
+ *
+ * \return The number of bytes read, less than \p size only at the end
+ *         of the input.
+ */
+std::size_t ZipStreamReaderStreambuf::readRaw(void * buf, std::size_t size)
+{
+    char * out(static_cast<char *>(buf));
+    std::size_t total(0);
+    while(total < size)
+    {
+        if(m_in_avail == 0
+        && !fill())
+        {
+            break;
+        }
+        std::size_t const sz(std::min(size - total, m_in_avail));
+        std::copy(m_in_ptr, m_in_ptr + sz, out + total);
+        m_in_ptr += sz;
+        m_in_avail -= sz;
+        total += sz;
+    }
+    return total;
+}
+
+
+/** \brief Handle the end of the data of the current entry.
+ *
+ * If the entry has a trailing data descriptor, it gets read and the
+ * entry gets updated with its CRC32 and sizes. The descriptor
+ * signature is optional.
+ *
+ * Then the CRC32 and sizes of the data read are verified.
+ *
+ * \exception FileCollectionException
+ * This exception is raised if the data descriptor is truncated or if
+ * the data does not match the entry.
+ */
+void ZipStreamReaderStreambuf::endOfData()
+{
+    m_end_of_data = true;
+
+    if(m_entry->hasTrailingDataDescriptor())
+    {
+        std::size_t const size_width(m_entry->isZip64() ? 8 : 4);
+        unsigned char descriptor[4 + 4 + 8 + 8];
+        std::size_t size(4 + 4 + size_width * 2);
+        if(readRaw(descriptor, 4) != 4)
+        {
+            throw FileCollectionException("ZipStreamReaderStreambuf::endOfData(): premature end of the Zip archive.");
+        }
+        std::size_t pos(0);
+        if(decode(descriptor, 4) == g_data_descriptor_signature)
+        {
+            pos = 4;
+        }
+        else
+        {
+            // no signature, the first 4 bytes are the CRC32
+            //
+            size -= 4;
+        }
+        if(readRaw(descriptor + 4, size - 4) != size - 4)
+        {
+            throw FileCollectionException("ZipStreamReaderStreambuf::endOfData(): premature end of the Zip archive.");
+        }
+        m_entry->setCrc(static_cast<FileEntry::crc32_t>(decode(descriptor + pos, 4)));
+        m_entry->setCompressedSize(decode(descriptor + pos + 4, size_width));
+        m_entry->setSize(decode(descriptor + pos + 4 + size_width, size_width));
+    }
+
+    if(m_size != m_entry->getSize())
+    {
+        throw FileCollectionException("Zip file consistency problem. The size of the entry data does not match its header.");
+    }
+    if(m_entry->getMethod() == StorageMethod::DEFLATED
+    && m_compressed_size != m_entry->getCompressedSize())
+    {
+        throw FileCollectionException("Zip file consistency problem. The compressed size of the entry data does not match its header.");
+    }
+    if(m_crc32 != m_entry->getCrc())
+    {
+        throw FileCollectionException("Zip file consistency problem. The CRC32 of the entry data does not match.");
+    }
+}
+
+
+} // zipios namespace
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
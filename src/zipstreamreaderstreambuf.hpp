@@ -0,0 +1,91 @@
+#pragma once
+#ifndef ZIPSTREAMREADERSTREAMBUF_HPP
+#define ZIPSTREAMREADERSTREAMBUF_HPP
+
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ * \brief Define the zipios::ZipStreamReaderStreambuf class.
+ *
+ * This file defines the zipios::ZipStreamReaderStreambuf class which
+ * reads the entries of a Zip archive one after the other from a
+ * stream which cannot seek.
+ */
+
+#include "filterinputstreambuf.hpp"
+
+#include "ziplocalentry.hpp"
+
+#include <zlib.h>
+
+
+namespace zipios
+{
+
+
+class ZipStreamReaderStreambuf : public FilterInputStreambuf
+{
+public:
+                            ZipStreamReaderStreambuf(std::streambuf * inbuf);
+                            ZipStreamReaderStreambuf(ZipStreamReaderStreambuf const & src) = delete;
+    ZipStreamReaderStreambuf &
+                            operator = (ZipStreamReaderStreambuf const & rhs) = delete;
+    virtual                 ~ZipStreamReaderStreambuf() override;
+
+    FileEntry::pointer_t    nextEntry();
+
+protected:
+    virtual std::streambuf::int_type    underflow() override;
+
+private:
+    bool                    fill();
+    std::size_t             readRaw(void * buf, std::size_t size);
+    void                    endOfData();
+
+    std::vector<char>       m_invec = std::vector<char>();
+    std::vector<char>       m_outvec = std::vector<char>();
+    char *                  m_in_ptr = nullptr;
+    std::size_t             m_in_avail = 0;
+    std::size_t             m_position = 0;
+    z_stream *              m_zs = nullptr;
+    std::shared_ptr<ZipLocalEntry>
+                            m_entry = std::shared_ptr<ZipLocalEntry>();
+    bool                    m_end_of_data = true;
+    bool                    m_end_of_archive = false;
+    std::size_t             m_remain = 0;           // For STORED entry only.
+    std::size_t             m_size = 0;
+    std::size_t             m_compressed_size = 0;
+    std::uint32_t           m_crc32 = 0;
+};
+
+
+} // zipios namespace
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
+#endif
@@ -0,0 +1,253 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the CRC32 class and the verification
+ * of the CRC32 of the entries being read.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/crc32.hpp>
+#include <src/zipinputstreambuf.hpp>
+#include <src/zipoutputstream.hpp>
+#include <zipios/streamentry.hpp>
+#include <zipios/zipfile.hpp>
+#include <zipios/zipiosexceptions.hpp>
+
+#include <fstream>
+
+#include <zlib.h>
+
+
+namespace
+{
+
+
+std::string make_zip(std::string const & content, zipios::StorageMethod method)
+{
+    std::stringstream zip;
+    {
+        zipios::ZipOutputStream zos(zip);
+        std::stringstream ss;
+        zipios::StreamEntry entry(ss, zipios::FilePath("data.txt"));
+        entry.setMethod(method);
+        zos.putNextEntry(entry.clone());
+        zos << content;
+    }
+    return zip.str();
+}
+
+
+std::string read_entry(std::string const & zip)
+{
+    std::stringstream ss(zip);
+    zipios::ZipInputStreambuf buf(ss.rdbuf(), 0);
+    std::istream is(&buf);
+    return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+}
+
+
+} // no name namespace
+
+
+CATCH_TEST_CASE("crc32_matches_zlib", "[CRC32]")
+{
+    CATCH_START_SECTION("crc32_matches_zlib: buffers of all sizes and alignments")
+    {
+        std::vector<unsigned char> data(70000);
+        uint32_t seed(7);
+        for(auto & c : data)
+        {
+            seed = seed * 1103515245 + 12345;
+            c = static_cast<unsigned char>(seed >> 16);
+        }
+
+        CATCH_REQUIRE(zipios::CRC32::update(0, data.data(), 0) == 0);
+
+        // the sizes go through the small buffer, 16 bytes blocks and
+        // 64 bytes blocks cases
+        //
+        for(std::size_t offset(0); offset < 16; ++offset)
+        {
+            for(std::size_t size(0); size < 1200; size += 1 + size / 8)
+            {
+                CATCH_REQUIRE(zipios::CRC32::update(0, data.data() + offset, size)
+                                == crc32(0, data.data() + offset, static_cast<uInt>(size)));
+            }
+        }
+
+        CATCH_REQUIRE(zipios::CRC32::update(0, data.data(), data.size())
+                        == crc32(0, data.data(), static_cast<uInt>(data.size())));
+
+        // computing in pieces gives the same result
+        //
+        uint32_t crc(0);
+        for(std::size_t pos(0), size(1); pos < data.size(); pos += size, size = size * 3 + 1)
+        {
+            std::size_t const length(std::min(size, data.size() - pos));
+            crc = zipios::CRC32::update(crc, data.data() + pos, length);
+        }
+        CATCH_REQUIRE(crc == crc32(0, data.data(), static_cast<uInt>(data.size())));
+
+        // CRC of separate blocks combined gives the same result
+        //
+        crc = 0;
+        for(std::size_t pos(0), size(1); pos < data.size(); pos += size, size = size * 5 + 3)
+        {
+            std::size_t const length(std::min(size, data.size() - pos));
+            crc = zipios::CRC32::combine(crc, zipios::CRC32::update(0, data.data() + pos, length), length);
+        }
+        CATCH_REQUIRE(crc == crc32(0, data.data(), static_cast<uInt>(data.size())));
+
+        std::string const implementation(zipios::CRC32::getImplementation());
+        CATCH_REQUIRE((implementation == "pclmul" || implementation == "slice-by-8"));
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("crc32_verified_on_read", "[CRC32] [ZipFile]")
+{
+    std::string content;
+    for(int i(0); i < 30000; ++i)
+    {
+        content += "line #" + std::to_string(i) + "\n";
+    }
+
+    for(auto const method : { zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED })
+    {
+        std::string zip(make_zip(content, method));
+
+        // valid data reads as is
+        //
+        CATCH_REQUIRE(read_entry(zip) == content);
+
+        // reading part of the data does not verify anything
+        //
+        {
+            std::stringstream ss(zip);
+            zipios::ZipInputStreambuf buf(ss.rdbuf(), 0);
+            std::istream is(&buf);
+            std::string data(1000, '\0');
+            is.read(&data[0], data.length());
+            CATCH_REQUIRE(is);
+            CATCH_REQUIRE(data == content.substr(0, 1000));
+        }
+
+        // corrupt the CRC32 in the local header (offset 14)
+        //
+        zip[14] = static_cast<char>(zip[14] ^ 0x01);
+        CATCH_REQUIRE_THROWS_AS(read_entry(zip), zipios::FileCollectionException);
+
+        // with istream::read() the error sets the badbit
+        {
+            std::stringstream ss(zip);
+            zipios::ZipInputStreambuf buf(ss.rdbuf(), 0);
+            std::istream is(&buf);
+            std::string data(content.length() + 10, '\0');
+            is.read(&data[0], data.length());
+            CATCH_REQUIRE(is.bad());
+        }
+
+        // reading back and forth still verifies the data once complete
+        //
+        {
+            std::stringstream ss(zip);
+            zipios::ZipInputStreambuf buf(ss.rdbuf(), 0);
+            std::istream is(&buf);
+            is.seekg(100000);
+            std::string data(1000, '\0');
+            is.read(&data[0], data.length());
+            CATCH_REQUIRE(data == content.substr(100000, 1000));
+            is.seekg(0);
+            CATCH_REQUIRE_THROWS_AS(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()), zipios::FileCollectionException);
+        }
+    }
+}
+
+
+CATCH_TEST_CASE("crc32_verified_on_memory_mapped_read", "[CRC32] [ZipFile]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+    zipios_test::auto_unlink_t auto_unlink("mapped.zip", true);
+
+    std::string content;
+    for(int i(0); i < 200; ++i)
+    {
+        content += "line #" + std::to_string(i) + "\n";
+    }
+    std::string const zip(make_zip(content, zipios::StorageMethod::STORED));
+
+    for(int corrupted(0); corrupted < 2; ++corrupted)
+    {
+        {
+            std::string archive(zip);
+            if(corrupted != 0)
+            {
+                std::string::size_type const pos(archive.find(content) + content.length() / 2);
+                archive[pos] = static_cast<char>(archive[pos] ^ 0x20);
+            }
+            std::ofstream os("mapped.zip", std::ios::out | std::ios::binary);
+            os << archive;
+        }
+
+        zipios::ZipFile zf("mapped.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP);
+
+        // the stream returned from the mapping is verified once, so
+        // read it twice
+        //
+        for(int repeat(0); repeat < 2; ++repeat)
+        {
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("data.txt"));
+            CATCH_REQUIRE(is);
+            std::string data(content.length(), '\0');
+            is->read(&data[0], data.length());
+            if(corrupted == 0)
+            {
+                CATCH_REQUIRE(*is);
+                CATCH_REQUIRE(data == content);
+            }
+            else
+            {
+                CATCH_REQUIRE(is->bad());
+            }
+        }
+
+        // getStoredData() gives access to the data without verifying it
+        //
+        char const * data(nullptr);
+        std::size_t size(0);
+        CATCH_REQUIRE(zf.getStoredData("data.txt", data, size));
+        CATCH_REQUIRE(size == content.length());
+        CATCH_REQUIRE((std::string(data, size) == content) == (corrupted == 0));
+    }
+}
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,222 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the EntryCache class.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/entrycache.hpp>
+
+#include <atomic>
+#include <thread>
+
+
+namespace
+{
+
+
+zipios::EntryCache::data_t make_data(std::size_t size, unsigned char c)
+{
+    return std::make_shared<zipios::buffer_t const>(size, c);
+}
+
+
+} // no name namespace
+
+
+CATCH_SCENARIO("EntryCache keeps the most recently used entries within its budget", "[EntryCache] [ZipFile]")
+{
+    CATCH_GIVEN("a cache with a budget of 1000 bytes")
+    {
+        zipios::EntryCache cache(1000);
+
+        CATCH_REQUIRE(cache.getBudget() == 1000);
+        CATCH_REQUIRE(cache.find(0) == nullptr);
+
+        zipios::ZipFile::CacheStatistics statistics(cache.getStatistics());
+        CATCH_REQUIRE(statistics.m_hits == 0);
+        CATCH_REQUIRE(statistics.m_misses == 1);
+        CATCH_REQUIRE(statistics.m_evictions == 0);
+        CATCH_REQUIRE(statistics.m_entries == 0);
+        CATCH_REQUIRE(statistics.m_size == 0);
+
+        CATCH_WHEN("entries are added until the budget is exceeded")
+        {
+            cache.insert(0, make_data(300, 'a'));
+            cache.insert(100, make_data(300, 'b'));
+            cache.insert(200, make_data(300, 'c'));
+
+            // use entry 0 so entry 100 becomes the least recently used
+            //
+            zipios::EntryCache::data_t a(cache.find(0));
+            CATCH_REQUIRE(a != nullptr);
+            CATCH_REQUIRE(a->size() == 300);
+            CATCH_REQUIRE((*a)[0] == 'a');
+
+            cache.insert(300, make_data(300, 'd'));
+
+            CATCH_THEN("the least recently used entry was evicted")
+            {
+                CATCH_REQUIRE(cache.find(100) == nullptr);
+                CATCH_REQUIRE(cache.find(0) != nullptr);
+                CATCH_REQUIRE(cache.find(200) != nullptr);
+                CATCH_REQUIRE(cache.find(300) != nullptr);
+
+                statistics = cache.getStatistics();
+                CATCH_REQUIRE(statistics.m_hits == 4);
+                CATCH_REQUIRE(statistics.m_misses == 2);
+                CATCH_REQUIRE(statistics.m_evictions == 1);
+                CATCH_REQUIRE(statistics.m_entries == 3);
+                CATCH_REQUIRE(statistics.m_size == 900);
+            }
+        }
+
+        CATCH_WHEN("an entry is replaced or too large")
+        {
+            cache.insert(0, make_data(300, 'a'));
+            cache.insert(0, make_data(500, 'b'));
+            cache.insert(100, make_data(1001, 'c'));
+            cache.insert(200, zipios::EntryCache::data_t());
+
+            CATCH_THEN("the cache only holds the new data")
+            {
+                zipios::EntryCache::data_t b(cache.find(0));
+                CATCH_REQUIRE(b != nullptr);
+                CATCH_REQUIRE(b->size() == 500);
+                CATCH_REQUIRE((*b)[499] == 'b');
+                CATCH_REQUIRE(cache.find(100) == nullptr);
+                CATCH_REQUIRE(cache.find(200) == nullptr);
+
+                statistics = cache.getStatistics();
+                CATCH_REQUIRE(statistics.m_entries == 1);
+                CATCH_REQUIRE(statistics.m_size == 500);
+                CATCH_REQUIRE(statistics.m_evictions == 0);
+            }
+        }
+
+        CATCH_WHEN("the budget gets reduced")
+        {
+            cache.insert(0, make_data(300, 'a'));
+            cache.insert(100, make_data(300, 'b'));
+            zipios::EntryCache::data_t a(cache.find(0));
+
+            cache.setBudget(400);
+
+            CATCH_THEN("entries get evicted immediately")
+            {
+                CATCH_REQUIRE(cache.getBudget() == 400);
+                CATCH_REQUIRE(cache.getStatistics().m_entries == 1);
+                CATCH_REQUIRE(cache.find(0) != nullptr);
+                CATCH_REQUIRE(cache.find(100) == nullptr);
+
+                // a budget of zero empties the cache, the data we hold
+                // remains valid
+                //
+                cache.setBudget(0);
+                CATCH_REQUIRE(cache.getStatistics().m_entries == 0);
+                CATCH_REQUIRE(cache.getStatistics().m_size == 0);
+                CATCH_REQUIRE(a->size() == 300);
+                CATCH_REQUIRE((*a)[299] == 'a');
+
+                cache.insert(0, make_data(1, 'x'));
+                CATCH_REQUIRE(cache.find(0) == nullptr);
+            }
+        }
+
+        CATCH_WHEN("the cache gets cleared")
+        {
+            cache.insert(0, make_data(300, 'a'));
+            cache.clear();
+
+            CATCH_THEN("it is empty but the statistics remain")
+            {
+                CATCH_REQUIRE(cache.find(0) == nullptr);
+                statistics = cache.getStatistics();
+                CATCH_REQUIRE(statistics.m_entries == 0);
+                CATCH_REQUIRE(statistics.m_size == 0);
+                CATCH_REQUIRE(statistics.m_misses == 2);
+            }
+        }
+    }
+}
+
+
+CATCH_SCENARIO("EntryCache used by many threads", "[EntryCache] [ZipFile]")
+{
+    CATCH_GIVEN("a cache smaller than the data being inserted")
+    {
+        zipios::EntryCache cache(64 * 100);
+
+        CATCH_WHEN("threads insert and search entries concurrently")
+        {
+            std::atomic<std::size_t> failures(0);
+            std::vector<std::thread> threads;
+            for(std::size_t t(0); t < 8; ++t)
+            {
+                threads.emplace_back([&cache, &failures, t]()
+                    {
+                        for(std::size_t i(0); i < 5000; ++i)
+                        {
+                            zipios::offset_t const key(static_cast<zipios::offset_t>((i * 7 + t) % 200));
+                            zipios::EntryCache::data_t data(cache.find(key));
+                            if(data == nullptr)
+                            {
+                                cache.insert(key, make_data(100, static_cast<unsigned char>(key)));
+                            }
+                            else if(data->size() != 100
+                                 || (*data)[50] != static_cast<unsigned char>(key))
+                            {
+                                ++failures;
+                            }
+                        }
+                    });
+            }
+            for(auto & th : threads)
+            {
+                th.join();
+            }
+
+            CATCH_THEN("the data is consistent and within budget")
+            {
+                CATCH_REQUIRE(failures == 0);
+
+                zipios::ZipFile::CacheStatistics const statistics(cache.getStatistics());
+                CATCH_REQUIRE(statistics.m_hits + statistics.m_misses == 8 * 5000);
+                CATCH_REQUIRE(statistics.m_size <= cache.getBudget());
+                CATCH_REQUIRE(statistics.m_size == statistics.m_entries * 100);
+            }
+        }
+    }
+}
+
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,150 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the FileEntryIndex class.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/fileentryindex.hpp>
+#include <zipios/streamentry.hpp>
+#include <zipios/zipfile.hpp>
+
+
+CATCH_SCENARIO("FileEntryIndex search entries by name and base name", "[FileEntryIndex] [FileCollection]")
+{
+    std::stringstream ss;
+    ss << "content of the entries\n";
+
+    CATCH_GIVEN("an index of many entries, some of which are duplicates")
+    {
+        zipios::FileEntry::vector_t entries;
+        for(int i(0); i < 1000; ++i)
+        {
+            entries.push_back(std::make_shared<zipios::StreamEntry>(ss, zipios::FilePath("dir" + std::to_string(i % 7) + "/file" + std::to_string(i) + ".txt")));
+        }
+        entries.push_back(std::make_shared<zipios::StreamEntry>(ss, zipios::FilePath("dir3/file3.txt")));
+
+        zipios::FileEntryIndex index(&zipios::FileEntry::getName);
+
+        CATCH_WHEN("the index is rebuilt from the vector")
+        {
+            index.rebuild(entries);
+
+            CATCH_THEN("all the entries are found at their position")
+            {
+                CATCH_REQUIRE(index.size() == entries.size());
+                for(std::size_t i(0); i < 1000; ++i)
+                {
+                    CATCH_REQUIRE(index.find(entries[i]->getName()) == i);
+                }
+                CATCH_REQUIRE(index.find("dir3/file3.txt") == 3);
+                CATCH_REQUIRE(index.find("file3.txt") == zipios::FileEntryIndex::npos);
+                CATCH_REQUIRE(index.find("") == zipios::FileEntryIndex::npos);
+            }
+        }
+
+        CATCH_WHEN("the entries are added one at a time")
+        {
+            for(auto it(entries.begin()); it != entries.end(); ++it)
+            {
+                index.add(**it);
+            }
+
+            CATCH_THEN("the first entry with a given name is returned")
+            {
+                CATCH_REQUIRE(index.size() == entries.size());
+                CATCH_REQUIRE(index.find("dir3/file3.txt") == 3);
+                CATCH_REQUIRE(index.find("dir5/file999.txt") == 999);
+
+                index.clear();
+                CATCH_REQUIRE(index.size() == 0);
+                CATCH_REQUIRE(index.find("dir3/file3.txt") == zipios::FileEntryIndex::npos);
+            }
+        }
+    }
+
+    CATCH_GIVEN("a ZipFile to which we add entries")
+    {
+        zipios::ZipFile zf;
+        zf.addEntry(zipios::StreamEntry(ss, zipios::FilePath("a/b/c.txt"), "first"));
+        zf.addEntry(zipios::StreamEntry(ss, zipios::FilePath("a/b/d.txt")));
+        zf.addEntry(zipios::StreamEntry(ss, zipios::FilePath("a/b/c.txt"), "second"));
+
+        CATCH_THEN("getEntry() uses the index")
+        {
+            CATCH_REQUIRE(zf.getEntry("a/b/c.txt")->getComment() == "first");
+            CATCH_REQUIRE(zf.getEntry("a/b/d.txt") != nullptr);
+            CATCH_REQUIRE(zf.getEntry("a/b/e.txt") == nullptr);
+
+            zipios::ZipFile copy(zf);
+            CATCH_REQUIRE(copy.getEntry("a/b/c.txt")->getComment() == "first");
+            CATCH_REQUIRE(copy.getEntry("a/b/c.txt") != zf.getEntry("a/b/c.txt"));
+
+            zf.close();
+            CATCH_REQUIRE(copy.getEntry("a/b/d.txt") != nullptr);
+        }
+
+        CATCH_THEN("getEntry() with IGNORE returns the first entry with that base name")
+        {
+            zf.addEntry(zipios::StreamEntry(ss, zipios::FilePath("x/d.txt"), "third"));
+
+            CATCH_REQUIRE(zf.getEntry("c.txt", zipios::FileCollection::MatchPath::IGNORE)->getComment() == "first");
+            CATCH_REQUIRE(zf.getEntry("d.txt", zipios::FileCollection::MatchPath::IGNORE)->getName() == "a/b/d.txt");
+            CATCH_REQUIRE(zf.getEntry("x/d.txt", zipios::FileCollection::MatchPath::IGNORE) == nullptr);
+            CATCH_REQUIRE(zf.getEntry("e.txt", zipios::FileCollection::MatchPath::IGNORE) == nullptr);
+
+            zipios::ZipFile copy(zf);
+            CATCH_REQUIRE(copy.getEntry("d.txt", zipios::FileCollection::MatchPath::IGNORE)->getName() == "a/b/d.txt");
+        }
+    }
+
+    CATCH_GIVEN("an index of base names")
+    {
+        zipios::FileEntryIndex index(&zipios::FileEntry::getFileName);
+        for(int i(0); i < 100; ++i)
+        {
+            index.add(zipios::StreamEntry(ss, zipios::FilePath("dir" + std::to_string(i) + "/file" + std::to_string(i % 10) + ".txt")));
+        }
+
+        CATCH_THEN("the first entry with each base name is found")
+        {
+            for(int i(0); i < 10; ++i)
+            {
+                CATCH_REQUIRE(index.find("file" + std::to_string(i) + ".txt") == static_cast<std::size_t>(i));
+            }
+            CATCH_REQUIRE(index.find("dir3/file3.txt") == zipios::FileEntryIndex::npos);
+        }
+    }
+}
+
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
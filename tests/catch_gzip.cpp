@@ -0,0 +1,594 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the GZIPOutputStream and GZIPInputStream classes.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/gzipinputstream.hpp>
+#include <src/gzipoutputstream.hpp>
+#include <zipios/zipiosexceptions.hpp>
+
+#include <fstream>
+
+#include <zlib.h>
+
+
+namespace
+{
+
+
+/** \brief Decompress a gzip file with zlib.
+ *
+ * This function decompresses all the members of \p gz and returns the
+ * data. The number of members found is saved in \p members.
+ */
+std::string gunzip(std::string const & gz, std::size_t & members)
+{
+    members = 0;
+
+    z_stream zs = {};
+    CATCH_REQUIRE(inflateInit2(&zs, MAX_WBITS + 16) == Z_OK);
+
+    std::string result;
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(gz.data()));
+    zs.avail_in = static_cast<uInt>(gz.length());
+    while(zs.avail_in > 0)
+    {
+        char buf[4096];
+        zs.next_out = reinterpret_cast<Bytef *>(buf);
+        zs.avail_out = sizeof(buf);
+        int const err(inflate(&zs, Z_NO_FLUSH));
+        result.append(buf, sizeof(buf) - zs.avail_out);
+        if(err == Z_STREAM_END)
+        {
+            ++members;
+            CATCH_REQUIRE(inflateReset(&zs) == Z_OK);
+        }
+        else
+        {
+            CATCH_REQUIRE(err == Z_OK);
+        }
+    }
+    inflateEnd(&zs);
+
+    return result;
+}
+
+
+std::string make_data(std::size_t size)
+{
+    std::string data;
+    uint32_t seed(rand());
+    while(data.length() < size)
+    {
+        seed = seed * 1103515245 + 12345;
+        data += "record " + std::to_string(seed % 5000) + " of the log\n";
+    }
+    data.resize(size);
+    return data;
+}
+
+
+/** \brief Compress data in the gzip format with zlib.
+ *
+ * This function creates a gzip file with all the optional header
+ * fields, including the header CRC16.
+ */
+std::string zlib_gzip(std::string const & data, std::string const & filename, std::string const & comment, std::string const & extra)
+{
+    z_stream zs = {};
+    CATCH_REQUIRE(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+
+    gz_header header = {};
+    header.extra = reinterpret_cast<Bytef *>(const_cast<char *>(extra.data()));
+    header.extra_len = static_cast<uInt>(extra.length());
+    header.name = reinterpret_cast<Bytef *>(const_cast<char *>(filename.c_str()));
+    header.comment = reinterpret_cast<Bytef *>(const_cast<char *>(comment.c_str()));
+    header.hcrc = 1;
+    CATCH_REQUIRE(deflateSetHeader(&zs, &header) == Z_OK);
+
+    std::string result(deflateBound(&zs, static_cast<uLong>(data.length())) + 1024, '\0');
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.length());
+    zs.next_out = reinterpret_cast<Bytef *>(&result[0]);
+    zs.avail_out = static_cast<uInt>(result.length());
+    CATCH_REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+    result.resize(result.length() - zs.avail_out);
+    deflateEnd(&zs);
+
+    return result;
+}
+
+
+std::string gzip(std::string const & data, std::size_t member_size = 0)
+{
+    std::stringstream ss;
+    {
+        zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+        gz.setFilename("data.txt");
+        gz.setMemberSize(member_size);
+        gz << data;
+    }
+    return ss.str();
+}
+
+
+std::string read_all(std::string const & gz)
+{
+    std::stringstream ss(gz);
+    zipios::GZIPInputStream is(ss);
+    return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+}
+
+
+/** \brief Read random ranges of data with seekg().
+ *
+ * This function seeks to random positions in \p gz and verifies that
+ * the data read there matches \p data.
+ */
+void verify_seeks(std::istream & is, std::string const & data)
+{
+    for(int i(0); i < 50; ++i)
+    {
+        std::size_t const offset(rand() % (data.length() + 1));
+        std::size_t const size(std::min(static_cast<std::size_t>(rand() % 5000), data.length() - offset));
+        is.seekg(offset);
+        CATCH_REQUIRE(is);
+        CATCH_REQUIRE(static_cast<std::size_t>(is.tellg()) == offset);
+        std::string buf(size, '\0');
+        is.read(&buf[0], size);
+        CATCH_REQUIRE(static_cast<std::size_t>(is.gcount()) == size);
+        CATCH_REQUIRE(buf == data.substr(offset, size));
+    }
+}
+
+
+std::string decompress(std::string const & gz)
+{
+    std::vector<char> data;
+    zipios::GZIPInputStreambuf::decompress(gz.data(), gz.length(), data);
+    return std::string(data.begin(), data.end());
+}
+
+
+} // no name namespace
+
+
+CATCH_TEST_CASE("gzip_output_stream", "[GZIP]")
+{
+    CATCH_START_SECTION("gzip_output_stream: one member")
+    {
+        std::string const data(make_data(300000));
+        std::stringstream ss;
+        {
+            zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+            gz.setFilename("log.txt");
+            gz << data;
+        }
+        std::string const result(ss.str());
+        CATCH_REQUIRE(result.substr(0, 4) == std::string("\x1f\x8b\x08\x08", 4));
+        CATCH_REQUIRE(result.substr(10, 8) == std::string("log.txt\0", 8));
+
+        std::size_t members(0);
+        CATCH_REQUIRE(gunzip(result, members) == data);
+        CATCH_REQUIRE(members == 1);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_output_stream: empty file")
+    {
+        std::stringstream ss;
+        {
+            zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+            gz.finish();
+        }
+        std::string const result(ss.str());
+        CATCH_REQUIRE(result.length() == 20);
+
+        std::size_t members(0);
+        CATCH_REQUIRE(gunzip(result, members).empty());
+        CATCH_REQUIRE(members == 1);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_output_stream: parallel compression in one member")
+    {
+        std::string const data(make_data(1000000));
+        std::string serial;
+        {
+            std::stringstream ss;
+            {
+                zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+                gz << data;
+            }
+            serial = ss.str();
+        }
+
+        for(std::size_t threads(2); threads <= 5; ++threads)
+        {
+            std::stringstream ss;
+            {
+                zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+                gz.setParallelDeflate(threads, 32 * 1024);
+                gz << data;
+            }
+            std::string const result(ss.str());
+            CATCH_REQUIRE(result != serial);
+            CATCH_REQUIRE(result.length() < serial.length() + serial.length() / 20);
+
+            std::size_t members(0);
+            CATCH_REQUIRE(gunzip(result, members) == data);
+            CATCH_REQUIRE(members == 1);
+        }
+
+        // once data was written, it is too late
+        //
+        std::stringstream ss;
+        zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+        gz << data;
+        CATCH_REQUIRE_THROWS_AS(gz.setParallelDeflate(4, 32 * 1024), zipios::InvalidStateException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_output_stream: multiple members")
+    {
+        std::size_t const sizes[] = { 1, 99999, 100000, 100001, 1000000, 1012345 };
+        for(auto const size : sizes)
+        {
+            std::string const data(make_data(size));
+            for(std::size_t threads(1); threads <= 3; threads += 2)
+            {
+                std::stringstream ss;
+                {
+                    zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+                    gz.setFilename("log.txt");
+                    gz.setParallelDeflate(threads, 32 * 1024);
+                    gz.setMemberSize(100000);
+                    gz << data;
+                }
+
+                std::size_t members(0);
+                CATCH_REQUIRE(gunzip(ss.str(), members) == data);
+                CATCH_REQUIRE(members == (size + 99999) / 100000);
+            }
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("gzip_input_stream", "[GZIP]")
+{
+    CATCH_START_SECTION("gzip_input_stream: read back GZIPOutputStream files")
+    {
+        std::size_t const sizes[] = { 0, 1, 1000, 300000 };
+        for(auto const size : sizes)
+        {
+            std::string const data(make_data(size));
+
+            std::stringstream ss(gzip(data));
+            zipios::GZIPInputStream is(ss);
+            CATCH_REQUIRE(is.getFilename() == "data.txt");
+            CATCH_REQUIRE(is.getComment().empty());
+            CATCH_REQUIRE(is.getExtra().empty());
+            CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == data);
+
+            CATCH_REQUIRE(decompress(gzip(data)) == data);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_input_stream: multiple members are read as one file")
+    {
+        std::size_t const sizes[] = { 99999, 100000, 100001, 1012345 };
+        for(auto const size : sizes)
+        {
+            std::string const data(make_data(size));
+            std::string const gz(gzip(data, 100000));
+            CATCH_REQUIRE(read_all(gz) == data);
+            CATCH_REQUIRE(decompress(gz) == data);
+
+            // concatenated files work the same way
+            //
+            CATCH_REQUIRE(read_all(gz + gzip("tail")) == data + "tail");
+            CATCH_REQUIRE(decompress(gz + gzip("tail")) == data + "tail");
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_input_stream: optional header fields")
+    {
+        std::string const data(make_data(50000));
+        std::string const extra("AB\x04\x00test", 8);
+        std::string const gz(zlib_gzip(data, "name.txt", "a comment", extra));
+
+        std::stringstream ss(gz);
+        zipios::GZIPInputStream is(ss);
+        CATCH_REQUIRE(is.getFilename() == "name.txt");
+        CATCH_REQUIRE(is.getComment() == "a comment");
+        CATCH_REQUIRE(is.getExtra() == zipios::buffer_t(extra.begin(), extra.end()));
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == data);
+
+        CATCH_REQUIRE(decompress(gz) == data);
+
+        // the header CRC16 follows the comment
+        //
+        std::string bad_header(gz);
+        std::size_t const pos(10 + 2 + extra.length() + 9 + 10);
+        bad_header[pos] = static_cast<char>(bad_header[pos] ^ 0x01);
+        CATCH_REQUIRE_THROWS_AS(read_all(bad_header), zipios::IOException);
+        CATCH_REQUIRE_THROWS_AS(decompress(bad_header), zipios::IOException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_input_stream: invalid files")
+    {
+        std::string const data(make_data(100000));
+        std::string const gz(gzip(data, 30000));
+
+        // not gzip data
+        //
+        CATCH_REQUIRE_THROWS_AS(read_all("not a gzip file"), zipios::IOException);
+        CATCH_REQUIRE_THROWS_AS(decompress("not a gzip file"), zipios::IOException);
+        CATCH_REQUIRE_THROWS_AS(read_all(std::string()), zipios::IOException);
+        CATCH_REQUIRE_THROWS_AS(decompress(std::string()), zipios::IOException);
+
+        // bad CRC32 and size in the last trailer
+        //
+        for(std::size_t offset(8); offset > 0; offset -= 4)
+        {
+            std::string bad(gz);
+            bad[bad.length() - offset] = static_cast<char>(bad[bad.length() - offset] ^ 0x01);
+            CATCH_REQUIRE_THROWS_AS(read_all(bad), zipios::IOException);
+            CATCH_REQUIRE_THROWS_AS(decompress(bad), zipios::IOException);
+        }
+
+        // truncated file
+        //
+        for(std::size_t size(1); size < gz.length(); size += size / 2 + 1)
+        {
+            CATCH_REQUIRE_THROWS_AS(read_all(gz.substr(0, size)), zipios::IOException);
+            CATCH_REQUIRE_THROWS_AS(decompress(gz.substr(0, size)), zipios::IOException);
+        }
+
+        // a size in the last trailer larger than what the data can
+        // inflate to does not get allocated
+        //
+        {
+            std::string lying_size(gzip(""));
+            lying_size.replace(lying_size.length() - 4, 4, "\xFF\xFF\xFF\xFF");
+            std::vector<char> buffer;
+            CATCH_REQUIRE_THROWS_AS(zipios::GZIPInputStreambuf::decompress(lying_size.data(), lying_size.length(), buffer), zipios::IOException);
+            CATCH_REQUIRE(buffer.capacity() <= lying_size.length() * 1032);
+        }
+
+        // garbage after the last member
+        //
+        CATCH_REQUIRE_THROWS_AS(read_all(gz + "garbage"), zipios::IOException);
+        CATCH_REQUIRE_THROWS_AS(decompress(gz + "garbage"), zipios::IOException);
+
+        // with istream::read() errors set the badbit
+        //
+        {
+            std::stringstream ss(gz.substr(0, gz.length() - 1));
+            zipios::GZIPInputStream is(ss);
+            std::string buf(data.length() + 10, '\0');
+            is.read(&buf[0], buf.length());
+            CATCH_REQUIRE(is.bad());
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_input_stream: read files")
+    {
+        zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+        zipios_test::auto_unlink_t remove_gz("data.gz", true);
+
+        std::string const data(make_data(200000));
+        {
+            std::ofstream out("data.gz", std::ios::out | std::ios::binary);
+            out << gzip(data);
+        }
+
+        zipios::GZIPInputStream is("data.gz");
+        CATCH_REQUIRE(is.getFilename() == "data.txt");
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == data);
+
+        std::vector<char> result;
+        zipios::GZIPInputStream::readFile("data.gz", result);
+        CATCH_REQUIRE(std::string(result.begin(), result.end()) == data);
+
+        CATCH_REQUIRE_THROWS_AS(zipios::GZIPInputStream::readFile("missing.gz", result), zipios::IOException);
+        CATCH_REQUIRE_THROWS_AS(zipios::GZIPInputStream("missing.gz"), zipios::IOException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("gzip_index", "[GZIP] [InflateIndex]")
+{
+    CATCH_START_SECTION("gzip_index: the writer creates the index")
+    {
+        std::string const data(make_data(2 * 1024 * 1024));
+        for(int mode(0); mode < 3; ++mode)
+        {
+            zipios::InflateIndex::pointer_t index(std::make_shared<zipios::InflateIndex>(128 * 1024));
+            std::stringstream ss;
+            {
+                zipios::GZIPOutputStream gz(ss, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+                gz.setFilename("data.txt");
+                gz.setInflateIndex(index);
+                switch(mode)
+                {
+                case 1:
+                    gz.setParallelDeflate(3, 64 * 1024);
+                    break;
+
+                case 2:
+                    gz.setMemberSize(300000);
+                    break;
+
+                }
+                gz << data;
+
+                CATCH_REQUIRE_THROWS_AS(gz.setInflateIndex(index), zipios::InvalidStateException);
+            }
+
+            // the access points are after sync flushes or at the start
+            // of members so always on a byte boundary
+            //
+            CATCH_REQUIRE(index->size() >= 15);
+            zipios::InflateIndex::checkpoint_t checkpoint;
+            zipios::offset_t out(static_cast<zipios::offset_t>(data.length()));
+            while(index->findCheckpoint(out, checkpoint))
+            {
+                CATCH_REQUIRE(checkpoint.m_bits == 0);
+                CATCH_REQUIRE(checkpoint.m_window.size() <= zipios::InflateIndex::WINDOW_SIZE);
+                out = checkpoint.m_out - 1;
+            }
+
+            // the sync flushes do not prevent other tools from reading
+            // the file
+            //
+            std::size_t members(0);
+            CATCH_REQUIRE(gunzip(ss.str(), members) == data);
+            CATCH_REQUIRE(members == (mode == 2 ? 7 : 1));
+
+            zipios::GZIPInputStream is(ss, index);
+            verify_seeks(is, data);
+
+            // reading the whole file again verifies all the members
+            //
+            is.seekg(0);
+            CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == data);
+
+            is.clear();
+            is.seekg(static_cast<std::streamoff>(data.length() + 1));
+            CATCH_REQUIRE_FALSE(is);
+
+            is.clear();
+            is.seekg(-10, std::ios::end);
+            CATCH_REQUIRE_FALSE(is);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_index: seek without an index")
+    {
+        std::string const data(make_data(500000));
+        std::stringstream ss(gzip(data, 200000));
+        zipios::GZIPInputStream is(ss);
+
+        std::string buf(100, '\0');
+        is.seekg(450000);
+        is.read(&buf[0], buf.length());
+        CATCH_REQUIRE(buf == data.substr(450000, 100));
+
+        is.seekg(-200, std::ios::cur);
+        is.read(&buf[0], buf.length());
+        CATCH_REQUIRE(buf == data.substr(449900, 100));
+
+        // restarts after the header of the first member
+        //
+        is.seekg(10);
+        is.read(&buf[0], buf.length());
+        CATCH_REQUIRE(buf == data.substr(10, 100));
+
+        verify_seeks(is, data);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_index: build, save and load an index")
+    {
+        zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+        zipios_test::auto_unlink_t remove_gz("index.gz", true);
+        zipios_test::auto_unlink_t remove_index("index.gz.idx", true);
+
+        std::string const data(make_data(2 * 1024 * 1024));
+        {
+            std::ofstream out("index.gz", std::ios::out | std::ios::binary);
+            out << zlib_gzip(data, "index.txt", "with an index", std::string());
+        }
+
+        {
+            zipios::InflateIndex::pointer_t const index(zipios::GZIPInputStream::buildIndex("index.gz", 64 * 1024));
+            CATCH_REQUIRE(index->size() >= 4);
+
+            std::ofstream out("index.gz.idx", std::ios::out | std::ios::binary);
+            index->save(out);
+        }
+
+        std::ifstream in("index.gz.idx", std::ios::in | std::ios::binary);
+        zipios::InflateIndex::pointer_t const index(zipios::InflateIndex::load(in));
+        CATCH_REQUIRE(index->getSpan() == 64 * 1024);
+        CATCH_REQUIRE(index->size() >= 4);
+
+        zipios::GZIPInputStream is("index.gz", index);
+        CATCH_REQUIRE(is.getFilename() == "index.txt");
+        verify_seeks(is, data);
+
+        CATCH_REQUIRE_THROWS_AS(zipios::GZIPInputStream::buildIndex("missing.gz"), zipios::IOException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("gzip_index: the CRC32 is verified when reading from the start")
+    {
+        std::string const data(make_data(1024 * 1024));
+        zipios::InflateIndex::pointer_t index(std::make_shared<zipios::InflateIndex>(128 * 1024));
+        std::stringstream out;
+        {
+            zipios::GZIPOutputStream gz(out, zipios::FileEntry::COMPRESSION_LEVEL_DEFAULT);
+            gz.setInflateIndex(index);
+            gz << data;
+        }
+        std::string gz(out.str());
+        gz[gz.length() - 8] = static_cast<char>(gz[gz.length() - 8] ^ 0x01);
+
+        // starting from an access point, the CRC32 cannot be verified
+        //
+        std::stringstream ss(gz);
+        zipios::GZIPInputStream is(ss, index);
+        is.seekg(900000);
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == data.substr(900000));
+
+        is.clear();
+        is.seekg(0);
+        std::string buf(data.length(), '\0');
+        is.read(&buf[0], buf.length());
+        CATCH_REQUIRE(is);
+        is.get();
+        CATCH_REQUIRE(is.bad());
+    }
+    CATCH_END_SECTION()
+}
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,307 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the InflateIndex class and seeking in
+ * ZipInputStreambuf.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/zipinputstreambuf.hpp>
+#include <src/zipoutputstream.hpp>
+#include <zipios/streamentry.hpp>
+#include <zipios/zipiosexceptions.hpp>
+
+
+namespace
+{
+
+
+std::string make_content(std::size_t size)
+{
+    // text which compresses, but not too well, so we get many blocks
+    //
+    std::string content;
+    content.reserve(size + 100);
+    uint32_t seed(12345);
+    while(content.length() < size)
+    {
+        seed = seed * 1103515245 + 12345;
+        content += "line " + std::to_string(seed % 100000) + " of the log\n";
+    }
+    content.resize(size);
+    return content;
+}
+
+
+std::string make_zip(std::string const & content, zipios::StorageMethod method)
+{
+    std::stringstream zip;
+    {
+        zipios::ZipOutputStream zos(zip);
+        std::stringstream ss;
+        zipios::StreamEntry entry(ss, zipios::FilePath("log.txt"));
+        entry.setMethod(method);
+        zos.putNextEntry(entry.clone());
+        zos << content;
+    }
+    return zip.str();
+}
+
+
+} // no name namespace
+
+
+CATCH_SCENARIO("InflateIndex keeps sorted access points", "[InflateIndex] [ZipFile]")
+{
+    CATCH_GIVEN("an index with a span of 100 bytes")
+    {
+        zipios::InflateIndex index(100);
+        CATCH_REQUIRE(index.getSpan() == 100);
+        CATCH_REQUIRE(index.size() == 0);
+        CATCH_REQUIRE_FALSE(index.needsCheckpoint(99));
+        CATCH_REQUIRE(index.needsCheckpoint(100));
+
+        zipios::InflateIndex::checkpoint_t checkpoint;
+        CATCH_REQUIRE_FALSE(index.findCheckpoint(1000, checkpoint));
+
+        CATCH_WHEN("access points get added")
+        {
+            for(zipios::offset_t out(100); out <= 500; out += 100)
+            {
+                checkpoint.m_out = out;
+                checkpoint.m_in = out / 2;
+                checkpoint.m_bits = static_cast<int>(out / 100);
+                index.addCheckpoint(checkpoint);
+            }
+
+            // not past the last one, ignored
+            //
+            checkpoint.m_out = 450;
+            index.addCheckpoint(checkpoint);
+
+            CATCH_THEN("the closest access point is found")
+            {
+                CATCH_REQUIRE(index.size() == 5);
+                CATCH_REQUIRE_FALSE(index.needsCheckpoint(599));
+                CATCH_REQUIRE(index.needsCheckpoint(600));
+
+                CATCH_REQUIRE_FALSE(index.findCheckpoint(99, checkpoint));
+                CATCH_REQUIRE(index.findCheckpoint(100, checkpoint));
+                CATCH_REQUIRE(checkpoint.m_out == 100);
+                CATCH_REQUIRE(index.findCheckpoint(399, checkpoint));
+                CATCH_REQUIRE(checkpoint.m_out == 300);
+                CATCH_REQUIRE(checkpoint.m_in == 150);
+                CATCH_REQUIRE(checkpoint.m_bits == 3);
+                CATCH_REQUIRE(index.findCheckpoint(10000, checkpoint));
+                CATCH_REQUIRE(checkpoint.m_out == 500);
+            }
+        }
+
+        CATCH_WHEN("the index gets saved and loaded back")
+        {
+            for(zipios::offset_t out(100); out <= 300; out += 100)
+            {
+                checkpoint.m_out = out;
+                checkpoint.m_in = out / 2;
+                checkpoint.m_bits = static_cast<int>(out / 100);
+                checkpoint.m_window.assign(static_cast<std::size_t>(out), static_cast<unsigned char>(out / 100));
+                index.addCheckpoint(checkpoint);
+            }
+
+            std::stringstream ss;
+            index.save(ss);
+            std::string const saved(ss.str());
+
+            CATCH_THEN("the loaded index has the same access points")
+            {
+                zipios::InflateIndex::pointer_t loaded(zipios::InflateIndex::load(ss));
+                CATCH_REQUIRE(loaded->getSpan() == 100);
+                CATCH_REQUIRE(loaded->size() == 3);
+                CATCH_REQUIRE(loaded->findCheckpoint(299, checkpoint));
+                CATCH_REQUIRE(checkpoint.m_out == 200);
+                CATCH_REQUIRE(checkpoint.m_in == 100);
+                CATCH_REQUIRE(checkpoint.m_bits == 2);
+                CATCH_REQUIRE(checkpoint.m_window == zipios::buffer_t(200, 2));
+            }
+
+            CATCH_THEN("invalid indexes are refused")
+            {
+                std::stringstream truncated(saved.substr(0, saved.length() - 1));
+                CATCH_REQUIRE_THROWS_AS(zipios::InflateIndex::load(truncated), zipios::IOException);
+
+                std::string bad_magic(saved);
+                bad_magic[0] = 'X';
+                std::stringstream bad_magic_stream(bad_magic);
+                CATCH_REQUIRE_THROWS_AS(zipios::InflateIndex::load(bad_magic_stream), zipios::IOException);
+
+                // the m_bits of the first access point (4 + 4 + 8 + 8 + 8 + 8)
+                //
+                std::string bad_bits(saved);
+                bad_bits[40] = 8;
+                std::stringstream bad_bits_stream(bad_bits);
+                CATCH_REQUIRE_THROWS_AS(zipios::InflateIndex::load(bad_bits_stream), zipios::IOException);
+
+                std::stringstream empty;
+                CATCH_REQUIRE_THROWS_AS(zipios::InflateIndex::load(empty), zipios::IOException);
+            }
+        }
+    }
+}
+
+
+CATCH_SCENARIO("ZipInputStreambuf seeks inside entries", "[InflateIndex] [ZipFile]")
+{
+    std::string const content(make_content(700 * 1024));
+
+    CATCH_GIVEN("a DEFLATED entry read with an index")
+    {
+        std::stringstream zip(make_zip(content, zipios::StorageMethod::DEFLATED));
+        zipios::InflateIndex::pointer_t index(std::make_shared<zipios::InflateIndex>(64 * 1024));
+
+        CATCH_WHEN("the entry is read once")
+        {
+            {
+                zipios::ZipInputStreambuf buf(zip.rdbuf(), 0, index);
+                std::istream is(&buf);
+                CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == content);
+            }
+
+            CATCH_THEN("access points were added and seeking uses them")
+            {
+                CATCH_REQUIRE(index->size() >= 3);
+
+                // the access points are at block boundaries, which
+                // are rarely on a byte boundary
+                //
+                bool partial_byte(false);
+                zipios::InflateIndex::checkpoint_t checkpoint;
+                zipios::offset_t out(static_cast<zipios::offset_t>(content.length()));
+                while(index->findCheckpoint(out, checkpoint))
+                {
+                    CATCH_REQUIRE(checkpoint.m_window.size() == zipios::InflateIndex::WINDOW_SIZE);
+                    partial_byte = partial_byte || checkpoint.m_bits != 0;
+                    out = checkpoint.m_out - 1;
+                }
+                CATCH_REQUIRE(partial_byte);
+
+                zipios::ZipInputStreambuf buf(zip.rdbuf(), 0, index);
+                std::istream is(&buf);
+
+                CATCH_REQUIRE(is.tellg() == 0);
+                uint32_t seed(1);
+                for(int i(0); i < 100; ++i)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    std::size_t const offset(seed % content.length());
+                    std::size_t const size(seed % 5000);
+                    is.seekg(offset);
+                    CATCH_REQUIRE(is);
+                    CATCH_REQUIRE(static_cast<std::size_t>(is.tellg()) == offset);
+                    std::string data(size, '\0');
+                    is.read(&data[0], size);
+                    data.resize(static_cast<std::size_t>(is.gcount()));
+                    CATCH_REQUIRE(data == content.substr(offset, size));
+                    is.clear();
+                }
+
+                is.seekg(-10, std::ios::end);
+                CATCH_REQUIRE(static_cast<std::size_t>(is.tellg()) == content.length() - 10);
+                CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == content.substr(content.length() - 10));
+
+                is.clear();
+                is.seekg(static_cast<std::streamoff>(content.length() + 1));
+                CATCH_REQUIRE_FALSE(is);
+            }
+        }
+    }
+
+    CATCH_GIVEN("a DEFLATED entry read without an index")
+    {
+        std::stringstream zip(make_zip(content, zipios::StorageMethod::DEFLATED));
+
+        CATCH_WHEN("seeking forward and backward")
+        {
+            zipios::ZipInputStreambuf buf(zip.rdbuf(), 0);
+            std::istream is(&buf);
+
+            CATCH_THEN("the data is inflated again from the start")
+            {
+                std::string data(100, '\0');
+                is.seekg(500000);
+                is.read(&data[0], data.length());
+                CATCH_REQUIRE(data == content.substr(500000, 100));
+
+                is.seekg(-200, std::ios::cur);
+                is.read(&data[0], data.length());
+                CATCH_REQUIRE(data == content.substr(499900, 100));
+
+                is.seekg(1000);
+                is.read(&data[0], data.length());
+                CATCH_REQUIRE(data == content.substr(1000, 100));
+            }
+        }
+    }
+
+    CATCH_GIVEN("a STORED entry")
+    {
+        std::stringstream zip(make_zip(content, zipios::StorageMethod::STORED));
+
+        CATCH_WHEN("seeking forward and backward")
+        {
+            zipios::ZipInputStreambuf buf(zip.rdbuf(), 0);
+            std::istream is(&buf);
+
+            CATCH_THEN("the input is repositioned directly")
+            {
+                std::string data(100, '\0');
+                is.seekg(600000);
+                is.read(&data[0], data.length());
+                CATCH_REQUIRE(data == content.substr(600000, 100));
+                CATCH_REQUIRE(is.tellg() == 600100);
+
+                is.seekg(-50, std::ios::cur);
+                is.read(&data[0], data.length());
+                CATCH_REQUIRE(data == content.substr(600050, 100));
+
+                is.seekg(-100, std::ios::end);
+                CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()) == content.substr(content.length() - 100));
+
+                is.clear();
+                is.seekg(-1, std::ios::beg);
+                CATCH_REQUIRE_FALSE(is);
+            }
+        }
+    }
+}
+
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -0,0 +1,167 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the StreamPool class.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/streampool.hpp>
+#include <src/zipoutputstream.hpp>
+#include <zipios/streamentry.hpp>
+#include <zipios/zipfile.hpp>
+
+#include <fstream>
+
+
+CATCH_SCENARIO("StreamPool recycles objects", "[StreamPool]")
+{
+    CATCH_GIVEN("an inflate stream")
+    {
+        z_stream * zs(zipios::StreamPool::acquireInflate());
+        CATCH_REQUIRE(zs != nullptr);
+
+        CATCH_WHEN("it gets released")
+        {
+            zipios::StreamPool::releaseInflate(zs);
+
+            CATCH_THEN("the next acquisition returns the same stream")
+            {
+                z_stream * again(zipios::StreamPool::acquireInflate());
+                CATCH_REQUIRE(again == zs);
+                zipios::StreamPool::releaseInflate(again);
+
+                // releasing nullptr is ignored
+                //
+                zipios::StreamPool::releaseInflate(nullptr);
+            }
+        }
+    }
+
+    CATCH_GIVEN("a deflate stream")
+    {
+        z_stream * zs(zipios::StreamPool::acquireDeflate(1));
+        CATCH_REQUIRE(zs != nullptr);
+
+        CATCH_WHEN("it gets released")
+        {
+            zipios::StreamPool::releaseDeflate(zs, 1);
+
+            CATCH_THEN("it is only reused for the same level")
+            {
+                z_stream * other(zipios::StreamPool::acquireDeflate(9));
+                CATCH_REQUIRE(other != zs);
+
+                z_stream * again(zipios::StreamPool::acquireDeflate(1));
+                CATCH_REQUIRE(again == zs);
+
+                zipios::StreamPool::releaseDeflate(other, 9);
+                zipios::StreamPool::releaseDeflate(again, 1);
+                zipios::StreamPool::releaseDeflate(nullptr, 1);
+            }
+        }
+    }
+
+    CATCH_GIVEN("an I/O buffer")
+    {
+        std::vector<char> buffer(zipios::StreamPool::acquireBuffer());
+        CATCH_REQUIRE(buffer.size() == zipios::getBufferSize());
+        char const * data(buffer.data());
+
+        CATCH_WHEN("it gets released")
+        {
+            zipios::StreamPool::releaseBuffer(buffer);
+            CATCH_REQUIRE(buffer.empty());
+
+            CATCH_THEN("its memory gets reused")
+            {
+                std::vector<char> again(zipios::StreamPool::acquireBuffer());
+                CATCH_REQUIRE(again.size() == zipios::getBufferSize());
+                CATCH_REQUIRE(again.data() == data);
+                zipios::StreamPool::releaseBuffer(again);
+
+                // buffers of the wrong size are not kept
+                //
+                std::vector<char> small(10);
+                zipios::StreamPool::releaseBuffer(small);
+                CATCH_REQUIRE(small.empty());
+                std::vector<char> next(zipios::StreamPool::acquireBuffer());
+                CATCH_REQUIRE(next.size() == zipios::getBufferSize());
+                zipios::StreamPool::releaseBuffer(next);
+            }
+        }
+    }
+}
+
+
+CATCH_TEST_CASE("StreamPool with many small entries", "[StreamPool] [ZipFile]")
+{
+    CATCH_START_SECTION("write and read back entries using pooled streams")
+    {
+        zipios_test::auto_unlink_t auto_unlink("streampool.zip", true);
+
+        std::vector<std::string> contents;
+        {
+            std::ofstream os("streampool.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            for(int i(0); i < 200; ++i)
+            {
+                std::string content;
+                for(int j(0); j <= i; ++j)
+                {
+                    content += "entry " + std::to_string(i) + " line " + std::to_string(j) + "\n";
+                }
+                contents.push_back(content);
+
+                std::stringstream ss;
+                zipios::StreamEntry entry(ss, zipios::FilePath("file" + std::to_string(i) + ".txt"));
+                entry.setMethod(i % 3 == 0 ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED);
+                entry.setLevel(i % 2 == 0 ? zipios::FileEntry::COMPRESSION_LEVEL_MAXIMUM : zipios::FileEntry::COMPRESSION_LEVEL_MINIMUM);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        zipios::ZipFile zf("streampool.zip");
+        for(int repeat(0); repeat < 3; ++repeat)
+        {
+            for(int i(0); i < 200; ++i)
+            {
+                zipios::ZipFile::stream_pointer_t is(zf.getInputStream("file" + std::to_string(i) + ".txt"));
+                CATCH_REQUIRE(is != nullptr);
+                std::string const data((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+                CATCH_REQUIRE(data == contents[i]);
+            }
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
@@ -26,13 +26,22 @@
 
 #include "catch_main.hpp"
 
+#include <src/zipcentraldirectoryentry.hpp>
+#include <src/zipinputstream.hpp>
+#include <src/zipoutputstream.hpp>
+
 #include <zipios/zipfile.hpp>
+#include <zipios/collectioncollection.hpp>
 #include <zipios/directorycollection.hpp>
+#include <zipios/streamentry.hpp>
 #include <zipios/zipiosexceptions.hpp>
 #include <zipios/dosdatetime.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <map>
+#include <thread>
 
 #include <unistd.h>
 #include <string.h>
@@ -856,13 +865,16 @@ CATCH_SCENARIO("use Zipios to create zip archives with 1 or 3 files each", "[Zip
                 dc.addEntry(other_entry);
             }
 
-            CATCH_THEN("the creating of the zip archive fails: too many file entries")
+            CATCH_THEN("the zip archive gets created with a ZIP64 End of Central Directory")
             {
                 zipios_test::auto_unlink_t remove_zip("file.zip", true);
                 {
                     std::ofstream out("file.zip", std::ios::out | std::ios::binary);
-                    CATCH_REQUIRE_THROWS_AS(zipios::ZipFile::saveCollectionToArchive(out, dc), zipios::InvalidStateException);
+                    zipios::ZipFile::saveCollectionToArchive(out, dc);
                 }
+
+                zipios::ZipFile zf("file.zip");
+                CATCH_REQUIRE(zf.size() == static_cast<std::size_t>(max + 1));
             }
         }
     }
@@ -1252,6 +1264,82 @@ struct end_of_central_directory_t
 };
 
 
+struct zip64_end_of_central_directory_t
+{
+    uint32_t            m_signature;        // "PK 6.6"
+    uint64_t            m_record_size;      // size of the record minus 12
+    uint16_t            m_version;
+    uint16_t            m_extract_version;
+    uint32_t            m_disk_number;
+    uint32_t            m_disk_start;
+    uint64_t            m_file_count;       // number of files in this archive
+    uint64_t            m_total_count;      // total number across all split files
+    uint64_t            m_central_directory_size;
+    uint64_t            m_central_directory_offset;
+
+    zip64_end_of_central_directory_t()
+        : m_signature(0x06064B50)
+        , m_record_size(56 - 12)
+        , m_version(45)
+        , m_extract_version(45)
+        , m_disk_number(0)
+        , m_disk_start(0)
+        , m_file_count(0)
+        , m_total_count(0)
+        , m_central_directory_size(0)
+        , m_central_directory_offset(0)
+    {
+    }
+
+    static void write_value(std::ostream& os, uint64_t value, int size)
+    {
+        for(int i(0); i < size; ++i)
+        {
+            os << static_cast<unsigned char>(value >> (i * 8));
+        }
+    }
+
+    void write(std::ostream& os)
+    {
+        write_value(os, m_signature, 4);
+        write_value(os, m_record_size, 8);
+        write_value(os, m_version, 2);
+        write_value(os, m_extract_version, 2);
+        write_value(os, m_disk_number, 4);
+        write_value(os, m_disk_start, 4);
+        write_value(os, m_file_count, 8);
+        write_value(os, m_total_count, 8);
+        write_value(os, m_central_directory_size, 8);
+        write_value(os, m_central_directory_offset, 8);
+    }
+};
+
+
+struct zip64_end_of_central_directory_locator_t
+{
+    uint32_t            m_signature;        // "PK 6.7"
+    uint32_t            m_disk_number;
+    uint64_t            m_zip64_offset;     // offset of the ZIP64 End of Central Directory
+    uint32_t            m_total_disks;
+
+    zip64_end_of_central_directory_locator_t()
+        : m_signature(0x07064B50)
+        , m_disk_number(0)
+        , m_zip64_offset(0)
+        , m_total_disks(1)
+    {
+    }
+
+    void write(std::ostream& os)
+    {
+        zip64_end_of_central_directory_t::write_value(os, m_signature, 4);
+        zip64_end_of_central_directory_t::write_value(os, m_disk_number, 4);
+        zip64_end_of_central_directory_t::write_value(os, m_zip64_offset, 8);
+        zip64_end_of_central_directory_t::write_value(os, m_total_disks, 4);
+    }
+};
+
+
 CATCH_TEST_CASE("valid_and_invalid_zipfile_archives", "[ZipFile][FileCollection]")
 {
     zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
@@ -1752,6 +1840,2197 @@ CATCH_TEST_CASE("saveCollectionToArchive_with_DirectoryCollection", "[ZipFile][D
 }
 
 
+CATCH_TEST_CASE("zipfile_shared_file_descriptor", "[ZipFile][FileCollection]")
+{
+    CATCH_START_SECTION("zipfile_shared_file_descriptor: read entries after the archive was renamed and closed")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/shared-file");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        std::string cache_bin;
+        std::string cache_text;
+        {
+            std::ofstream file_bin("test_dir/file1.bin", std::ios::out | std::ios::binary);
+            size_t const size(20000 + rand() % 512);
+            for(size_t pos(0); pos < size; ++pos)
+            {
+                char const c(static_cast<char>(rand()));
+                file_bin << c;
+                cache_bin += c;
+            }
+
+            std::ofstream file_text("test_dir/file2.text", std::ios::out | std::ios::binary);
+            size_t const length(50000 + rand() % 512);
+            for(size_t pos(0); pos < length; ++pos)
+            {
+                char const c(pos % 40 == 39 ? '\n' : rand() % 26 + 'a');
+                file_text << c;
+                cache_text += c;
+            }
+        }
+
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            dc.setMethod(1024, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::FileCollection::stream_pointer_t is_bin;
+        zipios::FileCollection::stream_pointer_t is_text;
+        {
+            zipios::ZipFile zf("test.zip");
+            is_bin = zf.getInputStream("file1.bin", zipios::FileCollection::MatchPath::IGNORE);
+            is_text = zf.getInputStream("file2.text", zipios::FileCollection::MatchPath::IGNORE);
+            CATCH_REQUIRE(is_bin);
+            CATCH_REQUIRE(is_text);
+
+            // the streams use the file opened by the ZipFile
+            //
+            CATCH_REQUIRE(rename("test.zip", "renamed.zip") == 0);
+            zipios::FileCollection::stream_pointer_t is_again(zf.getInputStream("file1.bin", zipios::FileCollection::MatchPath::IGNORE));
+            CATCH_REQUIRE(is_again);
+            CATCH_REQUIRE(is_again->get() == static_cast<unsigned char>(cache_bin[0]));
+        }
+        CATCH_REQUIRE(unlink("renamed.zip") == 0);
+
+        // read both entries in an interleaved manner
+        //
+        std::string data_bin;
+        std::string data_text;
+        while(*is_bin || *is_text)
+        {
+            char buf[1000];
+            if(*is_bin)
+            {
+                is_bin->read(buf, sizeof(buf));
+                data_bin += std::string(buf, is_bin->gcount());
+            }
+            if(*is_text)
+            {
+                is_text->read(buf, sizeof(buf));
+                data_text += std::string(buf, is_text->gcount());
+            }
+        }
+        CATCH_REQUIRE(data_bin == cache_bin);
+        CATCH_REQUIRE(data_text == cache_text);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_memory_map", "[ZipFile][FileCollection]")
+{
+    CATCH_START_SECTION("zipfile_memory_map: read STORED and DEFLATED entries from a memory mapped archive")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/memory-map");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        std::string cache_bin;
+        std::string cache_text;
+        {
+            std::ofstream file_bin("test_dir/file1.bin", std::ios::out | std::ios::binary);
+            size_t const size(30000 + rand() % 512);
+            for(size_t pos(0); pos < size; ++pos)
+            {
+                char const c(static_cast<char>(rand()));
+                file_bin << c;
+                cache_bin += c;
+            }
+
+            std::ofstream file_text("test_dir/file2.text", std::ios::out | std::ios::binary);
+            size_t const length(30000 + rand() % 512);
+            for(size_t pos(0); pos < length; ++pos)
+            {
+                char const c(pos % 40 == 39 ? '\n' : rand() % 26 + 'a');
+                file_text << c;
+                cache_text += c;
+            }
+        }
+
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            zipios::FileEntry::vector_t v(dc.entries());
+            for(auto it(v.begin()); it != v.end(); ++it)
+            {
+                (*it)->setMethod((*it)->getName() == "test_dir/file1.bin"
+                                    ? zipios::StorageMethod::STORED
+                                    : zipios::StorageMethod::DEFLATED);
+            }
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile zf_default("test.zip");
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP);
+
+        // both modes find the same entries
+        //
+        CATCH_REQUIRE(zf.size() == zf_default.size());
+        zipios::FileEntry::vector_t v_default(zf_default.entries());
+        zipios::FileEntry::vector_t v(zf.entries());
+        for(size_t idx(0); idx < v.size(); ++idx)
+        {
+            CATCH_REQUIRE(v[idx]->isEqual(*v_default[idx]));
+        }
+
+        // STORED data is available directly
+        //
+        char const * data(nullptr);
+        std::size_t size(0);
+        CATCH_REQUIRE(zf.getStoredData("test_dir/file1.bin", data, size));
+        CATCH_REQUIRE(size == cache_bin.length());
+        CATCH_REQUIRE(memcmp(data, cache_bin.c_str(), size) == 0);
+
+        CATCH_REQUIRE_FALSE(zf.getStoredData("test_dir/file2.text", data, size));
+        CATCH_REQUIRE_FALSE(zf.getStoredData("test_dir/unknown", data, size));
+        CATCH_REQUIRE_FALSE(zf_default.getStoredData("test_dir/file1.bin", data, size));
+
+        // the streams return the same data in both modes
+        //
+        {
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("file1.bin", zipios::FileCollection::MatchPath::IGNORE));
+            CATCH_REQUIRE(is);
+            std::string const content((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(content == cache_bin);
+
+            is->clear();
+            is->seekg(100);
+            CATCH_REQUIRE(is->get() == static_cast<unsigned char>(cache_bin[100]));
+        }
+        {
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("file2.text", zipios::FileCollection::MatchPath::IGNORE));
+            CATCH_REQUIRE(is);
+            std::string const content((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(content == cache_text);
+        }
+
+        // streams keep the mapping alive
+        //
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("file1.bin", zipios::FileCollection::MatchPath::IGNORE));
+        zf.close();
+        std::string const content((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+        CATCH_REQUIRE(content == cache_bin);
+
+        // a truncated archive is still detected
+        //
+        CATCH_REQUIRE(truncate("test.zip", 200) == 0);
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_local_header_validation", "[ZipFile][FileCollection]")
+{
+    CATCH_START_SECTION("zipfile_local_header_validation: lazy and parallel validation of the local headers")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/local-header-validation");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        // enough entries for the parallel validation to use threads
+        //
+        for(int i(0); i < 600; ++i)
+        {
+            std::ofstream file("test_dir/f" + std::to_string(i) + ".txt", std::ios::out | std::ios::binary);
+            file << "content of file #" << i << "\n";
+        }
+
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile zf_default("test.zip");
+        zipios::ZipFile zf_lazy("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_LAZY_VALIDATION);
+        zipios::ZipFile zf_parallel("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_PARALLEL_VALIDATION);
+        zipios::ZipFile zf_mapped("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP | zipios::ZipFile::OPEN_MODE_PARALLEL_VALIDATION);
+
+        CATCH_REQUIRE(zf_default.size() == 601);
+        CATCH_REQUIRE(zf_lazy.size() == zf_default.size());
+        CATCH_REQUIRE(zf_parallel.size() == zf_default.size());
+        CATCH_REQUIRE(zf_mapped.size() == zf_default.size());
+        for(int i(0); i < 600; i += 37)
+        {
+            std::string const name("test_dir/f" + std::to_string(i) + ".txt");
+            std::string const expected("content of file #" + std::to_string(i) + "\n");
+
+            zipios::FileCollection::stream_pointer_t is_lazy(zf_lazy.getInputStream(name));
+            CATCH_REQUIRE(is_lazy);
+            CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is_lazy)), std::istreambuf_iterator<char>()) == expected);
+
+            zipios::FileCollection::stream_pointer_t is_parallel(zf_parallel.getInputStream(name));
+            CATCH_REQUIRE(is_parallel);
+            CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is_parallel)), std::istreambuf_iterator<char>()) == expected);
+        }
+
+        // corrupt the date of one local header
+        //
+        {
+            std::fstream file("test.zip", std::ios::in | std::ios::out | std::ios::binary);
+            std::string const content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            std::string const header(std::string("PK\x03\x04", 4));
+            std::string const name("test_dir/f321.txt");
+            std::string::size_type pos(content.find(header));
+            while(pos != std::string::npos
+               && content.compare(pos + 30, name.length(), name) != 0)
+            {
+                pos = content.find(header, pos + 1);
+            }
+            CATCH_REQUIRE(pos != std::string::npos);
+            file.clear();
+            file.seekp(pos + 10);
+            file.put(static_cast<char>(content[pos + 10] ^ 0x01));
+        }
+
+        // the default and parallel modes refuse to open the archive
+        //
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("test.zip"), zipios::FileCollectionException);
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_PARALLEL_VALIDATION), zipios::FileCollectionException);
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP), zipios::FileCollectionException);
+
+        // the lazy mode opens it and only fails on the corrupted entry
+        //
+        zipios::ZipFile zf("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_LAZY_VALIDATION);
+        CATCH_REQUIRE(zf.size() == 601);
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("test_dir/f320.txt"));
+        CATCH_REQUIRE(is);
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>()) == "content of file #320\n");
+        CATCH_REQUIRE_THROWS_AS(zf.getInputStream("test_dir/f321.txt"), zipios::FileCollectionException);
+        CATCH_REQUIRE_THROWS_AS(zf.getInputStream("test_dir/f321.txt"), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_long_comment", "[ZipFile][FileCollection]")
+{
+    CATCH_START_SECTION("zipfile_long_comment: find the End of Central Directory before a long comment")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/long-comment");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir + "/test_dir").c_str()) == 0);
+        zipios_test::safe_chdir cwd(top_dir);
+
+        {
+            std::ofstream file("test_dir/file.txt", std::ios::out | std::ios::binary);
+            file << "small file\n";
+        }
+
+        // the comment is as long as possible
+        //
+        std::string const comment(65535, 'c');
+        {
+            zipios::DirectoryCollection dc("test_dir");
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc, comment);
+        }
+
+        zipios::ZipFile zf("test.zip");
+        zipios::ZipFile zf_mapped("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP);
+        CATCH_REQUIRE(zf.size() == 2);
+        CATCH_REQUIRE(zf_mapped.size() == 2);
+
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("test_dir/file.txt"));
+        CATCH_REQUIRE(is);
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>()) == "small file\n");
+
+        // with a few more bytes the End of Central Directory is out of reach
+        //
+        {
+            std::ofstream out("test.zip", std::ios::out | std::ios::binary | std::ios::app);
+            out << std::string(100, '!');
+        }
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("test.zip"), zipios::FileCollectionException);
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("test.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_zip64_archive", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    std::string const content("This entry is saved in a ZIP64 archive.\n");
+    uint32_t const content_crc32(0xE8424CCF);
+
+    // create an archive where all the sizes and offsets are saved in
+    // the ZIP64 structures (0xFFFF... in the 16 and 32 bit fields)
+    //
+    auto create_archive = [&](uint64_t zip64_offset_adjustment)
+    {
+        std::ofstream os("zip64.zip", std::ios::out | std::ios::binary);
+
+        local_header_t lh;
+        lh.m_version = 45;
+        lh.m_crc32 = content_crc32;
+        lh.m_compressed_size = 0xFFFFFFFF;
+        lh.m_uncompressed_size = 0xFFFFFFFF;
+        lh.m_filename = "zip64.txt";
+        {
+            std::stringstream extra;
+            zip64_end_of_central_directory_t::write_value(extra, 0x0001, 2);
+            zip64_end_of_central_directory_t::write_value(extra, 16, 2);
+            zip64_end_of_central_directory_t::write_value(extra, content.length(), 8);
+            zip64_end_of_central_directory_t::write_value(extra, content.length(), 8);
+            std::string const e(extra.str());
+            lh.m_extra_field.assign(e.begin(), e.end());
+        }
+        lh.write(os);
+        os << content;
+
+        uint64_t const cd_offset(os.tellp());
+        central_directory_header_t cdh;
+        cdh.m_version = 45;
+        cdh.m_extract_version = 45;
+        cdh.m_time_and_date = lh.m_time_and_date;
+        cdh.m_crc32 = content_crc32;
+        cdh.m_compressed_size = 0xFFFFFFFF;
+        cdh.m_uncompressed_size = 0xFFFFFFFF;
+        cdh.m_relative_offset_to_local_header = 0xFFFFFFFF;
+        cdh.m_filename = "zip64.txt";
+        {
+            std::stringstream extra;
+            zip64_end_of_central_directory_t::write_value(extra, 0x0001, 2);
+            zip64_end_of_central_directory_t::write_value(extra, 24, 2);
+            zip64_end_of_central_directory_t::write_value(extra, content.length(), 8);
+            zip64_end_of_central_directory_t::write_value(extra, content.length(), 8);
+            zip64_end_of_central_directory_t::write_value(extra, 0, 8);
+            std::string const e(extra.str());
+            cdh.m_extra_field.assign(e.begin(), e.end());
+        }
+        cdh.write(os);
+
+        uint64_t const zip64_offset(os.tellp());
+        zip64_end_of_central_directory_t zip64_eocd;
+        zip64_eocd.m_file_count = 1;
+        zip64_eocd.m_total_count = 1;
+        zip64_eocd.m_central_directory_size = zip64_offset - cd_offset;
+        zip64_eocd.m_central_directory_offset = cd_offset;
+        zip64_eocd.write(os);
+
+        zip64_end_of_central_directory_locator_t locator;
+        locator.m_zip64_offset = zip64_offset + zip64_offset_adjustment;
+        locator.write(os);
+
+        end_of_central_directory_t eocd;
+        eocd.m_file_count = 0xFFFF;
+        eocd.m_total_count = 0xFFFF;
+        eocd.m_central_directory_size = 0xFFFFFFFF;
+        eocd.m_central_directory_offset = 0xFFFFFFFF;
+        eocd.write(os);
+    };
+
+    CATCH_START_SECTION("zipfile_zip64_archive: read a ZIP64 archive")
+    {
+        zipios_test::auto_unlink_t auto_unlink("zip64.zip", true);
+        create_archive(0);
+
+        zipios::ZipFile zf("zip64.zip");
+        zipios::ZipFile zf_mapped("zip64.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP);
+
+        CATCH_REQUIRE(zf.size() == 1);
+        CATCH_REQUIRE(zf_mapped.size() == 1);
+
+        zipios::FileEntry::pointer_t entry(zf.getEntry("zip64.txt"));
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getSize() == content.length());
+        CATCH_REQUIRE(entry->getCompressedSize() == content.length());
+        CATCH_REQUIRE(entry->getEntryOffset() == 0);
+        CATCH_REQUIRE(entry->getCrc() == content_crc32);
+
+        zipios::FileCollection::stream_pointer_t is(zf.getInputStream("zip64.txt"));
+        CATCH_REQUIRE(is);
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>()) == content);
+
+        zipios::FileCollection::stream_pointer_t is_mapped(zf_mapped.getInputStream("zip64.txt"));
+        CATCH_REQUIRE(is_mapped);
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is_mapped)), std::istreambuf_iterator<char>()) == content);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_zip64_archive: a locator pointing to the wrong place fails")
+    {
+        zipios_test::auto_unlink_t auto_unlink("zip64.zip", true);
+        create_archive(1);
+
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("zip64.zip"), zipios::FileCollectionException);
+        CATCH_REQUIRE_THROWS_AS(zipios::ZipFile("zip64.zip", 0, 0, zipios::ZipFile::OPEN_MODE_MEMORY_MAP), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+// Output buffer used to write entries of more than 4Gb without using
+// that much memory or disk space: the large writes (the data of the
+// entries) only move the position, the small writes (the headers) are
+// saved so the test can read them back
+class sparse_streambuf_t
+    : public std::streambuf
+{
+public:
+    std::string get(std::streamoff pos, std::size_t size) const
+    {
+        std::string result(size, '\0');
+        for(std::size_t idx(0); idx < size; ++idx)
+        {
+            auto it(m_bytes.find(pos + static_cast<std::streamoff>(idx)));
+            if(it != m_bytes.end())
+            {
+                result[idx] = it->second;
+            }
+        }
+        return result;
+    }
+
+    std::streamoff size() const
+    {
+        return m_size;
+    }
+
+protected:
+    virtual std::streamsize xsputn(char const * s, std::streamsize n) override
+    {
+        if(n < 1024)
+        {
+            for(std::streamsize idx(0); idx < n; ++idx)
+            {
+                m_bytes[m_pos + idx] = s[idx];
+            }
+        }
+        m_pos += n;
+        m_size = std::max(m_size, m_pos);
+        return n;
+    }
+
+    virtual int_type overflow(int_type c) override
+    {
+        if(c != traits_type::eof())
+        {
+            char const ch(static_cast<char>(c));
+            xsputn(&ch, 1);
+        }
+        return 0;
+    }
+
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        switch(dir)
+        {
+        case std::ios_base::beg:
+            return seekpos(off, which);
+
+        case std::ios_base::end:
+            return seekpos(m_size + off, which);
+
+        default:
+            return seekpos(m_pos + off, which);
+
+        }
+    }
+
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        static_cast<void>(which);
+        m_pos = pos;
+        return m_pos;
+    }
+
+private:
+    std::map<std::streamoff, char>  m_bytes = std::map<std::streamoff, char>();
+    std::streamoff                  m_pos = 0;
+    std::streamoff                  m_size = 0;
+};
+
+
+CATCH_TEST_CASE("zipfile_zip64_write", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    CATCH_START_SECTION("zipfile_zip64_write: write and read back an archive with more than 65535 entries")
+    {
+        zipios_test::auto_unlink_t auto_unlink("many.zip", true);
+
+        std::size_t const count(70000);
+        {
+            std::ofstream os("many.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(std::size_t i(0); i < count; ++i)
+            {
+                zipios::StreamEntry entry(ss, zipios::FilePath("e" + std::to_string(i) + ".txt"));
+                entry.setMethod(zipios::StorageMethod::STORED);
+                zos.putNextEntry(entry.clone());
+                zos << "entry #" << i << "\n";
+            }
+            zos.closeEntry();
+            zos.finish();
+        }
+
+        // the End of Central Directory only has escaped values
+        //
+        {
+            std::ifstream is("many.zip", std::ios::in | std::ios::binary);
+            is.seekg(-22, std::ios::end);
+            char eocd[22];
+            CATCH_REQUIRE(is.read(eocd, sizeof(eocd)));
+            CATCH_REQUIRE(static_cast<unsigned char>(eocd[8]) == 0xFF);
+            CATCH_REQUIRE(static_cast<unsigned char>(eocd[9]) == 0xFF);
+            CATCH_REQUIRE(static_cast<unsigned char>(eocd[16]) == 0xFF);
+            CATCH_REQUIRE(static_cast<unsigned char>(eocd[19]) == 0xFF);
+        }
+
+        zipios::ZipFile zf("many.zip");
+        CATCH_REQUIRE(zf.size() == count);
+        for(std::size_t i(0); i < count; i += 997)
+        {
+            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("e" + std::to_string(i) + ".txt"));
+            CATCH_REQUIRE(is);
+            CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>()) == "entry #" + std::to_string(i) + "\n");
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_zip64_write: stream an entry without a size hint over 4Gb")
+    {
+        std::size_t const data_size(0x100000000ULL + 0x10000);
+
+        sparse_streambuf_t sparse;
+        {
+            std::ostream os(&sparse);
+            zipios::ZipOutputStream zos(os);
+
+            // the stream is empty so the entry has no size hint
+            //
+            std::stringstream ss;
+            zipios::StreamEntry entry(ss, zipios::FilePath("streamed.bin"));
+            CATCH_REQUIRE(entry.getSize() == 0);
+            entry.setMethod(zipios::StorageMethod::STORED);
+            zos.putNextEntry(entry.clone());
+
+            std::vector<char> const zeroes(1024 * 1024);
+            std::size_t remaining(data_size);
+            while(remaining > 0)
+            {
+                std::size_t const size(std::min(remaining, zeroes.size()));
+                zos.write(zeroes.data(), static_cast<std::streamsize>(size));
+                remaining -= size;
+            }
+            zos.closeEntry();
+            zos.finish();
+        }
+
+        // the local header was rewritten with the 64 bit sizes
+        //
+        std::stringstream lh(sparse.get(0, 1024));
+        zipios::ZipLocalEntry local_entry;
+        local_entry.read(lh);
+        CATCH_REQUIRE(local_entry.getName() == "streamed.bin");
+        CATCH_REQUIRE(local_entry.isZip64());
+        CATCH_REQUIRE(local_entry.getSize() == data_size);
+        CATCH_REQUIRE(local_entry.getCompressedSize() == data_size);
+
+        // the Central Directory follows the data
+        //
+        std::streamoff const cd_offset(local_entry.getHeaderSize() + data_size);
+        CATCH_REQUIRE(sparse.size() > cd_offset);
+        std::string const cd(sparse.get(cd_offset, static_cast<std::size_t>(sparse.size() - cd_offset)));
+        zipios::ZipCentralDirectoryEntry cd_entry;
+        std::size_t pos(0);
+        cd_entry.read(reinterpret_cast<unsigned char const *>(cd.c_str()), cd.length(), pos);
+        CATCH_REQUIRE(cd_entry.getName() == "streamed.bin");
+        CATCH_REQUIRE(cd_entry.getSize() == data_size);
+        CATCH_REQUIRE(cd_entry.getCompressedSize() == data_size);
+        CATCH_REQUIRE(cd_entry.getEntryOffset() == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_zip64_write: headers with sizes and offset over 4Gb")
+    {
+        std::stringstream ss;
+        zipios::StreamEntry source(ss, zipios::FilePath("large.bin"));
+        zipios::ZipCentralDirectoryEntry entry(source);
+        entry.setSize(0x140000000ULL);
+        entry.setCompressedSize(0x120000000ULL);
+        entry.setEntryOffset(0x180000000LL);
+        entry.setZip64(true);
+
+        // Central Directory entry
+        {
+            std::stringstream os;
+            entry.write(os);
+            std::string const data(os.str());
+            CATCH_REQUIRE(data.length() == entry.getHeaderSize());
+
+            zipios::ZipCentralDirectoryEntry copy;
+            std::size_t pos(0);
+            copy.read(reinterpret_cast<unsigned char const *>(data.c_str()), data.length(), pos);
+            CATCH_REQUIRE(pos == data.length());
+            CATCH_REQUIRE(copy.getSize() == 0x140000000ULL);
+            CATCH_REQUIRE(copy.getCompressedSize() == 0x120000000ULL);
+            CATCH_REQUIRE(copy.getEntryOffset() == 0x180000000LL);
+            CATCH_REQUIRE(copy.getExtra().empty());
+        }
+
+        // local header
+        {
+            std::stringstream os;
+            entry.ZipLocalEntry::write(os);
+            std::string const data(os.str());
+            CATCH_REQUIRE(data.length() == entry.ZipLocalEntry::getHeaderSize());
+
+            zipios::ZipLocalEntry copy;
+            copy.read(os);
+            CATCH_REQUIRE(copy.getSize() == 0x140000000ULL);
+            CATCH_REQUIRE(copy.getCompressedSize() == 0x120000000ULL);
+            CATCH_REQUIRE(copy.getName() == "large.bin");
+        }
+
+        // without the ZIP64 reservation, the local header cannot be saved
+        //
+        entry.setZip64(false);
+        std::stringstream os;
+        CATCH_REQUIRE_THROWS_AS(entry.ZipLocalEntry::write(os), zipios::InvalidStateException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_concurrent_reads", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    CATCH_START_SECTION("zipfile_concurrent_reads: many threads reading entries from the same ZipFile")
+    {
+        zipios_test::auto_unlink_t auto_unlink("concurrent.zip", true);
+
+        // entries of various sizes, STORED and DEFLATED
+        //
+        std::size_t const count(200);
+        std::vector<std::string> contents;
+        {
+            std::ofstream os("concurrent.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(std::size_t i(0); i < count; ++i)
+            {
+                std::string content;
+                std::size_t const lines(i * 37 % 1500 + 1);
+                for(std::size_t l(0); l < lines; ++l)
+                {
+                    content += "entry #" + std::to_string(i) + " line #" + std::to_string(l) + "\n";
+                }
+                contents.push_back(content);
+
+                zipios::StreamEntry entry(ss, zipios::FilePath("c" + std::to_string(i) + ".txt"));
+                entry.setMethod(g_supported_storage_methods[i % 2]);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        zipios::ZipFile::OpenMode const modes[]
+        {
+            zipios::ZipFile::OPEN_MODE_DEFAULT,
+            zipios::ZipFile::OPEN_MODE_MEMORY_MAP,
+            zipios::ZipFile::OPEN_MODE_LAZY_VALIDATION,
+            zipios::ZipFile::OPEN_MODE_MEMORY_MAP | zipios::ZipFile::OPEN_MODE_LAZY_VALIDATION,
+        };
+        for(auto const mode : modes)
+        {
+            zipios::ZipFile zf("concurrent.zip", 0, 0, mode);
+            CATCH_REQUIRE(zf.size() == count);
+
+            std::atomic<std::size_t> failures(0);
+            std::atomic<std::size_t> reads(0);
+            std::vector<std::thread> threads;
+            for(std::size_t t(0); t < 16; ++t)
+            {
+                threads.emplace_back([&zf, &contents, &failures, &reads, t]()
+                    {
+                        try
+                        {
+                            std::size_t idx(t * 13);
+                            for(std::size_t r(0); r < 250; ++r)
+                            {
+                                idx = (idx * 1103515245 + 12345) % count;
+                                std::string const name("c" + std::to_string(idx) + ".txt");
+
+                                zipios::FileEntry::pointer_t entry(zf.getEntry(name));
+                                if(entry == nullptr
+                                || entry->getSize() != contents[idx].length())
+                                {
+                                    ++failures;
+                                    continue;
+                                }
+
+                                zipios::FileCollection::stream_pointer_t is(zf.getInputStream(name));
+                                if(is == nullptr
+                                || std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>()) != contents[idx])
+                                {
+                                    ++failures;
+                                    continue;
+                                }
+                                ++reads;
+                            }
+                        }
+                        catch(std::exception const &)
+                        {
+                            ++failures;
+                        }
+                    });
+            }
+            for(auto & th : threads)
+            {
+                th.join();
+            }
+
+            CATCH_REQUIRE(failures == 0);
+            CATCH_REQUIRE(reads == 16 * 250);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_decompressed_cache", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    CATCH_START_SECTION("zipfile_decompressed_cache: repeated reads come from the cache")
+    {
+        zipios_test::auto_unlink_t auto_unlink("cached.zip", true);
+
+        std::size_t const count(10);
+        std::vector<std::string> contents;
+        {
+            std::ofstream os("cached.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(std::size_t i(0); i < count; ++i)
+            {
+                // 1,000 bytes per entry
+                //
+                std::string content;
+                for(std::size_t l(0); l < 100; ++l)
+                {
+                    content += "entry #" + std::to_string(i) + "\n";
+                }
+                content.resize(1000, '.');
+                contents.push_back(content);
+
+                zipios::StreamEntry entry(ss, zipios::FilePath("d" + std::to_string(i) + ".txt"));
+                entry.setMethod(zipios::StorageMethod::DEFLATED);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        zipios::ZipFile zf("cached.zip");
+        CATCH_REQUIRE(zf.getCacheBudget() == 0);
+
+        auto read_entry = [&zf](std::size_t idx)
+            {
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream("d" + std::to_string(idx) + ".txt"));
+                CATCH_REQUIRE(is);
+                return std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+            };
+
+        // no cache by default
+        //
+        CATCH_REQUIRE(read_entry(0) == contents[0]);
+        zipios::ZipFile::CacheStatistics statistics(zf.getCacheStatistics());
+        CATCH_REQUIRE(statistics.m_hits == 0);
+        CATCH_REQUIRE(statistics.m_misses == 0);
+
+        // room for 3 entries
+        //
+        zf.setCacheBudget(3500);
+        CATCH_REQUIRE(zf.getCacheBudget() == 3500);
+        for(std::size_t i(0); i < 3; ++i)
+        {
+            CATCH_REQUIRE(read_entry(i) == contents[i]);
+            CATCH_REQUIRE(read_entry(i) == contents[i]);
+        }
+        statistics = zf.getCacheStatistics();
+        CATCH_REQUIRE(statistics.m_hits == 3);
+        CATCH_REQUIRE(statistics.m_misses == 3);
+        CATCH_REQUIRE(statistics.m_entries == 3);
+        CATCH_REQUIRE(statistics.m_size == 3000);
+
+        // a stream keeps its data even if the entry gets evicted
+        //
+        zipios::FileCollection::stream_pointer_t is0(zf.getInputStream("d0.txt"));
+        CATCH_REQUIRE(is0);
+        CATCH_REQUIRE(read_entry(3) == contents[3]);
+        CATCH_REQUIRE(read_entry(4) == contents[4]);
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is0)), std::istreambuf_iterator<char>()) == contents[0]);
+
+        statistics = zf.getCacheStatistics();
+        CATCH_REQUIRE(statistics.m_hits == 4);
+        CATCH_REQUIRE(statistics.m_misses == 5);
+        CATCH_REQUIRE(statistics.m_evictions == 2);
+        CATCH_REQUIRE(statistics.m_entries == 3);
+
+        // cached streams can seek
+        //
+        zipios::FileCollection::stream_pointer_t is4(zf.getInputStream("d4.txt"));
+        CATCH_REQUIRE(is4);
+        is4->seekg(-4, std::ios::end);
+        CATCH_REQUIRE(std::string((std::istreambuf_iterator<char>(*is4)), std::istreambuf_iterator<char>()) == "....");
+
+        // entries larger than the budget are read but not cached
+        //
+        zf.setCacheBudget(999);
+        statistics = zf.getCacheStatistics();
+        CATCH_REQUIRE(statistics.m_entries == 0);
+        CATCH_REQUIRE(read_entry(5) == contents[5]);
+        CATCH_REQUIRE(read_entry(5) == contents[5]);
+        CATCH_REQUIRE(zf.getCacheStatistics().m_entries == 0);
+
+        // many threads hitting a cache smaller than the archive
+        //
+        zf.setCacheBudget(5000);
+        std::atomic<std::size_t> failures(0);
+        std::vector<std::thread> threads;
+        for(std::size_t t(0); t < 8; ++t)
+        {
+            threads.emplace_back([&zf, &contents, &failures, t]()
+                {
+                    try
+                    {
+                        for(std::size_t r(0); r < 500; ++r)
+                        {
+                            std::size_t const idx((r * 3 + t) % count);
+                            zipios::FileCollection::stream_pointer_t is(zf.getInputStream("d" + std::to_string(idx) + ".txt"));
+                            if(is == nullptr
+                            || std::string((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>()) != contents[idx])
+                            {
+                                ++failures;
+                            }
+                        }
+                    }
+                    catch(std::exception const &)
+                    {
+                        ++failures;
+                    }
+                });
+        }
+        for(auto & th : threads)
+        {
+            th.join();
+        }
+        CATCH_REQUIRE(failures == 0);
+        statistics = zf.getCacheStatistics();
+        CATCH_REQUIRE(statistics.m_size <= 5000);
+        CATCH_REQUIRE(statistics.m_hits > 0);
+
+        // the cache is shared with the clones, destroying or closing
+        // one of them does not clear it
+        //
+        std::size_t const entries(zf.getCacheStatistics().m_entries);
+        CATCH_REQUIRE(entries > 0);
+        {
+            zipios::FileCollection::pointer_t clone(zf.clone());
+            CATCH_REQUIRE(std::dynamic_pointer_cast<zipios::ZipFile>(clone)->getCacheStatistics().m_entries == entries);
+        }
+        CATCH_REQUIRE(zf.getCacheStatistics().m_entries == entries);
+        {
+            zipios::FileCollection::pointer_t clone(zf.clone());
+            clone->close();
+            CATCH_REQUIRE(zf.getCacheStatistics().m_entries == entries);
+            CATCH_REQUIRE(read_entry(9) == contents[9]);
+        }
+
+        zf.close();
+        CATCH_REQUIRE(zf.getCacheStatistics().m_entries == 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_decompressed_cache: corrupted entries are not cached")
+    {
+        zipios_test::auto_unlink_t auto_unlink("corrupted.zip", true);
+
+        std::string content;
+        for(std::size_t l(0); l < 100; ++l)
+        {
+            content += "line #" + std::to_string(l) + "\n";
+        }
+        {
+            std::ofstream os("corrupted.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(auto const method : g_supported_storage_methods)
+            {
+                zipios::StreamEntry entry(ss, zipios::FilePath(method == zipios::StorageMethod::STORED ? "s.txt" : "d.txt"));
+                entry.setMethod(method);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        // flip one byte in the middle of the data of each entry
+        //
+        {
+            std::fstream file("corrupted.zip", std::ios::in | std::ios::out | std::ios::binary);
+            std::string const archive((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            for(auto const & name : { std::string("s.txt"), std::string("d.txt") })
+            {
+                std::string::size_type const start(archive.find(name));
+                std::string::size_type const end(archive.find("PK", start));
+                CATCH_REQUIRE(start != std::string::npos);
+                CATCH_REQUIRE(end != std::string::npos);
+                std::string::size_type const pos((start + end) / 2);
+                file.clear();
+                file.seekp(pos);
+                file.put(static_cast<char>(archive[pos] ^ 0x20));
+            }
+        }
+
+        for(auto const mode : { zipios::ZipFile::OPEN_MODE_DEFAULT, zipios::ZipFile::OPEN_MODE_MEMORY_MAP })
+        {
+            zipios::ZipFile zf("corrupted.zip", 0, 0, mode);
+            zf.setCacheBudget(1 << 20);
+            for(auto const & name : { std::string("s.txt"), std::string("d.txt") })
+            {
+                for(int repeat(0); repeat < 2; ++repeat)
+                {
+                    zipios::FileCollection::stream_pointer_t is(zf.getInputStream(name));
+                    CATCH_REQUIRE(is);
+                    std::string data(content.length(), '\0');
+                    is->read(&data[0], data.length());
+                    CATCH_REQUIRE(is->bad());
+                }
+            }
+            CATCH_REQUIRE(zf.getCacheStatistics().m_entries == 0);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_seekable_streams", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    CATCH_START_SECTION("zipfile_seekable_streams: seek and readAt() in STORED and DEFLATED entries")
+    {
+        zipios_test::auto_unlink_t auto_unlink("seekable.zip", true);
+
+        std::string content;
+        uint32_t seed(7);
+        while(content.length() < 3 * 1024 * 1024)
+        {
+            seed = seed * 1103515245 + 12345;
+            content += "request " + std::to_string(seed % 1000000) + " served\n";
+        }
+
+        {
+            std::ofstream os("seekable.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(auto const method : g_supported_storage_methods)
+            {
+                zipios::StreamEntry entry(ss, zipios::FilePath(method == zipios::StorageMethod::STORED ? "stored.log" : "deflated.log"));
+                entry.setMethod(method);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        zipios::ZipFile::OpenMode const modes[]
+        {
+            zipios::ZipFile::OPEN_MODE_DEFAULT,
+            zipios::ZipFile::OPEN_MODE_SEEKABLE,
+            zipios::ZipFile::OPEN_MODE_SEEKABLE | zipios::ZipFile::OPEN_MODE_MEMORY_MAP,
+        };
+        for(auto const mode : modes)
+        {
+            zipios::ZipFile zf("seekable.zip", 0, 0, mode);
+
+            for(auto const & name : { std::string("stored.log"), std::string("deflated.log") })
+            {
+                // a stream can seek backward and forward
+                //
+                zipios::FileCollection::stream_pointer_t is(zf.getInputStream(name));
+                CATCH_REQUIRE(is);
+                std::string data(64, '\0');
+                zipios::offset_t const offsets[] = { 2500000, 100, 3000000, 1500000, 1500064, 0 };
+                for(auto const offset : offsets)
+                {
+                    is->seekg(offset);
+                    CATCH_REQUIRE(is->tellg() == offset);
+                    is->read(&data[0], data.length());
+                    CATCH_REQUIRE(data == content.substr(offset, data.length()));
+                }
+                is->seekg(0, std::ios::end);
+                CATCH_REQUIRE(static_cast<std::size_t>(is->tellg()) == content.length());
+
+                // random readAt() calls
+                //
+                char buf[1000];
+                for(int i(0); i < 50; ++i)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    zipios::offset_t const offset(seed % content.length());
+                    std::size_t const size(zf.readAt(name, offset, buf, sizeof(buf)));
+                    CATCH_REQUIRE(size == std::min(sizeof(buf), content.length() - offset));
+                    CATCH_REQUIRE(std::string(buf, size) == content.substr(offset, size));
+                }
+                CATCH_REQUIRE(zf.readAt(name, content.length() - 3, buf, sizeof(buf)) == 3);
+                CATCH_REQUIRE(zf.readAt(name, content.length() + 1, buf, sizeof(buf)) == 0);
+            }
+
+            char buf[10];
+            CATCH_REQUIRE_THROWS_AS(zf.readAt("unknown.log", 0, buf, sizeof(buf)), zipios::FileCollectionException);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_read_entry", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    CATCH_START_SECTION("zipfile_read_entry: read whole entries in vectors and buffers")
+    {
+        zipios_test::auto_unlink_t auto_unlink("read-entry.zip", true);
+
+        std::string content;
+        for(int i(0); i < 20000; ++i)
+        {
+            content += "line #" + std::to_string(i) + "\n";
+        }
+
+        {
+            std::ofstream os("read-entry.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(auto const method : g_supported_storage_methods)
+            {
+                std::string const suffix(method == zipios::StorageMethod::STORED ? "stored" : "deflated");
+
+                zipios::StreamEntry entry(ss, zipios::FilePath("data." + suffix));
+                entry.setMethod(method);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+
+                zipios::StreamEntry empty(ss, zipios::FilePath("empty." + suffix));
+                empty.setMethod(method);
+                zos.putNextEntry(empty.clone());
+            }
+        }
+
+        zipios::ZipFile::OpenMode const modes[]
+        {
+            zipios::ZipFile::OPEN_MODE_DEFAULT,
+            zipios::ZipFile::OPEN_MODE_MEMORY_MAP,
+            zipios::ZipFile::OPEN_MODE_LAZY_VALIDATION,
+        };
+        for(auto const mode : modes)
+        {
+            zipios::ZipFile zf("read-entry.zip", 0, 0, mode);
+
+            for(auto const & suffix : { std::string("stored"), std::string("deflated") })
+            {
+                std::vector<char> data;
+                CATCH_REQUIRE(zf.readEntry("data." + suffix, data));
+                CATCH_REQUIRE(std::string(data.begin(), data.end()) == content);
+
+                CATCH_REQUIRE(zf.readEntry("empty." + suffix, data));
+                CATCH_REQUIRE(data.empty());
+
+                std::vector<char> buf(content.length() + 10);
+                std::size_t size(buf.size());
+                CATCH_REQUIRE(zf.readEntry("data." + suffix, buf.data(), size));
+                CATCH_REQUIRE(size == content.length());
+                CATCH_REQUIRE(std::string(buf.data(), size) == content);
+
+                size = content.length() - 1;
+                CATCH_REQUIRE_THROWS_AS(zf.readEntry("data." + suffix, buf.data(), size), zipios::InvalidException);
+            }
+
+            // the same with the entries themselves
+            //
+            zipios::FileEntry::vector_t entries(zf.entries());
+            for(auto it(entries.begin()); it != entries.end(); ++it)
+            {
+                std::string const expected((*it)->getName().substr(0, 5) == "data." ? content : std::string());
+
+                std::vector<char> data;
+                CATCH_REQUIRE(zf.readEntry(**it, data));
+                CATCH_REQUIRE(std::string(data.begin(), data.end()) == expected);
+
+                std::vector<char> buf(content.length());
+                std::size_t size(buf.size());
+                CATCH_REQUIRE(zf.readEntry(**it, buf.data(), size));
+                CATCH_REQUIRE(std::string(buf.data(), size) == expected);
+            }
+
+            std::vector<char> data(3, 'x');
+            CATCH_REQUIRE_FALSE(zf.readEntry("unknown", data));
+            CATCH_REQUIRE(data.size() == 3);
+            std::size_t size(data.size());
+            CATCH_REQUIRE_FALSE(zf.readEntry("unknown", data.data(), size));
+        }
+
+        // corrupt one byte of each data entry
+        //
+        {
+            std::fstream file("read-entry.zip", std::ios::in | std::ios::out | std::ios::binary);
+            std::string const archive((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            for(auto const & name : { std::string("data.stored"), std::string("data.deflated") })
+            {
+                std::string::size_type const pos(archive.find(name));
+                CATCH_REQUIRE(pos != std::string::npos);
+                file.clear();
+                file.seekp(pos + name.length() + 20 + 100);
+                file.put(static_cast<char>(archive[pos + name.length() + 20 + 100] ^ 0x20));
+            }
+        }
+
+        zipios::ZipFile zf("read-entry.zip");
+        std::vector<char> data;
+        CATCH_REQUIRE_THROWS_AS(zf.readEntry("data.stored", data), zipios::FileCollectionException);
+        CATCH_REQUIRE_THROWS_AS(zf.readEntry("data.deflated", data), zipios::FileCollectionException);
+        CATCH_REQUIRE(zf.readEntry("empty.stored", data));
+        CATCH_REQUIRE(data.empty());
+
+        // the default implementation reads the input stream which
+        // fails on the corrupted data
+        //
+        zipios::CollectionCollection cc;
+        CATCH_REQUIRE(cc.addCollection(zf));
+        std::vector<char> buf(content.length());
+        for(auto const & name : { std::string("data.stored"), std::string("data.deflated") })
+        {
+            CATCH_REQUIRE_THROWS_AS(cc.readEntry(name, data), zipios::FileCollectionException);
+            std::size_t size(buf.size());
+            CATCH_REQUIRE_THROWS_AS(cc.readEntry(name, buf.data(), size), zipios::FileCollectionException);
+        }
+        CATCH_REQUIRE(cc.readEntry("empty.deflated", data));
+        CATCH_REQUIRE(data.empty());
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_read_entry: entries with the same name")
+    {
+        zipios_test::auto_unlink_t auto_unlink("read-entry-duplicate.zip", true);
+
+        std::string duplicates[2];
+        {
+            std::ofstream os("read-entry-duplicate.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(int i(0); i < 2; ++i)
+            {
+                for(int j(0); j < (i + 1) * 700; ++j)
+                {
+                    duplicates[i] += "duplicate " + std::to_string(i) + " line " + std::to_string(j) + "\n";
+                }
+
+                zipios::StreamEntry entry(ss, zipios::FilePath("dup.txt"));
+                entry.setMethod(g_supported_storage_methods[i]);
+                zos.putNextEntry(entry.clone());
+                zos << duplicates[i];
+            }
+        }
+
+        zipios::ZipFile zf("read-entry-duplicate.zip");
+        zipios::FileEntry::vector_t entries(zf.entries());
+        CATCH_REQUIRE(entries.size() == 2);
+        for(std::size_t idx(0); idx < entries.size(); ++idx)
+        {
+            std::vector<char> data;
+            CATCH_REQUIRE(zf.readEntry(*entries[idx], data));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == duplicates[idx]);
+
+            std::vector<char> buf(duplicates[1].length());
+            std::size_t size(buf.size());
+            CATCH_REQUIRE(zf.readEntry(*entries[idx], buf.data(), size));
+            CATCH_REQUIRE(std::string(buf.data(), size) == duplicates[idx]);
+
+            size = duplicates[idx].length() - 1;
+            CATCH_REQUIRE_THROWS_AS(zf.readEntry(*entries[idx], buf.data(), size), zipios::InvalidException);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_read_entry: default implementation through the input stream")
+    {
+        std::string const top_dir(SNAP_CATCH2_NAMESPACE::g_tmp_dir() + "/read-entry");
+        zipios_test::auto_unlink_t auto_unlink(top_dir, true);
+
+        CATCH_REQUIRE(system(("mkdir -p " + top_dir).c_str()) == 0);
+        {
+            std::ofstream file(top_dir + "/file.txt", std::ios::out | std::ios::binary);
+            file << "content of the file\n";
+        }
+
+        zipios::DirectoryCollection dc(top_dir);
+        std::vector<char> data;
+        CATCH_REQUIRE(dc.readEntry("file.txt", data, zipios::FileCollection::MatchPath::IGNORE));
+        CATCH_REQUIRE(std::string(data.begin(), data.end()) == "content of the file\n");
+
+        char buf[100];
+        std::size_t size(sizeof(buf));
+        CATCH_REQUIRE(dc.readEntry("file.txt", buf, size, zipios::FileCollection::MatchPath::IGNORE));
+        CATCH_REQUIRE(std::string(buf, size) == "content of the file\n");
+
+        size = 5;
+        CATCH_REQUIRE_THROWS_AS(dc.readEntry("file.txt", buf, size, zipios::FileCollection::MatchPath::IGNORE), zipios::InvalidException);
+        CATCH_REQUIRE_FALSE(dc.readEntry("unknown.txt", data));
+
+        zipios::FileEntry::pointer_t entry(dc.getEntry("file.txt", zipios::FileCollection::MatchPath::IGNORE));
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(dc.readEntry(*entry, data));
+        CATCH_REQUIRE(std::string(data.begin(), data.end()) == "content of the file\n");
+        size = sizeof(buf);
+        CATCH_REQUIRE(dc.readEntry(*entry, buf, size));
+        CATCH_REQUIRE(std::string(buf, size) == "content of the file\n");
+
+        // a file which got truncated is an error, not a shorter entry
+        //
+        {
+            std::ofstream file(top_dir + "/file.txt", std::ios::out | std::ios::binary);
+            file << "content";
+        }
+        CATCH_REQUIRE_THROWS_AS(dc.readEntry(*entry, data), zipios::FileCollectionException);
+        size = sizeof(buf);
+        CATCH_REQUIRE_THROWS_AS(dc.readEntry("file.txt", buf, size, zipios::FileCollection::MatchPath::IGNORE), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_read_entries", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    CATCH_START_SECTION("zipfile_read_entries: read many entries at once in archive order")
+    {
+        zipios_test::auto_unlink_t auto_unlink("read-entries.zip", true);
+
+        std::map<std::string, std::string> contents;
+        {
+            std::ofstream os("read-entries.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(int i(0); i < 300; ++i)
+            {
+                std::string const name("dir/file" + std::to_string(i) + ".txt");
+                std::string content;
+                int const lines(i % 50 == 0 ? 10000 : i % 7);
+                for(int j(0); j < lines; ++j)
+                {
+                    content += "file #" + std::to_string(i) + " line #" + std::to_string(j) + "\n";
+                }
+                contents[name] = content;
+
+                zipios::StreamEntry entry(ss, zipios::FilePath(name));
+                entry.setMethod(g_supported_storage_methods[i % 2]);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        zipios::ZipFile::OpenMode const modes[]
+        {
+            zipios::ZipFile::OPEN_MODE_DEFAULT,
+            zipios::ZipFile::OPEN_MODE_MEMORY_MAP,
+            zipios::ZipFile::OPEN_MODE_LAZY_VALIDATION,
+        };
+        for(auto const mode : modes)
+        {
+            zipios::ZipFile zf("read-entries.zip", 0, 0, mode);
+
+            // request the entries in reverse order, skipping some
+            //
+            zipios::FileEntry::vector_t all(zf.entries());
+            zipios::FileEntry::vector_t requested;
+            for(auto it(all.rbegin()); it != all.rend(); ++it)
+            {
+                if((*it)->getName().back() != '3')
+                {
+                    requested.push_back(*it);
+                }
+            }
+
+            for(std::size_t const gap : { static_cast<std::size_t>(0), zipios::ZipFile::DEFAULT_MERGE_GAP })
+            {
+                std::size_t count(0);
+                zipios::offset_t previous(-1);
+                zf.readEntries(
+                      requested
+                    , [&](zipios::FileEntry::pointer_t entry, char const * data, std::size_t size)
+                    {
+                        CATCH_REQUIRE(static_cast<zipios::offset_t>(entry->getEntryOffset()) > previous);
+                        previous = entry->getEntryOffset();
+                        CATCH_REQUIRE(size == entry->getSize());
+                        CATCH_REQUIRE(std::string(data, size) == contents[entry->getName()]);
+                        ++count;
+                    }
+                    , gap);
+                CATCH_REQUIRE(count == requested.size());
+            }
+
+            zipios::FileEntry::vector_t with_null{ all[0], zipios::FileEntry::pointer_t() };
+            CATCH_REQUIRE_THROWS_AS(zf.readEntries(with_null, [](zipios::FileEntry::pointer_t, char const *, std::size_t) noexcept {}), zipios::InvalidException);
+        }
+
+        // corrupt the data of one of the large entries
+        //
+        {
+            std::fstream file("read-entries.zip", std::ios::in | std::ios::out | std::ios::binary);
+            std::string const archive((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            std::string const name("dir/file250.txt");
+            std::string::size_type const pos(archive.find(name));
+            CATCH_REQUIRE(pos != std::string::npos);
+            file.clear();
+            file.seekp(pos + name.length() + 1000);
+            file.put(static_cast<char>(archive[pos + name.length() + 1000] ^ 0x20));
+        }
+
+        zipios::ZipFile zf("read-entries.zip");
+        std::size_t count(0);
+        CATCH_REQUIRE_THROWS_AS(zf.readEntries(
+                  zf.entries()
+                , [&](zipios::FileEntry::pointer_t, char const *, std::size_t) noexcept
+                {
+                    ++count;
+                }), zipios::FileCollectionException);
+        CATCH_REQUIRE(count == 250);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_read_entries: entries read through their stream")
+    {
+        zipios_test::auto_unlink_t auto_unlink("read-entries-stream.zip", true);
+
+        {
+            std::ofstream os("read-entries-stream.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            zipios::StreamEntry entry(ss, zipios::FilePath("archive.txt"));
+            zos.putNextEntry(entry.clone());
+            zos << "data from the archive\n";
+        }
+
+        // two entries with the same name added to the ZipFile, their
+        // streams have to be in the Zip format
+        //
+        std::string const contents[2] =
+        {
+            "first entry named dup.txt\n",
+            "second and longer entry named dup.txt\n",
+        };
+        std::stringstream streams[2];
+        zipios::ZipFile zf("read-entries-stream.zip");
+        for(int i(0); i < 2; ++i)
+        {
+            {
+                zipios::ZipOutputStream zos(streams[i]);
+                std::stringstream ss;
+                zipios::StreamEntry entry(ss, zipios::FilePath("dup.txt"));
+                entry.setMethod(g_supported_storage_methods[i]);
+                zos.putNextEntry(entry.clone());
+                zos << contents[i];
+            }
+            streams[i].seekg(0);
+
+            zipios::StreamEntry entry(streams[i], zipios::FilePath("dup.txt"));
+            entry.setSize(contents[i].length());
+            zf.addEntry(entry);
+        }
+
+        std::size_t count(0);
+        zf.readEntries(
+              zf.entries()
+            , [&](zipios::FileEntry::pointer_t entry, char const * data, std::size_t size)
+            {
+                CATCH_REQUIRE(size == entry->getSize());
+                if(entry->getName() == "archive.txt")
+                {
+                    CATCH_REQUIRE(std::string(data, size) == "data from the archive\n");
+                }
+                else
+                {
+                    CATCH_REQUIRE(std::string(data, size) == contents[size == contents[0].length() ? 0 : 1]);
+                }
+                ++count;
+            });
+        CATCH_REQUIRE(count == 3);
+
+        // a stream shorter than the entry is an error
+        //
+        streams[0].clear();
+        streams[0].seekg(0);
+        zipios::StreamEntry truncated(streams[0], zipios::FilePath("truncated.txt"));
+        truncated.setSize(contents[0].length() + 1);
+        zf.addEntry(truncated);
+        CATCH_REQUIRE_THROWS_AS(zf.readEntries(
+                  zf.entries()
+                , [](zipios::FileEntry::pointer_t, char const *, std::size_t) noexcept {}), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_extract_to", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    CATCH_START_SECTION("zipfile_extract_to: extract a tree with one or more threads")
+    {
+        CATCH_REQUIRE(system("rm -rf tree tree.zip extracted") == 0); // clean up, just in case
+        zipios_test::file_t tree(zipios_test::file_t::type_t::DIRECTORY, rand() % 40 + 80, "tree");
+        zipios_test::auto_unlink_t remove_zip("tree.zip", false);
+        zipios_test::auto_unlink_t remove_extracted("extracted", true);
+        {
+            zipios::DirectoryCollection dc("tree");
+            dc.setMethod(1024, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+            std::ofstream out("tree.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        for(std::size_t const threads : { 1, 4 })
+        {
+            CATCH_REQUIRE(system("rm -rf extracted") == 0);
+
+            zipios::ZipFile zf("tree.zip");
+            zipios::ZipFile::ExtractOptions options;
+            options.m_threads = threads;
+            zf.extractTo("extracted/", options);
+
+            zipios::FileEntry::vector_t entries(zf.entries());
+            for(auto it(entries.begin()); it != entries.end(); ++it)
+            {
+                std::string const filename("extracted/" + (*it)->getName());
+                struct stat st;
+                CATCH_REQUIRE(stat(filename.c_str(), &st) == 0);
+                CATCH_REQUIRE(st.st_mtime == (*it)->getUnixTime());
+                if((*it)->isDirectory())
+                {
+                    CATCH_REQUIRE(S_ISDIR(st.st_mode));
+                    continue;
+                }
+
+                std::vector<char> expected;
+                CATCH_REQUIRE(zf.readEntry((*it)->getName(), expected));
+                std::ifstream in(filename, std::ios::in | std::ios::binary);
+                std::string const data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                CATCH_REQUIRE(data == std::string(expected.begin(), expected.end()));
+            }
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_extract_to: large entries get streamed")
+    {
+        zipios_test::auto_unlink_t auto_unlink("extract-large.zip", true);
+        zipios_test::auto_unlink_t remove_extracted("extracted-large", true);
+        CATCH_REQUIRE(system("rm -rf extracted-large") == 0);
+
+        std::string content;
+        for(int i(0); content.length() <= zipios::ZipFile::MAXIMUM_BATCH_READ; ++i)
+        {
+            content += "line #" + std::to_string(i) + " of a large entry\n";
+        }
+
+        std::time_t const mtime(1600000000);
+        {
+            std::ofstream os("extract-large.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(auto const method : g_supported_storage_methods)
+            {
+                std::string const suffix(method == zipios::StorageMethod::STORED ? "stored" : "deflated");
+                zipios::StreamEntry entry(ss, zipios::FilePath("a/b/large." + suffix));
+                entry.setMethod(method);
+                entry.setUnixTime(mtime);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        zipios::ZipFile zf("extract-large.zip");
+        zf.extractTo("extracted-large");
+
+        for(auto const & suffix : { std::string("stored"), std::string("deflated") })
+        {
+            std::string const filename("extracted-large/a/b/large." + suffix);
+            std::ifstream in(filename, std::ios::in | std::ios::binary);
+            std::string const data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(data == content);
+
+            struct stat st;
+            CATCH_REQUIRE(stat(filename.c_str(), &st) == 0);
+            CATCH_REQUIRE(st.st_mtime == mtime);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_extract_to: names outside of the destination are refused")
+    {
+        zipios_test::auto_unlink_t auto_unlink("extract-unsafe.zip", true);
+        zipios_test::auto_unlink_t remove_extracted("extracted-unsafe", true);
+        CATCH_REQUIRE(system("rm -rf extracted-unsafe") == 0);
+
+        {
+            std::ofstream os("extract-unsafe.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            zipios::StreamEntry safe(ss, zipios::FilePath("safe.txt"));
+            zos.putNextEntry(safe.clone());
+            zos << "safe\n";
+            zipios::StreamEntry unsafe(ss, zipios::FilePath("dir/../../unsafe.txt"));
+            zos.putNextEntry(unsafe.clone());
+            zos << "unsafe\n";
+        }
+
+        zipios::ZipFile zf("extract-unsafe.zip");
+        CATCH_REQUIRE_THROWS_AS(zf.extractTo("extracted-unsafe"), zipios::FileCollectionException);
+
+        // nothing was created
+        //
+        struct stat st;
+        CATCH_REQUIRE(stat("extracted-unsafe", &st) != 0);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_extract_to: colons, backslashes and duplicate names")
+    {
+        zipios_test::auto_unlink_t auto_unlink("extract-names.zip", true);
+        zipios_test::auto_unlink_t remove_extracted("extracted-names", true);
+        CATCH_REQUIRE(system("rm -rf extracted-names") == 0);
+
+        std::map<std::string, std::string> expected;
+        {
+            std::ofstream os("extract-names.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            char const * names[] =
+            {
+                "logs/10:30.txt",
+                "back\\slash.txt",
+                "dup.txt",
+                "other.txt",
+                "dup.txt",
+            };
+            for(std::size_t idx(0); idx < sizeof(names) / sizeof(names[0]); ++idx)
+            {
+                std::string const content("entry #" + std::to_string(idx) + " named " + names[idx] + "\n");
+                expected[names[idx]] = content;
+
+                zipios::StreamEntry entry(ss, zipios::FilePath(names[idx]));
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        zipios::ZipFile zf("extract-names.zip");
+        zipios::ZipFile::ExtractOptions options;
+        options.m_threads = 4;
+        zf.extractTo("extracted-names", options);
+
+        // the last "dup.txt" entry wins
+        //
+        CATCH_REQUIRE(expected.size() == 4);
+        for(auto it(expected.begin()); it != expected.end(); ++it)
+        {
+            std::ifstream in("extracted-names/" + it->first, std::ios::in | std::ios::binary);
+            CATCH_REQUIRE(in);
+            std::string const data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(data == it->second);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_raw_input_stream", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    std::string content;
+    for(int i(0); i < 20000; ++i)
+    {
+        content += "raw line #" + std::to_string(i * 7) + "\n";
+    }
+
+    zipios_test::auto_unlink_t auto_unlink("raw.zip", true);
+    {
+        std::ofstream os("raw.zip", std::ios::out | std::ios::binary);
+        zipios::ZipOutputStream zos(os);
+        std::stringstream ss;
+        for(auto const method : g_supported_storage_methods)
+        {
+            std::string const suffix(method == zipios::StorageMethod::STORED ? "stored" : "deflated");
+            zipios::StreamEntry entry(ss, zipios::FilePath("raw." + suffix));
+            entry.setMethod(method);
+            zos.putNextEntry(entry.clone());
+            zos << content;
+        }
+        zipios::StreamEntry empty(ss, zipios::FilePath("empty.deflated"));
+        empty.setMethod(zipios::StorageMethod::DEFLATED);
+        zos.putNextEntry(empty.clone());
+    }
+
+    // inflate a raw deflate (-MAX_WBITS) or gzip (16 + MAX_WBITS) stream
+    //
+    auto inflate_all = [](std::string const & compressed, int window_bits)
+    {
+        z_stream zs = {};
+        CATCH_REQUIRE(inflateInit2(&zs, window_bits) == Z_OK);
+        std::string result;
+        char out[4096];
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+        zs.avail_in = static_cast<uInt>(compressed.size());
+        int err(Z_OK);
+        while(err == Z_OK)
+        {
+            zs.next_out = reinterpret_cast<Bytef *>(out);
+            zs.avail_out = sizeof(out);
+            err = inflate(&zs, Z_NO_FLUSH);
+            result.append(out, sizeof(out) - zs.avail_out);
+        }
+        CATCH_REQUIRE(err == Z_STREAM_END);
+        CATCH_REQUIRE(zs.avail_in == 0);
+        inflateEnd(&zs);
+        return result;
+    };
+
+    CATCH_START_SECTION("zipfile_raw_input_stream: raw data of STORED and DEFLATED entries")
+    {
+        for(auto const mode : { zipios::ZipFile::OPEN_MODE_DEFAULT, zipios::ZipFile::OPEN_MODE_MEMORY_MAP })
+        {
+            zipios::ZipFile zf("raw.zip", 0, 0, mode);
+
+            zipios::ZipFile::stream_pointer_t stored(zf.getRawInputStream("raw.stored"));
+            CATCH_REQUIRE(stored != nullptr);
+            std::string const stored_data((std::istreambuf_iterator<char>(*stored)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(stored_data == content);
+
+            zipios::FileEntry::pointer_t entry(zf.getEntry("raw.deflated"));
+            zipios::ZipFile::stream_pointer_t deflated(zf.getRawInputStream("raw.deflated"));
+            CATCH_REQUIRE(deflated != nullptr);
+            std::string const deflated_data((std::istreambuf_iterator<char>(*deflated)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(deflated_data.length() == entry->getCompressedSize());
+            CATCH_REQUIRE(deflated_data.length() < content.length());
+            CATCH_REQUIRE(inflate_all(deflated_data, -MAX_WBITS) == content);
+
+            // the stream positions are relative to the start of the data
+            //
+            deflated->clear();
+            deflated->seekg(10);
+            CATCH_REQUIRE(deflated->tellg() == 10);
+            CATCH_REQUIRE(deflated->get() == static_cast<unsigned char>(deflated_data[10]));
+
+            CATCH_REQUIRE(zf.getRawInputStream("missing.txt") == nullptr);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_raw_input_stream: DEFLATED entries as gzip members")
+    {
+        for(auto const mode : { zipios::ZipFile::OPEN_MODE_DEFAULT, zipios::ZipFile::OPEN_MODE_MEMORY_MAP })
+        {
+            zipios::ZipFile zf("raw.zip", 0, 0, mode);
+
+            std::stringstream gz;
+            CATCH_REQUIRE(zf.writeGZIPMember("raw.deflated", gz));
+            CATCH_REQUIRE(inflate_all(gz.str(), 16 + MAX_WBITS) == content);
+
+            std::stringstream empty;
+            CATCH_REQUIRE(zf.writeGZIPMember("empty.deflated", empty));
+            CATCH_REQUIRE(inflate_all(empty.str(), 16 + MAX_WBITS).empty());
+
+            std::stringstream ignored;
+            CATCH_REQUIRE_FALSE(zf.writeGZIPMember("missing.txt", ignored));
+            CATCH_REQUIRE_THROWS_AS(zf.writeGZIPMember("raw.stored", ignored), zipios::FileCollectionException);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_raw_copy", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    zipios_test::auto_unlink_t remove_first("raw-first.zip", true);
+    zipios_test::auto_unlink_t remove_second("raw-second.zip", true);
+    zipios_test::auto_unlink_t remove_output("raw-output.zip", true);
+
+    // create two archives with STORED and DEFLATED entries, the second
+    // archive has one entry with the same name as one in the first
+    //
+    std::map<std::string, std::string> contents;
+    for(int a(0); a < 2; ++a)
+    {
+        std::string const archive(a == 0 ? "raw-first.zip" : "raw-second.zip");
+        std::ofstream os(archive, std::ios::out | std::ios::binary);
+        zipios::ZipOutputStream zos(os);
+        std::stringstream ss;
+        for(int i(0); i < 10; ++i)
+        {
+            std::string const name(i == 9 ? "same.txt" : "file" + std::to_string(a * 10 + i) + ".txt");
+            std::string content;
+            for(int j(0); j < (i + 1) * 300; ++j)
+            {
+                content += "archive " + std::to_string(a) + " entry " + std::to_string(i) + " line " + std::to_string(j) + "\n";
+            }
+            if(contents.find(name) == contents.end())
+            {
+                contents[name] = content;
+            }
+
+            zipios::StreamEntry entry(ss, zipios::FilePath(name));
+            entry.setMethod(i % 2 == 0 ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED);
+            entry.setLevel(zipios::FileEntry::COMPRESSION_LEVEL_MAXIMUM);
+            zos.putNextEntry(entry.clone());
+            zos << content;
+        }
+    }
+
+    CATCH_START_SECTION("zipfile_raw_copy: saving a ZipFile copies the compressed data")
+    {
+        zipios::ZipFile source("raw-first.zip");
+        {
+            std::ofstream out("raw-output.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, source);
+        }
+
+        // the source entries were not modified
+        //
+        zipios::ZipFile original("raw-first.zip");
+        zipios::FileEntry::vector_t original_entries(original.entries());
+        zipios::FileEntry::vector_t source_entries(source.entries());
+        CATCH_REQUIRE(source_entries.size() == original_entries.size());
+        for(std::size_t idx(0); idx < source_entries.size(); ++idx)
+        {
+            CATCH_REQUIRE(source_entries[idx]->getEntryOffset() == original_entries[idx]->getEntryOffset());
+        }
+
+        zipios::ZipFile copy("raw-output.zip");
+        zipios::FileEntry::vector_t entries(copy.entries());
+        CATCH_REQUIRE(entries.size() == 10);
+        for(auto it(entries.begin()); it != entries.end(); ++it)
+        {
+            zipios::FileEntry::pointer_t entry(source.getEntry((*it)->getName()));
+            CATCH_REQUIRE(entry != nullptr);
+            CATCH_REQUIRE((*it)->getMethod() == entry->getMethod());
+            CATCH_REQUIRE((*it)->getCompressedSize() == entry->getCompressedSize());
+            CATCH_REQUIRE((*it)->getCrc() == entry->getCrc());
+
+            std::vector<char> data;
+            CATCH_REQUIRE(copy.readEntry((*it)->getName(), data));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == contents[(*it)->getName()]);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_raw_copy: entries with a new method get recompressed")
+    {
+        zipios::ZipFile source("raw-first.zip");
+        source.setMethod(0, zipios::StorageMethod::DEFLATED, zipios::StorageMethod::DEFLATED);
+        {
+            std::ofstream out("raw-output.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, source);
+        }
+
+        zipios::ZipFile copy("raw-output.zip");
+        zipios::FileEntry::vector_t entries(copy.entries());
+        CATCH_REQUIRE(entries.size() == 10);
+        for(auto it(entries.begin()); it != entries.end(); ++it)
+        {
+            CATCH_REQUIRE((*it)->getMethod() == zipios::StorageMethod::DEFLATED);
+            CATCH_REQUIRE((*it)->getCompressedSize() < (*it)->getSize());
+
+            std::vector<char> data;
+            CATCH_REQUIRE(copy.readEntry((*it)->getName(), data));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == contents[(*it)->getName()]);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_raw_copy: entries with a new level get recompressed")
+    {
+        zipios::ZipFile source("raw-first.zip");
+        source.setLevel(0, zipios::FileEntry::COMPRESSION_LEVEL_MINIMUM, zipios::FileEntry::COMPRESSION_LEVEL_MINIMUM);
+        {
+            std::ofstream out("raw-output.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, source);
+        }
+
+        // the same entries compressed with the minimum level
+        //
+        zipios_test::auto_unlink_t remove_reference("raw-reference.zip", true);
+        {
+            std::ofstream os("raw-reference.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            zipios::FileEntry::vector_t entries(source.entries());
+            for(auto it(entries.begin()); it != entries.end(); ++it)
+            {
+                zipios::StreamEntry entry(ss, zipios::FilePath((*it)->getName()));
+                entry.setMethod((*it)->getMethod());
+                entry.setLevel(zipios::FileEntry::COMPRESSION_LEVEL_MINIMUM);
+                zos.putNextEntry(entry.clone());
+                zos << contents[(*it)->getName()];
+            }
+        }
+
+        zipios::ZipFile original("raw-first.zip");
+        zipios::ZipFile reference("raw-reference.zip");
+        zipios::ZipFile copy("raw-output.zip");
+        zipios::FileEntry::vector_t entries(copy.entries());
+        CATCH_REQUIRE(entries.size() == 10);
+        for(auto it(entries.begin()); it != entries.end(); ++it)
+        {
+            zipios::FileEntry::pointer_t expected(reference.getEntry((*it)->getName()));
+            CATCH_REQUIRE(expected != nullptr);
+            CATCH_REQUIRE((*it)->getMethod() == expected->getMethod());
+            CATCH_REQUIRE((*it)->getCompressedSize() == expected->getCompressedSize());
+            if((*it)->getMethod() == zipios::StorageMethod::DEFLATED)
+            {
+                zipios::FileEntry::pointer_t entry(original.getEntry((*it)->getName()));
+                CATCH_REQUIRE(entry != nullptr);
+                CATCH_REQUIRE((*it)->getCompressedSize() != entry->getCompressedSize());
+            }
+
+            std::vector<char> data;
+            CATCH_REQUIRE(copy.readEntry((*it)->getName(), data));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == contents[(*it)->getName()]);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_raw_copy: merge archives")
+    {
+        zipios::FileCollection::vector_t collections;
+        collections.push_back(std::make_shared<zipios::ZipFile>("raw-first.zip"));
+        collections.push_back(std::make_shared<zipios::ZipFile>("raw-second.zip"));
+        {
+            std::ofstream out("raw-output.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::mergeArchives(out, collections, "merged");
+        }
+
+        zipios::ZipFile merged("raw-output.zip");
+        zipios::FileEntry::vector_t entries(merged.entries());
+        CATCH_REQUIRE(entries.size() == 19);
+        CATCH_REQUIRE(contents.size() == 19);
+        for(auto it(entries.begin()); it != entries.end(); ++it)
+        {
+            std::vector<char> data;
+            CATCH_REQUIRE(merged.readEntry((*it)->getName(), data));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == contents[(*it)->getName()]);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_raw_copy: putRawEntry() with an unknown entry")
+    {
+        zipios::ZipFile source("raw-first.zip");
+        zipios::DirectoryEntry unknown(zipios::FilePath("unknown.txt"));
+        std::stringstream out;
+        zipios::ZipOutputStream zos(out);
+        CATCH_REQUIRE_THROWS_AS(zos.putRawEntry(source, unknown.clone()), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_raw_copy: entries with the same name")
+    {
+        zipios_test::auto_unlink_t remove_duplicate("raw-duplicate.zip", true);
+
+        std::string duplicates[2];
+        {
+            std::ofstream os("raw-duplicate.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(int i(0); i < 2; ++i)
+            {
+                for(int j(0); j < (i + 1) * 500; ++j)
+                {
+                    duplicates[i] += "duplicate " + std::to_string(i) + " line " + std::to_string(j) + "\n";
+                }
+
+                zipios::StreamEntry entry(ss, zipios::FilePath("dup.txt"));
+                entry.setMethod(i == 0 ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED);
+                zos.putNextEntry(entry.clone());
+                zos << duplicates[i];
+            }
+        }
+
+        zipios::ZipFile source("raw-duplicate.zip");
+        CATCH_REQUIRE(source.entries().size() == 2);
+        {
+            std::ofstream out("raw-output.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, source);
+        }
+
+        // each entry must have its own data, read them by offset since
+        // searching by name always returns the first one
+        //
+        zipios::ZipFile copy("raw-output.zip");
+        zipios::FileEntry::vector_t entries(copy.entries());
+        CATCH_REQUIRE(entries.size() == 2);
+        for(std::size_t idx(0); idx < entries.size(); ++idx)
+        {
+            CATCH_REQUIRE(entries[idx]->getName() == "dup.txt");
+            CATCH_REQUIRE(entries[idx]->getSize() == duplicates[idx].length());
+
+            zipios::ZipInputStream zis("raw-output.zip", entries[idx]->getEntryOffset());
+            std::string const data((std::istreambuf_iterator<char>(zis)), std::istreambuf_iterator<char>());
+            CATCH_REQUIRE(zis);
+            CATCH_REQUIRE(data == duplicates[idx]);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_parallel_save", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    auto read_file = [](std::string const & filename)
+    {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    };
+
+    CATCH_START_SECTION("zipfile_parallel_save: the output is the same as the serial output")
+    {
+        CATCH_REQUIRE(system("rm -rf tree") == 0); // clean up, just in case
+        zipios_test::file_t tree(zipios_test::file_t::type_t::DIRECTORY, rand() % 40 + 80, "tree");
+        zipios_test::auto_unlink_t remove_serial("serial.zip", false);
+        zipios_test::auto_unlink_t remove_parallel("parallel.zip", false);
+
+        zipios::DirectoryCollection dc("tree");
+        dc.setMethod(1024, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        {
+            std::ofstream out("serial.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc, "comment");
+        }
+        std::string const serial(read_file("serial.zip"));
+
+        std::pair<std::size_t, std::size_t> const settings[] =
+        {
+            { 0, zipios::ZipFile::DEFAULT_SAVE_BUDGET },
+            { 1, zipios::ZipFile::DEFAULT_SAVE_BUDGET },
+            { 2, 1 },
+            { 7, 4096 },
+        };
+        for(auto const & setting : settings)
+        {
+            zipios::ZipFile::SaveOptions options;
+            options.m_threads = setting.first;
+            options.m_budget = setting.second;
+            {
+                std::ofstream out("parallel.zip", std::ios::out | std::ios::binary);
+                zipios::ZipFile::saveCollectionToArchive(out, dc, "comment", options);
+            }
+            CATCH_REQUIRE(read_file("parallel.zip") == serial);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_parallel_save: ZipFile entries get copied or recompressed")
+    {
+        zipios_test::auto_unlink_t remove_source("parallel-source.zip", true);
+        zipios_test::auto_unlink_t remove_serial("serial.zip", true);
+        zipios_test::auto_unlink_t remove_parallel("parallel.zip", true);
+        {
+            std::ofstream os("parallel-source.zip", std::ios::out | std::ios::binary);
+            zipios::ZipOutputStream zos(os);
+            std::stringstream ss;
+            for(int i(0); i < 30; ++i)
+            {
+                zipios::StreamEntry entry(ss, zipios::FilePath("file" + std::to_string(i) + ".txt"));
+                entry.setMethod(i % 2 == 0 ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED);
+                zos.putNextEntry(entry.clone());
+                for(int j(0); j < i * 100; ++j)
+                {
+                    zos << "entry " << i << " line " << j << "\n";
+                }
+            }
+        }
+
+        // entries of 1Kb or more get DEFLATED, the others keep their method
+        //
+        zipios::ZipFile serial_source("parallel-source.zip");
+        serial_source.setMethod(1024, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        {
+            std::ofstream out("serial.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, serial_source);
+        }
+
+        zipios::ZipFile parallel_source("parallel-source.zip");
+        parallel_source.setMethod(1024, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        zipios::ZipFile::SaveOptions options;
+        options.m_threads = 4;
+        {
+            std::ofstream out("parallel.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, parallel_source, std::string(), options);
+        }
+
+        CATCH_REQUIRE(read_file("parallel.zip") == read_file("serial.zip"));
+
+        zipios::ZipFile result("parallel.zip");
+        zipios::ZipFile original("parallel-source.zip");
+        zipios::FileEntry::vector_t entries(original.entries());
+        for(auto it(entries.begin()); it != entries.end(); ++it)
+        {
+            std::vector<char> expected;
+            CATCH_REQUIRE(original.readEntry((*it)->getName(), expected));
+            std::vector<char> data;
+            CATCH_REQUIRE(result.readEntry((*it)->getName(), data));
+            CATCH_REQUIRE(data == expected);
+        }
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zipfile_parallel_deflate", "[ZipFile][FileCollection]")
+{
+    zipios_test::safe_chdir cwd(SNAP_CATCH2_NAMESPACE::g_tmp_dir());
+
+    auto read_file = [](std::string const & filename)
+    {
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    };
+
+    CATCH_START_SECTION("zipfile_parallel_deflate: large entries get compressed in blocks")
+    {
+        CATCH_REQUIRE(system("rm -rf blocks") == 0); // clean up, just in case
+        zipios_test::auto_unlink_t remove_blocks("blocks", true);
+        zipios_test::auto_unlink_t remove_serial("serial.zip", true);
+        zipios_test::auto_unlink_t remove_parallel("parallel.zip", true);
+        CATCH_REQUIRE(system("mkdir -p blocks") == 0);
+
+        // sizes around the 32Kb blocks and the batches of 3 blocks
+        //
+        std::size_t const sizes[] =
+        {
+            1,
+            32 * 1024,
+            32 * 1024 + 1,
+            3 * 32 * 1024,
+            3 * 32 * 1024 + 1,
+            6 * 32 * 1024,
+            1000000,
+        };
+        std::map<std::string, std::string> contents;
+        uint32_t seed(rand());
+        for(auto const size : sizes)
+        {
+            std::string content;
+            while(content.length() < size)
+            {
+                seed = seed * 1103515245 + 12345;
+                content += "line " + std::to_string(seed % 1000) + " of the file\n";
+            }
+            content.resize(size);
+            std::string const name("file" + std::to_string(size) + ".txt");
+            std::ofstream out("blocks/" + name, std::ios::out | std::ios::binary);
+            out << content;
+            contents["blocks/" + name] = content;
+        }
+
+        zipios::DirectoryCollection dc("blocks");
+        dc.setMethod(1024, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        {
+            std::ofstream out("serial.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        // a budget of 1 byte makes the calling thread save all the entries
+        //
+        zipios::ZipFile::SaveOptions options;
+        options.m_threads = 3;
+        options.m_budget = 1;
+        options.m_block_size = 1024; // becomes 32Kb
+        {
+            std::ofstream out("parallel.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc, std::string(), options);
+        }
+
+        // the large entries differ but barely grow
+        //
+        std::size_t const serial_size(read_file("serial.zip").length());
+        std::size_t const parallel_size(read_file("parallel.zip").length());
+        CATCH_REQUIRE(read_file("parallel.zip") != read_file("serial.zip"));
+        CATCH_REQUIRE(parallel_size < serial_size + serial_size / 20);
+
+        // reading verifies the deflate stream and the CRC32
+        //
+        zipios::ZipFile zf("parallel.zip");
+        CATCH_REQUIRE(zf.size() == contents.size() + 1);
+        for(auto it(contents.begin()); it != contents.end(); ++it)
+        {
+            zipios::FileEntry::pointer_t entry(zf.getEntry(it->first));
+            CATCH_REQUIRE(entry != nullptr);
+            CATCH_REQUIRE(entry->getMethod() == (it->second.length() < 1024 ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED));
+            CATCH_REQUIRE(entry->getSize() == it->second.length());
+            std::vector<char> data;
+            CATCH_REQUIRE(zf.readEntry(it->first, data));
+            CATCH_REQUIRE(std::string(data.begin(), data.end()) == it->second);
+        }
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zipfile_parallel_deflate: one thread or no block size keeps the serial output")
+    {
+        CATCH_REQUIRE(system("rm -rf blocks") == 0); // clean up, just in case
+        zipios_test::file_t tree(zipios_test::file_t::type_t::DIRECTORY, rand() % 20 + 20, "blocks");
+        zipios_test::auto_unlink_t remove_serial("serial.zip", true);
+        zipios_test::auto_unlink_t remove_parallel("parallel.zip", true);
+
+        zipios::DirectoryCollection dc("blocks");
+        dc.setMethod(1024, zipios::StorageMethod::STORED, zipios::StorageMethod::DEFLATED);
+        {
+            std::ofstream out("serial.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc);
+        }
+
+        zipios::ZipFile::SaveOptions options;
+        options.m_threads = 1;
+        options.m_budget = 1;
+        options.m_block_size = 32 * 1024;
+        {
+            std::ofstream out("parallel.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc, std::string(), options);
+        }
+        CATCH_REQUIRE(read_file("parallel.zip") == read_file("serial.zip"));
+
+        options.m_threads = 4;
+        options.m_block_size = 0;
+        {
+            std::ofstream out("parallel.zip", std::ios::out | std::ios::binary);
+            zipios::ZipFile::saveCollectionToArchive(out, dc, std::string(), options);
+        }
+        CATCH_REQUIRE(read_file("parallel.zip") == read_file("serial.zip"));
+    }
+    CATCH_END_SECTION()
+}
+
+
 CATCH_TEST_CASE("test_memory_input_stream", "[ZipFile][MemoryStream]")
 {
     CATCH_START_SECTION("test_memory_input_stream: create files with a compressed file, save only 50% of the data")
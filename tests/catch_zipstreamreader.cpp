@@ -0,0 +1,322 @@
+/*
+  Zipios -- a small C++ library that provides easy access to .zip files.
+
+  Copyright (C) 2000-2007  Thomas Sondergaard
+  Copyright (c) 2015-2022  Made to Order Software Corp.  All Rights Reserved
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/** \file
+ *
+ * Zipios unit tests for the ZipStreamReader class.
+ */
+
+#include "catch_main.hpp"
+
+#include <src/crc32.hpp>
+#include <src/zipoutputstream.hpp>
+#include <zipios/streamentry.hpp>
+#include <zipios/zipiosexceptions.hpp>
+#include <zipios/zipstreamreader.hpp>
+
+#include <cstring>
+#include <sstream>
+
+#include <zlib.h>
+
+
+namespace
+{
+
+
+/** \brief A streambuf which cannot seek.
+ *
+ * This streambuf returns its data in small blocks and does not
+ * implement seeking, like a pipe.
+ */
+class pipe_streambuf
+    : public std::streambuf
+{
+public:
+    pipe_streambuf(std::string const & data)
+        : m_data(data)
+    {
+    }
+
+protected:
+    virtual int_type underflow() override
+    {
+        if(m_pos >= m_data.size())
+        {
+            return traits_type::eof();
+        }
+        std::size_t const size(std::min<std::size_t>(7, m_data.size() - m_pos));
+        std::memcpy(m_block, m_data.data() + m_pos, size);
+        m_pos += size;
+        setg(m_block, m_block, m_block + size);
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    std::string     m_data;
+    std::size_t     m_pos = 0;
+    char            m_block[7] = {};
+};
+
+
+void append16(std::string & out, std::uint16_t value)
+{
+    out += static_cast<char>(value);
+    out += static_cast<char>(value >> 8);
+}
+
+
+void append32(std::string & out, std::uint32_t value)
+{
+    append16(out, static_cast<std::uint16_t>(value));
+    append16(out, static_cast<std::uint16_t>(value >> 16));
+}
+
+
+std::string raw_deflate(std::string const & data)
+{
+    z_stream zs = {};
+    CATCH_REQUIRE(deflateInit2(&zs, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    std::string out(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    CATCH_REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+
+/** \brief Create a local entry followed by a data descriptor.
+ *
+ * This is what streaming tools generate: the local header has its
+ * CRC32 and sizes set to zero and bit 3 set.
+ */
+std::string streamed_entry(std::string const & name, std::string const & data, std::uint16_t method, bool descriptor_signature, std::uint32_t crc_delta = 0)
+{
+    std::string const compressed(method == 8 ? raw_deflate(data) : data);
+
+    std::string out;
+    append32(out, 0x04034b50);
+    append16(out, 20);
+    append16(out, 1 << 3);
+    append16(out, method);
+    append32(out, 0x21 << 16);      // 1980/1/1 00:00:00
+    append32(out, 0);
+    append32(out, 0);
+    append32(out, 0);
+    append16(out, static_cast<std::uint16_t>(name.length()));
+    append16(out, 0);
+    out += name;
+    out += compressed;
+    if(descriptor_signature)
+    {
+        append32(out, 0x08074b50);
+    }
+    append32(out, zipios::CRC32::update(0, data.data(), data.size()) + crc_delta);
+    append32(out, static_cast<std::uint32_t>(compressed.size()));
+    append32(out, static_cast<std::uint32_t>(data.size()));
+    return out;
+}
+
+
+std::string read_all(std::istream & is)
+{
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+
+} // no name namespace
+
+
+
+CATCH_TEST_CASE("zip_stream_reader_archive", "[ZipStreamReader]")
+{
+    CATCH_START_SECTION("zip_stream_reader_archive: read a ZipOutputStream archive through a pipe")
+    {
+        std::vector<std::string> contents;
+        std::stringstream archive;
+        {
+            zipios::ZipOutputStream zos(archive);
+            for(int i(0); i < 50; ++i)
+            {
+                std::string content;
+                for(int j(0); j < i * 37; ++j)
+                {
+                    content += "line " + std::to_string(j) + " of entry " + std::to_string(i) + "\n";
+                }
+                contents.push_back(content);
+
+                std::stringstream ss;
+                zipios::StreamEntry entry(ss, zipios::FilePath("file" + std::to_string(i) + ".txt"));
+                entry.setMethod(i % 3 == 0 ? zipios::StorageMethod::STORED : zipios::StorageMethod::DEFLATED);
+                zos.putNextEntry(entry.clone());
+                zos << content;
+            }
+        }
+
+        pipe_streambuf pipe(archive.str());
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+        for(int i(0); i < 50; ++i)
+        {
+            zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+            CATCH_REQUIRE(entry != nullptr);
+            CATCH_REQUIRE(entry->getName() == "file" + std::to_string(i) + ".txt");
+            CATCH_REQUIRE(entry->getSize() == contents[i].length());
+
+            // skip some of the entries without reading them, the next
+            // call to getNextEntry() has to skip their data
+            //
+            if(i % 5 != 4)
+            {
+                CATCH_REQUIRE(read_all(reader.getInputStream()) == contents[i]);
+            }
+        }
+        CATCH_REQUIRE(reader.getNextEntry() == nullptr);
+        CATCH_REQUIRE(reader.getNextEntry() == nullptr);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zip_stream_reader_archive: an empty input has no entries")
+    {
+        pipe_streambuf pipe((std::string()));
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+        CATCH_REQUIRE(reader.getNextEntry() == nullptr);
+    }
+    CATCH_END_SECTION()
+}
+
+
+CATCH_TEST_CASE("zip_stream_reader_data_descriptor", "[ZipStreamReader]")
+{
+    std::string large;
+    for(int j(0); j < 10000; ++j)
+    {
+        large += "data descriptor test " + std::to_string(j * j) + "\n";
+    }
+
+    CATCH_START_SECTION("zip_stream_reader_data_descriptor: entries with and without descriptor signature")
+    {
+        std::string data(streamed_entry("large.txt", large, 8, true));
+        data += streamed_entry("small.txt", "small", 8, false);
+        data += streamed_entry("empty.txt", std::string(), 8, true);
+        append32(data, 0x06054b50);
+
+        pipe_streambuf pipe(data);
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+
+        zipios::FileEntry::pointer_t entry(reader.getNextEntry());
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getName() == "large.txt");
+        CATCH_REQUIRE(entry->getSize() == 0);
+        CATCH_REQUIRE(read_all(reader.getInputStream()) == large);
+        CATCH_REQUIRE(entry->getSize() == large.length());
+        CATCH_REQUIRE(entry->getCrc() == zipios::CRC32::update(0, large.data(), large.size()));
+
+        entry = reader.getNextEntry();
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getName() == "small.txt");
+        CATCH_REQUIRE(read_all(reader.getInputStream()) == "small");
+        CATCH_REQUIRE(entry->getSize() == 5);
+
+        entry = reader.getNextEntry();
+        CATCH_REQUIRE(entry != nullptr);
+        CATCH_REQUIRE(entry->getName() == "empty.txt");
+        CATCH_REQUIRE(read_all(reader.getInputStream()).empty());
+
+        CATCH_REQUIRE(reader.getNextEntry() == nullptr);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zip_stream_reader_data_descriptor: a bad CRC32 is detected")
+    {
+        std::string data(streamed_entry("bad.txt", large, 8, true, 1));
+        pipe_streambuf pipe(data);
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+
+        CATCH_REQUIRE(reader.getNextEntry() != nullptr);
+        reader.getInputStream().exceptions(std::ios::badbit);
+        CATCH_REQUIRE_THROWS_AS(read_all(reader.getInputStream()), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zip_stream_reader_data_descriptor: skipping an entry still verifies its CRC32")
+    {
+        std::string data(streamed_entry("bad.txt", large, 8, false, 1));
+        pipe_streambuf pipe(data);
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+
+        CATCH_REQUIRE(reader.getNextEntry() != nullptr);
+        CATCH_REQUIRE_THROWS_AS(reader.getNextEntry(), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zip_stream_reader_data_descriptor: a STORED entry with a descriptor is rejected")
+    {
+        std::string data(streamed_entry("stored.txt", "stored", 0, true));
+        pipe_streambuf pipe(data);
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+
+        CATCH_REQUIRE_THROWS_AS(reader.getNextEntry(), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zip_stream_reader_data_descriptor: a truncated archive is detected")
+    {
+        std::string data(streamed_entry("truncated.txt", large, 8, true));
+        data.resize(data.size() / 2);
+        pipe_streambuf pipe(data);
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+
+        CATCH_REQUIRE(reader.getNextEntry() != nullptr);
+        CATCH_REQUIRE_THROWS_AS(reader.getNextEntry(), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+
+    CATCH_START_SECTION("zip_stream_reader_data_descriptor: garbage instead of a header is rejected")
+    {
+        pipe_streambuf pipe("not a zip archive");
+        std::istream in(&pipe);
+        zipios::ZipStreamReader reader(in);
+
+        CATCH_REQUIRE_THROWS_AS(reader.getNextEntry(), zipios::FileCollectionException);
+    }
+    CATCH_END_SECTION()
+}
+
+
+// Local Variables:
+// mode: cpp
+// indent-tabs-mode: nil
+// c-basic-offset: 4
+// tab-width: 4
+// End:
+
+// vim: ts=4 sw=4 et
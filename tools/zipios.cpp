@@ -66,8 +66,10 @@ void usage()
     std::cout << "  --count                 count the number of files in a .zip archive" << std::endl;
     std::cout << "  --count-directories     count the number of files in a .zip archive" << std::endl;
     std::cout << "  --count-files           count the number of files in a .zip archive" << std::endl;
+    std::cout << "  --extract <dir>         extract the files of a .zip archive in <dir>" << std::endl;
     std::cout << "  --help                  show this help screen" << std::endl;
     std::cout << "  --libzipios-version     print the library version and exit" << std::endl;
+    std::cout << "  --threads <count>       number of threads used to extract files" << std::endl;
     std::cout << "  --version               print this tool's version and exit" << std::endl;
     exit(1);
 }
@@ -107,7 +109,15 @@ enum class func_t
      * It represents the number of entries representing regular files
      * found in a Zip archive.
      */
-    COUNT_FILES
+    COUNT_FILES,
+
+    /** \brief Extract the files of a Zip archive.
+     *
+     * This function is used when the user specify --extract. It creates
+     * the directories and files found in the Zip archive in the specified
+     * directory.
+     */
+    EXTRACT
 };
 
 } // no name namespace
@@ -135,6 +145,8 @@ int main(int argc, char *argv[])
         // check the various command line options
         std::vector<std::string> files;
         func_t function(func_t::UNDEFINED);
+        std::string directory;
+        zipios::ZipFile::ExtractOptions options;
         for(int i(1); i < argc; ++i)
         {
             if(argv[i][0] == '-')
@@ -168,6 +180,27 @@ int main(int argc, char *argv[])
                 {
                     function = func_t::COUNT_FILES;
                 }
+                else if(strcmp(argv[i], "--extract") == 0)
+                {
+                    ++i;
+                    if(i >= argc)
+                    {
+                        std::cerr << g_progname << ":error: --extract expects a directory name." << std::endl;
+                        exit(1);
+                    }
+                    function = func_t::EXTRACT;
+                    directory = argv[i];
+                }
+                else if(strcmp(argv[i], "--threads") == 0)
+                {
+                    ++i;
+                    if(i >= argc)
+                    {
+                        std::cerr << g_progname << ":error: --threads expects a number." << std::endl;
+                        exit(1);
+                    }
+                    options.m_threads = strtoul(argv[i], nullptr, 10);
+                }
             }
             else
             {
@@ -234,6 +267,14 @@ int main(int argc, char *argv[])
             }
             break;
 
+        case func_t::EXTRACT:
+            for(auto it(files.begin()); it != files.end(); ++it)
+            {
+                zipios::ZipFile zf(*it);
+                zf.extractTo(directory, options);
+            }
+            break;
+
         default:
             std::cerr << g_progname << ":error: undefined function." << std::endl;
             usage();
@@ -37,6 +37,9 @@ namespace zipios
 {
 
 
+class FileEntryIndex;
+
+
 class FileCollection
 {
 public:
@@ -63,6 +66,10 @@ public:
     virtual FileEntry::pointer_t    getEntry(std::string const & name, MatchPath matchpath = MatchPath::MATCH) const;
     virtual stream_pointer_t        getInputStream(std::string const & entry_name, MatchPath matchpath = MatchPath::MATCH) = 0;
     virtual std::string             getName() const;
+    virtual bool                    readEntry(std::string const & entry_name, std::vector<char> & data, MatchPath matchpath = MatchPath::MATCH);
+    virtual bool                    readEntry(std::string const & entry_name, char * buf, std::size_t & size, MatchPath matchpath = MatchPath::MATCH);
+    virtual bool                    readEntry(FileEntry const & entry, std::vector<char> & data);
+    virtual bool                    readEntry(FileEntry const & entry, char * buf, std::size_t & size);
     virtual size_t                  size() const;
     bool                            isValid() const;
     virtual void                    mustBeValid() const;
@@ -70,8 +77,13 @@ public:
     void                            setLevel(size_t limit, FileEntry::CompressionLevel small_compression_level, FileEntry::CompressionLevel large_compression_level);
 
 protected:
+    void                            indexEntries();
+    static void                     readEntryStream(FileEntry const & entry, std::istream & is, char * buf);
+
     std::string                     m_filename = std::string();
     FileEntry::vector_t             m_entries = FileEntry::vector_t();
+    std::unique_ptr<FileEntryIndex> m_name_index;
+    std::unique_ptr<FileEntryIndex> m_filename_index;
     bool                            m_valid = true;
 };
 
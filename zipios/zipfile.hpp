@@ -39,34 +39,159 @@
 #include "zipios/filecollection.hpp"
 #include "zipios/virtualseeker.hpp"
 
+#include <functional>
+
 
 namespace zipios
 {
 
 
+class EntryCache;
+class RandomAccessFile;
+class ZipOutputStream;
+
+
 class ZipFile : public FileCollection
 {
 public:
-    static pointer_t            openEmbeddedZipFile(std::string const & filename);
+    typedef uint32_t            OpenMode;
+
+    static OpenMode const       OPEN_MODE_DEFAULT               = 0x0000;
+    static OpenMode const       OPEN_MODE_MEMORY_MAP            = 0x0001;
+    static OpenMode const       OPEN_MODE_LAZY_VALIDATION       = 0x0002;
+    static OpenMode const       OPEN_MODE_PARALLEL_VALIDATION   = 0x0004;
+    static OpenMode const       OPEN_MODE_SEEKABLE              = 0x0008;
+
+    static std::size_t const    DEFAULT_MERGE_GAP               = 64 * 1024;
+    static std::size_t const    MAXIMUM_BATCH_READ              = 16 * 1024 * 1024;
+    static std::size_t const    DEFAULT_SAVE_BUDGET             = 64 * 1024 * 1024;
+
+    typedef std::function<void(FileEntry::pointer_t entry, char const * data, std::size_t size)>
+                                entry_callback_t;
+
+    struct CacheStatistics
+    {
+        std::size_t             m_hits = 0;
+        std::size_t             m_misses = 0;
+        std::size_t             m_evictions = 0;
+        std::size_t             m_entries = 0;
+        std::size_t             m_size = 0;
+    };
+
+    struct ExtractOptions
+    {
+        std::size_t             m_threads = 0;
+        bool                    m_restore_times = true;
+    };
+
+    struct SaveOptions
+    {
+        std::size_t             m_threads = 0;
+        std::size_t             m_budget = DEFAULT_SAVE_BUDGET;
+        std::size_t             m_block_size = 0;
+    };
+
+    static pointer_t            openEmbeddedZipFile(std::string const & filename, OpenMode mode = OPEN_MODE_DEFAULT);
 
                                 ZipFile();
-                                ZipFile(std::string const & filename, offset_t s_off = 0, offset_t e_off = 0);
+                                ZipFile(std::string const & filename, offset_t s_off = 0, offset_t e_off = 0, OpenMode mode = OPEN_MODE_DEFAULT);
                                 ZipFile(std::istream & is, offset_t s_off = 0, offset_t e_off = 0);
     virtual pointer_t           clone() const override;
     virtual                     ~ZipFile() override;
 
+    virtual void                close() override;
     virtual stream_pointer_t    getInputStream(
                                           std::string const & entry_name
                                         , MatchPath matchpath = MatchPath::MATCH) override;
+    bool                        getStoredData(
+                                          std::string const & entry_name
+                                        , char const * & data
+                                        , std::size_t & size
+                                        , MatchPath matchpath = MatchPath::MATCH) const;
+    stream_pointer_t            getRawInputStream(
+                                          std::string const & entry_name
+                                        , MatchPath matchpath = MatchPath::MATCH);
+    bool                        writeGZIPMember(
+                                          std::string const & entry_name
+                                        , std::ostream & os
+                                        , MatchPath matchpath = MatchPath::MATCH);
+    virtual bool                readEntry(
+                                          std::string const & entry_name
+                                        , std::vector<char> & data
+                                        , MatchPath matchpath = MatchPath::MATCH) override;
+    virtual bool                readEntry(
+                                          std::string const & entry_name
+                                        , char * buf
+                                        , std::size_t & size
+                                        , MatchPath matchpath = MatchPath::MATCH) override;
+    virtual bool                readEntry(
+                                          FileEntry const & entry
+                                        , std::vector<char> & data) override;
+    virtual bool                readEntry(
+                                          FileEntry const & entry
+                                        , char * buf
+                                        , std::size_t & size) override;
+    void                        readEntries(
+                                          FileEntry::vector_t const & entries
+                                        , entry_callback_t const & callback
+                                        , std::size_t merge_gap = DEFAULT_MERGE_GAP);
+    std::size_t                 readAt(
+                                          std::string const & entry_name
+                                        , offset_t offset
+                                        , void * buf
+                                        , std::size_t size
+                                        , MatchPath matchpath = MatchPath::MATCH);
+    void                        extractTo(std::string const & path);
+    void                        extractTo(
+                                          std::string const & path
+                                        , ExtractOptions const & options);
+    void                        setCacheBudget(std::size_t budget);
+    std::size_t                 getCacheBudget() const;
+    CacheStatistics             getCacheStatistics() const;
     static void                 saveCollectionToArchive(
                                           std::ostream & os
                                         , FileCollection & collection
                                         , std::string const & zip_comment = std::string());
+    static void                 saveCollectionToArchive(
+                                          std::ostream & os
+                                        , FileCollection & collection
+                                        , std::string const & zip_comment
+                                        , SaveOptions const & options);
+    static void                 mergeArchives(
+                                          std::ostream & os
+                                        , FileCollection::vector_t const & collections
+                                        , std::string const & zip_comment = std::string());
 
 private:
+    friend class ZipOutputStream;
+
     void                        init(std::istream & is);
+    void                        init(unsigned char const * data, offset_t size);
+    void                        readCentralDirectory(unsigned char const * buf, std::size_t size, std::size_t count, std::size_t central_directory_size);
+    stream_pointer_t            getEntryInputStream(FileEntry const & entry);
+    stream_pointer_t            openEntry(FileEntry const & entry) const;
+    stream_pointer_t            getRawInputStream(FileEntry const & entry);
+    bool                        isDirectlyReadable(FileEntry const & entry) const;
+    bool                        isRawCopyable(FileEntry const & entry) const;
+    static void                 saveEntry(
+                                          ZipOutputStream & output_stream
+                                        , FileCollection & collection
+                                        , FileEntry::pointer_t entry);
+    void                        readEntryData(FileEntry const & entry, char * buf) const;
+    offset_t                    getEntryDataOffset(FileEntry const & entry, offset_t header_offset, unsigned char const * header) const;
+    void                        readEntryBatch(FileEntry::vector_t const & batch, entry_callback_t const & callback, FileEntry::buffer_t & buffer) const;
+    static void                 inflateEntryData(FileEntry const & entry, unsigned char const * in, char * buf);
+    static void                 verifyEntryCrc(FileEntry const & entry, char const * buf);
+    void                        extractEntry(FileEntry & entry, std::string const & filename, bool restore_time, std::vector<char> & buffer) const;
+    bool                        getMappedData(FileEntry const & entry, char const * & data, std::size_t & size) const;
+    void                        verifyLocalHeaders();
+    void                        verifyLocalHeader(FileEntry const & entry) const;
 
     VirtualSeeker               m_vs = VirtualSeeker();
+    OpenMode                    m_open_mode = OPEN_MODE_DEFAULT;
+    std::shared_ptr<RandomAccessFile>
+                                m_file = std::shared_ptr<RandomAccessFile>();
+    std::shared_ptr<EntryCache> m_cache = std::shared_ptr<EntryCache>();
 };
 
 